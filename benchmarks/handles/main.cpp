@@ -0,0 +1,322 @@
+/**
+ * @file benchmarks/handles/main.cpp
+ *
+ * This is a microbenchmark which measures the overhead of the SQLiteWrappers
+ * handle types, by creating, destroying, and stepping connections and
+ * statements at a high rate, through the wrappers and through the SQLite
+ * C API directly.
+ *
+ * For comparison, it also measures handles which use a type-erased
+ * std::function deleter, which is what the wrappers used to do.
+ *
+ * Usage: SQLiteHandlesBench [iterations]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <SQLiteWrappers/Wrappers.hpp>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace SQLiteWrappers;
+
+namespace {
+
+    /**
+     * This is the number of times each benchmark is repeated.  The fastest
+     * repetition is reported, to filter out noise from the rest of the
+     * system.
+     */
+    constexpr int REPETITIONS = 5;
+
+    /**
+     * This is the SQL text of the statement prepared and stepped by
+     * the statement benchmarks.
+     */
+    constexpr const char* STATEMENT = "SELECT 1";
+
+    /**
+     * This is a statement handle with a type-erased deleter, as the
+     * wrappers used to define PreparedStatement.
+     */
+    using ErasedStatement = std::unique_ptr< sqlite3_stmt, std::function< void(sqlite3_stmt*) > >;
+
+    /**
+     * This is a connection handle with a type-erased deleter, as the
+     * wrappers used to define DatabaseConnection.
+     */
+    using ErasedConnection = std::unique_ptr< sqlite3, std::function< void(sqlite3*) > >;
+
+    /**
+     * The move benchmarks store the handle here after each move, in the
+     * same way for every kind of handle, so that the compiler can't
+     * optimize the moves away.
+     */
+    const void* volatile movedHandle = nullptr;
+
+    /**
+     * Time the given benchmark, returning the average number of nanoseconds
+     * each iteration took in the fastest repetition, after one repetition
+     * to warm up.
+     *
+     * @param[in] iterations
+     *     This is the number of iterations to perform in each repetition.
+     *
+     * @param[in] body
+     *     This is the function which performs the given number of
+     *     iterations of the benchmark.
+     *
+     * @return
+     *     The average number of nanoseconds taken by each iteration
+     *     is returned.
+     */
+    template< typename Body >
+    double Time(
+        size_t iterations,
+        Body body
+    ) {
+        // Run once without timing, to warm up caches and the allocator.
+        body(iterations);
+        auto best = std::chrono::nanoseconds::max();
+        for (int repetition = 0; repetition < REPETITIONS; ++repetition) {
+            const auto start = std::chrono::steady_clock::now();
+            body(iterations);
+            const auto elapsed = std::chrono::duration_cast< std::chrono::nanoseconds >(
+                std::chrono::steady_clock::now() - start
+            );
+            best = std::min(best, elapsed);
+        }
+        return (double)best.count() / (double)iterations;
+    }
+
+    /**
+     * Print the result of one benchmark, along with how it compares to
+     * the result of using the C API directly.
+     *
+     * @param[in] name
+     *     This is the name of the benchmark.
+     *
+     * @param[in] nanoseconds
+     *     This is the average number of nanoseconds taken by each iteration
+     *     of the benchmark.
+     *
+     * @param[in] rawNanoseconds
+     *     This is the average number of nanoseconds taken by each iteration
+     *     of the same benchmark using the C API directly.
+     */
+    void Report(
+        const char* name,
+        double nanoseconds,
+        double rawNanoseconds
+    ) {
+        printf(
+            "%-44s %10.1f ns/op  %+7.1f%%\n",
+            name,
+            nanoseconds,
+            (nanoseconds - rawNanoseconds) * 100.0 / rawNanoseconds
+        );
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 200000;
+    if (argc > 1) {
+        iterations = (size_t)strtoull(argv[1], NULL, 10);
+        if (iterations == 0) {
+            fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    printf(
+        "handle sizes: raw %zu, PreparedStatement %zu, std::function deleter %zu bytes\n",
+        sizeof(sqlite3_stmt*),
+        sizeof(PreparedStatement),
+        sizeof(ErasedStatement)
+    );
+
+    // Connections are much more expensive than statements, so do fewer.
+    const auto connectionIterations = std::max(iterations / 20, (size_t)1);
+    const auto rawOpen = Time(
+        connectionIterations,
+        [](size_t iterations){
+            for (size_t i = 0; i < iterations; ++i) {
+                sqlite3* db;
+                (void)sqlite3_open_v2(":memory:", &db, SQLITE_OPEN_READWRITE, NULL);
+                (void)sqlite3_close(db);
+            }
+        }
+    );
+    Report("open/close connection (C API)", rawOpen, rawOpen);
+    Report(
+        "open/close connection (DatabaseConnection)",
+        Time(
+            connectionIterations,
+            [](size_t iterations){
+                for (size_t i = 0; i < iterations; ++i) {
+                    const auto db = OpenDatabase(":memory:", SQLITE_OPEN_READWRITE);
+                }
+            }
+        ),
+        rawOpen
+    );
+    Report(
+        "open/close connection (std::function deleter)",
+        Time(
+            connectionIterations,
+            [](size_t iterations){
+                for (size_t i = 0; i < iterations; ++i) {
+                    sqlite3* db;
+                    (void)sqlite3_open_v2(":memory:", &db, SQLITE_OPEN_READWRITE, NULL);
+                    const ErasedConnection handle(
+                        db,
+                        [](sqlite3* db){
+                            (void)sqlite3_close(db);
+                        }
+                    );
+                }
+            }
+        ),
+        rawOpen
+    );
+
+    // Churn through short-lived statements: prepare, step, finalize.
+    const auto db = OpenDatabase(":memory:");
+    if (!db) {
+        fprintf(stderr, "Unable to open database!\n");
+        return EXIT_FAILURE;
+    }
+    const auto rawChurn = Time(
+        iterations,
+        [&db](size_t iterations){
+            for (size_t i = 0; i < iterations; ++i) {
+                sqlite3_stmt* stmt;
+                (void)sqlite3_prepare_v2(db.get(), STATEMENT, -1, &stmt, NULL);
+                (void)sqlite3_step(stmt);
+                (void)sqlite3_finalize(stmt);
+            }
+        }
+    );
+    Report("prepare/step/finalize (C API)", rawChurn, rawChurn);
+    Report(
+        "prepare/step/finalize (PreparedStatement)",
+        Time(
+            iterations,
+            [&db](size_t iterations){
+                for (size_t i = 0; i < iterations; ++i) {
+                    const auto stmt = BuildStatement(db, STATEMENT);
+                    (void)StepStatement(stmt);
+                }
+            }
+        ),
+        rawChurn
+    );
+    Report(
+        "prepare/step/finalize (std::function deleter)",
+        Time(
+            iterations,
+            [&db](size_t iterations){
+                for (size_t i = 0; i < iterations; ++i) {
+                    sqlite3_stmt* stmt;
+                    (void)sqlite3_prepare_v2(db.get(), STATEMENT, -1, &stmt, NULL);
+                    const ErasedStatement handle(
+                        stmt,
+                        [](sqlite3_stmt* stmt){
+                            (void)sqlite3_finalize(stmt);
+                        }
+                    );
+                    (void)sqlite3_step(handle.get());
+                }
+            }
+        ),
+        rawChurn
+    );
+
+    // Pass statements around by moving their handles, as a statement
+    // cache or a queue of work would.
+    const auto rawMoves = Time(
+        iterations,
+        [&db](size_t iterations){
+            sqlite3_stmt* stmt;
+            (void)sqlite3_prepare_v2(db.get(), STATEMENT, -1, &stmt, NULL);
+            sqlite3_stmt* holder = stmt;
+            for (size_t i = 0; i < iterations; ++i) {
+                sqlite3_stmt* next = holder;
+                holder = nullptr;
+                holder = next;
+                movedHandle = holder;
+            }
+            (void)sqlite3_finalize(holder);
+        }
+    );
+    Report("move handle (C API)", rawMoves, rawMoves);
+    Report(
+        "move handle (PreparedStatement)",
+        Time(
+            iterations,
+            [&db](size_t iterations){
+                auto holder = BuildStatement(db, STATEMENT);
+                for (size_t i = 0; i < iterations; ++i) {
+                    auto next = std::move(holder);
+                    holder = std::move(next);
+                    movedHandle = holder.get();
+                }
+            }
+        ),
+        rawMoves
+    );
+    Report(
+        "move handle (std::function deleter)",
+        Time(
+            iterations,
+            [&db](size_t iterations){
+                sqlite3_stmt* stmt;
+                (void)sqlite3_prepare_v2(db.get(), STATEMENT, -1, &stmt, NULL);
+                ErasedStatement holder(
+                    stmt,
+                    [](sqlite3_stmt* stmt){
+                        (void)sqlite3_finalize(stmt);
+                    }
+                );
+                for (size_t i = 0; i < iterations; ++i) {
+                    auto next = std::move(holder);
+                    holder = std::move(next);
+                    movedHandle = holder.get();
+                }
+            }
+        ),
+        rawMoves
+    );
+
+    // Reuse one statement: step, reset, and clear bindings, as
+    // ResetStatement does.
+    const auto stmt = BuildStatement(db, STATEMENT);
+    const auto rawReuse = Time(
+        iterations,
+        [&stmt](size_t iterations){
+            for (size_t i = 0; i < iterations; ++i) {
+                (void)sqlite3_step(stmt.get());
+                (void)sqlite3_reset(stmt.get());
+                (void)sqlite3_clear_bindings(stmt.get());
+            }
+        }
+    );
+    Report("step/reset/clear bindings (C API)", rawReuse, rawReuse);
+    Report(
+        "step/reset/clear bindings (wrappers)",
+        Time(
+            iterations,
+            [&stmt](size_t iterations){
+                for (size_t i = 0; i < iterations; ++i) {
+                    (void)StepStatement(stmt);
+                    ResetStatement(stmt);
+                }
+            }
+        ),
+        rawReuse
+    );
+    return EXIT_SUCCESS;
+}
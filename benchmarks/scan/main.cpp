@@ -0,0 +1,355 @@
+/**
+ * @file benchmarks/scan/main.cpp
+ *
+ * This is a microbenchmark which measures the kernels the shell uses when
+ * it outputs CSV fields, SQL string literals and hex-encoded blobs, for
+ * each instruction set the CPU supports, against the byte-at-a-time loops
+ * the shell used before.
+ *
+ * Each kernel is run over long fields which need no quoting, which is
+ * the common case, and where the whole field has to be scanned.  Hex
+ * encoding is measured as the shell does it, writing to a stream (the
+ * null device), since the old loop called fprintf for each byte.
+ *
+ * Usage: SQLiteScanBench [field bytes]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <shellscan.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+    /**
+     * This is the number of times each benchmark is repeated.  The fastest
+     * repetition is reported, to filter out noise from the rest of the
+     * system.
+     */
+    constexpr int REPETITIONS = 5;
+
+    /**
+     * This is roughly the number of bytes processed by each repetition
+     * of each benchmark.
+     */
+    constexpr size_t BYTES_PER_REPETITION = 64 * 1024 * 1024;
+
+    /**
+     * This is the table the shell used to decide whether or not a CSV
+     * field needs quoting, one byte at a time.
+     */
+    const char NEED_CSV_QUOTE[256] = {
+        1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+        1, 0, 1, 0, 0, 0, 0, 1,   0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+    };
+
+    /**
+     * This is the loop the shell used to find the first byte of a
+     * nul-terminated CSV field which needs quoting.
+     */
+    size_t OldScanCsv(const char* z, char separator) {
+        size_t i;
+        for (i = 0; z[i]; ++i) {
+            if (
+                NEED_CSV_QUOTE[(unsigned char)z[i]]
+                || (z[i] == separator)
+            ) {
+                break;
+            }
+        }
+        return i;
+    }
+
+    /**
+     * This is the loop the shell used to find the first byte of a
+     * nul-terminated string which needs escaping in an SQL literal.
+     */
+    size_t OldScanQuote(const char* z) {
+        size_t i;
+        char c;
+        for (i = 0; (c = z[i]) != 0 && c != '\'' && c != '\n' && c != '\r'; ++i) {
+        }
+        return i;
+    }
+
+    /**
+     * This is the size of the buffer into which the shell hex-encodes
+     * a blob, a piece at a time, as in output_hex_blob().
+     */
+    constexpr size_t HEX_BUFFER_SIZE = 2048;
+
+    /**
+     * This is the loop the shell used to write a blob in hex to a stream,
+     * one fprintf per byte, as in output_hex_blob().
+     */
+    void OldHexOutput(FILE* out, const unsigned char* blob, size_t n) {
+        const auto zBlob = (const char*)blob;
+        for (size_t i = 0; i < n; ++i) {
+            (void)fprintf(out, "%02x", zBlob[i] & 0xff);
+        }
+    }
+
+    /**
+     * This is how the shell now writes a blob in hex to a stream, encoding
+     * it a buffer at a time with the given kernels, as in output_hex_blob().
+     */
+    void HexOutput(
+        FILE* out,
+        const ShellScanKernels* k,
+        const unsigned char* blob,
+        size_t n
+    ) {
+        char hex[HEX_BUFFER_SIZE];
+        while (n > 0) {
+            const auto chunk = std::min(n, sizeof(hex) / 2);
+            k->xHexEncode(hex, blob, chunk);
+            (void)fwrite(hex, 1, 2 * chunk, out);
+            blob += chunk;
+            n -= chunk;
+        }
+    }
+
+    /**
+     * Time the given benchmark, returning the number of bytes it processed
+     * per nanosecond (which is gigabytes per second) in the fastest
+     * repetition, after one repetition to warm up.
+     *
+     * @param[in] iterations
+     *     This is the number of iterations to perform in each repetition.
+     *
+     * @param[in] bytes
+     *     This is the number of bytes processed by each iteration.
+     *
+     * @param[in] body
+     *     This is the function which performs the given number of
+     *     iterations of the benchmark.
+     *
+     * @return
+     *     The throughput of the benchmark, in gigabytes per second,
+     *     is returned.
+     */
+    template< typename Body >
+    double Time(
+        size_t iterations,
+        size_t bytes,
+        Body body
+    ) {
+        // Run once without timing, to warm up caches.
+        body(iterations);
+        auto best = std::chrono::nanoseconds::max();
+        for (int repetition = 0; repetition < REPETITIONS; ++repetition) {
+            const auto start = std::chrono::steady_clock::now();
+            body(iterations);
+            const auto elapsed = std::chrono::duration_cast< std::chrono::nanoseconds >(
+                std::chrono::steady_clock::now() - start
+            );
+            best = std::min(best, elapsed);
+        }
+        return (double)(iterations * bytes) / (double)best.count();
+    }
+
+    /**
+     * Print the result of one benchmark, along with how it compares to
+     * the result of the old loop.
+     *
+     * @param[in] name
+     *     This is the name of the benchmark.
+     *
+     * @param[in] throughput
+     *     This is the throughput of the benchmark, in gigabytes per second.
+     *
+     * @param[in] oldThroughput
+     *     This is the throughput of the old loop, in gigabytes per second.
+     */
+    void Report(
+        const char* name,
+        double throughput,
+        double oldThroughput
+    ) {
+        printf(
+            "%-32s %8.2f GB/s  %7.1fx\n",
+            name,
+            throughput,
+            throughput / oldThroughput
+        );
+    }
+
+    /**
+     * This keeps the compiler from optimizing away results which are
+     * otherwise unused.
+     */
+    volatile size_t sink;
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t fieldBytes = 4096;
+    if (argc > 1) {
+        fieldBytes = (size_t)strtoull(argv[1], NULL, 10);
+        if (fieldBytes == 0) {
+            fprintf(stderr, "usage: %s [field bytes]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    const auto iterations = std::max(BYTES_PER_REPETITION / fieldBytes, (size_t)1);
+
+    // A field of printable text with nothing in it which needs quoting,
+    // and a blob of arbitrary bytes.
+    std::vector< char > field(fieldBytes + 1);
+    std::vector< unsigned char > blob(fieldBytes);
+    std::vector< char > hex(2 * fieldBytes + 1);
+    for (size_t i = 0; i < fieldBytes; ++i) {
+        field[i] = (char)('a' + i % 26);
+        blob[i] = (unsigned char)(i * 131 + 7);
+    }
+    field[fieldBytes] = 0;
+
+    // Every set of kernels built into the program, whether or not the
+    // CPU supports it; unsupported ones are skipped below.
+    std::vector< const ShellScanKernels* > kernels{&shellScanScalar};
+#if SHELL_SCAN_SSE2
+    kernels.push_back(&shellScanSse2);
+#endif
+#if SHELL_SCAN_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back(&shellScanAvx2);
+    }
+#endif
+#if SHELL_SCAN_NEON
+    kernels.push_back(&shellScanNeon);
+#endif
+    shellScanInit();
+    printf(
+        "field size %zu bytes, kernels chosen at runtime: %s\n",
+        fieldBytes,
+        shellScan->zName
+    );
+
+    char name[64];
+    const auto oldCsv = Time(
+        iterations,
+        fieldBytes,
+        [&field](size_t iterations){
+            for (size_t i = 0; i < iterations; ++i) {
+                sink = OldScanCsv(field.data(), ',');
+            }
+        }
+    );
+    Report("CSV scan (old loop)", oldCsv, oldCsv);
+    for (const auto k: kernels) {
+        (void)snprintf(name, sizeof(name), "CSV scan (%s)", k->zName);
+        Report(
+            name,
+            Time(
+                iterations,
+                fieldBytes,
+                [&field, k](size_t iterations){
+                    for (size_t i = 0; i < iterations; ++i) {
+                        // The shell needs the length of the field first.
+                        const auto n = strlen(field.data());
+                        sink = k->xScanCsv(field.data(), n, ',');
+                    }
+                }
+            ),
+            oldCsv
+        );
+    }
+
+    const auto oldQuote = Time(
+        iterations,
+        fieldBytes,
+        [&field](size_t iterations){
+            for (size_t i = 0; i < iterations; ++i) {
+                sink = OldScanQuote(field.data());
+            }
+        }
+    );
+    Report("quote scan (old loop)", oldQuote, oldQuote);
+    for (const auto k: kernels) {
+        (void)snprintf(name, sizeof(name), "quote scan (%s)", k->zName);
+        Report(
+            name,
+            Time(
+                iterations,
+                fieldBytes,
+                [&field, k](size_t iterations){
+                    for (size_t i = 0; i < iterations; ++i) {
+                        const auto n = strlen(field.data());
+                        sink = k->xScanQuote(field.data(), n, 1);
+                    }
+                }
+            ),
+            oldQuote
+        );
+    }
+
+#if defined(_WIN32)
+    const auto nullDevice = fopen("NUL", "wb");
+#else
+    const auto nullDevice = fopen("/dev/null", "wb");
+#endif
+    if (nullDevice == NULL) {
+        fprintf(stderr, "cannot open the null device\n");
+        return EXIT_FAILURE;
+    }
+
+    // The old hex output is so slow that it gets fewer iterations.
+    const auto hexIterations = std::max(iterations / 16, (size_t)1);
+    const auto oldHex = Time(
+        hexIterations,
+        fieldBytes,
+        [&blob, nullDevice](size_t iterations){
+            for (size_t i = 0; i < iterations; ++i) {
+                OldHexOutput(nullDevice, blob.data(), blob.size());
+            }
+        }
+    );
+    Report("hex output (old loop)", oldHex, oldHex);
+    for (size_t i = 0; i < fieldBytes; ++i) {
+        (void)snprintf(&hex[2 * i], 3, "%02x", blob[i]);
+    }
+    for (const auto k: kernels) {
+        std::vector< char > encoded(2 * fieldBytes + 1);
+        k->xHexEncode(encoded.data(), blob.data(), blob.size());
+        if (memcmp(encoded.data(), hex.data(), 2 * fieldBytes) != 0) {
+            fprintf(stderr, "hex encode (%s) gives the wrong result!\n", k->zName);
+            (void)fclose(nullDevice);
+            return EXIT_FAILURE;
+        }
+        (void)snprintf(name, sizeof(name), "hex output (%s)", k->zName);
+        Report(
+            name,
+            Time(
+                iterations,
+                fieldBytes,
+                [&blob, nullDevice, k](size_t iterations){
+                    for (size_t i = 0; i < iterations; ++i) {
+                        HexOutput(nullDevice, k, blob.data(), blob.size());
+                    }
+                }
+            ),
+            oldHex
+        );
+    }
+    (void)fclose(nullDevice);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,329 @@
+/**
+ * @file Baseline.cpp
+ *
+ * This module contains the implementation of the functions SQLiteBench
+ * uses to store and compare baselines.
+ *
+ * Baselines are stored as text, one line per set of samples, with the
+ * build configuration, the workload, the number of threads and the metric
+ * separated by tabs, followed by a tab and the values separated by spaces.
+ * Lines which begin with '#' are comments.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Baseline.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+
+    /**
+     * These are the 97.5th percentiles of Student's t-distribution with
+     * 1 to 30 degrees of freedom, which bound 95% confidence intervals.
+     */
+    const double T_975[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+
+    /**
+     * Return the 97.5th percentile of Student's t-distribution with the
+     * given number of degrees of freedom.
+     *
+     * @param[in] degreesOfFreedom
+     *     This is the number of degrees of freedom, which need not be a
+     *     whole number.
+     *
+     * @return
+     *     The percentile is returned.
+     */
+    double StudentT975(double degreesOfFreedom) {
+        const size_t tableSize = sizeof(T_975) / sizeof(T_975[0]);
+        if (degreesOfFreedom < 1.0) {
+            return T_975[0];
+        }
+        if (degreesOfFreedom <= (double)tableSize) {
+            // Round down, which errs on the side of a wider interval.
+            return T_975[(size_t)degreesOfFreedom - 1];
+        }
+
+        // Beyond the table, the percentile approaches that of the normal
+        // distribution roughly in proportion to 1 / degreesOfFreedom.
+        return 1.960 + (T_975[tableSize - 1] - 1.960) * (double)tableSize / degreesOfFreedom;
+    }
+
+    /**
+     * Return the mean of the given values.
+     *
+     * @param[in] values
+     *     These are the values.  There must be at least one.
+     *
+     * @return
+     *     The mean of the values is returned.
+     */
+    double Mean(const std::vector< double >& values) {
+        double sum = 0.0;
+        for (const auto value: values) {
+            sum += value;
+        }
+        return sum / (double)values.size();
+    }
+
+    /**
+     * Return the sample variance of the given values.
+     *
+     * @param[in] values
+     *     These are the values.  There must be at least two.
+     *
+     * @param[in] mean
+     *     This is the mean of the values.
+     *
+     * @return
+     *     The sample variance of the values is returned.
+     */
+    double Variance(
+        const std::vector< double >& values,
+        double mean
+    ) {
+        double sum = 0.0;
+        for (const auto value: values) {
+            sum += (value - mean) * (value - mean);
+        }
+        return sum / (double)(values.size() - 1);
+    }
+
+    /**
+     * Split the given text at each occurrence of the given delimiter.
+     *
+     * @param[in] text
+     *     This is the text to split.
+     *
+     * @param[in] delimiter
+     *     This is the character at which to split the text.
+     *
+     * @return
+     *     The pieces of the text between delimiters are returned.
+     */
+    std::vector< std::string > Split(
+        const std::string& text,
+        char delimiter
+    ) {
+        std::vector< std::string > pieces;
+        size_t start = 0;
+        for (;;) {
+            const auto end = text.find(delimiter, start);
+            if (end == std::string::npos) {
+                pieces.push_back(text.substr(start));
+                return pieces;
+            }
+            pieces.push_back(text.substr(start, end - start));
+            start = end + 1;
+        }
+    }
+
+}
+
+namespace SQLiteBench {
+
+    Summary Summarize(const std::vector< double >& values) {
+        Summary summary;
+        if (values.empty()) {
+            return summary;
+        }
+        summary.mean = Mean(values);
+        if (values.size() >= 2) {
+            const auto n = (double)values.size();
+            summary.halfWidth = (
+                StudentT975(n - 1.0)
+                * sqrt(Variance(values, summary.mean) / n)
+            );
+        }
+        return summary;
+    }
+
+    Comparison Compare(
+        const std::vector< double >& baseline,
+        const std::vector< double >& values
+    ) {
+        Comparison comparison;
+        if (baseline.empty() || values.empty()) {
+            return comparison;
+        }
+        const auto baselineMean = Mean(baseline);
+        const auto mean = Mean(values);
+        if (baselineMean == 0.0) {
+            return comparison;
+        }
+        const auto difference = mean - baselineMean;
+        comparison.change = difference / baselineMean;
+        comparison.low = comparison.change;
+        comparison.high = comparison.change;
+        if ((baseline.size() < 2) || (values.size() < 2)) {
+            return comparison;
+        }
+        comparison.enoughTrials = true;
+        const auto baselineSquaredError = Variance(baseline, baselineMean) / (double)baseline.size();
+        const auto squaredError = Variance(values, mean) / (double)values.size();
+        const auto standardError = sqrt(baselineSquaredError + squaredError);
+        if (standardError > 0.0) {
+            // Welch-Satterthwaite approximation of the degrees of freedom.
+            const auto degreesOfFreedom = (
+                (standardError * standardError * standardError * standardError)
+                / (
+                    baselineSquaredError * baselineSquaredError / (double)(baseline.size() - 1)
+                    + squaredError * squaredError / (double)(values.size() - 1)
+                )
+            );
+            const auto halfWidth = StudentT975(degreesOfFreedom) * standardError;
+            comparison.low = (difference - halfWidth) / fabs(baselineMean);
+            comparison.high = (difference + halfWidth) / fabs(baselineMean);
+        }
+        comparison.significant = (comparison.low > 0.0) || (comparison.high < 0.0);
+        return comparison;
+    }
+
+    bool LoadBaseline(
+        const std::string& path,
+        std::vector< Samples >& samples
+    ) {
+        const auto file = fopen(path.c_str(), "r");
+        if (file == NULL) {
+            return false;
+        }
+        std::string line;
+        int c;
+        bool ok = true;
+        do {
+            c = fgetc(file);
+            if ((c != EOF) && (c != '\n')) {
+                line += (char)c;
+                continue;
+            }
+            if (!line.empty() && (line[0] != '#')) {
+                const auto fields = Split(line, '\t');
+                if (fields.size() != 5) {
+                    ok = false;
+                    break;
+                }
+                Samples entry;
+                entry.config = fields[0];
+                entry.workload = fields[1];
+                entry.threads = (unsigned int)strtoul(fields[2].c_str(), NULL, 10);
+                entry.metric = fields[3];
+                for (const auto& value: Split(fields[4], ' ')) {
+                    if (!value.empty()) {
+                        entry.values.push_back(strtod(value.c_str(), NULL));
+                    }
+                }
+                samples.push_back(std::move(entry));
+            }
+            line.clear();
+        } while (c != EOF);
+        (void)fclose(file);
+        return ok;
+    }
+
+    bool SaveBaseline(
+        const std::string& path,
+        const std::vector< Samples >& samples
+    ) {
+        // Writing nothing would only throw away what's stored.
+        if (samples.empty()) {
+            return false;
+        }
+
+        // Keep every baseline which wasn't measured again.  A missing
+        // file just means there aren't any yet, but one which can't be
+        // read in full would lose some of them, so leave it alone.
+        std::vector< Samples > entries;
+        const auto oldFile = fopen(path.c_str(), "r");
+        if (oldFile != NULL) {
+            (void)fclose(oldFile);
+            if (!LoadBaseline(path, entries)) {
+                return false;
+            }
+        }
+        for (const auto& entry: samples) {
+            auto replaced = false;
+            for (auto& oldEntry: entries) {
+                if (
+                    (oldEntry.config == entry.config)
+                    && (oldEntry.workload == entry.workload)
+                    && (oldEntry.threads == entry.threads)
+                    && (oldEntry.metric == entry.metric)
+                ) {
+                    oldEntry.values = entry.values;
+                    replaced = true;
+                }
+            }
+            if (!replaced) {
+                entries.push_back(entry);
+            }
+        }
+
+        // Write a new file and then put it in place of the old one, so
+        // that the old one survives anything going wrong on the way.
+        const auto newPath = path + ".tmp";
+        const auto file = fopen(newPath.c_str(), "w");
+        if (file == NULL) {
+            return false;
+        }
+        fprintf(file, "# SQLiteBench baselines: config, workload, threads, metric, values\n");
+        for (const auto& entry: entries) {
+            fprintf(
+                file,
+                "%s\t%s\t%u\t%s\t",
+                entry.config.c_str(),
+                entry.workload.c_str(),
+                entry.threads,
+                entry.metric.c_str()
+            );
+            for (size_t i = 0; i < entry.values.size(); ++i) {
+                fprintf(file, "%s%.17g", (i == 0) ? "" : " ", entry.values[i]);
+            }
+            fprintf(file, "\n");
+        }
+        const auto written = !ferror(file);
+        if (
+            (fclose(file) != 0)
+            || !written
+        ) {
+            (void)remove(newPath.c_str());
+            return false;
+        }
+#ifdef _WIN32
+        // Windows won't rename a file over one which exists.
+        (void)remove(path.c_str());
+#endif
+        if (rename(newPath.c_str(), path.c_str()) != 0) {
+            (void)remove(newPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    const Samples* FindSamples(
+        const std::vector< Samples >& samples,
+        const std::string& config,
+        const std::string& workload,
+        unsigned int threads,
+        const std::string& metric
+    ) {
+        for (const auto& entry: samples) {
+            if (
+                (entry.config == config)
+                && (entry.workload == workload)
+                && (entry.threads == threads)
+                && (entry.metric == metric)
+            ) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+}
@@ -0,0 +1,212 @@
+#ifndef SQLITE_BENCH_BASELINE_HPP
+#define SQLITE_BENCH_BASELINE_HPP
+
+/**
+ * @file Baseline.hpp
+ *
+ * This module declares the functions SQLiteBench uses to store the results
+ * of its runs as baselines, and to decide whether or not the results of a
+ * later run differ significantly from a baseline.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace SQLiteBench {
+
+    /**
+     * This holds the values one metric of one workload took in each trial
+     * of a run, for one build configuration.
+     */
+    struct Samples {
+        /**
+         * This is the name of the build configuration which was measured,
+         * such as "release-3.31.1".
+         */
+        std::string config;
+
+        /**
+         * This is the name of the workload which was measured.
+         */
+        std::string workload;
+
+        /**
+         * This is the number of threads on which the workload ran.
+         */
+        unsigned int threads = 1;
+
+        /**
+         * This is the name of the metric, such as "ops_per_sec".
+         */
+        std::string metric;
+
+        /**
+         * These are the values the metric took, one per trial.
+         */
+        std::vector< double > values;
+    };
+
+    /**
+     * This summarizes a set of values of one metric.
+     */
+    struct Summary {
+        /**
+         * This is the mean of the values.
+         */
+        double mean = 0.0;
+
+        /**
+         * This is half the width of the 95% confidence interval of the
+         * mean, from Student's t-distribution, or zero if there are fewer
+         * than two values.
+         */
+        double halfWidth = 0.0;
+    };
+
+    /**
+     * This holds the outcome of comparing the values of a metric in a new
+     * run with its values in a baseline.  Changes are relative to the mean
+     * of the baseline, so 0.05 means 5% more than the baseline.
+     */
+    struct Comparison {
+        /**
+         * This is the relative change of the mean.
+         */
+        double change = 0.0;
+
+        /**
+         * This is the lower bound of the 95% confidence interval of
+         * the relative change.
+         */
+        double low = 0.0;
+
+        /**
+         * This is the upper bound of the 95% confidence interval of
+         * the relative change.
+         */
+        double high = 0.0;
+
+        /**
+         * This indicates whether or not there were enough values (two in
+         * each set) to estimate the noise in the measurements.
+         */
+        bool enoughTrials = false;
+
+        /**
+         * This indicates whether or not the confidence interval excludes
+         * zero, meaning the change is unlikely to be noise.
+         */
+        bool significant = false;
+    };
+
+    /**
+     * Summarize the given values.
+     *
+     * @param[in] values
+     *     These are the values to summarize.
+     *
+     * @return
+     *     The mean of the values and the confidence interval of
+     *     the mean are returned.
+     */
+    Summary Summarize(const std::vector< double >& values);
+
+    /**
+     * Compare the values of a metric in a new run with its values in a
+     * baseline, using Welch's t-test, which doesn't assume that the two
+     * sets of values are equally noisy.
+     *
+     * @param[in] baseline
+     *     These are the values the metric took in the baseline.
+     *
+     * @param[in] values
+     *     These are the values the metric took in the new run.
+     *
+     * @return
+     *     The change of the metric from the baseline is returned.
+     */
+    Comparison Compare(
+        const std::vector< double >& baseline,
+        const std::vector< double >& values
+    );
+
+    /**
+     * Read the baselines stored in the given file.
+     *
+     * @param[in] path
+     *     This is the path to the file to read.
+     *
+     * @param[out] samples
+     *     This is where to store the baselines read.
+     *
+     * @return
+     *     An indication of whether or not the file was read successfully
+     *     is returned.
+     */
+    bool LoadBaseline(
+        const std::string& path,
+        std::vector< Samples >& samples
+    );
+
+    /**
+     * Store the given samples in the given file as baselines, replacing
+     * only those the file already holds for the same build configuration,
+     * workload, number of threads and metric, and keeping all others.
+     * The file is replaced only once the new one has been written in full,
+     * and not at all if it exists but can't be read in full, or if there
+     * are no samples to store.
+     *
+     * @param[in] path
+     *     This is the path to the file to write.
+     *
+     * @param[in] samples
+     *     These are the samples to store.
+     *
+     * @return
+     *     An indication of whether or not the file was written
+     *     successfully is returned.
+     */
+    bool SaveBaseline(
+        const std::string& path,
+        const std::vector< Samples >& samples
+    );
+
+    /**
+     * Find the samples of the given metric of the given workload in the
+     * given build configuration.
+     *
+     * @param[in] samples
+     *     These are the samples to search.
+     *
+     * @param[in] config
+     *     This is the name of the build configuration.
+     *
+     * @param[in] workload
+     *     This is the name of the workload.
+     *
+     * @param[in] threads
+     *     This is the number of threads on which the workload ran.
+     *
+     * @param[in] metric
+     *     This is the name of the metric.
+     *
+     * @return
+     *     The matching samples are returned.
+     *
+     * @retval nullptr
+     *     This is returned if there are no matching samples.
+     */
+    const Samples* FindSamples(
+        const std::vector< Samples >& samples,
+        const std::string& config,
+        const std::string& workload,
+        unsigned int threads,
+        const std::string& metric
+    );
+
+}
+
+#endif /* SQLITE_BENCH_BASELINE_HPP */
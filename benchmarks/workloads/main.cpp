@@ -0,0 +1,1417 @@
+/**
+ * @file benchmarks/workloads/main.cpp
+ *
+ * This is a benchmark which times the kinds of work the playground
+ * applications demonstrate, on synthetic data generated at a configurable
+ * scale:
+ *
+ * - lookup: point lookups of keys in a key-value table (SQLPlay1)
+ * - scan: reads of many rows and columns of a table (SQLPlay2)
+ * - mix: inserts, updates and deletes of rows (SQLPlay3)
+ * - json: json_extract and json_replace of JSON text (SQLPlay4)
+ *
+ * Each workload is run on one thread, and then on several threads at once,
+ * each with its own connection to the database.  Any run which follows one
+ * that changed the data starts from freshly generated data.  SQL scripts
+ * given with --script are timed as well, each run as a whole through the
+ * library, or through the sqlite3 shell given with --shell.  The throughput
+ * and the distribution of the latency of the operations of each run are
+ * written to the standard output as JSON.
+ *
+ * With --trials, everything is run several times, on freshly generated
+ * data each time, to measure how noisy the results are.  --save stores the
+ * throughput and p99 latency of every trial in a baseline file, under the
+ * build configuration named by --config, and --compare compares them with
+ * the baseline of that configuration stored in a file.  If the throughput
+ * of any workload is significantly lower than its baseline, or its p99
+ * latency significantly higher, by more than the --threshold percentage,
+ * the program exits with status 2.  So it does if any operation or script
+ * failed, or if a workload with a baseline was skipped or not run at all.
+ * Telling noise from a regression takes at least two trials, both in the
+ * baseline and in the run compared with it, so --compare requires
+ * --trials 2 or more, and any comparison with a baseline of fewer trials
+ * fails as well.
+ *
+ * Usage: SQLiteBench [--rows N] [--ops N] [--threads N] [--seed N]
+ *                    [--workload NAME] [--db PATH] [--script FILE]...
+ *                    [--shell PATH] [--trials N] [--config NAME]
+ *                    [--save FILE] [--compare FILE] [--threshold PERCENT]
+ */
+
+#include "Baseline.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <SQLiteWrappers/LatencyHistogram.hpp>
+#include <SQLiteWrappers/Wrappers.hpp>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace SQLiteWrappers;
+
+namespace {
+
+    /**
+     * This is how long a connection waits for another connection to
+     * release a lock before giving up.
+     */
+    constexpr int BUSY_TIMEOUT_MILLISECONDS = 10000;
+
+    /**
+     * This is the number of rows each operation of the scan workload reads.
+     */
+    constexpr int SCAN_ROWS = 100;
+
+    /**
+     * This is the exit status of the program when it finds a significant
+     * regression from the baseline.
+     */
+    constexpr int REGRESSION_EXIT_STATUS = 2;
+
+    /**
+     * These are the settings of the benchmark, from the command line.
+     */
+    struct Options {
+        /**
+         * This is the number of rows generated in each table.
+         */
+        int rows = 100000;
+
+        /**
+         * This is the number of operations each thread performs in each run
+         * of each workload.
+         */
+        size_t ops = 20000;
+
+        /**
+         * This is the number of threads used by the multi-threaded runs.
+         */
+        unsigned int threads = std::max(std::thread::hardware_concurrency(), 2u);
+
+        /**
+         * This seeds the pseudo-random numbers which generate the data and
+         * choose the operations, so that runs are repeatable.
+         */
+        uint64_t seed = 1;
+
+        /**
+         * If not empty, this is the name of the only workload to run.
+         */
+        std::string workload;
+
+        /**
+         * This is the path of the database file the benchmark creates.
+         * It's deleted when the benchmark finishes.
+         */
+        std::string path = "SQLiteBench.db";
+
+        /**
+         * These are the paths of SQL scripts to time, besides
+         * the workloads.
+         */
+        std::vector< std::string > scripts;
+
+        /**
+         * If not empty, this is the path of the sqlite3 shell through
+         * which to run the scripts, rather than the library.
+         */
+        std::string shell;
+
+        /**
+         * This is the number of times to run everything.
+         */
+        size_t trials = 1;
+
+        /**
+         * This is the name of the build configuration being measured,
+         * under which baselines are stored and compared.
+         */
+        std::string config = "default";
+
+        /**
+         * If not empty, this is the path of the file in which to store the
+         * results as the baseline of the build configuration.
+         */
+        std::string save;
+
+        /**
+         * If not empty, this is the path of the file holding the baseline
+         * with which to compare the results.
+         */
+        std::string compare;
+
+        /**
+         * This is the smallest relative change from the baseline which
+         * counts as a regression, if it's significant.
+         */
+        double threshold = 0.05;
+    };
+
+    /**
+     * This is one thread's way of performing the operations of a workload,
+     * through a connection of its own.
+     */
+    class Operation {
+    public:
+        virtual ~Operation() = default;
+
+        /**
+         * Perform one operation of the workload.
+         *
+         * @param[in,out] random
+         *     This is the thread's generator of pseudo-random numbers,
+         *     used to choose what the operation works on.
+         *
+         * @return
+         *     An indication of whether or not the operation succeeded
+         *     is returned.
+         */
+        virtual bool Run(std::mt19937_64& random) = 0;
+    };
+
+    /**
+     * This keeps the compiler from optimizing away results which are
+     * otherwise unused.
+     */
+    std::atomic< int > sink;
+
+    /**
+     * Step the given statement until it's done, reading the given number
+     * of integer columns of each row, and then reset it.
+     *
+     * @param[in] stmt
+     *     This is the statement to step.
+     *
+     * @param[in] columns
+     *     This is the number of columns of each row to read.
+     *
+     * @return
+     *     An indication of whether or not the statement ran to completion
+     *     is returned.
+     */
+    bool StepToCompletion(
+        const PreparedStatement& stmt,
+        int columns
+    ) {
+        int sum = 0;
+        StepStatementResults results;
+        while (
+            results = StepStatement(stmt),
+            !results.done && !results.error
+        ) {
+            for (int i = 0; i < columns; ++i) {
+                sum += FetchColumnInt(stmt, i);
+            }
+        }
+        ResetStatement(stmt);
+        sink.fetch_add(sum, std::memory_order_relaxed);
+        return !results.error;
+    }
+
+    /**
+     * This looks up random keys of the globals table, as SQLPlay1 does.
+     */
+    class LookupOperation: public Operation {
+    public:
+        LookupOperation(
+            DatabaseConnection db,
+            const Options& options
+        )
+            : db_(std::move(db))
+            , rows_(options.rows)
+        {
+            stmt_ = BuildStatement(db_, "SELECT value FROM globals WHERE key = ?");
+        }
+
+        bool IsReady() const {
+            return (bool)stmt_;
+        }
+
+        bool Run(std::mt19937_64& random) override {
+            const auto row = (int)(random() % (uint64_t)rows_);
+            BindStatementParameter(stmt_, 1, "key" + std::to_string(row));
+            return StepToCompletion(stmt_, 1);
+        }
+
+    private:
+        DatabaseConnection db_;
+        PreparedStatement stmt_;
+        int rows_;
+    };
+
+    /**
+     * This reads all the columns of a run of rows of the characters table,
+     * starting from a random one, as SQLPlay2 does for the whole table.
+     */
+    class ScanOperation: public Operation {
+    public:
+        ScanOperation(
+            DatabaseConnection db,
+            const Options& options
+        )
+            : db_(std::move(db))
+            , rows_(options.rows)
+        {
+            stmt_ = BuildStatement(
+                db_,
+                "SELECT entity, armor, con, dex, hp, hpmax, int, str"
+                " FROM characters WHERE entity >= ? LIMIT " + std::to_string(SCAN_ROWS)
+            );
+        }
+
+        bool IsReady() const {
+            return (bool)stmt_;
+        }
+
+        bool Run(std::mt19937_64& random) override {
+            const auto first = (int)(random() % (uint64_t)rows_);
+            BindStatementParameter(stmt_, 1, first);
+            return StepToCompletion(stmt_, 8);
+        }
+
+    private:
+        DatabaseConnection db_;
+        PreparedStatement stmt_;
+        int rows_;
+    };
+
+    /**
+     * This is the next entity number available to the inserts of the mix
+     * workload, shared by all its threads.
+     */
+    std::atomic< int > nextEntity;
+
+    /**
+     * This inserts, updates and deletes rows of the characters table,
+     * as SQLPlay3 does, in the ratio 2:2:1, each in its own transaction.
+     */
+    class MixOperation: public Operation {
+    public:
+        MixOperation(
+            DatabaseConnection db,
+            const Options& options
+        )
+            : db_(std::move(db))
+            , rows_(options.rows)
+        {
+            insert_ = BuildStatement(
+                db_,
+                "INSERT INTO characters (entity, hp, hpmax) VALUES (?, ?, ?)"
+            );
+            update_ = BuildStatement(
+                db_,
+                "UPDATE characters SET con = ? WHERE entity = ?"
+            );
+            delete_ = BuildStatement(
+                db_,
+                "DELETE FROM characters WHERE entity = ?"
+            );
+        }
+
+        bool IsReady() const {
+            return insert_ && update_ && delete_;
+        }
+
+        bool Run(std::mt19937_64& random) override {
+            const auto choice = random() % 5;
+            const auto value = (int)(random() % 20) + 1;
+            if (choice < 2) {
+                const auto entity = nextEntity.fetch_add(1, std::memory_order_relaxed);
+                BindStatementParameter(insert_, 1, entity);
+                BindStatementParameter(insert_, 2, value);
+                BindStatementParameter(insert_, 3, value);
+                return StepToCompletion(insert_, 0);
+            } else {
+                const auto entity = (int)(random() % (uint64_t)rows_);
+                const auto& stmt = (choice < 4) ? update_ : delete_;
+                if (choice < 4) {
+                    BindStatementParameter(stmt, 1, value);
+                    BindStatementParameter(stmt, 2, entity);
+                } else {
+                    BindStatementParameter(stmt, 1, entity);
+                }
+                return StepToCompletion(stmt, 0);
+            }
+        }
+
+    private:
+        DatabaseConnection db_;
+        PreparedStatement insert_;
+        PreparedStatement update_;
+        PreparedStatement delete_;
+        int rows_;
+    };
+
+    /**
+     * This extracts a value from the JSON text of a random row of the doors
+     * table, or replaces it, as SQLPlay4 does, in equal measure.
+     */
+    class JsonOperation: public Operation {
+    public:
+        JsonOperation(
+            DatabaseConnection db,
+            const Options& options
+        )
+            : db_(std::move(db))
+            , rows_(options.rows)
+        {
+            extract_ = BuildStatement(
+                db_,
+                "SELECT json_extract(on_close, '$.tile.id') FROM doors WHERE entity = ?"
+            );
+            replace_ = BuildStatement(
+                db_,
+                "UPDATE doors SET on_close = json_replace(on_close, '$.tile.id', ?)"
+                " WHERE entity = ?"
+            );
+        }
+
+        bool IsReady() const {
+            return extract_ && replace_;
+        }
+
+        bool Run(std::mt19937_64& random) override {
+            const auto entity = (int)(random() % (uint64_t)rows_);
+            if (random() % 2 == 0) {
+                BindStatementParameter(extract_, 1, entity);
+                return StepToCompletion(extract_, 1);
+            } else {
+                BindStatementParameter(replace_, 1, (int)(random() % 1000));
+                BindStatementParameter(replace_, 2, entity);
+                return StepToCompletion(replace_, 0);
+            }
+        }
+
+    private:
+        DatabaseConnection db_;
+        PreparedStatement extract_;
+        PreparedStatement replace_;
+        int rows_;
+    };
+
+    /**
+     * Make a thread's way of performing the operations of a workload.
+     *
+     * @param[in] db
+     *     This is the thread's connection to the database.
+     *
+     * @param[in] options
+     *     These are the settings of the benchmark.
+     *
+     * @return
+     *     The new operation is returned.
+     *
+     * @retval nullptr
+     *     This is returned if the workload's statements could not be
+     *     compiled, for example because SQLite was built without the
+     *     functions they use.
+     */
+    template< typename T >
+    std::unique_ptr< Operation > MakeOperation(
+        DatabaseConnection db,
+        const Options& options
+    ) {
+        auto operation = std::make_unique< T >(std::move(db), options);
+        if (!operation->IsReady()) {
+            return nullptr;
+        }
+        return operation;
+    }
+
+    /**
+     * This describes one of the workloads.
+     */
+    struct Workload {
+        /**
+         * This is the name of the workload.
+         */
+        const char* name;
+
+        /**
+         * This makes a thread's way of performing the workload.
+         */
+        std::unique_ptr< Operation > (*makeOperation)(
+            DatabaseConnection db,
+            const Options& options
+        );
+
+        /**
+         * This indicates whether or not the workload changes the data,
+         * so that the next run needs freshly generated data.
+         */
+        bool writes;
+    };
+
+    /**
+     * These are all the workloads, in the order they're run.
+     */
+    const Workload WORKLOADS[] = {
+        {"lookup", MakeOperation< LookupOperation >, false},
+        {"scan", MakeOperation< ScanOperation >, false},
+        {"mix", MakeOperation< MixOperation >, true},
+        {"json", MakeOperation< JsonOperation >, true},
+    };
+
+    /**
+     * This holds the outcome of running one workload on some number
+     * of threads.
+     */
+    struct RunResults {
+        /**
+         * This indicates whether or not the workload could run at all.
+         */
+        bool skipped = false;
+
+        /**
+         * This is the number of operations which failed.
+         */
+        uint64_t errors = 0;
+
+        /**
+         * This is the time from when the threads started performing
+         * operations to when the last one finished, in seconds.
+         */
+        double seconds = 0.0;
+
+        /**
+         * This records how long each operation took.
+         */
+        LatencyHistogram latencies;
+    };
+
+    /**
+     * Open a connection to the benchmark's database.
+     *
+     * @param[in] options
+     *     These are the settings of the benchmark.
+     *
+     * @return
+     *     The new database connection is returned.
+     *
+     * @retval nullptr
+     *     This is returned if the database could not be opened.
+     */
+    DatabaseConnection Connect(const Options& options) {
+        auto db = OpenDatabase(options.path);
+        if (db) {
+            (void)sqlite3_busy_timeout(db.get(), BUSY_TIMEOUT_MILLISECONDS);
+            (void)sqlite3_exec(db.get(), "PRAGMA synchronous=NORMAL", NULL, NULL, NULL);
+        }
+        return db;
+    }
+
+    /**
+     * Run the given workload on the given number of threads, each
+     * performing the configured number of operations.
+     *
+     * @param[in] workload
+     *     This is the workload to run.
+     *
+     * @param[in] options
+     *     These are the settings of the benchmark.
+     *
+     * @param[in] threads
+     *     This is the number of threads on which to run the workload.
+     *
+     * @return
+     *     The outcome of the run is returned.
+     */
+    RunResults Run(
+        const Workload& workload,
+        const Options& options,
+        unsigned int threads
+    ) {
+        RunResults results;
+
+        // Connect and compile every thread's statements before any thread
+        // starts, so that only the operations themselves are timed.
+        std::vector< std::unique_ptr< Operation > > operations;
+        for (unsigned int i = 0; i < threads; ++i) {
+            auto db = Connect(options);
+            if (!db) {
+                results.skipped = true;
+                return results;
+            }
+            auto operation = workload.makeOperation(std::move(db), options);
+            if (operation == nullptr) {
+                results.skipped = true;
+                return results;
+            }
+            operations.push_back(std::move(operation));
+        }
+        std::vector< LatencyHistogram > latencies(threads);
+        std::vector< uint64_t > errors(threads);
+        std::atomic< bool > go(false);
+        std::vector< std::thread > workers;
+        for (unsigned int i = 0; i < threads; ++i) {
+            workers.emplace_back(
+                [&, i]{
+                    std::mt19937_64 random(options.seed + i);
+                    while (!go.load(std::memory_order_acquire)) {
+                        std::this_thread::yield();
+                    }
+                    for (size_t op = 0; op < options.ops; ++op) {
+                        const auto start = std::chrono::steady_clock::now();
+                        const auto ok = operations[i]->Run(random);
+                        const auto elapsed = std::chrono::duration_cast< std::chrono::nanoseconds >(
+                            std::chrono::steady_clock::now() - start
+                        );
+                        latencies[i].Record((uint64_t)elapsed.count());
+                        if (!ok) {
+                            ++errors[i];
+                        }
+                    }
+                }
+            );
+        }
+        const auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& worker: workers) {
+            worker.join();
+        }
+        results.seconds = std::chrono::duration< double >(
+            std::chrono::steady_clock::now() - start
+        ).count();
+        for (unsigned int i = 0; i < threads; ++i) {
+            results.latencies.Merge(latencies[i]);
+            results.errors += errors[i];
+        }
+        return results;
+    }
+
+    /**
+     * Create the benchmark's database and fill its tables with
+     * pseudo-random data.
+     *
+     * @param[in] options
+     *     These are the settings of the benchmark.
+     *
+     * @return
+     *     An indication of whether or not the database was created
+     *     successfully is returned.
+     */
+    bool GenerateData(const Options& options) {
+        const auto db = Connect(options);
+        if (!db) {
+            return false;
+        }
+        if (
+            sqlite3_exec(
+                db.get(),
+                "PRAGMA journal_mode=WAL;"
+                "CREATE TABLE globals(key text primary key, value text);"
+                "CREATE TABLE characters(entity int primary key, armor int, con int,"
+                " dex int, hp int, hpmax int, int int, str int);"
+                "CREATE TABLE doors(entity int primary key, locked int(1), open int(1),"
+                " on_close text, on_open text);"
+                "BEGIN",
+                NULL, NULL, NULL
+            ) != SQLITE_OK
+        ) {
+            fprintf(stderr, "Unable to create tables: %s\n", sqlite3_errmsg(db.get()));
+            return false;
+        }
+        const auto globals = BuildStatement(
+            db,
+            "INSERT INTO globals VALUES (?, ?)"
+        );
+        const auto characters = BuildStatement(
+            db,
+            "INSERT INTO characters VALUES (?, ?, ?, ?, ?, ?, ?, ?)"
+        );
+        const auto doors = BuildStatement(
+            db,
+            "INSERT INTO doors VALUES (?, ?, ?, ?, ?)"
+        );
+        std::mt19937_64 random(options.seed);
+        const auto attribute = [&random]{ return (int)(random() % 18) + 3; };
+        bool ok = true;
+        for (int row = 0; ok && (row < options.rows); ++row) {
+            BindStatementParameter(globals, 1, "key" + std::to_string(row));
+            BindStatementParameter(globals, 2, std::to_string(random() % 100000000));
+            ok = StepToCompletion(globals, 0);
+
+            const auto hp = (int)(random() % 100) + 1;
+            BindStatementParameter(characters, 1, row);
+            BindStatementParameter(characters, 2, (int)(random() % 10));
+            BindStatementParameter(characters, 3, attribute());
+            BindStatementParameter(characters, 4, attribute());
+            BindStatementParameter(characters, 5, hp);
+            BindStatementParameter(characters, 6, hp);
+            BindStatementParameter(characters, 7, attribute());
+            BindStatementParameter(characters, 8, attribute());
+            ok = ok && StepToCompletion(characters, 0);
+
+            const auto tile = (int)(random() % 1000);
+            const auto open = (int)(random() % 2);
+            BindStatementParameter(doors, 1, row);
+            BindStatementParameter(doors, 2, 0);
+            BindStatementParameter(doors, 3, open);
+            BindStatementParameter(doors, 4, "{\"tile\":{\"id\":" + std::to_string(tile) + "}}");
+            BindStatementParameter(doors, 5, "{\"tile\":{\"id\":" + std::to_string(tile + 1) + "}}");
+            ok = ok && StepToCompletion(doors, 0);
+        }
+        if (
+            !ok
+            || (sqlite3_exec(db.get(), "COMMIT; ANALYZE", NULL, NULL, NULL) != SQLITE_OK)
+        ) {
+            fprintf(stderr, "Unable to generate data: %s\n", sqlite3_errmsg(db.get()));
+            return false;
+        }
+        nextEntity = options.rows;
+        return true;
+    }
+
+    /**
+     * Delete the benchmark's database, along with its write-ahead log
+     * and shared-memory index, if there are any.
+     *
+     * @param[in] options
+     *     These are the settings of the benchmark.
+     */
+    void DeleteDatabase(const Options& options) {
+        for (const auto suffix: {"", "-wal", "-shm", "-journal"}) {
+            (void)remove((options.path + suffix).c_str());
+        }
+    }
+
+    /**
+     * Delete the benchmark's database, if there is one, and generate
+     * it again.
+     *
+     * @param[in] options
+     *     These are the settings of the benchmark.
+     *
+     * @param[in] trial
+     *     This is the number of the trial for which the data is needed.
+     *
+     * @return
+     *     An indication of whether or not the database was created
+     *     successfully is returned.
+     */
+    bool RegenerateData(
+        const Options& options,
+        size_t trial
+    ) {
+        DeleteDatabase(options);
+        fprintf(
+            stderr,
+            "trial %zu of %zu: generating %d rows per table...\n",
+            trial,
+            options.trials,
+            options.rows
+        );
+        return GenerateData(options);
+    }
+
+    /**
+     * Read the whole of the given file.
+     *
+     * @param[in] path
+     *     This is the path of the file to read.
+     *
+     * @param[out] content
+     *     This is where to store the content of the file.
+     *
+     * @return
+     *     An indication of whether or not the file was read successfully
+     *     is returned.
+     */
+    bool ReadFile(
+        const std::string& path,
+        std::string& content
+    ) {
+        const auto file = fopen(path.c_str(), "rb");
+        if (file == NULL) {
+            return false;
+        }
+        char buffer[65536];
+        size_t amount;
+        while ((amount = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            content.append(buffer, amount);
+        }
+        const auto ok = (ferror(file) == 0);
+        (void)fclose(file);
+        return ok;
+    }
+
+    /**
+     * Run the given SQL script against the benchmark's database, as one
+     * operation, either through the library or through the sqlite3 shell.
+     *
+     * @param[in] script
+     *     This is the path of the script to run.
+     *
+     * @param[in] options
+     *     These are the settings of the benchmark.
+     *
+     * @return
+     *     The outcome of the run is returned.
+     */
+    RunResults RunScript(
+        const std::string& script,
+        const Options& options
+    ) {
+        RunResults results;
+        bool ok;
+        auto start = std::chrono::steady_clock::now();
+        if (options.shell.empty()) {
+            std::string sql;
+            const auto db = Connect(options);
+            if (!db || !ReadFile(script, sql)) {
+                fprintf(stderr, "Unable to read script %s\n", script.c_str());
+                results.skipped = true;
+                return results;
+            }
+            start = std::chrono::steady_clock::now();
+            ok = (sqlite3_exec(db.get(), sql.c_str(), NULL, NULL, NULL) == SQLITE_OK);
+            if (!ok) {
+                fprintf(stderr, "%s: %s\n", script.c_str(), sqlite3_errmsg(db.get()));
+            }
+        } else {
+#ifdef _WIN32
+            const char* nullDevice = "NUL";
+#else
+            const char* nullDevice = "/dev/null";
+#endif
+            const auto command = (
+                "\"" + options.shell + "\" -bail \"" + options.path + "\" < \""
+                + script + "\" > " + nullDevice
+            );
+            ok = (system(command.c_str()) == 0);
+            if (!ok) {
+                fprintf(stderr, "%s: the shell failed\n", script.c_str());
+            }
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        results.seconds = std::chrono::duration< double >(elapsed).count();
+        results.latencies.Record(
+            (uint64_t)std::chrono::duration_cast< std::chrono::nanoseconds >(elapsed).count()
+        );
+        results.errors = ok ? 0 : 1;
+        return results;
+    }
+
+    /**
+     * This accumulates the outcomes of every trial of one workload on
+     * some number of threads.
+     */
+    struct Measurement {
+        /**
+         * This is the name of the workload.
+         */
+        std::string workload;
+
+        /**
+         * This is the number of threads on which the workload runs.
+         */
+        unsigned int threads = 1;
+
+        /**
+         * This indicates whether or not the workload could not run
+         * in some trial.
+         */
+        bool skipped = false;
+
+        /**
+         * This is the number of operations which failed, in all trials.
+         */
+        uint64_t errors = 0;
+
+        /**
+         * This is the time all the trials took, in seconds.
+         */
+        double seconds = 0.0;
+
+        /**
+         * This is the throughput of each trial, in operations per second.
+         */
+        std::vector< double > opsPerSec;
+
+        /**
+         * This is the 99th percentile of the latency of each trial,
+         * in nanoseconds.
+         */
+        std::vector< double > p99;
+
+        /**
+         * This records how long each operation of every trial took.
+         */
+        LatencyHistogram latencies;
+    };
+
+    /**
+     * This describes one of the metrics stored in baselines.
+     */
+    struct Metric {
+        /**
+         * This is the name of the metric.
+         */
+        const char* name;
+
+        /**
+         * This indicates whether larger values of the metric are better,
+         * rather than worse.
+         */
+        bool higherIsBetter;
+
+        /**
+         * This selects the values of the metric from a measurement.
+         */
+        std::vector< double > Measurement::* values;
+    };
+
+    /**
+     * These are the metrics stored in baselines.
+     */
+    const Metric METRICS[] = {
+        {"ops_per_sec", true, &Measurement::opsPerSec},
+        {"p99_ns", false, &Measurement::p99},
+    };
+
+    /**
+     * Add the outcome of one trial to a measurement.  The metrics of a
+     * trial in which anything failed are not kept, since they don't
+     * measure the work the trial was meant to do.
+     *
+     * @param[in,out] measurement
+     *     This is the measurement to which to add the outcome.
+     *
+     * @param[in] results
+     *     This is the outcome of the trial.
+     */
+    void AddTrial(
+        Measurement& measurement,
+        const RunResults& results
+    ) {
+        if (results.skipped) {
+            measurement.skipped = true;
+            return;
+        }
+        const auto ops = results.latencies.GetCount();
+        measurement.errors += results.errors;
+        if (results.errors > 0) {
+            return;
+        }
+        measurement.seconds += results.seconds;
+        measurement.opsPerSec.push_back(
+            (results.seconds > 0.0) ? (double)ops / results.seconds : 0.0
+        );
+        measurement.p99.push_back((double)results.latencies.GetValueAtPercentile(99.0));
+        measurement.latencies.Merge(results.latencies);
+    }
+
+    /**
+     * Write a string as a JSON string literal.
+     *
+     * @param[in] text
+     *     This is the string to write.
+     */
+    void PrintJsonString(const std::string& text) {
+        putchar('"');
+        for (const auto c: text) {
+            if ((c == '"') || (c == '\\')) {
+                printf("\\%c", c);
+            } else if ((unsigned char)c < 0x20) {
+                printf("\\u%04x", (unsigned char)c);
+            } else {
+                putchar(c);
+            }
+        }
+        putchar('"');
+    }
+
+    /**
+     * Write the outcome of all trials of one workload as a JSON object.
+     *
+     * @param[in] measurement
+     *     This is the outcome of the trials.
+     *
+     * @param[in] last
+     *     This indicates whether or not this is the last outcome to report.
+     */
+    void Report(
+        const Measurement& measurement,
+        bool last
+    ) {
+        printf("    {\"workload\": ");
+        PrintJsonString(measurement.workload);
+        printf(", \"threads\": %u, ", measurement.threads);
+        if (measurement.skipped) {
+            printf("\"skipped\": true}%s\n", last ? "" : ",");
+            return;
+        }
+        const auto throughput = SQLiteBench::Summarize(measurement.opsPerSec);
+        printf(
+            "\"trials\": %zu, \"ops\": %llu, \"errors\": %llu, \"seconds\": %.6f,\n"
+            "     \"ops_per_sec\": %.1f, \"ops_per_sec_ci95\": %.1f,\n",
+            measurement.opsPerSec.size(),
+            (unsigned long long)measurement.latencies.GetCount(),
+            (unsigned long long)measurement.errors,
+            measurement.seconds,
+            throughput.mean,
+            throughput.halfWidth
+        );
+        printf(
+            "     \"latency_ns\": {\"min\": %llu, \"mean\": %.1f, \"p50\": %llu,"
+            " \"p99\": %llu, \"p999\": %llu, \"max\": %llu}}%s\n",
+            (unsigned long long)measurement.latencies.GetMin(),
+            measurement.latencies.GetMean(),
+            (unsigned long long)measurement.latencies.GetValueAtPercentile(50.0),
+            (unsigned long long)measurement.latencies.GetValueAtPercentile(99.0),
+            (unsigned long long)measurement.latencies.GetValueAtPercentile(99.9),
+            (unsigned long long)measurement.latencies.GetMax(),
+            last ? "" : ","
+        );
+    }
+
+    /**
+     * Store the per-trial metrics of the given measurements in the
+     * baseline file, keeping the baselines of everything not measured.
+     *
+     * @param[in] measurements
+     *     These are the measurements to store.
+     *
+     * @param[in] options
+     *     These are the settings of the benchmark.
+     *
+     * @return
+     *     An indication of whether or not the baseline was stored
+     *     successfully is returned.
+     */
+    bool SaveBaseline(
+        const std::vector< Measurement >& measurements,
+        const Options& options
+    ) {
+        std::vector< SQLiteBench::Samples > samples;
+        for (const auto& measurement: measurements) {
+            if (measurement.skipped || measurement.opsPerSec.empty()) {
+                continue;
+            }
+            for (const auto& metric: METRICS) {
+                SQLiteBench::Samples entry;
+                entry.config = options.config;
+                entry.workload = measurement.workload;
+                entry.threads = measurement.threads;
+                entry.metric = metric.name;
+                entry.values = measurement.*metric.values;
+                samples.push_back(std::move(entry));
+            }
+        }
+        if (samples.empty()) {
+            fprintf(stderr, "Nothing was measured to store as a baseline\n");
+            return false;
+        }
+        return SQLiteBench::SaveBaseline(options.save, samples);
+    }
+
+    /**
+     * Indicate whether or not the given workload would have been run,
+     * given the settings of the benchmark.
+     *
+     * @param[in] workload
+     *     This is the name of the workload, or "script:" followed by the
+     *     path of a script.
+     *
+     * @param[in] options
+     *     These are the settings of the benchmark.
+     *
+     * @return
+     *     An indication of whether or not the workload was selected
+     *     is returned.
+     */
+    bool IsSelected(
+        const std::string& workload,
+        const Options& options
+    ) {
+        if (workload.compare(0, 7, "script:") == 0) {
+            return (
+                std::find(
+                    options.scripts.begin(),
+                    options.scripts.end(),
+                    workload.substr(7)
+                ) != options.scripts.end()
+            );
+        }
+        return (
+            options.workload.empty()
+            || (workload == options.workload)
+        );
+    }
+
+    /**
+     * Compare the per-trial metrics of the given measurements with the
+     * baseline of the build configuration, and print how they differ.
+     * Runs with errors fail the comparison, as do workloads which have a
+     * baseline but were skipped, or weren't run at all, and comparisons
+     * with too few trials to tell a regression from noise.
+     *
+     * @param[in] measurements
+     *     These are the measurements to compare.
+     *
+     * @param[in] baseline
+     *     These are the baselines with which to compare them.
+     *
+     * @param[in] options
+     *     These are the settings of the benchmark.
+     *
+     * @return
+     *     The number of significant regressions and failures found
+     *     is returned.
+     */
+    size_t CompareWithBaseline(
+        const std::vector< Measurement >& measurements,
+        const std::vector< SQLiteBench::Samples >& baseline,
+        const Options& options
+    ) {
+        size_t regressions = 0;
+        size_t undecided = 0;
+        fprintf(
+            stderr,
+            "compared with baseline \"%s\" (threshold %.1f%%, 95%% confidence):\n",
+            options.config.c_str(),
+            options.threshold * 100.0
+        );
+        for (const auto& measurement: measurements) {
+            bool hasBaseline = false;
+            for (const auto& metric: METRICS) {
+                if (
+                    SQLiteBench::FindSamples(
+                        baseline,
+                        options.config,
+                        measurement.workload,
+                        measurement.threads,
+                        metric.name
+                    ) != nullptr
+                ) {
+                    hasBaseline = true;
+                }
+            }
+            if (measurement.errors > 0) {
+                fprintf(
+                    stderr,
+                    "  %-24s %3u thread(s) %llu error(s)  FAILED\n",
+                    measurement.workload.c_str(),
+                    measurement.threads,
+                    (unsigned long long)measurement.errors
+                );
+                ++regressions;
+                continue;
+            }
+            if (measurement.skipped) {
+                if (hasBaseline) {
+                    fprintf(
+                        stderr,
+                        "  %-24s %3u thread(s) skipped  FAILED\n",
+                        measurement.workload.c_str(),
+                        measurement.threads
+                    );
+                    ++regressions;
+                }
+                continue;
+            }
+            for (const auto& metric: METRICS) {
+                fprintf(
+                    stderr,
+                    "  %-24s %3u thread(s) %-12s ",
+                    measurement.workload.c_str(),
+                    measurement.threads,
+                    metric.name
+                );
+                const auto samples = SQLiteBench::FindSamples(
+                    baseline,
+                    options.config,
+                    measurement.workload,
+                    measurement.threads,
+                    metric.name
+                );
+                if (samples == nullptr) {
+                    fprintf(stderr, "no baseline\n");
+                    continue;
+                }
+                const auto comparison = SQLiteBench::Compare(
+                    samples->values,
+                    measurement.*metric.values
+                );
+                const char* verdict = "ok";
+                const auto worse = (
+                    metric.higherIsBetter
+                    ? (comparison.high < 0.0) && (comparison.change < -options.threshold)
+                    : (comparison.low > 0.0) && (comparison.change > options.threshold)
+                );
+                if (!comparison.enoughTrials) {
+                    verdict = "too few trials to tell  FAILED";
+                    ++undecided;
+                    ++regressions;
+                } else if (worse) {
+                    verdict = "REGRESSION";
+                    ++regressions;
+                } else if (!comparison.significant) {
+                    verdict = "within noise";
+                }
+                fprintf(
+                    stderr,
+                    "%+7.1f%% [%+.1f%%, %+.1f%%]  %s\n",
+                    comparison.change * 100.0,
+                    comparison.low * 100.0,
+                    comparison.high * 100.0,
+                    verdict
+                );
+            }
+        }
+
+        // Anything in the baseline which should have run, but didn't,
+        // might be hiding a failure.  The baseline holds one entry per
+        // metric, so report each workload and number of threads once.
+        std::vector< std::pair< std::string, unsigned int > > notRun;
+        for (const auto& entry: baseline) {
+            if (
+                (entry.config != options.config)
+                || !IsSelected(entry.workload, options)
+            ) {
+                continue;
+            }
+            const auto key = std::make_pair(entry.workload, entry.threads);
+            if (std::find(notRun.begin(), notRun.end(), key) != notRun.end()) {
+                continue;
+            }
+            const auto found = std::any_of(
+                measurements.begin(),
+                measurements.end(),
+                [&entry](const Measurement& measurement){
+                    return (
+                        (measurement.workload == entry.workload)
+                        && (measurement.threads == entry.threads)
+                    );
+                }
+            );
+            if (!found) {
+                fprintf(
+                    stderr,
+                    "  %-24s %3u thread(s) not run  FAILED\n",
+                    entry.workload.c_str(),
+                    entry.threads
+                );
+                notRun.push_back(key);
+                ++regressions;
+            }
+        }
+        if (undecided > 0) {
+            fprintf(
+                stderr,
+                "error: %zu comparison(s) had too few trials to tell; the baseline"
+                " and this run each need --trials 2 or more\n",
+                undecided
+            );
+        }
+        return regressions;
+    }
+
+    /**
+     * Print how to run the program.
+     *
+     * @param[in] program
+     *     This is the name of the program.
+     */
+    void PrintUsage(const char* program) {
+        fprintf(
+            stderr,
+            "usage: %s [--rows N] [--ops N] [--threads N] [--seed N]\n"
+            "       [--workload NAME|none] [--db PATH] [--script FILE]... [--shell PATH]\n"
+            "       [--trials N] [--config NAME] [--save FILE] [--compare FILE]\n"
+            "       [--threshold PERCENT]\n",
+            program
+        );
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const auto arg = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        const auto value = argv[++i];
+        if (strcmp(arg, "--rows") == 0) {
+            options.rows = atoi(value);
+        } else if (strcmp(arg, "--ops") == 0) {
+            options.ops = (size_t)strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options.threads = (unsigned int)atoi(value);
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = (uint64_t)strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--workload") == 0) {
+            options.workload = value;
+        } else if (strcmp(arg, "--db") == 0) {
+            options.path = value;
+        } else if (strcmp(arg, "--script") == 0) {
+            options.scripts.push_back(value);
+        } else if (strcmp(arg, "--shell") == 0) {
+            options.shell = value;
+        } else if (strcmp(arg, "--trials") == 0) {
+            options.trials = (size_t)strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--config") == 0) {
+            options.config = value;
+        } else if (strcmp(arg, "--save") == 0) {
+            options.save = value;
+        } else if (strcmp(arg, "--compare") == 0) {
+            options.compare = value;
+        } else if (strcmp(arg, "--threshold") == 0) {
+            options.threshold = strtod(value, NULL) / 100.0;
+        } else {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (
+        (options.rows <= 0)
+        || (options.ops == 0)
+        || (options.threads == 0)
+        || (options.trials == 0)
+        || (options.threshold < 0.0)
+        || (options.config.find_first_of("\t\n") != std::string::npos)
+    ) {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (
+        !options.compare.empty()
+        && (options.trials < 2)
+    ) {
+        fprintf(stderr, "--compare needs --trials 2 or more to tell a regression from noise\n");
+        return EXIT_FAILURE;
+    }
+    std::vector< const Workload* > workloads;
+    for (const auto& workload: WORKLOADS) {
+        if (options.workload.empty() || (options.workload == workload.name)) {
+            workloads.push_back(&workload);
+        }
+    }
+    if (
+        workloads.empty()
+        && (options.workload != "none")
+    ) {
+        fprintf(stderr, "unknown workload: %s\n", options.workload.c_str());
+        return EXIT_FAILURE;
+    }
+
+    // Load the baseline first, so as not to waste a run if it's missing.
+    std::vector< SQLiteBench::Samples > baseline;
+    if (
+        !options.compare.empty()
+        && !SQLiteBench::LoadBaseline(options.compare, baseline)
+    ) {
+        fprintf(stderr, "Unable to read baseline %s\n", options.compare.c_str());
+        return EXIT_FAILURE;
+    }
+
+    // Each workload runs single-threaded, and then multi-threaded unless
+    // only one thread was asked for.  Scripts run on one thread.
+    std::vector< unsigned int > threadCounts{1};
+    if (options.threads > 1) {
+        threadCounts.push_back(options.threads);
+    }
+    std::vector< Measurement > measurements;
+    for (const auto workload: workloads) {
+        for (const auto threads: threadCounts) {
+            Measurement measurement;
+            measurement.workload = workload->name;
+            measurement.threads = threads;
+            measurements.push_back(std::move(measurement));
+        }
+    }
+    for (const auto& script: options.scripts) {
+        Measurement measurement;
+        measurement.workload = "script:" + script;
+        measurements.push_back(std::move(measurement));
+    }
+
+    // Every run which follows one that changed the data starts from freshly
+    // generated data, so that the single-threaded and multi-threaded runs
+    // of a workload, and every trial, work on the same data.  Scripts are
+    // assumed to change the data.
+    for (size_t trial = 1; trial <= options.trials; ++trial) {
+        bool dirty = true;
+        auto measurement = measurements.begin();
+        for (const auto workload: workloads) {
+            for (const auto threads: threadCounts) {
+                if (dirty && !RegenerateData(options, trial)) {
+                    DeleteDatabase(options);
+                    return EXIT_FAILURE;
+                }
+                fprintf(
+                    stderr,
+                    "running %s on %u thread(s)...\n",
+                    workload->name,
+                    threads
+                );
+                const auto results = Run(*workload, options, threads);
+                if (results.skipped) {
+                    fprintf(
+                        stderr,
+                        "%s skipped: its statements could not be compiled\n",
+                        workload->name
+                    );
+                }
+                AddTrial(*measurement++, results);
+                dirty = workload->writes;
+            }
+        }
+        for (const auto& script: options.scripts) {
+            if (dirty && !RegenerateData(options, trial)) {
+                DeleteDatabase(options);
+                return EXIT_FAILURE;
+            }
+            fprintf(stderr, "running script %s...\n", script.c_str());
+            AddTrial(*measurement++, RunScript(script, options));
+            dirty = true;
+        }
+    }
+    DeleteDatabase(options);
+
+    printf(
+        "{\"sqlite_version\": \"%s\", \"config\": ",
+        sqlite3_libversion()
+    );
+    PrintJsonString(options.config);
+    printf(
+        ", \"rows\": %d, \"ops_per_thread\": %zu, \"seed\": %llu,\n",
+        options.rows,
+        options.ops,
+        (unsigned long long)options.seed
+    );
+    printf(" \"results\": [\n");
+    for (size_t i = 0; i < measurements.size(); ++i) {
+        Report(measurements[i], i + 1 == measurements.size());
+    }
+    printf(" ]}\n");
+    fflush(stdout);
+
+    if (
+        !options.save.empty()
+        && !SaveBaseline(measurements, options)
+    ) {
+        fprintf(stderr, "Unable to read or write baseline %s\n", options.save.c_str());
+        return EXIT_FAILURE;
+    }
+    if (
+        !options.compare.empty()
+        && (CompareWithBaseline(measurements, baseline, options) > 0)
+    ) {
+        return REGRESSION_EXIT_STATUS;
+    }
+    return EXIT_SUCCESS;
+}
@@ -6,95 +6,12 @@
  * This example simply reads one value from a key-value kind of table.
  */
 
-#include <functional>
-#include <memory>
-#include <sqlite3.h>
+#include <SQLiteWrappers/Wrappers.hpp>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-using DatabaseConnection = std::unique_ptr< sqlite3, std::function< void(sqlite3*) > >;
-using PreparedStatement = std::unique_ptr< sqlite3_stmt, std::function< void(sqlite3_stmt*) > >;
-
-DatabaseConnection OpenDatabase(const std::string& path) {
-    sqlite3* dbRaw;
-    if (sqlite3_open(path.c_str(), &dbRaw) != SQLITE_OK) {
-        return nullptr;
-    }
-    return DatabaseConnection(
-        dbRaw,
-        [](sqlite3* dbRaw){
-            (void)sqlite3_close(dbRaw);
-        }
-    );
-}
-
-PreparedStatement BuildStatement(
-    const DatabaseConnection& db,
-    const std::string& statement
-) {
-    sqlite3_stmt* statementRaw;
-    if (
-        sqlite3_prepare_v2(
-            db.get(),
-            statement.c_str(),
-            (int)(statement.length() + 1), // sqlite wants count to include the null
-            &statementRaw,
-            NULL
-        ) != SQLITE_OK)
-    {
-        return nullptr;
-    }
-    return PreparedStatement(
-        statementRaw,
-        [](sqlite3_stmt* statementRaw){
-            (void)sqlite3_finalize(statementRaw);
-        }
-    );
-}
-
-void BindStatementParameter(
-    const PreparedStatement& stmt,
-    int index,
-    const std::string& value
-) {
-    (void)sqlite3_bind_text(
-        stmt.get(),
-        index,
-        value.data(),
-        (int)value.length(),
-        SQLITE_TRANSIENT
-    );
-}
-
-struct StepStatementResults {
-    bool done = false;
-    bool error = false;
-};
-
-StepStatementResults StepStatement(const PreparedStatement& stmt) {
-    StepStatementResults results;
-    switch (sqlite3_step(stmt.get())) {
-        case SQLITE_DONE: {
-            results.done = true;
-        } break;
-
-        case SQLITE_ROW: {
-        } break;
-
-        default: {
-            results.error = true;
-        } break;
-    }
-    return results;
-}
-
-int FetchColumnInt(
-    const PreparedStatement& stmt,
-    int index
-) {
-    return sqlite3_column_int(stmt.get(), index);
-}
+using namespace SQLiteWrappers;
 
 int main(int argc, char* argv[]) {
     // Open our test database.
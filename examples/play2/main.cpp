@@ -6,100 +6,13 @@
  * This example shows how to fetch multiple rows and columns at once.
  */
 
-#include <functional>
-#include <memory>
-#include <sqlite3.h>
+#include <SQLiteWrappers/Wrappers.hpp>
 #include <sstream>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-using DatabaseConnection = std::unique_ptr< sqlite3, std::function< void(sqlite3*) > >;
-using PreparedStatement = std::unique_ptr< sqlite3_stmt, std::function< void(sqlite3_stmt*) > >;
-
-DatabaseConnection OpenDatabase(const std::string& path) {
-    sqlite3* dbRaw;
-    if (sqlite3_open(path.c_str(), &dbRaw) != SQLITE_OK) {
-        return nullptr;
-    }
-    return DatabaseConnection(
-        dbRaw,
-        [](sqlite3* dbRaw){
-            (void)sqlite3_close(dbRaw);
-        }
-    );
-}
-
-PreparedStatement BuildStatement(
-    const DatabaseConnection& db,
-    const std::string& statement
-) {
-    sqlite3_stmt* statementRaw;
-    if (
-        sqlite3_prepare_v2(
-            db.get(),
-            statement.c_str(),
-            (int)(statement.length() + 1), // sqlite wants count to include the null
-            &statementRaw,
-            NULL
-        ) != SQLITE_OK)
-    {
-        return nullptr;
-    }
-    return PreparedStatement(
-        statementRaw,
-        [](sqlite3_stmt* statementRaw){
-            (void)sqlite3_finalize(statementRaw);
-        }
-    );
-}
-
-int CountColumns(const PreparedStatement& stmt) {
-    return sqlite3_column_count(stmt.get());
-}
-
-std::string ColumnName(
-    const PreparedStatement& stmt,
-    int index
-) {
-    return sqlite3_column_name(stmt.get(), index);
-}
-
-struct StepStatementResults {
-    bool done = false;
-    bool error = false;
-};
-
-StepStatementResults StepStatement(const PreparedStatement& stmt) {
-    StepStatementResults results;
-    switch (sqlite3_step(stmt.get())) {
-        case SQLITE_DONE: {
-            results.done = true;
-        } break;
-
-        case SQLITE_ROW: {
-        } break;
-
-        default: {
-            results.error = true;
-        } break;
-    }
-    return results;
-}
-
-int FetchColumnInt(
-    const PreparedStatement& stmt,
-    int index
-) {
-    return sqlite3_column_int(stmt.get(), index);
-}
-
-bool IsColumnNull(
-    const PreparedStatement& stmt,
-    int index
-) {
-    return (sqlite3_column_type(stmt.get(), index) == SQLITE_NULL);
-}
+using namespace SQLiteWrappers;
 
 int main(int argc, char* argv[]) {
     // Open our test database.
@@ -7,126 +7,33 @@
  * old rows of a table.
  */
 
-#include <functional>
-#include <memory>
-#include <sqlite3.h>
+#include <SQLiteWrappers/Query.hpp>
+#include <SQLiteWrappers/Wrappers.hpp>
 #include <sstream>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-using DatabaseConnection = std::unique_ptr< sqlite3, std::function< void(sqlite3*) > >;
-using PreparedStatement = std::unique_ptr< sqlite3_stmt, std::function< void(sqlite3_stmt*) > >;
-
-DatabaseConnection OpenDatabase(const std::string& path) {
-    sqlite3* dbRaw;
-    if (sqlite3_open(path.c_str(), &dbRaw) != SQLITE_OK) {
-        return nullptr;
-    }
-    return DatabaseConnection(
-        dbRaw,
-        [](sqlite3* dbRaw){
-            (void)sqlite3_close(dbRaw);
-        }
-    );
-}
-
-PreparedStatement BuildStatement(
-    const DatabaseConnection& db,
-    const std::string& statement
-) {
-    sqlite3_stmt* statementRaw;
-    if (
-        sqlite3_prepare_v2(
-            db.get(),
-            statement.c_str(),
-            (int)(statement.length() + 1), // sqlite wants count to include the null
-            &statementRaw,
-            NULL
-        ) != SQLITE_OK)
-    {
-        return nullptr;
-    }
-    return PreparedStatement(
-        statementRaw,
-        [](sqlite3_stmt* statementRaw){
-            (void)sqlite3_finalize(statementRaw);
-        }
-    );
-}
-
-void BindStatementParameter(
-    const PreparedStatement& stmt,
-    int index,
-    int value
-) {
-    (void)sqlite3_bind_int(
-        stmt.get(),
-        index,
-        value
-    );
-}
-
-struct StepStatementResults {
-    bool done = false;
-    bool error = false;
-};
-
-StepStatementResults StepStatement(const PreparedStatement& stmt) {
-    StepStatementResults results;
-    switch (sqlite3_step(stmt.get())) {
-        case SQLITE_DONE: {
-            results.done = true;
-        } break;
-
-        case SQLITE_ROW: {
-        } break;
-
-        default: {
-            results.error = true;
-        } break;
-    }
-    return results;
-}
-
-int FetchColumnInt(
-    const PreparedStatement& stmt,
-    int index
-) {
-    return sqlite3_column_int(stmt.get(), index);
-}
-
-bool IsColumnNull(
-    const PreparedStatement& stmt,
-    int index
-) {
-    return (sqlite3_column_type(stmt.get(), index) == SQLITE_NULL);
-}
+using namespace SQLiteWrappers;
 
 bool DumpTable(const DatabaseConnection& db) {
     printf("-----------------------------------------------------\n");
     const auto stmt = BuildStatement(db, "SELECT entity, hp, con FROM characters");
-    StepStatementResults stepStatementResults;
-    while (
-        stepStatementResults = StepStatement(stmt),
-        !stepStatementResults.done
-    ) {
-        if (stepStatementResults.error) {
-            return false;
-        }
-        const auto entity = FetchColumnInt(stmt, 0);
-        const auto hp = FetchColumnInt(stmt, 1);
-        const auto hasCon = !IsColumnNull(stmt, 2);
-        const auto con = FetchColumnInt(stmt, 2);
+    Query< int, int, std::optional< int > > query(stmt);
+    std::tuple< int, int, std::optional< int > > row;
+    while (query.Next(row)) {
+        const auto& entity = std::get< 0 >(row);
+        const auto& hp = std::get< 1 >(row);
+        const auto& con = std::get< 2 >(row);
         printf(
             "Entity %d: hp=%d, con=%d (%s)\n",
             entity,
             hp,
-            con,
-            hasCon ? "non-null" : "null"
+            con.value_or(0),
+            con ? "non-null" : "null"
         );
     }
-    return true;
+    return !query.HasError();
 }
 
 void DemonstrateInsertRow(const DatabaseConnection& db) {
@@ -7,122 +7,22 @@
  * old rows of a table.
  */
 
-#include <functional>
-#include <memory>
-#include <sqlite3.h>
+#include <SQLiteWrappers/BindGuard.hpp>
+#include <SQLiteWrappers/Query.hpp>
+#include <SQLiteWrappers/StatementCache.hpp>
+#include <SQLiteWrappers/Wrappers.hpp>
 #include <sstream>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-using DatabaseConnection = std::unique_ptr< sqlite3, std::function< void(sqlite3*) > >;
-using PreparedStatement = std::unique_ptr< sqlite3_stmt, std::function< void(sqlite3_stmt*) > >;
-
-DatabaseConnection OpenDatabase(const std::string& path) {
-    sqlite3* dbRaw;
-    if (sqlite3_open(path.c_str(), &dbRaw) != SQLITE_OK) {
-        return nullptr;
-    }
-    return DatabaseConnection(
-        dbRaw,
-        [](sqlite3* dbRaw){
-            (void)sqlite3_close(dbRaw);
-        }
-    );
-}
-
-PreparedStatement BuildStatement(
-    const DatabaseConnection& db,
-    const std::string& statement
-) {
-    sqlite3_stmt* statementRaw;
-    if (
-        sqlite3_prepare_v2(
-            db.get(),
-            statement.c_str(),
-            (int)(statement.length() + 1), // sqlite wants count to include the null
-            &statementRaw,
-            NULL
-        ) != SQLITE_OK)
-    {
-        return nullptr;
-    }
-    return PreparedStatement(
-        statementRaw,
-        [](sqlite3_stmt* statementRaw){
-            (void)sqlite3_finalize(statementRaw);
-        }
-    );
-}
-
-void BindStatementParameter(
-    const PreparedStatement& stmt,
-    int index,
-    int value
-) {
-    (void)sqlite3_bind_int(
-        stmt.get(),
-        index,
-        value
-    );
-}
-
-void BindStatementParameter(
-    const PreparedStatement& stmt,
-    int index,
-    const std::string& value
-) {
-    (void)sqlite3_bind_text(
-        stmt.get(),
-        index,
-        value.data(),
-        (int)value.length(),
-        SQLITE_TRANSIENT
-    );
-}
-
-struct StepStatementResults {
-    bool done = false;
-    bool error = false;
-};
-
-StepStatementResults StepStatement(const PreparedStatement& stmt) {
-    StepStatementResults results;
-    switch (sqlite3_step(stmt.get())) {
-        case SQLITE_DONE: {
-            results.done = true;
-        } break;
-
-        case SQLITE_ROW: {
-        } break;
-
-        default: {
-            results.error = true;
-        } break;
-    }
-    return results;
-}
-
-int FetchColumnInt(
-    const PreparedStatement& stmt,
-    int index
-) {
-    return sqlite3_column_int(stmt.get(), index);
-}
-
-std::string FetchColumnString(
-    const PreparedStatement& stmt,
-    int index
-) {
-    return (const char*)sqlite3_column_text(stmt.get(), index);
-}
+using namespace SQLiteWrappers;
 
 int GetCloseTile(
-    const DatabaseConnection& db,
+    StatementCache& statements,
     int entity
 ) {
-    const auto stmt = BuildStatement(
-        db,
+    const auto stmt = statements.Acquire(
         "SELECT json_extract(on_close, \"$.tile.id\") FROM doors WHERE entity = ?"
     );
     BindStatementParameter(stmt, 1, entity);
@@ -135,30 +35,30 @@ int GetCloseTile(
 }
 
 void SetCloseTile(
-    const DatabaseConnection& db,
+    StatementCache& statements,
     int entity,
     int tile
 ) {
-    auto stmt = BuildStatement(
-        db,
+    const auto select = statements.Acquire(
         "SELECT json_replace(on_close, \"$.tile.id\", ?) FROM doors WHERE entity = ?"
     );
-    BindStatementParameter(stmt, 1, tile);
-    BindStatementParameter(stmt, 2, entity);
-    auto stepStatementResults = StepStatement(stmt);
-    if (stepStatementResults.error) {
+    BindStatementParameter(select, 1, tile);
+    BindStatementParameter(select, 2, entity);
+    if (StepStatement(select).error) {
         fprintf(stderr, "Something unexpected happened!  Reeeeeeeeee!!!!\n");
         return;
     }
-    const auto onClose = FetchColumnString(stmt, 0);
-    stmt = BuildStatement(
-        db,
+
+    // The modified JSON stays valid until the first statement is stepped
+    // again or reset, so we can bind it to the second statement without
+    // making any copies of it.
+    const auto onClose = std::get< 0 >(FetchRow< std::string_view >(select));
+    const auto update = statements.Acquire(
         "UPDATE doors SET on_close = ? WHERE entity = ?"
     );
-    BindStatementParameter(stmt, 1, onClose);
-    BindStatementParameter(stmt, 2, entity);
-    stepStatementResults = StepStatement(stmt);
-    if (stepStatementResults.error) {
+    BindGuard bindings(update);
+    bindings.BindAll(onClose, entity);
+    if (bindings.Step().error) {
         fprintf(stderr, "Something unexpected happened!  Reeeeeeeeee!!!!\n");
         return;
     }
@@ -166,25 +66,22 @@ void SetCloseTile(
 
 bool DumpTable(const DatabaseConnection& db) {
     printf("-----------------------------------------------------\n");
+    struct Door {
+        int entity;
+        std::string onClose;
+    };
     const auto stmt = BuildStatement(db, "SELECT entity, on_close FROM doors");
-    StepStatementResults stepStatementResults;
-    while (
-        stepStatementResults = StepStatement(stmt),
-        !stepStatementResults.done
-    ) {
-        if (stepStatementResults.error) {
-            return false;
-        }
-        const auto entity = FetchColumnInt(stmt, 0);
-        const auto onClose = FetchColumnString(stmt, 1);
+    Query< int, std::string > query(stmt);
+    Door door;
+    while (query.Next(door)) {
         printf(
             "Entity %d: on_close=\"%s\"\n",
-            entity,
-            onClose.c_str()
+            door.entity,
+            door.onClose.c_str()
         );
     }
     printf("-----------------------------------------------------\n");
-    return true;
+    return !query.HasError();
 }
 
 int main(int argc, char* argv[]) {
@@ -201,14 +98,18 @@ int main(int argc, char* argv[]) {
         return EXIT_FAILURE;
     }
 
+    // Keep the statements used by the lookup helpers around, so that
+    // calling the helpers again doesn't compile the same SQL again.
+    StatementCache statements(db);
+
     // These demonstrate reading and modifying a JSON value in the database.
     DumpTable(db);
-    auto tile = GetCloseTile(db, 44466);
+    auto tile = GetCloseTile(statements, 44466);
     printf("The close tile is %d.\n", tile);
     tile = 3;
     printf("Changing the close tile to %d.\n", tile);
-    SetCloseTile(db, 44466, tile);
-    tile = GetCloseTile(db, 44466);
+    SetCloseTile(statements, 44466, tile);
+    tile = GetCloseTile(statements, 44466);
     printf("The close tile is now %d.\n", tile);
     DumpTable(db);
 
@@ -185,6 +185,26 @@ typedef unsigned char u8;
 #define isatty(x) 1
 #endif
 
+/*
+** Some long-running commands, such as .import, spread their work over
+** several threads where POSIX threads are available.  Define
+** SQLITE_SHELL_NO_THREADS to build the shell without them, in which case
+** those commands do all their work on the main thread.
+*/
+#if !defined(SQLITE_SHELL_NO_THREADS) && !defined(_WIN32) && !defined(WIN32) \
+ && !defined(__RTP__) && !defined(_WRS_KERNEL)
+# define SHELL_USE_PTHREADS 1
+# include <pthread.h>
+#else
+# define SHELL_USE_PTHREADS 0
+#endif
+
+/*
+** Vectorized kernels for scanning and hex-encoding output text, with
+** scalar fallbacks.  The best ones for the CPU are chosen in main().
+*/
+#include "shellscan.h"
+
 /* ctype macros that work with signed characters */
 #define IsSpace(X)  isspace((unsigned char)X)
 #define IsDigit(X)  isdigit((unsigned char)X)
@@ -221,7 +241,11 @@ static void setTextMode(FILE *file, int isOutput){
 #endif
 
 
-/* True if the timer is enabled */
+/* Allowed values for enableTimer */
+#define SHELL_TIMER_ON       1   /* Show the time taken by each line of SQL */
+#define SHELL_TIMER_SUMMARY  2   /* Only collect times, for a summary */
+
+/* One of the SHELL_TIMER_* values if the timer is enabled, else 0 */
 static int enableTimer = 0;
 
 /* Return the current wall-clock time */
@@ -239,6 +263,31 @@ static sqlite3_int64 timeOfDay(void){
   return t;
 }
 
+#if !defined(_WIN32) && !defined(WIN32)
+# include <time.h>
+#endif
+
+/*
+** Return the time in nanoseconds from a monotonic clock, which changes of
+** the wall-clock time do not affect, for timing statements.
+*/
+static sqlite3_int64 timerNow(void){
+#if defined(_WIN32) || defined(WIN32)
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER t;
+  if( freq.QuadPart==0 ) QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&t);
+  return (t.QuadPart/freq.QuadPart)*1000000000
+       + (t.QuadPart%freq.QuadPart)*1000000000/freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (sqlite3_int64)t.tv_sec*1000000000 + t.tv_nsec;
+#else
+  return timeOfDay()*1000000;
+#endif
+}
+
 #if !defined(_WIN32) && !defined(WIN32) && !defined(__minux)
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -262,7 +311,7 @@ static sqlite3_int64 iBegin;  /* Wall-clock time at start */
 static void beginTimer(void){
   if( enableTimer ){
     getrusage(RUSAGE_SELF, &sBegin);
-    iBegin = timeOfDay();
+    iBegin = timerNow();
   }
 }
 
@@ -273,22 +322,24 @@ static double timeDiff(struct timeval *pStart, struct timeval *pEnd){
 }
 
 /*
-** Print the timing results.
+** Print the timing results, with the nPrepare and nStep nanoseconds spent
+** preparing and stepping statements since the timer began.
 */
-static void endTimer(void){
-  if( enableTimer ){
-    sqlite3_int64 iEnd = timeOfDay();
+static void endTimer(sqlite3_int64 nPrepare, sqlite3_int64 nStep){
+  if( enableTimer==SHELL_TIMER_ON ){
+    sqlite3_int64 iEnd = timerNow();
     struct rusage sEnd;
     getrusage(RUSAGE_SELF, &sEnd);
-    printf("Run Time: real %.3f user %f sys %f\n",
-       (iEnd - iBegin)*0.001,
+    printf("Run Time: real %.6f user %f sys %f prepare %.6f step %.6f\n",
+       (iEnd - iBegin)*0.000000001,
        timeDiff(&sBegin.ru_utime, &sEnd.ru_utime),
-       timeDiff(&sBegin.ru_stime, &sEnd.ru_stime));
+       timeDiff(&sBegin.ru_stime, &sEnd.ru_stime),
+       nPrepare*0.000000001, nStep*0.000000001);
   }
 }
 
 #define BEGIN_TIMER beginTimer()
-#define END_TIMER endTimer()
+#define END_TIMER(P,S) endTimer(P,S)
 #define HAS_TIMER 1
 
 #elif (defined(_WIN32) || defined(WIN32))
@@ -338,7 +389,7 @@ static void beginTimer(void){
     FILETIME ftCreation, ftExit;
     getProcessTimesAddr(hProcess,&ftCreation,&ftExit,
                         &ftKernelBegin,&ftUserBegin);
-    ftWallBegin = timeOfDay();
+    ftWallBegin = timerNow();
   }
 }
 
@@ -350,27 +401,29 @@ static double timeDiff(FILETIME *pStart, FILETIME *pEnd){
 }
 
 /*
-** Print the timing results.
+** Print the timing results, with the nPrepare and nStep nanoseconds spent
+** preparing and stepping statements since the timer began.
 */
-static void endTimer(void){
-  if( enableTimer && getProcessTimesAddr){
+static void endTimer(sqlite3_int64 nPrepare, sqlite3_int64 nStep){
+  if( enableTimer==SHELL_TIMER_ON && getProcessTimesAddr){
     FILETIME ftCreation, ftExit, ftKernelEnd, ftUserEnd;
-    sqlite3_int64 ftWallEnd = timeOfDay();
+    sqlite3_int64 ftWallEnd = timerNow();
     getProcessTimesAddr(hProcess,&ftCreation,&ftExit,&ftKernelEnd,&ftUserEnd);
-    printf("Run Time: real %.3f user %f sys %f\n",
-       (ftWallEnd - ftWallBegin)*0.001,
+    printf("Run Time: real %.6f user %f sys %f prepare %.6f step %.6f\n",
+       (ftWallEnd - ftWallBegin)*0.000000001,
        timeDiff(&ftUserBegin, &ftUserEnd),
-       timeDiff(&ftKernelBegin, &ftKernelEnd));
+       timeDiff(&ftKernelBegin, &ftKernelEnd),
+       nPrepare*0.000000001, nStep*0.000000001);
   }
 }
 
 #define BEGIN_TIMER beginTimer()
-#define END_TIMER endTimer()
+#define END_TIMER(P,S) endTimer(P,S)
 #define HAS_TIMER hasTimer()
 
 #else
 #define BEGIN_TIMER
-#define END_TIMER
+#define END_TIMER(P,S)
 #define HAS_TIMER 0
 #endif
 
@@ -460,6 +513,31 @@ void utf8_printf(FILE *out, const char *zFormat, ...){
 # define raw_printf fprintf
 #endif
 
+/*
+** Write the text z to out, exactly as utf8_printf(out,"%s",z) would, but
+** without formatting it unless it needs to be translated for the console.
+*/
+#if defined(_WIN32) || defined(WIN32)
+# define utf8_fputs(z,out) utf8_printf(out,"%s",z)
+#else
+# define utf8_fputs(z,out) fputs(z,out)
+#endif
+
+/*
+** Size of the buffer given to output streams which are not a terminal.
+** Results written to a file or pipe go out in writes of this size rather
+** than in the few kilobytes which stdio would use otherwise.  Output is
+** still flushed before each line of input is read.
+*/
+#ifndef SHELL_OUTPUT_BUFFER
+# define SHELL_OUTPUT_BUFFER (1<<20)
+#endif
+
+/* Give the output stream f a buffer of SHELL_OUTPUT_BUFFER bytes */
+static void output_set_buffer(FILE *f){
+  if( f ) setvbuf(f, 0, _IOFBF, SHELL_OUTPUT_BUFFER);
+}
+
 /* Indicate out-of-memory and exit. */
 static void shell_out_of_memory(void){
   raw_printf(stderr,"Error: out of memory\n");
@@ -9588,6 +9666,7 @@ struct ShellState {
   int lineno;            /* Line number of last line read from in */
   int openFlags;         /* Additional flags to open.  (SQLITE_OPEN_NOFOLLOW) */
   FILE *in;              /* Read commands from this stream */
+  struct CompressedInput *pCin; /* Decompresses the text of in, or NULL */
   FILE *out;             /* Write results here */
   FILE *traceOut;        /* Output for sqlite3_trace() */
   int nErr;              /* Number of errors seen */
@@ -9604,6 +9683,12 @@ struct ShellState {
   unsigned shellFlgs;    /* Various flags */
   sqlite3_int64 szMax;   /* --maxsize argument to .open */
   char *zDestTable;      /* Name of destination table when MODE_Insert */
+  int nInsertRows;       /* Most rows per INSERT statement in MODE_Insert */
+  int nInsertBatch;      /* Rows per transaction in MODE_Insert.  0: any */
+  int nInsertOpen;       /* Rows in the INSERT statement not yet ended */
+  int nInsertTxn;        /* Rows since the last transaction began */
+  int nInsertCommit;     /* Transactions committed between rows */
+  u8 bInsertInTxn;       /* MODE_Insert output is already in a transaction */
   char *zTempFile;       /* Temporary file that might need deleting */
   char zTestcase[30];    /* Name of current test case */
   char colSeparator[20]; /* Column separator character for several modes */
@@ -9629,6 +9714,11 @@ struct ShellState {
   OpenSession aSession[4];  /* Array of sessions.  [0] is in focus. */
 #endif
   ExpertInfo expert;        /* Valid if previous command was ".expert OPT..." */
+  struct BackupJob *pBackupJob; /* The ".backup --background" running, if any */
+  sqlite3_int64 iTimerPrepare;  /* Nanoseconds preparing since BEGIN_TIMER */
+  sqlite3_int64 iTimerStep;     /* Nanoseconds stepping since BEGIN_TIMER */
+  sqlite3_int64 iStmtStep;      /* Nanoseconds stepping the current stmt */
+  struct TimerStats *pTimerStats; /* Times collected by ".timer", or NULL */
 };
 
 
@@ -9696,6 +9786,8 @@ struct ShellState {
 #define MODE_Ascii   10  /* Use ASCII unit and record separators (0x1F/0x1E) */
 #define MODE_Pretty  11  /* Pretty-print schemas */
 #define MODE_EQP     12  /* Converts EXPLAIN QUERY PLAN output into a graph */
+#define MODE_Json    13  /* Rows as objects of one JSON array */
+#define MODE_NdJson  14  /* One JSON object per row, one row per line */
 
 static const char *modeDescr[] = {
   "line",
@@ -9710,7 +9802,9 @@ static const char *modeDescr[] = {
   "explain",
   "ascii",
   "prettyprint",
-  "eqp"
+  "eqp",
+  "json",
+  "ndjson"
 };
 
 /*
@@ -9915,10 +10009,16 @@ static void outputModePop(ShellState *p){
 ** Output the given string as a hex-encoded blob (eg. X'1234' )
 */
 static void output_hex_blob(FILE *out, const void *pBlob, int nBlob){
-  int i;
-  char *zBlob = (char *)pBlob;
+  const unsigned char *a = (const unsigned char*)pBlob;
+  char zHex[2048];
   raw_printf(out,"X'");
-  for(i=0; i<nBlob; i++){ raw_printf(out,"%02x",zBlob[i]&0xff); }
+  while( nBlob>0 ){
+    int n = nBlob<(int)sizeof(zHex)/2 ? nBlob : (int)sizeof(zHex)/2;
+    shellScan->xHexEncode(zHex, a, n);
+    fwrite(zHex, 1, 2*n, out);
+    a += n;
+    nBlob -= n;
+  }
   raw_printf(out,"'");
 }
 
@@ -9949,31 +10049,21 @@ static const char *unused_string(
 ** See also: output_quoted_escaped_string()
 */
 static void output_quoted_string(FILE *out, const char *z){
-  int i;
-  char c;
+  size_t n = strlen(z);
+  size_t i = shellScan->xScanQuote(z, n, 0);
   setBinaryMode(out, 1);
-  for(i=0; (c = z[i])!=0 && c!='\''; i++){}
-  if( c==0 ){
+  if( i==n ){
     utf8_printf(out,"'%s'",z);
   }else{
     raw_printf(out, "'");
-    while( *z ){
-      for(i=0; (c = z[i])!=0 && c!='\''; i++){}
-      if( c=='\'' ) i++;
-      if( i ){
-        utf8_printf(out, "%.*s", i, z);
-        z += i;
-      }
-      if( c=='\'' ){
-        raw_printf(out, "'");
-        continue;
-      }
-      if( c==0 ){
-        break;
-      }
-      z++;
+    while( i<n ){
+      /* Output up to and including the quote at z[i], then double it */
+      utf8_printf(out, "%.*s'", (int)i+1, z);
+      z += i+1;
+      n -= i+1;
+      i = shellScan->xScanQuote(z, n, 0);
     }
-    raw_printf(out, "'");
+    utf8_printf(out, "%s'", z);
   }
   setTextMode(out, 1);
 }
@@ -9988,11 +10078,11 @@ static void output_quoted_string(FILE *out, const char *z){
 ** escape mechanism.
 */
 static void output_quoted_escaped_string(FILE *out, const char *z){
-  int i;
+  size_t n = strlen(z);
+  size_t i = shellScan->xScanQuote(z, n, 1);
   char c;
   setBinaryMode(out, 1);
-  for(i=0; (c = z[i])!=0 && c!='\'' && c!='\n' && c!='\r'; i++){}
-  if( c==0 ){
+  if( i==n ){
     utf8_printf(out,"'%s'",z);
   }else{
     const char *zNL = 0;
@@ -10000,7 +10090,7 @@ static void output_quoted_escaped_string(FILE *out, const char *z){
     int nNL = 0;
     int nCR = 0;
     char zBuf1[20], zBuf2[20];
-    for(i=0; z[i]; i++){
+    for(; i<n; i+=1+shellScan->xScanQuote(&z[i+1], n-i-1, 1)){
       if( z[i]=='\n' ) nNL++;
       if( z[i]=='\r' ) nCR++;
     }
@@ -10013,26 +10103,22 @@ static void output_quoted_escaped_string(FILE *out, const char *z){
       zCR = unused_string(z, "\\r", "\\015", zBuf2);
     }
     raw_printf(out, "'");
-    while( *z ){
-      for(i=0; (c = z[i])!=0 && c!='\n' && c!='\r' && c!='\''; i++){}
-      if( c=='\'' ) i++;
-      if( i ){
-        utf8_printf(out, "%.*s", i, z);
-        z += i;
-      }
-      if( c=='\'' ){
-        raw_printf(out, "'");
-        continue;
-      }
-      if( c==0 ){
+    while( n>0 ){
+      i = shellScan->xScanQuote(z, n, 1);
+      if( i==n ){
+        utf8_printf(out, "%s", z);
         break;
       }
-      z++;
-      if( c=='\n' ){
-        raw_printf(out, "%s", zNL);
-        continue;
+      c = z[i];
+      if( c=='\'' ){
+        /* Output up to and including the quote, then double it */
+        utf8_printf(out, "%.*s'", (int)i+1, z);
+      }else{
+        if( i ) utf8_printf(out, "%.*s", (int)i, z);
+        raw_printf(out, "%s", c=='\n' ? zNL : zCR);
       }
-      raw_printf(out, "%s", zCR);
+      z += i+1;
+      n -= i+1;
     }
     raw_printf(out, "'");
     if( nCR ){
@@ -10111,29 +10197,6 @@ static void output_html_string(FILE *out, const char *z){
   }
 }
 
-/*
-** If a field contains any character identified by a 1 in the following
-** array, then the string must be quoted for CSV.
-*/
-static const char needCsvQuote[] = {
-  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
-  1, 0, 1, 0, 0, 0, 0, 1,   0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 1,
-  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
-  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
-};
-
 /*
 ** Output a single term of CSV.  Actually, p->colSeparator is used for
 ** the separator, which may or may not be a comma.  p->nullValue is
@@ -10143,28 +10206,32 @@ static const char needCsvQuote[] = {
 static void output_csv(ShellState *p, const char *z, int bSep){
   FILE *out = p->out;
   if( z==0 ){
-    utf8_printf(out,"%s",p->nullValue);
+    utf8_fputs(p->nullValue, out);
   }else{
-    int i;
     int nSep = strlen30(p->colSeparator);
-    for(i=0; z[i]; i++){
-      if( needCsvQuote[((unsigned char*)z)[i]]
-         || (z[i]==p->colSeparator[0] &&
-             (nSep==1 || memcmp(z, p->colSeparator, nSep)==0)) ){
-        i = 0;
-        break;
+    size_t n = strlen(z);
+    size_t i = 0;
+    int bQuote = n==0;
+    /* Each byte the scan stops at either needs quoting or might be the
+    ** start of the separator */
+    while( !bQuote
+        && (i += shellScan->xScanCsv(&z[i], n-i, p->colSeparator[0]))<n ){
+      if( shellScanNeedCsvQuote[((unsigned char*)z)[i]]
+         || nSep==1 || memcmp(z, p->colSeparator, nSep)==0 ){
+        bQuote = 1;
       }
+      i++;
     }
-    if( i==0 ){
+    if( bQuote ){
       char *zQuoted = sqlite3_mprintf("\"%w\"", z);
-      utf8_printf(out, "%s", zQuoted);
+      utf8_fputs(zQuoted, out);
       sqlite3_free(zQuoted);
     }else{
-      utf8_printf(out, "%s", z);
+      utf8_fputs(z, out);
     }
   }
   if( bSep ){
-    utf8_printf(p->out, "%s", p->colSeparator);
+    utf8_fputs(p->colSeparator, p->out);
   }
 }
 
@@ -10385,6 +10452,281 @@ static int progress_handler(void *pClientData) {
 }
 #endif /* SQLITE_OMIT_PROGRESS_CALLBACK */
 
+/*
+** Space needed for the text of any integer or real value, as formatted
+** by shell_format_int64() or shell_format_double().
+*/
+#define SHELL_NUM_WIDTH 32
+
+/*
+** Write the decimal text of v into z[], which must have room for
+** SHELL_NUM_WIDTH bytes, and return its length.  The text is the same
+** as sqlite3_column_text() returns for an integer value.
+*/
+static int shell_format_int64(char *z, sqlite3_int64 v){
+  char zBuf[24];
+  int i = sizeof(zBuf);
+  int n;
+  sqlite3_uint64 u = v<0 ? ~(sqlite3_uint64)v+1 : (sqlite3_uint64)v;
+  do{
+    zBuf[--i] = (char)('0' + u%10);
+    u /= 10;
+  }while( u );
+  if( v<0 ) zBuf[--i] = '-';
+  n = (int)sizeof(zBuf) - i;
+  memcpy(z, &zBuf[i], n);
+  z[n] = 0;
+  return n;
+}
+
+/*
+** Write the text of real value r into z[], which must have room for
+** SHELL_NUM_WIDTH bytes, and return its length.  The text is the same
+** as sqlite3_column_text() returns for a real value.
+*/
+static int shell_format_double(char *z, double r){
+  sqlite3_snprintf(SHELL_NUM_WIDTH, z, "%!.15g", r);
+  return strlen30(z);
+}
+
+/*
+** A buffer which collects the JSON text of a row for an output stream,
+** so that the text goes out in a few large writes.
+*/
+typedef struct JsonOut JsonOut;
+struct JsonOut {
+  FILE *out;            /* Where the text goes */
+  size_t n;             /* Bytes of z[] used */
+  char z[4096];         /* Text not yet written */
+};
+
+/* Write the text collected in p so far */
+static void json_out_flush(JsonOut *p){
+  if( p->n>0 ){
+    fwrite(p->z, 1, p->n, p->out);
+    p->n = 0;
+  }
+}
+
+/* Append the n bytes of z[] to p */
+static void json_out_append(JsonOut *p, const char *z, size_t n){
+  if( p->n+n>sizeof(p->z) ){
+    json_out_flush(p);
+    if( n>sizeof(p->z) ){
+      fwrite(z, 1, n, p->out);
+      return;
+    }
+  }
+  memcpy(&p->z[p->n], z, n);
+  p->n += n;
+}
+
+/*
+** Append the n bytes of z[] to p as a JSON string.  Runs of bytes which
+** need no escape are copied in one go.
+*/
+static void json_out_string(JsonOut *p, const char *z, size_t n){
+  static const char zHex[] = "0123456789abcdef";
+  size_t i = 0;
+  json_out_append(p, "\"", 1);
+  while( i<n ){
+    size_t j = i;
+    unsigned char c;
+    while( j<n && (c = (unsigned char)z[j])>=0x20 && c!='"' && c!='\\' ) j++;
+    json_out_append(p, &z[i], j-i);
+    if( j>=n ) break;
+    c = (unsigned char)z[j];
+    switch( c ){
+      case '"':   json_out_append(p, "\\\"", 2);  break;
+      case '\\':  json_out_append(p, "\\\\", 2);  break;
+      case '\n':  json_out_append(p, "\\n", 2);   break;
+      case '\r':  json_out_append(p, "\\r", 2);   break;
+      case '\t':  json_out_append(p, "\\t", 2);   break;
+      case '\b':  json_out_append(p, "\\b", 2);   break;
+      case '\f':  json_out_append(p, "\\f", 2);   break;
+      default: {
+        char zEsc[6];
+        zEsc[0] = '\\';
+        zEsc[1] = 'u';
+        zEsc[2] = '0';
+        zEsc[3] = '0';
+        zEsc[4] = zHex[c>>4];
+        zEsc[5] = zHex[c&0xf];
+        json_out_append(p, zEsc, 6);
+        break;
+      }
+    }
+    i = j+1;
+  }
+  json_out_append(p, "\"", 1);
+}
+
+/* Append integer v to p */
+static void json_out_int64(JsonOut *p, sqlite3_int64 v){
+  char zBuf[SHELL_NUM_WIDTH];
+  json_out_append(p, zBuf, shell_format_int64(zBuf, v));
+}
+
+/*
+** Append real r to p, with as few digits as read back as the same value.
+** JSON has no infinities or NaN, so those become 1e999, -1e999 and null,
+** as the JSON1 extension has them.
+*/
+static void json_out_double(JsonOut *p, double r){
+  char zBuf[40];
+  if( r!=r ){
+    json_out_append(p, "null", 4);
+    return;
+  }
+  if( r>1.7976931348623157e308 ){
+    json_out_append(p, "1e999", 5);
+    return;
+  }
+  if( r< -1.7976931348623157e308 ){
+    json_out_append(p, "-1e999", 6);
+    return;
+  }
+  if( r==0.0 && 1.0/r<0.0 ){
+    /* sqlite3_snprintf() drops the sign of negative zero */
+    json_out_append(p, "-0.0", 4);
+    return;
+  }
+  sqlite3_snprintf(sizeof(zBuf), zBuf, "%!.15g", r);
+  if( strtod(zBuf, 0)!=r ){
+    sqlite3_snprintf(sizeof(zBuf), zBuf, "%!.16g", r);
+    if( strtod(zBuf, 0)!=r ){
+      sqlite3_snprintf(sizeof(zBuf), zBuf, "%!.17g", r);
+    }
+  }
+  json_out_append(p, zBuf, strlen(zBuf));
+}
+
+/*
+** Output a row of results as a JSON object, for MODE_Json or MODE_NdJson.
+** Numbers, blobs and text are taken from p->pStmt as they are, if the types
+** of the values are known, and blobs become strings of hex digits.
+*/
+static void json_output_row(
+  ShellState *p,
+  int nArg,
+  char **azArg,
+  char **azCol,
+  int *aiType
+){
+  JsonOut o;
+  int i;
+  o.out = p->out;
+  o.n = 0;
+  if( p->cMode==MODE_Json ){
+    json_out_append(&o, p->cnt==0 ? "[" : ",\n", p->cnt==0 ? 1 : 2);
+  }
+  p->cnt++;
+  json_out_append(&o, "{", 1);
+  for(i=0; i<nArg; i++){
+    int eType = aiType ? aiType[i] : 0;
+    const char *zCol = azCol[i] ? azCol[i] : "";
+    if( i>0 ) json_out_append(&o, ",", 1);
+    json_out_string(&o, zCol, strlen(zCol));
+    json_out_append(&o, ":", 1);
+    if( azArg[i]==0 || eType==SQLITE_NULL ){
+      json_out_append(&o, "null", 4);
+    }else if( eType==SQLITE_INTEGER && p->pStmt ){
+      json_out_int64(&o, sqlite3_column_int64(p->pStmt, i));
+    }else if( eType==SQLITE_FLOAT && p->pStmt ){
+      json_out_double(&o, sqlite3_column_double(p->pStmt, i));
+    }else if( eType==SQLITE_BLOB && p->pStmt ){
+      const unsigned char *a = sqlite3_column_blob(p->pStmt, i);
+      int nBlob = sqlite3_column_bytes(p->pStmt, i);
+      json_out_append(&o, "\"", 1);
+      while( nBlob>0 ){
+        int n = nBlob<(int)sizeof(o.z)/4 ? nBlob : (int)sizeof(o.z)/4;
+        if( o.n+2*n>sizeof(o.z) ) json_out_flush(&o);
+        shellScan->xHexEncode(&o.z[o.n], a, n);
+        o.n += 2*n;
+        a += n;
+        nBlob -= n;
+      }
+      json_out_append(&o, "\"", 1);
+    }else if( eType==SQLITE_TEXT && p->pStmt ){
+      /* The text may hold NUL characters, which become \u0000 */
+      json_out_string(&o, azArg[i], sqlite3_column_bytes(p->pStmt, i));
+    }else if( eType==0 && isNumber(azArg[i], 0) ){
+      json_out_append(&o, azArg[i], strlen(azArg[i]));
+    }else{
+      json_out_string(&o, azArg[i], strlen(azArg[i]));
+    }
+  }
+  json_out_append(&o, p->cMode==MODE_Json ? "}" : "}\n",
+                  p->cMode==MODE_Json ? 1 : 2);
+  json_out_flush(&o);
+}
+
+/*
+** Begin a row of MODE_Insert output.  Begin a new INSERT statement unless
+** the previous one is still open for more rows, and begin or renew the
+** transaction around the statements if there is to be one.
+*/
+static void insert_begin_row(ShellState *p, int nArg, char **azCol){
+  int i;
+  if( p->nInsertOpen>0 ){
+    raw_printf(p->out, ",\n(");
+    return;
+  }
+  if( p->nInsertBatch>0 ){
+    if( p->cnt==0 ){
+      if( !p->bInsertInTxn ) raw_printf(p->out, "BEGIN TRANSACTION;\n");
+    }else if( p->nInsertTxn>=p->nInsertBatch ){
+      raw_printf(p->out, "COMMIT;\nBEGIN TRANSACTION;\n");
+      p->nInsertTxn = 0;
+      p->nInsertCommit++;
+    }
+  }
+  utf8_printf(p->out,"INSERT INTO %s",p->zDestTable);
+  if( p->showHeader ){
+    raw_printf(p->out,"(");
+    for(i=0; i<nArg; i++){
+      if( i>0 ) raw_printf(p->out, ",");
+      if( quoteChar(azCol[i]) ){
+        char *z = sqlite3_mprintf("\"%w\"", azCol[i]);
+        utf8_printf(p->out, "%s", z);
+        sqlite3_free(z);
+      }else{
+        raw_printf(p->out, "%s", azCol[i]);
+      }
+    }
+    raw_printf(p->out,")");
+  }
+  raw_printf(p->out," VALUES(");
+}
+
+/*
+** End a row of MODE_Insert output, and the INSERT statement too once it
+** holds p->nInsertRows rows.
+*/
+static void insert_end_row(ShellState *p){
+  raw_printf(p->out,")");
+  p->nInsertTxn++;
+  if( ++p->nInsertOpen>=p->nInsertRows ){
+    raw_printf(p->out,";\n");
+    p->nInsertOpen = 0;
+  }
+}
+
+/*
+** End the MODE_Insert output of a query: the INSERT statement still open
+** and the transaction begun for the query, if any.
+*/
+static void insert_finish(ShellState *p){
+  if( p->nInsertOpen>0 ){
+    raw_printf(p->out,";\n");
+    p->nInsertOpen = 0;
+  }
+  if( p->cnt>0 && p->nInsertBatch>0 && !p->bInsertInTxn ){
+    raw_printf(p->out, "COMMIT;\n");
+  }
+  p->nInsertTxn = 0;
+}
+
 /*
 ** This is the callback routine that the shell
 ** invokes for each row of a query result.
@@ -10573,11 +10915,11 @@ static int shell_callback(
       for(i=0; i<nArg; i++){
         char *z = azArg[i];
         if( z==0 ) z = p->nullValue;
-        utf8_printf(p->out, "%s", z);
+        utf8_fputs(z, p->out);
         if( i<nArg-1 ){
-          utf8_printf(p->out, "%s", p->colSeparator);
+          utf8_fputs(p->colSeparator, p->out);
         }else{
-          utf8_printf(p->out, "%s", p->rowSeparator);
+          utf8_fputs(p->rowSeparator, p->out);
         }
       }
       break;
@@ -10630,31 +10972,17 @@ static int shell_callback(
         for(i=0; i<nArg; i++){
           output_csv(p, azArg[i], i<nArg-1);
         }
-        utf8_printf(p->out, "%s", p->rowSeparator);
+        utf8_fputs(p->rowSeparator, p->out);
       }
       setTextMode(p->out, 1);
       break;
     }
     case MODE_Insert: {
       if( azArg==0 ) break;
-      utf8_printf(p->out,"INSERT INTO %s",p->zDestTable);
-      if( p->showHeader ){
-        raw_printf(p->out,"(");
-        for(i=0; i<nArg; i++){
-          if( i>0 ) raw_printf(p->out, ",");
-          if( quoteChar(azCol[i]) ){
-            char *z = sqlite3_mprintf("\"%w\"", azCol[i]);
-            utf8_printf(p->out, "%s", z);
-            sqlite3_free(z);
-          }else{
-            raw_printf(p->out, "%s", azCol[i]);
-          }
-        }
-        raw_printf(p->out,")");
-      }
+      insert_begin_row(p, nArg, azCol);
       p->cnt++;
       for(i=0; i<nArg; i++){
-        raw_printf(p->out, i>0 ? "," : " VALUES(");
+        if( i>0 ) raw_printf(p->out, ",");
         if( (azArg[i]==0) || (aiType && aiType[i]==SQLITE_NULL) ){
           utf8_printf(p->out,"NULL");
         }else if( aiType && aiType[i]==SQLITE_TEXT ){
@@ -10664,7 +10992,7 @@ static int shell_callback(
             output_quoted_escaped_string(p->out, azArg[i]);
           }
         }else if( aiType && aiType[i]==SQLITE_INTEGER ){
-          utf8_printf(p->out,"%s", azArg[i]);
+          utf8_fputs(azArg[i], p->out);
         }else if( aiType && aiType[i]==SQLITE_FLOAT ){
           char z[50];
           double r = sqlite3_column_double(p->pStmt, i);
@@ -10690,7 +11018,7 @@ static int shell_callback(
           output_quoted_escaped_string(p->out, azArg[i]);
         }
       }
-      raw_printf(p->out,");\n");
+      insert_end_row(p);
       break;
     }
     case MODE_Quote: {
@@ -10710,7 +11038,7 @@ static int shell_callback(
         }else if( aiType && aiType[i]==SQLITE_TEXT ){
           output_quoted_string(p->out, azArg[i]);
         }else if( aiType && aiType[i]==SQLITE_INTEGER ){
-          utf8_printf(p->out,"%s", azArg[i]);
+          utf8_fputs(azArg[i], p->out);
         }else if( aiType && aiType[i]==SQLITE_FLOAT ){
           char z[50];
           double r = sqlite3_column_double(p->pStmt, i);
@@ -10729,6 +11057,12 @@ static int shell_callback(
       raw_printf(p->out,"\n");
       break;
     }
+    case MODE_Json:
+    case MODE_NdJson: {
+      if( azArg==0 ) break;
+      json_output_row(p, nArg, azArg, azCol, aiType);
+      break;
+    }
     case MODE_Ascii: {
       if( p->cnt++==0 && p->showHeader ){
         for(i=0; i<nArg; i++){
@@ -11387,6 +11721,21 @@ static void bind_prepared_stmt(ShellState *pArg, sqlite3_stmt *pStmt){
   sqlite3_finalize(pQ);
 }
 
+/*
+** Step pStmt once.  If the timer is enabled, add the time the step took
+** to pArg->iStmtStep, so that the time spent formatting and writing rows
+** between steps is not counted as step time.
+*/
+static int shell_step(ShellState *pArg, sqlite3_stmt *pStmt){
+  sqlite3_int64 iStart;
+  int rc;
+  if( !enableTimer || pArg==0 ) return sqlite3_step(pStmt);
+  iStart = timerNow();
+  rc = sqlite3_step(pStmt);
+  pArg->iStmtStep += timerNow() - iStart;
+  return rc;
+}
+
 /*
 ** Run a prepared statement
 */
@@ -11399,18 +11748,20 @@ static void exec_prepared_stmt(
   /* perform the first step.  this will tell us if we
   ** have a result set or not and how wide it is.
   */
-  rc = sqlite3_step(pStmt);
+  rc = shell_step(pArg, pStmt);
   /* if we have a result set... */
   if( SQLITE_ROW == rc ){
     /* allocate space for col name ptr, value ptr, and type */
     int nCol = sqlite3_column_count(pStmt);
-    void *pData = sqlite3_malloc64(3*nCol*sizeof(const char*) + 1);
+    void *pData = sqlite3_malloc64(3*nCol*sizeof(const char*)
+                                   + nCol*SHELL_NUM_WIDTH + 1);
     if( !pData ){
       rc = SQLITE_NOMEM;
     }else{
       char **azCols = (char **)pData;      /* Names of result columns */
       char **azVals = &azCols[nCol];       /* Results */
       int *aiTypes = (int *)&azVals[nCol]; /* Result types */
+      char *zNums = (char*)&azVals[2*nCol];/* Text of numeric results */
       int i, x;
       assert(sizeof(int) <= sizeof(char *));
       /* save off ptrs to column names */
@@ -11423,6 +11774,17 @@ static void exec_prepared_stmt(
           aiTypes[i] = x = sqlite3_column_type(pStmt, i);
           if( x==SQLITE_BLOB && pArg && pArg->cMode==MODE_Insert ){
             azVals[i] = "";
+          }else if( x!=SQLITE_TEXT && x!=SQLITE_NULL && pArg
+                 && (pArg->cMode==MODE_Json || pArg->cMode==MODE_NdJson) ){
+            /* Non-text values are output from their native types */
+            azVals[i] = "";
+          }else if( x==SQLITE_INTEGER ){
+            /* Format numbers here rather than have SQLite convert them */
+            azVals[i] = &zNums[i*SHELL_NUM_WIDTH];
+            shell_format_int64(azVals[i], sqlite3_column_int64(pStmt, i));
+          }else if( x==SQLITE_FLOAT ){
+            azVals[i] = &zNums[i*SHELL_NUM_WIDTH];
+            shell_format_double(azVals[i], sqlite3_column_double(pStmt, i));
           }else{
             azVals[i] = (char*)sqlite3_column_text(pStmt, i);
           }
@@ -11438,11 +11800,15 @@ static void exec_prepared_stmt(
           if( shell_callback(pArg, nCol, azVals, azCols, aiTypes) ){
             rc = SQLITE_ABORT;
           }else{
-            rc = sqlite3_step(pStmt);
+            rc = shell_step(pArg, pStmt);
           }
         }
       } while( SQLITE_ROW == rc );
       sqlite3_free(pData);
+      if( pArg && pArg->cMode==MODE_Insert ) insert_finish(pArg);
+      if( pArg && pArg->cMode==MODE_Json && pArg->cnt>0 ){
+        raw_printf(pArg->out, "]\n");
+      }
     }
   }
 }
@@ -11578,6 +11944,159 @@ static int expertDotCommand(
 }
 #endif /* ifndef SQLITE_OMIT_VIRTUALTABLE */
 
+/*
+** With ".timer summary", the time taken to prepare and to step each
+** statement is collected into histograms instead of being shown line by
+** line, and percentiles of it are shown at the end of each top-level
+** .read script and on exit.  Histogram buckets are spaced by powers of
+** two, each split into TIMER_SUB_BUCKETS equal sub-buckets, so that any
+** percentile is within about 6% of the true value at any scale.  With
+** --csv, the times of every statement are also written to a file.
+*/
+#define TIMER_SUB_BITS     4
+#define TIMER_SUB_BUCKETS  (1<<TIMER_SUB_BITS)
+#define TIMER_N_BUCKET     ((64-TIMER_SUB_BITS+1)*TIMER_SUB_BUCKETS)
+
+/* Distribution of one kind of time taken by statements */
+typedef struct TimerHist TimerHist;
+struct TimerHist {
+  sqlite3_uint64 nCount;                  /* Number of times recorded */
+  sqlite3_uint64 iTotal;                  /* Sum of all times recorded */
+  sqlite3_uint64 iMax;                    /* Largest time recorded */
+  sqlite3_uint64 aBucket[TIMER_N_BUCKET]; /* Count of times in each bucket */
+};
+
+/* Times collected while the timer is enabled */
+typedef struct TimerStats TimerStats;
+struct TimerStats {
+  TimerHist aHist[3];     /* Prepare, step and total time of statements */
+  sqlite3_int64 nErr;     /* Number of statements which failed */
+  sqlite3_int64 iSeq;     /* Number of the last statement timed */
+  FILE *pCsv;             /* The time of each statement is written here */
+};
+
+/* Depth of nested .read commands, to find the end of a whole script */
+static int nTimerReadDepth = 0;
+
+/* Return the index of the histogram bucket which counts time iTime */
+static int timer_bucket(sqlite3_uint64 iTime){
+  int iShift = 0;
+  if( iTime<TIMER_SUB_BUCKETS ) return (int)iTime;
+  while( (iTime>>iShift)>=2*TIMER_SUB_BUCKETS ) iShift++;
+  return (iShift+1)*TIMER_SUB_BUCKETS
+           + (int)((iTime>>iShift) - TIMER_SUB_BUCKETS);
+}
+
+/* Return the largest time counted by histogram bucket i */
+static sqlite3_uint64 timer_bucket_max(int i){
+  int iShift;
+  if( i<TIMER_SUB_BUCKETS ) return (sqlite3_uint64)i;
+  iShift = i/TIMER_SUB_BUCKETS - 1;
+  return ((sqlite3_uint64)(i%TIMER_SUB_BUCKETS + TIMER_SUB_BUCKETS + 1)
+            << iShift) - 1;
+}
+
+/* Return the time below which rPct percent of the times in pHist fall */
+static sqlite3_uint64 timer_percentile(TimerHist *pHist, double rPct){
+  sqlite3_uint64 nTarget = (sqlite3_uint64)(rPct*0.01*pHist->nCount + 0.5);
+  sqlite3_uint64 nSeen = 0;
+  int i;
+  if( nTarget<1 ) nTarget = 1;
+  for(i=0; i<TIMER_N_BUCKET; i++){
+    nSeen += pHist->aBucket[i];
+    if( nSeen>=nTarget ){
+      sqlite3_uint64 iMax = timer_bucket_max(i);
+      return iMax<pHist->iMax ? iMax : pHist->iMax;
+    }
+  }
+  return pHist->iMax;
+}
+
+/*
+** Record in p the nPrepare nanoseconds taken to prepare and the nStep taken
+** to step one statement, whose text is the first nSql bytes of zSql, or all
+** of it if nSql is negative.  rc is the result of the statement.
+*/
+static void timer_record(
+  ShellState *p,
+  const char *zSql,
+  int nSql,
+  sqlite3_int64 nPrepare,
+  sqlite3_int64 nStep,
+  int rc
+){
+  sqlite3_uint64 aTime[3];
+  TimerStats *pTimerStats = p->pTimerStats;
+  int i;
+  p->iTimerPrepare += nPrepare;
+  p->iTimerStep += nStep;
+  if( pTimerStats==0 ) return;
+  aTime[0] = (sqlite3_uint64)nPrepare;
+  aTime[1] = (sqlite3_uint64)nStep;
+  aTime[2] = aTime[0] + aTime[1];
+  for(i=0; i<3; i++){
+    TimerHist *pHist = &pTimerStats->aHist[i];
+    pHist->nCount++;
+    pHist->iTotal += aTime[i];
+    if( aTime[i]>pHist->iMax ) pHist->iMax = aTime[i];
+    pHist->aBucket[timer_bucket(aTime[i])]++;
+  }
+  if( rc!=SQLITE_OK ) pTimerStats->nErr++;
+  pTimerStats->iSeq++;
+  if( pTimerStats->pCsv ){
+    FILE *out = pTimerStats->pCsv;
+    if( nSql<0 ) nSql = (int)strlen(zSql);
+    while( nSql>0 && IsSpace(zSql[nSql-1]) ) nSql--;
+    fprintf(out, "%lld,%lld,%lld,%lld,%d,\"",
+            pTimerStats->iSeq, nPrepare, nStep, nPrepare+nStep, rc);
+    for(i=0; i<nSql; i++){
+      if( zSql[i]=='"' ) fputc('"', out);
+      fputc(zSql[i], out);
+    }
+    fputs("\"\n", out);
+  }
+}
+
+/*
+** Show percentiles of the times collected since the last summary, then
+** forget them.
+*/
+static void timer_summary(ShellState *p){
+  static const char *azName[] = { "prepare", "step", "total" };
+  static const double aPct[] = { 50.0, 90.0, 99.0, 99.9 };
+  TimerStats *pTimerStats = p->pTimerStats;
+  int i, j;
+  if( pTimerStats==0 || pTimerStats->aHist[2].nCount==0 ) return;
+  raw_printf(p->out, "Timer: %lld statements, %lld failed, %.6f s in total\n",
+             (sqlite3_int64)pTimerStats->aHist[2].nCount, pTimerStats->nErr,
+             pTimerStats->aHist[2].iTotal*0.000000001);
+  raw_printf(p->out, "%-8s %10s %10s %10s %10s %10s %10s\n", "ms",
+             "mean", "p50", "p90", "p99", "p99.9", "max");
+  for(i=0; i<3; i++){
+    TimerHist *pHist = &pTimerStats->aHist[i];
+    raw_printf(p->out, "%-8s %10.3f", azName[i],
+               pHist->iTotal*0.000001/pHist->nCount);
+    for(j=0; j<(int)(sizeof(aPct)/sizeof(aPct[0])); j++){
+      raw_printf(p->out, " %10.3f", timer_percentile(pHist, aPct[j])*0.000001);
+    }
+    raw_printf(p->out, " %10.3f\n", pHist->iMax*0.000001);
+  }
+  memset(pTimerStats->aHist, 0, sizeof(pTimerStats->aHist));
+  pTimerStats->nErr = 0;
+}
+
+/*
+** Stop collecting times, showing a summary of any not yet shown if
+** the timer is in summary mode, and close the --csv file.
+*/
+static void timer_end(ShellState *p){
+  if( p->pTimerStats==0 ) return;
+  if( enableTimer==SHELL_TIMER_SUMMARY ) timer_summary(p);
+  if( p->pTimerStats->pCsv ) fclose(p->pTimerStats->pCsv);
+  sqlite3_free(p->pTimerStats);
+  p->pTimerStats = 0;
+}
+
 /*
 ** Execute a statement or set of statements.  Print
 ** any result rows/columns depending on the current mode
@@ -11597,6 +12116,9 @@ static int shell_exec(
   int rc2;
   const char *zLeftover;          /* Tail of unprocessed SQL */
   sqlite3 *db = pArg->db;
+  sqlite3_int64 iStart = 0;       /* When preparing began */
+  sqlite3_int64 nPrepare = 0;     /* Nanoseconds taken to prepare */
+  sqlite3_int64 nStep = 0;        /* Nanoseconds taken to step */
 
   if( pzErrMsg ){
     *pzErrMsg = NULL;
@@ -11610,15 +12132,19 @@ static int shell_exec(
 #endif
 
   while( zSql[0] && (SQLITE_OK == rc) ){
-    static const char *zStmtSql;
+    const char *zStmtSql;
+    if( enableTimer ) iStart = timerNow();
     rc = sqlite3_prepare_v2(db, zSql, -1, &pStmt, &zLeftover);
+    if( enableTimer ) nPrepare = timerNow() - iStart;
     if( SQLITE_OK != rc ){
+      if( enableTimer ) timer_record(pArg, zSql, -1, nPrepare, 0, rc);
       if( pzErrMsg ){
         *pzErrMsg = save_err_msg(db);
       }
     }else{
       if( !pStmt ){
         /* this happens for a comment or white-space */
+        if( enableTimer ) pArg->iTimerPrepare += nPrepare;
         zSql = zLeftover;
         while( IsSpace(zSql[0]) ) zSql++;
         continue;
@@ -11704,7 +12230,9 @@ static int shell_exec(
       }
 
       bind_prepared_stmt(pArg, pStmt);
+      if( enableTimer ) pArg->iStmtStep = 0;
       exec_prepared_stmt(pArg, pStmt);
+      if( enableTimer ) nStep = pArg->iStmtStep;
       explain_data_delete(pArg);
       eqp_render(pArg);
 
@@ -11723,6 +12251,9 @@ static int shell_exec(
       ** next statement to execute. */
       rc2 = sqlite3_finalize(pStmt);
       if( rc!=SQLITE_NOMEM ) rc = rc2;
+      if( enableTimer ){
+        timer_record(pArg, zSql, (int)(zLeftover - zSql), nPrepare, nStep, rc);
+      }
       if( rc==SQLITE_OK ){
         zSql = zLeftover;
         while( IsSpace(zSql[0]) ) zSql++;
@@ -11870,6 +12401,61 @@ static void toggleSelectOrder(sqlite3 *db){
   sqlite3_exec(db, zStmt, 0, 0, 0);
 }
 
+/*
+** Build the text that a dump uses for table zTable: in pTable, the quoted
+** name of the table, followed by a column list if rowids are preserved,
+** and in pSelect, the SELECT statement which reads its content.  Return 1
+** on success, or 0 if the columns of the table can't be found.
+*/
+static int dump_table_text(
+  ShellState *p,
+  const char *zTable,
+  ShellText *pTable,
+  ShellText *pSelect
+){
+  char **azCol;
+  int i;
+
+  azCol = tableColumnList(p, zTable);
+  if( azCol==0 ) return 0;
+
+  /* Always quote the table name, even if it appears to be pure ascii,
+  ** in case it is a keyword. Ex:  INSERT INTO "table" ... */
+  initText(pTable);
+  appendText(pTable, zTable, quoteChar(zTable));
+  /* If preserving the rowid, add a column list after the table name.
+  ** In other words:  "INSERT INTO tab(rowid,a,b,c,...) VALUES(...)"
+  ** instead of the usual "INSERT INTO tab VALUES(...)".
+  */
+  if( azCol[0] ){
+    appendText(pTable, "(", 0);
+    appendText(pTable, azCol[0], 0);
+    for(i=1; azCol[i]; i++){
+      appendText(pTable, ",", 0);
+      appendText(pTable, azCol[i], quoteChar(azCol[i]));
+    }
+    appendText(pTable, ")", 0);
+  }
+
+  /* Build an appropriate SELECT statement */
+  initText(pSelect);
+  appendText(pSelect, "SELECT ", 0);
+  if( azCol[0] ){
+    appendText(pSelect, azCol[0], 0);
+    appendText(pSelect, ",", 0);
+  }
+  for(i=1; azCol[i]; i++){
+    appendText(pSelect, azCol[i], quoteChar(azCol[i]));
+    if( azCol[i+1] ){
+      appendText(pSelect, ",", 0);
+    }
+  }
+  freeColumnList(azCol);
+  appendText(pSelect, " FROM ", 0);
+  appendText(pSelect, zTable, quoteChar(zTable));
+  return 1;
+}
+
 /*
 ** This is a different callback routine used for dumping the database.
 ** Each row received by this callback consists of a table name,
@@ -11915,52 +12501,14 @@ static int dump_callback(void *pArg, int nArg, char **azArg, char **azNotUsed){
   if( strcmp(zType, "table")==0 ){
     ShellText sSelect;
     ShellText sTable;
-    char **azCol;
-    int i;
     char *savedDestTable;
     int savedMode;
 
-    azCol = tableColumnList(p, zTable);
-    if( azCol==0 ){
+    if( !dump_table_text(p, zTable, &sTable, &sSelect) ){
       p->nErr++;
       return 0;
     }
 
-    /* Always quote the table name, even if it appears to be pure ascii,
-    ** in case it is a keyword. Ex:  INSERT INTO "table" ... */
-    initText(&sTable);
-    appendText(&sTable, zTable, quoteChar(zTable));
-    /* If preserving the rowid, add a column list after the table name.
-    ** In other words:  "INSERT INTO tab(rowid,a,b,c,...) VALUES(...)"
-    ** instead of the usual "INSERT INTO tab VALUES(...)".
-    */
-    if( azCol[0] ){
-      appendText(&sTable, "(", 0);
-      appendText(&sTable, azCol[0], 0);
-      for(i=1; azCol[i]; i++){
-        appendText(&sTable, ",", 0);
-        appendText(&sTable, azCol[i], quoteChar(azCol[i]));
-      }
-      appendText(&sTable, ")", 0);
-    }
-
-    /* Build an appropriate SELECT statement */
-    initText(&sSelect);
-    appendText(&sSelect, "SELECT ", 0);
-    if( azCol[0] ){
-      appendText(&sSelect, azCol[0], 0);
-      appendText(&sSelect, ",", 0);
-    }
-    for(i=1; azCol[i]; i++){
-      appendText(&sSelect, azCol[i], quoteChar(azCol[i]));
-      if( azCol[i+1] ){
-        appendText(&sSelect, ",", 0);
-      }
-    }
-    freeColumnList(azCol);
-    appendText(&sSelect, " FROM ", 0);
-    appendText(&sSelect, zTable, quoteChar(zTable));
-
     savedDestTable = p->zDestTable;
     savedMode = p->mode;
     p->zDestTable = sTable.z;
@@ -12019,24 +12567,379 @@ static int run_schema_dump_query(
   return rc;
 }
 
+#if SHELL_USE_PTHREADS
 /*
-** Text of help messages.
-**
-** The help text for each individual command begins with a line that starts
-** with ".".  Subsequent lines are supplimental information.
+** A parallel .dump hands the content of each ordinary table to a pool of
+** worker threads.  Each worker reads through its own connection, which
+** is pinned to the same view of the database as the main connection,
+** and writes the text for one table at a time into a temporary file of
+** its own.  The main thread copies those files to the output in schema
+** order, so the result is the same as that of a serial .dump.
 **
-** There must be two or more spaces between the end of the command and the
-** start of the description of what that command does.
-*/
-static const char *(azHelp[]) = {
-#if defined(SQLITE_HAVE_ZLIB) && !defined(SQLITE_OMIT_VIRTUALTABLE)
-  ".archive ...             Manage SQL archives",
-  "   Each command must have exactly one of the following options:",
-  "     -c, --create               Create a new archive",
-  "     -u, --update               Add or update files with changed mtime",
-  "     -i, --insert               Like -u but always add even if unchanged",
-  "     -t, --list                 List contents of archive",
-  "     -x, --extract              Extract files from archive",
+** In WAL mode, the workers open the main connection's snapshot (this
+** requires SQLITE_ENABLE_SNAPSHOT).  In rollback mode, the shared lock
+** held by the main connection keeps any writer from committing until
+** every worker has begun its own read transaction, so they all see the
+** same database too.
+*/
+
+/* Most tables the workers may dump ahead of the output, per worker */
+#define DUMP_AHEAD_PER_THREAD 4
+
+/* One row of the schema query, as dump_callback() would receive it */
+typedef struct DumpTable DumpTable;
+struct DumpTable {
+  char *azArg[3];     /* Name, type and SQL of the table */
+  int bWorker;        /* True if a worker thread dumps the content */
+  int bDone;          /* True once a worker has finished with the table */
+  FILE *out;          /* The text a worker wrote, or NULL if none */
+  int nErr;           /* Number of errors the worker saw */
+  int nCommit;        /* Batches the worker committed, for --batch */
+};
+
+/* State shared by the threads of a parallel .dump */
+typedef struct DumpPipeline DumpPipeline;
+struct DumpPipeline {
+  ShellState *p;      /* The shell, used only by the main thread */
+  ShellState sState;  /* Copy of *p taken before the workers start */
+  DumpTable *aTable;  /* Rows of the schema query, in order */
+  int nTable;         /* Number of entries in aTable[] */
+  int nAlloc;         /* Space allocated for aTable[] */
+  int nMaxAhead;      /* Most tables dumped but not yet output */
+  pthread_mutex_t mutex;  /* Protects all fields below */
+  pthread_cond_t cond;    /* Broadcast whenever a field below changes */
+  int iNext;          /* First table no worker has claimed yet */
+  int iOut;           /* First table not yet copied to the output */
+  int bAbort;         /* True to make all threads stop early */
+};
+
+/* A worker thread of a parallel .dump */
+typedef struct DumpWorker DumpWorker;
+struct DumpWorker {
+  DumpPipeline *pPipe;  /* The work to share */
+  sqlite3 *db;          /* Read connection used only by this worker */
+  pthread_t thread;     /* The thread itself */
+};
+
+/* sqlite3_exec() callback which collects the rows of the schema query */
+static int dump_collect_callback(
+  void *pArg,
+  int nArg,
+  char **azArg,
+  char **azNotUsed
+){
+  DumpPipeline *pPipe = (DumpPipeline*)pArg;
+  DumpTable *pTab;
+  int i;
+  UNUSED_PARAMETER(azNotUsed);
+  if( nArg!=3 || azArg==0 ) return 0;
+  if( pPipe->nTable>=pPipe->nAlloc ){
+    int nNew = pPipe->nAlloc*2 + 16;
+    DumpTable *aNew = sqlite3_realloc64(pPipe->aTable, nNew*sizeof(aNew[0]));
+    if( aNew==0 ) shell_out_of_memory();
+    pPipe->aTable = aNew;
+    pPipe->nAlloc = nNew;
+  }
+  pTab = &pPipe->aTable[pPipe->nTable++];
+  memset(pTab, 0, sizeof(*pTab));
+  for(i=0; i<3; i++){
+    if( azArg[i]==0 ) continue;
+    pTab->azArg[i] = sqlite3_mprintf("%s", azArg[i]);
+    if( pTab->azArg[i]==0 ) shell_out_of_memory();
+  }
+  /* Only the content of ordinary tables is worth handing to a worker.
+  ** Everything else is left to the main thread, by way of dump_callback(),
+  ** which also keeps track of p->writableSchema. */
+  pTab->bWorker = azArg[0] && azArg[1] && azArg[2]
+               && strcmp(azArg[1], "table")==0
+               && strncmp(azArg[0], "sqlite_", 7)!=0
+               && strncmp(azArg[2], "CREATE VIRTUAL TABLE", 20)!=0;
+  return 0;
+}
+
+/* Progress handler which stops a worker's query once ^C is seen */
+static int dump_progress_handler(void *pArg){
+  UNUSED_PARAMETER(pArg);
+  return seenInterrupt!=0;
+}
+
+/* Body of each worker thread of a parallel .dump */
+static void *dump_worker_main(void *pArg){
+  DumpWorker *pWorker = (DumpWorker*)pArg;
+  DumpPipeline *pPipe = pWorker->pPipe;
+  ShellState *pState;
+  pState = sqlite3_malloc64(sizeof(*pState));
+  pthread_mutex_lock(&pPipe->mutex);
+  if( pState==0 ) pPipe->bAbort = 1;
+  while( !pPipe->bAbort ){
+    DumpTable *pTab;
+    while( pPipe->iNext<pPipe->nTable && !pPipe->aTable[pPipe->iNext].bWorker ){
+      pPipe->iNext++;
+    }
+    if( pPipe->iNext>=pPipe->nTable ) break;
+    if( pPipe->iNext>=pPipe->iOut+pPipe->nMaxAhead ){
+      pthread_cond_wait(&pPipe->cond, &pPipe->mutex);
+      continue;
+    }
+    pTab = &pPipe->aTable[pPipe->iNext++];
+    pthread_mutex_unlock(&pPipe->mutex);
+
+    /* Dump the table just as the main thread would, except through this
+    ** worker's connection and into a file of its own.  If there is no
+    ** file, the table is left for the main thread to dump.  The settings
+    ** come from sState, since the main thread keeps writing through *p. */
+    memcpy(pState, &pPipe->sState, sizeof(*pState));
+    pState->db = pWorker->db;
+    pState->out = tmpfile();
+    pState->nErr = 0;
+    pState->nInsertCommit = 0;
+    pState->writableSchema = 0;
+    pState->pStmt = 0;
+    pState->pTimerStats = 0;  /* The main thread's, so not to be touched */
+    if( pState->out ){
+      dump_callback(pState, 3, pTab->azArg, 0);
+      if( fflush(pState->out) || ferror(pState->out) ){
+        fclose(pState->out);
+        pState->out = 0;
+      }
+    }
+
+    pthread_mutex_lock(&pPipe->mutex);
+    pTab->out = pState->out;
+    pTab->nErr = pState->nErr;
+    pTab->nCommit = pState->nInsertCommit;
+    pTab->bDone = 1;
+    if( seenInterrupt ) pPipe->bAbort = 1;
+    pthread_cond_broadcast(&pPipe->cond);
+  }
+  pthread_cond_broadcast(&pPipe->cond);
+  pthread_mutex_unlock(&pPipe->mutex);
+  sqlite3_free(pState);
+  return 0;
+}
+
+/*
+** Open a read connection to zFile for a worker of a parallel .dump, and
+** begin a read transaction on it, on pSnapshot if that is not NULL.
+** Return NULL if that can't be done.
+*/
+static sqlite3 *dump_open_reader(
+  const char *zFile,            /* Name of the database file */
+  void *pSnapshot               /* The snapshot to open, or NULL */
+){
+  sqlite3 *db = 0;
+  int rc;
+  rc = sqlite3_open_v2(zFile, &db, SQLITE_OPEN_READONLY|SQLITE_OPEN_NOMUTEX,
+                       0);
+  if( rc==SQLITE_OK ){
+    sqlite3_busy_timeout(db, 2000);
+    /* Load the schema before the transaction, as the snapshot needs */
+    rc = sqlite3_exec(db, "SELECT count(*) FROM sqlite_master", 0, 0, 0);
+  }
+  if( rc==SQLITE_OK ) rc = sqlite3_exec(db, "BEGIN", 0, 0, 0);
+#ifdef SQLITE_ENABLE_SNAPSHOT
+  if( rc==SQLITE_OK && pSnapshot ){
+    rc = sqlite3_snapshot_open(db, "main", (sqlite3_snapshot*)pSnapshot);
+  }
+#else
+  UNUSED_PARAMETER(pSnapshot);
+#endif
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_exec(db, "SELECT count(*) FROM sqlite_master", 0, 0, 0);
+  }
+  if( rc!=SQLITE_OK ){
+    sqlite3_close(db);
+    return 0;
+  }
+  sqlite3_progress_handler(db, 1000, dump_progress_handler, 0);
+  return db;
+}
+
+/*
+** Dump the tables which zQuery selects from sqlite_master, with the content
+** of ordinary tables dumped by nThread worker threads.  zQuery is a query
+** that run_schema_dump_query() would accept.
+**
+** The caller must have begun a transaction on p->db which has not yet
+** read or written anything, so that p->db sees no changes the workers
+** can't see.
+**
+** Return 1 once everything has been dumped.  Return 0, without having
+** written anything, if the workers can't be pinned to the view of the
+** database that p->db has, in which case the caller must dump the tables
+** itself.
+*/
+static int dump_parallel(ShellState *p, const char *zQuery, int nThread){
+  DumpPipeline sPipe;
+  DumpWorker *aWorker = 0;
+  void *pSnapshot = 0;
+  const char *zFile;
+  int bWal = 0;
+  int nWorker = 0;
+  int nStarted = 0;
+  int nTable = 0;
+  int rc;
+  int i;
+
+  /* Workers need the database to be a file which other connections can
+  ** open and read as it was when the dump began. */
+  zFile = sqlite3_db_filename(p->db, "main");
+  if( sqlite3_threadsafe()==0
+   || zFile==0 || zFile[0]==0
+   || (p->openMode!=SHELL_OPEN_UNSPEC && p->openMode!=SHELL_OPEN_NORMAL
+       && p->openMode!=SHELL_OPEN_READONLY)
+   || p->autoEQP
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+   || p->expert.pExpert
+#endif
+  ){
+    return 0;
+  }
+  memset(&sPipe, 0, sizeof(sPipe));
+  sPipe.p = p;
+
+  /* Running the schema query inside the "dump" savepoint begins the read
+  ** transaction which the workers are pinned to. */
+  rc = sqlite3_exec(p->db, zQuery, dump_collect_callback, &sPipe, 0);
+  if( rc==SQLITE_OK ){
+    sqlite3_stmt *pStmt = 0;
+    rc = sqlite3_prepare_v2(p->db, "PRAGMA main.journal_mode", -1, &pStmt, 0);
+    if( rc==SQLITE_OK && sqlite3_step(pStmt)==SQLITE_ROW ){
+      bWal = sqlite3_stricmp((const char*)sqlite3_column_text(pStmt,0),
+                             "wal")==0;
+    }
+    sqlite3_finalize(pStmt);
+  }
+  for(i=0; i<sPipe.nTable; i++){
+    if( sPipe.aTable[i].bWorker ) nTable++;
+  }
+  if( rc==SQLITE_OK && nTable>0 && bWal ){
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    sqlite3_snapshot *pSnap = 0;
+    if( sqlite3_snapshot_get(p->db, "main", &pSnap)==SQLITE_OK ){
+      pSnapshot = pSnap;
+    }
+#endif
+    /* Without a snapshot, WAL readers may each see different commits */
+    if( pSnapshot==0 ) nTable = 0;
+  }
+  if( rc==SQLITE_OK && nTable>0 ){
+    nWorker = nThread<nTable ? nThread : nTable;
+    aWorker = sqlite3_malloc64(nWorker*sizeof(aWorker[0]));
+    if( aWorker==0 ) shell_out_of_memory();
+    for(i=0; i<nWorker; i++){
+      aWorker[i].pPipe = &sPipe;
+      aWorker[i].db = dump_open_reader(zFile, pSnapshot);
+      if( aWorker[i].db==0 ) break;
+    }
+    if( i<nWorker ){
+      while( i>0 ) sqlite3_close(aWorker[--i].db);
+      nWorker = 0;
+    }
+  }
+#ifdef SQLITE_ENABLE_SNAPSHOT
+  if( pSnapshot ) sqlite3_snapshot_free((sqlite3_snapshot*)pSnapshot);
+#endif
+
+  if( nWorker>0 ){
+    sPipe.nMaxAhead = nWorker*DUMP_AHEAD_PER_THREAD;
+    pthread_mutex_init(&sPipe.mutex, 0);
+    pthread_cond_init(&sPipe.cond, 0);
+    memcpy(&sPipe.sState, p, sizeof(sPipe.sState));
+    for(nStarted=0; nStarted<nWorker; nStarted++){
+      if( pthread_create(&aWorker[nStarted].thread, 0, dump_worker_main,
+                         &aWorker[nStarted]) ){
+        break;
+      }
+    }
+    if( nStarted==0 ){
+      pthread_cond_destroy(&sPipe.cond);
+      pthread_mutex_destroy(&sPipe.mutex);
+      for(i=0; i<nWorker; i++) sqlite3_close(aWorker[i].db);
+      nWorker = 0;
+    }
+  }
+  if( nWorker==0 ){
+    for(i=0; i<sPipe.nTable; i++){
+      sqlite3_free(sPipe.aTable[i].azArg[0]);
+      sqlite3_free(sPipe.aTable[i].azArg[1]);
+      sqlite3_free(sPipe.aTable[i].azArg[2]);
+    }
+    sqlite3_free(sPipe.aTable);
+    sqlite3_free(aWorker);
+    return 0;
+  }
+
+  /* Output each table in turn, waiting for the workers as needed */
+  for(i=0; i<sPipe.nTable; i++){
+    DumpTable *pTab = &sPipe.aTable[i];
+    if( pTab->bWorker ){
+      pthread_mutex_lock(&sPipe.mutex);
+      while( !pTab->bDone && !sPipe.bAbort ){
+        pthread_cond_wait(&sPipe.cond, &sPipe.mutex);
+      }
+      pthread_mutex_unlock(&sPipe.mutex);
+      if( !pTab->bDone ) break;
+    }
+    if( pTab->out ){
+      char zBuf[16384];
+      size_t nRead;
+      rewind(pTab->out);
+      while( (nRead = fread(zBuf, 1, sizeof(zBuf), pTab->out))>0 ){
+        fwrite(zBuf, 1, nRead, p->out);
+      }
+      fclose(pTab->out);
+      pTab->out = 0;
+      p->nErr += pTab->nErr;
+      p->nInsertCommit += pTab->nCommit;
+    }else{
+      dump_callback(p, 3, pTab->azArg, 0);
+    }
+    pthread_mutex_lock(&sPipe.mutex);
+    sPipe.iOut = i+1;
+    pthread_cond_broadcast(&sPipe.cond);
+    pthread_mutex_unlock(&sPipe.mutex);
+  }
+  if( i<sPipe.nTable ) p->nErr++;
+
+  pthread_mutex_lock(&sPipe.mutex);
+  sPipe.bAbort = 1;
+  pthread_cond_broadcast(&sPipe.cond);
+  pthread_mutex_unlock(&sPipe.mutex);
+  for(i=0; i<nStarted; i++) pthread_join(aWorker[i].thread, 0);
+  for(i=0; i<nWorker; i++) sqlite3_close(aWorker[i].db);
+  for(i=0; i<sPipe.nTable; i++){
+    if( sPipe.aTable[i].out ) fclose(sPipe.aTable[i].out);
+    sqlite3_free(sPipe.aTable[i].azArg[0]);
+    sqlite3_free(sPipe.aTable[i].azArg[1]);
+    sqlite3_free(sPipe.aTable[i].azArg[2]);
+  }
+  pthread_cond_destroy(&sPipe.cond);
+  pthread_mutex_destroy(&sPipe.mutex);
+  sqlite3_free(sPipe.aTable);
+  sqlite3_free(aWorker);
+  return 1;
+}
+#endif /* SHELL_USE_PTHREADS */
+
+/*
+** Text of help messages.
+**
+** The help text for each individual command begins with a line that starts
+** with ".".  Subsequent lines are supplimental information.
+**
+** There must be two or more spaces between the end of the command and the
+** start of the description of what that command does.
+*/
+static const char *(azHelp[]) = {
+#if defined(SQLITE_HAVE_ZLIB) && !defined(SQLITE_OMIT_VIRTUALTABLE)
+  ".archive ...             Manage SQL archives",
+  "   Each command must have exactly one of the following options:",
+  "     -c, --create               Create a new archive",
+  "     -u, --update               Add or update files with changed mtime",
+  "     -i, --insert               Like -u but always add even if unchanged",
+  "     -t, --list                 List contents of archive",
+  "     -x, --extract              Extract files from archive",
   "   Optional arguments:",
   "     -v, --verbose              Print each filename as it is processed",
   "     -f FILE, --file FILE       Use archive FILE (default is current db)",
@@ -12056,12 +12959,21 @@ static const char *(azHelp[]) = {
   ".backup ?DB? FILE        Backup DB (default \"main\") to FILE",
   "       --append            Use the appendvfs",
   "       --async             Write to FILE without journal and fsync()",
+  "       --background        Copy on another thread, leaving the shell free",
+  "       --cancel            Stop the --background backup.  No FILE",
+  "       --pages N           Copy N pages per step.  Default 100, 0 for all",
+  "       --progress          Show pages left and MB/s copied on stderr",
+  "       --sleep MS          Pause MS milliseconds between steps.  Default 0,",
+  "                           or 20 with --background",
+  "       --status            Show progress of the --background backup.  No FILE",
   ".bail on|off             Stop after hitting an error.  Default OFF",
   ".binary on|off           Turn binary output on or off.  Default OFF",
   ".cd DIRECTORY            Change the working directory to DIRECTORY",
   ".changes on|off          Show number of rows changed by SQL",
   ".check GLOB              Fail if output since .testcase does not match",
-  ".clone NEWDB             Clone data into NEWDB from the existing database",
+  ".clone ?OPTIONS? NEWDB   Clone data into NEWDB from the existing database",
+  "   Options:",
+  "     --threads N            Copy tables on N threads, from one snapshot",
   ".databases               List names and files of attached databases",
   ".dbconfig ?op? ?val?     List or change sqlite3_db_config() options",
   ".dbinfo ?DB?             Show status information about the database",
@@ -12069,6 +12981,11 @@ static const char *(azHelp[]) = {
   "   Options:",
   "     --preserve-rowids      Include ROWID values in the output",
   "     --newlines             Allow unescaped newline characters in output",
+  "     --multirow N           Put up to N rows in each INSERT statement",
+  "     --batch N              Commit after every N rows of a table.  If there",
+  "                            are errors, only the last batch is rolled back",
+  "     --threads N            Dump table content on N threads, from one snapshot",
+  "     --binary               Write a compact binary dump for .restore-dump",
   "   TABLE is a LIKE pattern for the tables to dump",
   ".echo on|off             Turn command echo on or off",
   ".eqp on|off|full|...     Enable or disable automatic EXPLAIN QUERY PLAN",
@@ -12088,6 +13005,14 @@ static const char *(azHelp[]) = {
   ".headers on|off          Turn display of headers on or off",
   ".help ?-all? ?PATTERN?   Show help text for PATTERN",
   ".import FILE TABLE       Import data from FILE into TABLE",
+  "   Options:",
+  "     --batch N              Commit after every N rows",
+  "     --infer N              Infer new column types from the first N rows",
+  "     --progress             Report rows and bytes imported per second",
+  "     --threads N            Parse FILE on N threads.  0 to use no threads",
+#if defined(SQLITE_HAVE_ZLIB) || defined(SQLITE_HAVE_ZSTD)
+  "   A compressed FILE is decompressed as it is read",
+#endif
 #ifndef SQLITE_OMIT_TEST_CONTROL
   ".imposter INDEX TABLE    Create imposter table TABLE on index INDEX",
 #endif
@@ -12112,11 +13037,16 @@ static const char *(azHelp[]) = {
   "     column   Left-aligned columns.  (See .width)",
   "     html     HTML <table> code",
   "     insert   SQL insert statements for TABLE",
+  "     json     Results in a JSON array",
   "     line     One value per line",
   "     list     Values delimited by \"|\"",
+  "     ndjson   One JSON object per line",
   "     quote    Escape answers as for SQL",
   "     tabs     Tab-separated values",
   "     tcl      TCL list elements",
+  "   Options for insert mode:",
+  "     --multirow N           Put up to N rows in each INSERT statement",
+  "     --batch N              Wrap every N rows in a transaction",
   ".nullvalue STRING        Use STRING in place of NULL values",
   ".once (-e|-x|FILE)       Output for the next SQL command only to FILE",
   "     If FILE begins with '|' then open as a pipe",
@@ -12155,6 +13085,9 @@ static const char *(azHelp[]) = {
   ".prompt MAIN CONTINUE    Replace the standard prompts",
   ".quit                    Exit this program",
   ".read FILE               Read input from FILE",
+#if defined(SQLITE_HAVE_ZLIB) || defined(SQLITE_HAVE_ZSTD)
+  "   A compressed FILE is decompressed as it is read",
+#endif
 #if !defined(SQLITE_OMIT_VIRTUALTABLE) && defined(SQLITE_ENABLE_DBPAGE_VTAB)
   ".recover                 Recover as much data as possible from corrupt db.",
   "   --freelist-corrupt       Assume the freelist is corrupt",
@@ -12164,6 +13097,9 @@ static const char *(azHelp[]) = {
   "                            that are not also INTEGER PRIMARY KEYs",
 #endif
   ".restore ?DB? FILE       Restore content of DB (default \"main\") from FILE",
+  ".restore-dump FILE       Restore a dump written by \".dump --binary\"",
+  "   Options:",
+  "     --threads N            Load table content on N threads",
   ".save FILE               Write in-memory database into FILE",
   ".scanstats on|off        Turn sqlite3_stmt_scanstatus() metrics on or off",
   ".schema ?PATTERN?        Show the CREATE statements matching PATTERN",
@@ -12210,7 +13146,13 @@ static const char *(azHelp[]) = {
   ".testctrl CMD ...        Run various sqlite3_test_control() operations",
   "                           Run \".testctrl\" with no arguments for details",
   ".timeout MS              Try opening locked tables for MS milliseconds",
-  ".timer on|off            Turn SQL timer on or off",
+  ".timer MODE ?--csv FILE? Turn SQL timer on or off",
+  "   MODE is one of:",
+  "     on       Show the time each line of SQL takes, prepare and step apart",
+  "     off      Turn the timer off",
+  "     summary  Show percentiles of statement times after each .read script",
+  "     report   Show percentiles of statement times collected so far",
+  "   --csv FILE writes the time of each statement to FILE as well",
 #ifndef SQLITE_OMIT_TRACE
   ".trace ?OPTIONS?         Output each SQL statement as it is run",
   "    FILE                    Send output to FILE",
@@ -12989,6 +13931,8 @@ static FILE *output_file_open(const char *zFile, int bTextMode){
     f = fopen(zFile, bTextMode ? "w" : "wb");
     if( f==0 ){
       utf8_printf(stderr, "Error: cannot open \"%s\"\n", zFile);
+    }else{
+      output_set_buffer(f);
     }
   }
   return f;
@@ -13063,2414 +14007,5660 @@ static void test_breakpoint(void){
 }
 
 /*
-** An object used to read a CSV and other files for import.
+** Compressed input for the .import and .read commands.  A file which
+** begins with the gzip magic number, in builds with zlib
+** (SQLITE_HAVE_ZLIB), or with the zstd magic number, in builds with
+** SQLITE_HAVE_ZSTD, is decompressed as it is read.  Where threads are
+** available, decompression runs on a thread of its own, a few blocks ahead
+** of the command reading the text.
 */
-typedef struct ImportCtx ImportCtx;
-struct ImportCtx {
-  const char *zFile;  /* Name of the input file */
-  FILE *in;           /* Read the CSV text from this input stream */
-  char *z;            /* Accumulated text for a field */
-  int n;              /* Number of bytes in z */
-  int nAlloc;         /* Space allocated for z[] */
-  int nLine;          /* Current line number */
-  int bNotFirst;      /* True if one or more bytes already read */
-  int cTerm;          /* Character that terminated the most recent field */
-  int cColSep;        /* The column separator character.  (Usually ",") */
-  int cRowSep;        /* The row separator character.  (Usually "\n") */
+#if defined(SQLITE_HAVE_ZLIB) || defined(SQLITE_HAVE_ZSTD)
+# define SHELL_USE_DECOMPRESSION 1
+#else
+# define SHELL_USE_DECOMPRESSION 0
+#endif
+
+#if SHELL_USE_DECOMPRESSION
+#ifdef SQLITE_HAVE_ZLIB
+# include <zlib.h>
+#endif
+#ifdef SQLITE_HAVE_ZSTD
+# include <zstd.h>
+#endif
+
+/* Formats of compressed input */
+#define CINPUT_GZIP 1
+#define CINPUT_ZSTD 2
+
+/* Number of bytes in each block of compressed or decompressed data */
+#define CINPUT_BLOCK_SIZE (256*1024)
+
+/* Most blocks the decompression thread may get ahead of the reader */
+#define CINPUT_MAX_READY 4
+
+/* A block of decompressed text */
+typedef struct CompressedBlock CompressedBlock;
+struct CompressedBlock {
+  CompressedBlock *pNext;     /* Next block in the same list */
+  size_t n;                   /* Number of bytes of text in a[] */
+  size_t i;                   /* Number of bytes of a[] read already */
+  char a[CINPUT_BLOCK_SIZE];  /* The text */
 };
 
-/* Append a single byte to z[] */
-static void import_append_char(ImportCtx *p, int c){
-  if( p->n+1>=p->nAlloc ){
-    p->nAlloc += p->nAlloc + 100;
-    p->z = sqlite3_realloc64(p->z, p->nAlloc);
-    if( p->z==0 ) shell_out_of_memory();
-  }
-  p->z[p->n++] = (char)c;
-}
+/* A stream of text decompressed from a file */
+typedef struct CompressedInput CompressedInput;
+struct CompressedInput {
+  FILE *in;                   /* The compressed file */
+  const char *zName;          /* Name of the file, for error messages */
+  int eFormat;                /* CINPUT_GZIP or CINPUT_ZSTD */
+  int bEnd;                   /* True once there is nothing more to inflate */
+  int bInFrame;               /* True if part way through a compressed frame */
+  int bPadding;               /* True once zero padding follows the frames */
+  char *zIn;                  /* Compressed data read from the file */
+  CompressedBlock *pCur;      /* Block being read */
+#ifdef SQLITE_HAVE_ZLIB
+  z_stream zs;                /* State of a gzip decompression */
+#endif
+#ifdef SQLITE_HAVE_ZSTD
+  ZSTD_DStream *pZstd;        /* State of a zstd decompression */
+  ZSTD_inBuffer zsIn;         /* Compressed data for ZSTD_decompressStream() */
+#endif
+#if SHELL_USE_PTHREADS
+  int bThread;                /* True if decompressing on another thread */
+  pthread_t thread;           /* The decompression thread */
+  pthread_mutex_t mutex;      /* Protects the fields below */
+  pthread_cond_t cond;        /* Broadcast when a field below changes */
+  CompressedBlock *pReady;    /* Blocks decompressed but not yet read */
+  CompressedBlock *pReadyLast;  /* Last block of the pReady list */
+  CompressedBlock *pFree;     /* Blocks read and available for reuse */
+  int nReady;                 /* Number of blocks in the pReady list */
+  int bDone;                  /* True once the thread has finished */
+  int bStop;                  /* True to ask the thread to finish */
+#endif
+};
 
-/* Read a single field of CSV text.  Compatible with rfc4180 and extended
-** with the option of having a separator other than ",".
-**
-**   +  Input comes from p->in.
-**   +  Store results in p->z of length p->n.  Space to hold p->z comes
-**      from sqlite3_malloc64().
-**   +  Use p->cSep as the column separator.  The default is ",".
-**   +  Use p->rSep as the row separator.  The default is "\n".
-**   +  Keep track of the line number in p->nLine.
-**   +  Store the character that terminates the field in p->cTerm.  Store
-**      EOF on end-of-file.
-**   +  Report syntax errors on stderr
+/*
+** Decompress up to nOut bytes of text into zOut.  Return the number of
+** bytes decompressed, which is less than nOut only at the end of the
+** input or if the input is corrupt.
 */
-static char *SQLITE_CDECL csv_read_one_field(ImportCtx *p){
-  int c;
-  int cSep = p->cColSep;
-  int rSep = p->cRowSep;
-  p->n = 0;
-  c = fgetc(p->in);
-  if( c==EOF || seenInterrupt ){
-    p->cTerm = EOF;
-    return 0;
-  }
-  if( c=='"' ){
-    int pc, ppc;
-    int startLine = p->nLine;
-    int cQuote = c;
-    pc = ppc = 0;
-    while( 1 ){
-      c = fgetc(p->in);
-      if( c==rSep ) p->nLine++;
-      if( c==cQuote ){
-        if( pc==cQuote ){
-          pc = 0;
-          continue;
+static size_t cinput_inflate(CompressedInput *p, char *zOut, size_t nOut){
+  size_t nDone = 0;
+  while( nDone<nOut && !p->bEnd ){
+    size_t nIn = 0;
+    int bNeedInput = 0;
+#ifdef SQLITE_HAVE_ZLIB
+    if( p->eFormat==CINPUT_GZIP ) bNeedInput = p->zs.avail_in==0;
+#endif
+#ifdef SQLITE_HAVE_ZSTD
+    if( p->eFormat==CINPUT_ZSTD ) bNeedInput = p->zsIn.pos>=p->zsIn.size;
+#endif
+    if( bNeedInput ){
+      nIn = fread(p->zIn, 1, CINPUT_BLOCK_SIZE, p->in);
+      if( nIn==0 ){
+        if( p->bInFrame ){
+          utf8_printf(stderr, "%s: compressed input is truncated\n",
+                      p->zName);
         }
-      }
-      if( (c==cSep && pc==cQuote)
-       || (c==rSep && pc==cQuote)
-       || (c==rSep && pc=='\r' && ppc==cQuote)
-       || (c==EOF && pc==cQuote)
-      ){
-        do{ p->n--; }while( p->z[p->n]!=cQuote );
-        p->cTerm = c;
+        p->bEnd = 1;
         break;
       }
-      if( pc==cQuote && c!='\r' ){
-        utf8_printf(stderr, "%s:%d: unescaped %c character\n",
-                p->zFile, p->nLine, cQuote);
+    }
+#ifdef SQLITE_HAVE_ZLIB
+    if( p->eFormat==CINPUT_GZIP ){
+      int rc;
+      if( bNeedInput ){
+        p->zs.next_in = (Bytef*)p->zIn;
+        p->zs.avail_in = (uInt)nIn;
+      }
+      if( !p->bInFrame && (p->bPadding || p->zs.next_in[0]==0) ){
+        /* Tar and some other tools pad a gzip file with zero bytes after
+        ** its last member.  Nothing but zero bytes may follow. */
+        p->bPadding = 1;
+        while( p->zs.avail_in>0 && p->zs.next_in[0]==0 ){
+          p->zs.next_in++;
+          p->zs.avail_in--;
+        }
+        if( p->zs.avail_in>0 ){
+          utf8_printf(stderr, "%s: corrupt compressed input: "
+                      "data after zero padding\n", p->zName);
+          p->bEnd = 1;
+        }
+        continue;
       }
-      if( c==EOF ){
-        utf8_printf(stderr, "%s:%d: unterminated %c-quoted field\n",
-                p->zFile, startLine, cQuote);
-        p->cTerm = c;
-        break;
+      p->zs.next_out = (Bytef*)(zOut + nDone);
+      p->zs.avail_out = (uInt)(nOut - nDone);
+      p->bInFrame = 1;
+      rc = inflate(&p->zs, Z_NO_FLUSH);
+      nDone = nOut - p->zs.avail_out;
+      if( rc==Z_STREAM_END ){
+        /* A gzip file may hold several members, one after another */
+        p->bInFrame = 0;
+        inflateReset(&p->zs);
+      }else if( rc!=Z_OK && rc!=Z_BUF_ERROR ){
+        utf8_printf(stderr, "%s: corrupt compressed input: %s\n", p->zName,
+                    p->zs.msg ? p->zs.msg : "inflate() failed");
+        p->bEnd = 1;
       }
-      import_append_char(p, c);
-      ppc = pc;
-      pc = c;
     }
-  }else{
-    /* If this is the first field being parsed and it begins with the
-    ** UTF-8 BOM  (0xEF BB BF) then skip the BOM */
-    if( (c&0xff)==0xef && p->bNotFirst==0 ){
-      import_append_char(p, c);
-      c = fgetc(p->in);
-      if( (c&0xff)==0xbb ){
-        import_append_char(p, c);
-        c = fgetc(p->in);
-        if( (c&0xff)==0xbf ){
-          p->bNotFirst = 1;
-          p->n = 0;
-          return csv_read_one_field(p);
-        }
+#endif
+#ifdef SQLITE_HAVE_ZSTD
+    if( p->eFormat==CINPUT_ZSTD ){
+      ZSTD_outBuffer out;
+      size_t rc;
+      if( bNeedInput ){
+        p->zsIn.src = p->zIn;
+        p->zsIn.size = nIn;
+        p->zsIn.pos = 0;
+      }
+      out.dst = zOut;
+      out.size = nOut;
+      out.pos = nDone;
+      rc = ZSTD_decompressStream(p->pZstd, &out, &p->zsIn);
+      nDone = out.pos;
+      if( ZSTD_isError(rc) ){
+        utf8_printf(stderr, "%s: corrupt compressed input: %s\n", p->zName,
+                    ZSTD_getErrorName(rc));
+        p->bEnd = 1;
+      }else{
+        p->bInFrame = rc!=0;
       }
     }
-    while( c!=EOF && c!=cSep && c!=rSep ){
-      import_append_char(p, c);
-      c = fgetc(p->in);
+#endif
+  }
+  return nDone;
+}
+
+#if SHELL_USE_PTHREADS
+/*
+** The decompression thread.  Keep up to CINPUT_MAX_READY blocks of text
+** decompressed ahead of the reader.
+*/
+static void *cinput_main(void *pArg){
+  CompressedInput *p = (CompressedInput*)pArg;
+  while( 1 ){
+    CompressedBlock *pBlock;
+    pthread_mutex_lock(&p->mutex);
+    while( p->nReady>=CINPUT_MAX_READY && !p->bStop ){
+      pthread_cond_wait(&p->cond, &p->mutex);
+    }
+    if( p->bStop ){
+      pthread_mutex_unlock(&p->mutex);
+      break;
+    }
+    pBlock = p->pFree;
+    if( pBlock ) p->pFree = pBlock->pNext;
+    pthread_mutex_unlock(&p->mutex);
+    if( pBlock==0 ){
+      pBlock = sqlite3_malloc64(sizeof(*pBlock));
+      if( pBlock==0 ) shell_out_of_memory();
+    }
+    pBlock->pNext = 0;
+    pBlock->i = 0;
+    pBlock->n = cinput_inflate(p, pBlock->a, sizeof(pBlock->a));
+    if( pBlock->n==0 ){
+      sqlite3_free(pBlock);
+      break;
     }
-    if( c==rSep ){
-      p->nLine++;
-      if( p->n>0 && p->z[p->n-1]=='\r' ) p->n--;
+    pthread_mutex_lock(&p->mutex);
+    if( p->pReadyLast ){
+      p->pReadyLast->pNext = pBlock;
+    }else{
+      p->pReady = pBlock;
     }
-    p->cTerm = c;
+    p->pReadyLast = pBlock;
+    p->nReady++;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
   }
-  if( p->z ) p->z[p->n] = 0;
-  p->bNotFirst = 1;
-  return p->z;
+  pthread_mutex_lock(&p->mutex);
+  p->bDone = 1;
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->mutex);
+  return 0;
 }
+#endif /* SHELL_USE_PTHREADS */
 
-/* Read a single field of ASCII delimited text.
+/*
+** If the file "in" is compressed in a format this build understands,
+** return a new CompressedInput which reads the text decompressed from it.
+** Otherwise rewind the file and return NULL, so that it can be read as
+** it is.  zName is used in error messages.
 **
-**   +  Input comes from p->in.
-**   +  Store results in p->z of length p->n.  Space to hold p->z comes
-**      from sqlite3_malloc64().
-**   +  Use p->cSep as the column separator.  The default is "\x1F".
-**   +  Use p->rSep as the row separator.  The default is "\x1E".
-**   +  Keep track of the row number in p->nLine.
-**   +  Store the character that terminates the field in p->cTerm.  Store
-**      EOF on end-of-file.
-**   +  Report syntax errors on stderr
-*/
-static char *SQLITE_CDECL ascii_read_one_field(ImportCtx *p){
-  int c;
-  int cSep = p->cColSep;
-  int rSep = p->cRowSep;
-  p->n = 0;
-  c = fgetc(p->in);
-  if( c==EOF || seenInterrupt ){
-    p->cTerm = EOF;
-    return 0;
+** Streams which cannot be rewound, such as pipes and terminals, are never
+** treated as compressed, since the bytes read to check for a magic number
+** could not be put back.
+*/
+static CompressedInput *cinput_open(FILE *in, const char *zName){
+  unsigned char aMagic[4];
+  size_t nMagic;
+  int eFormat = 0;
+  CompressedInput *p;
+  if( fseek(in, 0, SEEK_CUR)!=0 ) return 0;
+  nMagic = fread(aMagic, 1, sizeof(aMagic), in);
+#ifdef SQLITE_HAVE_ZLIB
+  if( nMagic>=2 && aMagic[0]==0x1f && aMagic[1]==0x8b ){
+    eFormat = CINPUT_GZIP;
   }
-  while( c!=EOF && c!=cSep && c!=rSep ){
-    import_append_char(p, c);
-    c = fgetc(p->in);
+#endif
+#ifdef SQLITE_HAVE_ZSTD
+  if( nMagic>=4 && aMagic[0]==0x28 && aMagic[1]==0xb5
+   && aMagic[2]==0x2f && aMagic[3]==0xfd
+  ){
+    eFormat = CINPUT_ZSTD;
   }
-  if( c==rSep ){
-    p->nLine++;
+#endif
+  if( fseek(in, 0, SEEK_SET)!=0 ){
+    utf8_printf(stderr, "Error: cannot rewind \"%s\"\n", zName);
   }
-  p->cTerm = c;
-  if( p->z ) p->z[p->n] = 0;
-  return p->z;
+  if( eFormat==0 ) return 0;
+  p = sqlite3_malloc64(sizeof(*p));
+  if( p==0 ) shell_out_of_memory();
+  memset(p, 0, sizeof(*p));
+  p->in = in;
+  p->zName = zName;
+  p->eFormat = eFormat;
+  p->zIn = sqlite3_malloc64(CINPUT_BLOCK_SIZE);
+  if( p->zIn==0 ) shell_out_of_memory();
+#ifdef SQLITE_HAVE_ZLIB
+  if( eFormat==CINPUT_GZIP && inflateInit2(&p->zs, 15+16)!=Z_OK ){
+    shell_out_of_memory();
+  }
+#endif
+#ifdef SQLITE_HAVE_ZSTD
+  if( eFormat==CINPUT_ZSTD ){
+    p->pZstd = ZSTD_createDStream();
+    if( p->pZstd==0 ) shell_out_of_memory();
+    ZSTD_initDStream(p->pZstd);
+  }
+#endif
+#if SHELL_USE_PTHREADS
+  if( sqlite3_threadsafe() ){
+    pthread_mutex_init(&p->mutex, 0);
+    pthread_cond_init(&p->cond, 0);
+    p->bThread = pthread_create(&p->thread, 0, cinput_main, p)==0;
+    if( !p->bThread ){
+      pthread_cond_destroy(&p->cond);
+      pthread_mutex_destroy(&p->mutex);
+    }
+  }
+#endif
+  return p;
 }
 
 /*
-** Try to transfer data for table zTable.  If an error is seen while
-** moving forward, try to go backwards.  The backwards movement won't
-** work for WITHOUT ROWID tables.
+** Free a CompressedInput, stopping its thread if it has one.  The
+** compressed file is not closed.
 */
-static void tryToCloneData(
-  ShellState *p,
-  sqlite3 *newDb,
-  const char *zTable
-){
-  sqlite3_stmt *pQuery = 0;
-  sqlite3_stmt *pInsert = 0;
-  char *zQuery = 0;
-  char *zInsert = 0;
-  int rc;
-  int i, j, n;
-  int nTable = strlen30(zTable);
-  int k = 0;
-  int cnt = 0;
-  const int spinRate = 10000;
-
-  zQuery = sqlite3_mprintf("SELECT * FROM \"%w\"", zTable);
-  rc = sqlite3_prepare_v2(p->db, zQuery, -1, &pQuery, 0);
-  if( rc ){
-    utf8_printf(stderr, "Error %d: %s on [%s]\n",
-            sqlite3_extended_errcode(p->db), sqlite3_errmsg(p->db),
-            zQuery);
-    goto end_data_xfer;
-  }
-  n = sqlite3_column_count(pQuery);
-  zInsert = sqlite3_malloc64(200 + nTable + n*3);
-  if( zInsert==0 ) shell_out_of_memory();
-  sqlite3_snprintf(200+nTable,zInsert,
-                   "INSERT OR IGNORE INTO \"%s\" VALUES(?", zTable);
-  i = strlen30(zInsert);
-  for(j=1; j<n; j++){
-    memcpy(zInsert+i, ",?", 2);
-    i += 2;
-  }
-  memcpy(zInsert+i, ");", 3);
-  rc = sqlite3_prepare_v2(newDb, zInsert, -1, &pInsert, 0);
-  if( rc ){
-    utf8_printf(stderr, "Error %d: %s on [%s]\n",
-            sqlite3_extended_errcode(newDb), sqlite3_errmsg(newDb),
-            zQuery);
-    goto end_data_xfer;
+static void cinput_close(CompressedInput *p){
+  if( p==0 ) return;
+#if SHELL_USE_PTHREADS
+  if( p->bThread ){
+    pthread_mutex_lock(&p->mutex);
+    p->bStop = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+    pthread_join(p->thread, 0);
+    while( p->pReady ){
+      CompressedBlock *pBlock = p->pReady;
+      p->pReady = pBlock->pNext;
+      sqlite3_free(pBlock);
+    }
+    while( p->pFree ){
+      CompressedBlock *pBlock = p->pFree;
+      p->pFree = pBlock->pNext;
+      sqlite3_free(pBlock);
+    }
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
   }
-  for(k=0; k<2; k++){
-    while( (rc = sqlite3_step(pQuery))==SQLITE_ROW ){
-      for(i=0; i<n; i++){
-        switch( sqlite3_column_type(pQuery, i) ){
-          case SQLITE_NULL: {
-            sqlite3_bind_null(pInsert, i+1);
-            break;
-          }
-          case SQLITE_INTEGER: {
-            sqlite3_bind_int64(pInsert, i+1, sqlite3_column_int64(pQuery,i));
-            break;
-          }
-          case SQLITE_FLOAT: {
-            sqlite3_bind_double(pInsert, i+1, sqlite3_column_double(pQuery,i));
-            break;
-          }
-          case SQLITE_TEXT: {
-            sqlite3_bind_text(pInsert, i+1,
-                             (const char*)sqlite3_column_text(pQuery,i),
-                             -1, SQLITE_STATIC);
-            break;
-          }
-          case SQLITE_BLOB: {
-            sqlite3_bind_blob(pInsert, i+1, sqlite3_column_blob(pQuery,i),
-                                            sqlite3_column_bytes(pQuery,i),
-                                            SQLITE_STATIC);
-            break;
-          }
-        }
-      } /* End for */
-      rc = sqlite3_step(pInsert);
-      if( rc!=SQLITE_OK && rc!=SQLITE_ROW && rc!=SQLITE_DONE ){
-        utf8_printf(stderr, "Error %d: %s\n", sqlite3_extended_errcode(newDb),
-                        sqlite3_errmsg(newDb));
-      }
-      sqlite3_reset(pInsert);
-      cnt++;
-      if( (cnt%spinRate)==0 ){
-        printf("%c\b", "|/-\\"[(cnt/spinRate)%4]);
-        fflush(stdout);
-      }
-    } /* End while */
-    if( rc==SQLITE_DONE ) break;
-    sqlite3_finalize(pQuery);
-    sqlite3_free(zQuery);
-    zQuery = sqlite3_mprintf("SELECT * FROM \"%w\" ORDER BY rowid DESC;",
-                             zTable);
-    rc = sqlite3_prepare_v2(p->db, zQuery, -1, &pQuery, 0);
-    if( rc ){
-      utf8_printf(stderr, "Warning: cannot step \"%s\" backwards", zTable);
-      break;
-    }
-  } /* End for(k=0...) */
-
-end_data_xfer:
-  sqlite3_finalize(pQuery);
-  sqlite3_finalize(pInsert);
-  sqlite3_free(zQuery);
-  sqlite3_free(zInsert);
+#endif
+#ifdef SQLITE_HAVE_ZLIB
+  if( p->eFormat==CINPUT_GZIP ) inflateEnd(&p->zs);
+#endif
+#ifdef SQLITE_HAVE_ZSTD
+  if( p->eFormat==CINPUT_ZSTD ) ZSTD_freeDStream(p->pZstd);
+#endif
+  sqlite3_free(p->pCur);
+  sqlite3_free(p->zIn);
+  sqlite3_free(p);
 }
 
-
 /*
-** Try to transfer all rows of the schema that match zWhere.  For
-** each row, invoke xForEach() on the object defined by that row.
-** If an error is encountered while moving forward through the
-** sqlite_master table, try again moving backwards.
+** Return a pointer to the next text not yet read, and set *pn to the
+** number of bytes of it, which is at least one.  Return NULL at the end
+** of the input.  The text remains valid until cinput_consume() is called.
 */
-static void tryToCloneSchema(
-  ShellState *p,
-  sqlite3 *newDb,
-  const char *zWhere,
-  void (*xForEach)(ShellState*,sqlite3*,const char*)
-){
-  sqlite3_stmt *pQuery = 0;
-  char *zQuery = 0;
-  int rc;
-  const unsigned char *zName;
-  const unsigned char *zSql;
-  char *zErrMsg = 0;
-
-  zQuery = sqlite3_mprintf("SELECT name, sql FROM sqlite_master"
-                           " WHERE %s", zWhere);
-  rc = sqlite3_prepare_v2(p->db, zQuery, -1, &pQuery, 0);
-  if( rc ){
-    utf8_printf(stderr, "Error: (%d) %s on [%s]\n",
-                    sqlite3_extended_errcode(p->db), sqlite3_errmsg(p->db),
-                    zQuery);
-    goto end_schema_xfer;
-  }
-  while( (rc = sqlite3_step(pQuery))==SQLITE_ROW ){
-    zName = sqlite3_column_text(pQuery, 0);
-    zSql = sqlite3_column_text(pQuery, 1);
-    printf("%s... ", zName); fflush(stdout);
-    sqlite3_exec(newDb, (const char*)zSql, 0, 0, &zErrMsg);
-    if( zErrMsg ){
-      utf8_printf(stderr, "Error: %s\nSQL: [%s]\n", zErrMsg, zSql);
-      sqlite3_free(zErrMsg);
-      zErrMsg = 0;
-    }
-    if( xForEach ){
-      xForEach(p, newDb, (const char*)zName);
-    }
-    printf("done\n");
-  }
-  if( rc!=SQLITE_DONE ){
-    sqlite3_finalize(pQuery);
-    sqlite3_free(zQuery);
-    zQuery = sqlite3_mprintf("SELECT name, sql FROM sqlite_master"
-                             " WHERE %s ORDER BY rowid DESC", zWhere);
-    rc = sqlite3_prepare_v2(p->db, zQuery, -1, &pQuery, 0);
-    if( rc ){
-      utf8_printf(stderr, "Error: (%d) %s on [%s]\n",
-                      sqlite3_extended_errcode(p->db), sqlite3_errmsg(p->db),
-                      zQuery);
-      goto end_schema_xfer;
-    }
-    while( (rc = sqlite3_step(pQuery))==SQLITE_ROW ){
-      zName = sqlite3_column_text(pQuery, 0);
-      zSql = sqlite3_column_text(pQuery, 1);
-      printf("%s... ", zName); fflush(stdout);
-      sqlite3_exec(newDb, (const char*)zSql, 0, 0, &zErrMsg);
-      if( zErrMsg ){
-        utf8_printf(stderr, "Error: %s\nSQL: [%s]\n", zErrMsg, zSql);
-        sqlite3_free(zErrMsg);
-        zErrMsg = 0;
+static const char *cinput_data(CompressedInput *p, size_t *pn){
+  CompressedBlock *pBlock = p->pCur;
+  while( pBlock==0 || pBlock->i>=pBlock->n ){
+#if SHELL_USE_PTHREADS
+    if( p->bThread ){
+      pthread_mutex_lock(&p->mutex);
+      if( pBlock ){
+        pBlock->pNext = p->pFree;
+        p->pFree = pBlock;
       }
-      if( xForEach ){
-        xForEach(p, newDb, (const char*)zName);
+      while( p->pReady==0 && !p->bDone ){
+        pthread_cond_wait(&p->cond, &p->mutex);
       }
-      printf("done\n");
+      pBlock = p->pReady;
+      if( pBlock ){
+        p->pReady = pBlock->pNext;
+        if( p->pReady==0 ) p->pReadyLast = 0;
+        p->nReady--;
+      }
+      pthread_cond_broadcast(&p->cond);
+      pthread_mutex_unlock(&p->mutex);
+      p->pCur = pBlock;
+      if( pBlock==0 ) return 0;
+      continue;
+    }
+#endif
+    if( pBlock==0 ){
+      pBlock = p->pCur = sqlite3_malloc64(sizeof(*pBlock));
+      if( pBlock==0 ) shell_out_of_memory();
     }
+    pBlock->i = 0;
+    pBlock->n = cinput_inflate(p, pBlock->a, sizeof(pBlock->a));
+    if( pBlock->n==0 ) return 0;
   }
-end_schema_xfer:
-  sqlite3_finalize(pQuery);
-  sqlite3_free(zQuery);
+  *pn = pBlock->n - pBlock->i;
+  return pBlock->a + pBlock->i;
+}
+
+/* Mark n bytes of the text returned by cinput_data() as read */
+static void cinput_consume(CompressedInput *p, size_t n){
+  p->pCur->i += n;
 }
 
 /*
-** Open a new database file named "zNewDb".  Try to recover as much information
-** as possible out of the main database (which might be corrupt) and write it
-** into zNewDb.
+** Read up to n bytes of text into z, like fread().  Return the number of
+** bytes read, which is less than n only at the end of the input.
 */
-static void tryToClone(ShellState *p, const char *zNewDb){
-  int rc;
-  sqlite3 *newDb = 0;
-  if( access(zNewDb,0)==0 ){
-    utf8_printf(stderr, "File \"%s\" already exists.\n", zNewDb);
-    return;
-  }
-  rc = sqlite3_open(zNewDb, &newDb);
-  if( rc ){
-    utf8_printf(stderr, "Cannot create output database: %s\n",
-            sqlite3_errmsg(newDb));
-  }else{
-    sqlite3_exec(p->db, "PRAGMA writable_schema=ON;", 0, 0, 0);
-    sqlite3_exec(newDb, "BEGIN EXCLUSIVE;", 0, 0, 0);
-    tryToCloneSchema(p, newDb, "type='table'", tryToCloneData);
-    tryToCloneSchema(p, newDb, "type!='table'", 0);
-    sqlite3_exec(newDb, "COMMIT;", 0, 0, 0);
-    sqlite3_exec(p->db, "PRAGMA writable_schema=OFF;", 0, 0, 0);
+static size_t cinput_read(CompressedInput *p, char *z, size_t n){
+  size_t nDone = 0;
+  while( nDone<n ){
+    size_t nData;
+    const char *zData = cinput_data(p, &nData);
+    if( zData==0 ) break;
+    if( nData>n-nDone ) nData = n-nDone;
+    memcpy(z+nDone, zData, nData);
+    cinput_consume(p, nData);
+    nDone += nData;
   }
-  close_db(newDb);
+  return nDone;
 }
 
 /*
-** Change the output file back to stdout.
-**
-** If the p->doXdgOpen flag is set, that means the output was being
-** redirected to a temporary file named by p->zTempFile.  In that case,
-** launch start/open/xdg-open on that temporary file.
+** Read a line of text, like local_getline().  The line is stored in memory
+** obtained from realloc(), reusing zLine if it is not NULL, and any line
+** ending is removed.  Return NULL at the end of the input.
 */
-static void output_reset(ShellState *p){
-  if( p->outfile[0]=='|' ){
-#ifndef SQLITE_OMIT_POPEN
-    pclose(p->out);
-#endif
-  }else{
-    output_file_close(p->out);
-#ifndef SQLITE_NOHAVE_SYSTEM
-    if( p->doXdgOpen ){
-      const char *zXdgOpenCmd =
-#if defined(_WIN32)
-      "start";
-#elif defined(__APPLE__)
-      "open";
-#else
-      "xdg-open";
-#endif
-      char *zCmd;
-      zCmd = sqlite3_mprintf("%s %s", zXdgOpenCmd, p->zTempFile);
-      if( system(zCmd) ){
-        utf8_printf(stderr, "Failed: [%s]\n", zCmd);
+static char *cinput_getline(CompressedInput *p, char *zLine){
+  size_t n = 0;
+  int bEol = 0;
+  while( !bEol ){
+    size_t nData;
+    const char *zData = cinput_data(p, &nData);
+    const char *zEol;
+    if( zData==0 ){
+      if( n==0 ){
+        free(zLine);
+        return 0;
       }
-      sqlite3_free(zCmd);
-      outputModePop(p);
-      p->doXdgOpen = 0;
-      sqlite3_sleep(100);
+      break;
     }
-#endif /* !defined(SQLITE_NOHAVE_SYSTEM) */
+    zEol = memchr(zData, '\n', nData);
+    if( zEol ){
+      nData = zEol - zData;
+      bEol = 1;
+    }
+    zLine = realloc(zLine, n + nData + 1);
+    if( zLine==0 ) shell_out_of_memory();
+    memcpy(zLine+n, zData, nData);
+    n += nData;
+    cinput_consume(p, nData + bEol);
   }
-  p->outfile[0] = 0;
-  p->out = stdout;
+  if( bEol && n>0 && zLine[n-1]=='\r' ) n--;
+  zLine[n] = 0;
+  return zLine;
 }
+#endif /* SHELL_USE_DECOMPRESSION */
 
 /*
-** Run an SQL command and return the single integer result.
+** Number of bytes the .import command reads from its input at a time.
 */
-static int db_int(ShellState *p, const char *zSql){
-  sqlite3_stmt *pStmt;
-  int res = 0;
-  sqlite3_prepare_v2(p->db, zSql, -1, &pStmt, 0);
-  if( pStmt && sqlite3_step(pStmt)==SQLITE_ROW ){
-    res = sqlite3_column_int(pStmt,0);
-  }
-  sqlite3_finalize(pStmt);
-  return res;
-}
+#define IMPORT_BLOCK_SIZE (1<<20)
 
 /*
-** Convert a 2-byte or 4-byte big-endian integer into a native integer
+** The location of one field of the record being imported, as an offset
+** from the start of the record within ImportCtx.zBuf[] and a length.
 */
-static unsigned int get2byteInt(unsigned char *a){
-  return (a[0]<<8) + a[1];
-}
-static unsigned int get4byteInt(unsigned char *a){
-  return (a[0]<<24) + (a[1]<<16) + (a[2]<<8) + a[3];
-}
+typedef struct ImportField ImportField;
+struct ImportField {
+  size_t iOff;        /* Offset of the field from the start of the record */
+  int n;              /* Number of bytes in the field */
+};
 
 /*
-** Implementation of the ".dbinfo" command.
+** An object used to read a CSV and other files for import.
 **
-** Return 1 on error, 2 to exit, and 0 otherwise.
+** Input is read in large blocks into zBuf[], and fields are parsed in
+** place, so that each field is a slice of zBuf[] rather than a copy.
+** The text of the current record is kept in zBuf[] until the next record
+** begins, so its fields can be bound with SQLITE_STATIC.
 */
-static int shell_dbinfo_command(ShellState *p, int nArg, char **azArg){
-  static const struct { const char *zName; int ofst; } aField[] = {
-     { "file change counter:",  24  },
-     { "database page count:",  28  },
-     { "freelist page count:",  36  },
-     { "schema cookie:",        40  },
-     { "schema format:",        44  },
-     { "default cache size:",   48  },
-     { "autovacuum top root:",  52  },
-     { "incremental vacuum:",   64  },
-     { "text encoding:",        56  },
-     { "user version:",         60  },
-     { "application id:",       68  },
-     { "software version:",     96  },
-  };
-  static const struct { const char *zName; const char *zSql; } aQuery[] = {
-     { "number of tables:",
-       "SELECT count(*) FROM %s WHERE type='table'" },
-     { "number of indexes:",
-       "SELECT count(*) FROM %s WHERE type='index'" },
-     { "number of triggers:",
-       "SELECT count(*) FROM %s WHERE type='trigger'" },
-     { "number of views:",
-       "SELECT count(*) FROM %s WHERE type='view'" },
-     { "schema size:",
-       "SELECT total(length(sql)) FROM %s" },
-  };
-  int i, rc;
-  unsigned iDataVersion;
-  char *zSchemaTab;
-  char *zDb = nArg>=2 ? azArg[1] : "main";
-  sqlite3_stmt *pStmt = 0;
-  unsigned char aHdr[100];
-  open_db(p, 0);
-  if( p->db==0 ) return 1;
-  rc = sqlite3_prepare_v2(p->db,
-             "SELECT data FROM sqlite_dbpage(?1) WHERE pgno=1",
-             -1, &pStmt, 0);
-  if( rc ){
-    if( !sqlite3_compileoption_used("ENABLE_DBPAGE_VTAB") ){
-      utf8_printf(stderr, "the \".dbinfo\" command requires the "
-                          "-DSQLITE_ENABLE_DBPAGE_VTAB compile-time options\n");
-    }else{
-      utf8_printf(stderr, "error: %s\n", sqlite3_errmsg(p->db));
-    }
-    sqlite3_finalize(pStmt);
-    return 1;
-  }
-  sqlite3_bind_text(pStmt, 1, zDb, -1, SQLITE_STATIC);
-  if( sqlite3_step(pStmt)==SQLITE_ROW
-   && sqlite3_column_bytes(pStmt,0)>100
-  ){
-    memcpy(aHdr, sqlite3_column_blob(pStmt,0), 100);
-    sqlite3_finalize(pStmt);
-  }else{
-    raw_printf(stderr, "unable to read database header\n");
-    sqlite3_finalize(pStmt);
-    return 1;
-  }
-  i = get2byteInt(aHdr+16);
-  if( i==1 ) i = 65536;
-  utf8_printf(p->out, "%-20s %d\n", "database page size:", i);
-  utf8_printf(p->out, "%-20s %d\n", "write format:", aHdr[18]);
-  utf8_printf(p->out, "%-20s %d\n", "read format:", aHdr[19]);
-  utf8_printf(p->out, "%-20s %d\n", "reserved bytes:", aHdr[20]);
-  for(i=0; i<ArraySize(aField); i++){
-    int ofst = aField[i].ofst;
-    unsigned int val = get4byteInt(aHdr + ofst);
-    utf8_printf(p->out, "%-20s %u", aField[i].zName, val);
-    switch( ofst ){
-      case 56: {
-        if( val==1 ) raw_printf(p->out, " (utf8)");
-        if( val==2 ) raw_printf(p->out, " (utf16le)");
-        if( val==3 ) raw_printf(p->out, " (utf16be)");
-      }
-    }
-    raw_printf(p->out, "\n");
-  }
-  if( zDb==0 ){
-    zSchemaTab = sqlite3_mprintf("main.sqlite_master");
-  }else if( strcmp(zDb,"temp")==0 ){
-    zSchemaTab = sqlite3_mprintf("%s", "sqlite_temp_master");
-  }else{
-    zSchemaTab = sqlite3_mprintf("\"%w\".sqlite_master", zDb);
-  }
-  for(i=0; i<ArraySize(aQuery); i++){
-    char *zSql = sqlite3_mprintf(aQuery[i].zSql, zSchemaTab);
-    int val = db_int(p, zSql);
-    sqlite3_free(zSql);
-    utf8_printf(p->out, "%-20s %d\n", aQuery[i].zName, val);
-  }
-  sqlite3_free(zSchemaTab);
-  sqlite3_file_control(p->db, zDb, SQLITE_FCNTL_DATA_VERSION, &iDataVersion);
-  utf8_printf(p->out, "%-20s %u\n", "data version", iDataVersion);
-  return 0;
+typedef struct ImportCtx ImportCtx;
+struct ImportCtx {
+  const char *zFile;  /* Name of the input file */
+  FILE *in;           /* Read the CSV text from this input stream */
+  struct CompressedInput *pCin; /* Decompresses the text of in, or NULL */
+  char *z;            /* Text of the most recent field, within zBuf[] */
+  int n;              /* Number of bytes in z */
+  char *zBuf;         /* Block of input text being parsed */
+  size_t nBuf;        /* Number of bytes of input in zBuf[] */
+  size_t nAlloc;      /* Space allocated for zBuf[] */
+  size_t iBuf;        /* Offset in zBuf[] of the next byte to parse */
+  size_t iRow;        /* Offset in zBuf[] of the start of the current record */
+  size_t iRowSep;     /* Offset in zBuf[] of the next row separator */
+  int bRowSep;        /* True if iRowSep is known */
+  int bEof;           /* True once the input is exhausted */
+  sqlite3_int64 nRead; /* Number of bytes read from the input so far */
+  ImportField *aField; /* Fields of the current record */
+  int nField;         /* Number of fields in aField[] */
+  int nFieldAlloc;    /* Space allocated for aField[] */
+  int nLine;          /* Current line number */
+  int bNotFirst;      /* True if one or more bytes already read */
+  int cTerm;          /* Character that terminated the most recent field */
+  int cColSep;        /* The column separator character.  (Usually ",") */
+  int cRowSep;        /* The row separator character.  (Usually "\n") */
+  int bDeferWarnings; /* Collect warnings in zWarnings rather than print */
+  char *zWarnings;    /* Warnings not yet printed */
+};
+
+/*
+** Free all memory held by an ImportCtx, and stop decompressing its input.
+** The input is not closed.
+*/
+static void import_cleanup(ImportCtx *p){
+#if SHELL_USE_DECOMPRESSION
+  cinput_close(p->pCin);
+  p->pCin = 0;
+#endif
+  sqlite3_free(p->zBuf);
+  sqlite3_free(p->aField);
+  sqlite3_free(p->zWarnings);
+  p->zBuf = 0;
+  p->aField = 0;
+  p->zWarnings = 0;
 }
 
 /*
-** Print the current sqlite3_errmsg() value to stderr and return 1.
+** Report a problem with the input.  The message is printed on stderr
+** right away, or if bDeferWarnings is set, appended to zWarnings so that
+** it can be printed later, in order with the messages for other records.
 */
-static int shellDatabaseError(sqlite3 *db){
-  const char *zErr = sqlite3_errmsg(db);
-  utf8_printf(stderr, "Error: %s\n", zErr);
-  return 1;
+static void import_warning(ImportCtx *p, const char *zFormat, ...){
+  va_list ap;
+  char *z;
+  va_start(ap, zFormat);
+  z = sqlite3_vmprintf(zFormat, ap);
+  va_end(ap);
+  if( z==0 ) shell_out_of_memory();
+  if( p->bDeferWarnings ){
+    p->zWarnings = sqlite3_mprintf("%z%s", p->zWarnings, z);
+    if( p->zWarnings==0 ) shell_out_of_memory();
+  }else{
+    utf8_printf(stderr, "%s", z);
+  }
+  sqlite3_free(z);
 }
 
 /*
-** Compare the pattern in zGlob[] against the text in z[].  Return TRUE
-** if they match and FALSE (0) if they do not match.
-**
-** Globbing rules:
-**
-**      '*'       Matches any sequence of zero or more characters.
-**
-**      '?'       Matches exactly one character.
-**
-**     [...]      Matches one character from the enclosed list of
-**                characters.
-**
-**     [^...]     Matches one character not in the enclosed list.
-**
-**      '#'       Matches any sequence of one or more digits with an
-**                optional + or - sign in front
-**
-**      ' '       Any span of whitespace matches any other span of
-**                whitespace.
+** Read the next block of input into zBuf[].  Text before the start of the
+** current record is discarded to make room, and zBuf[] is enlarged if the
+** current record alone fills it.  Offsets iBuf and iRow are adjusted to
+** match.  One byte of space is always left past the end of the input so
+** that the last field can be zero-terminated.
 **
-** Extra whitespace at the end of z[] is ignored.
+** Return 1 if more input was read, or 0 at end-of-file.
 */
-static int testcase_glob(const char *zGlob, const char *z){
-  int c, c2;
-  int invert;
-  int seen;
-
-  while( (c = (*(zGlob++)))!=0 ){
-    if( IsSpace(c) ){
-      if( !IsSpace(*z) ) return 0;
-      while( IsSpace(*zGlob) ) zGlob++;
-      while( IsSpace(*z) ) z++;
-    }else if( c=='*' ){
-      while( (c=(*(zGlob++))) == '*' || c=='?' ){
-        if( c=='?' && (*(z++))==0 ) return 0;
-      }
-      if( c==0 ){
-        return 1;
-      }else if( c=='[' ){
-        while( *z && testcase_glob(zGlob-1,z)==0 ){
-          z++;
-        }
-        return (*z)!=0;
-      }
-      while( (c2 = (*(z++)))!=0 ){
-        while( c2!=c ){
-          c2 = *(z++);
-          if( c2==0 ) return 0;
-        }
-        if( testcase_glob(zGlob,z) ) return 1;
-      }
-      return 0;
-    }else if( c=='?' ){
-      if( (*(z++))==0 ) return 0;
-    }else if( c=='[' ){
-      int prior_c = 0;
-      seen = 0;
-      invert = 0;
-      c = *(z++);
-      if( c==0 ) return 0;
-      c2 = *(zGlob++);
-      if( c2=='^' ){
-        invert = 1;
-        c2 = *(zGlob++);
-      }
-      if( c2==']' ){
-        if( c==']' ) seen = 1;
-        c2 = *(zGlob++);
-      }
-      while( c2 && c2!=']' ){
-        if( c2=='-' && zGlob[0]!=']' && zGlob[0]!=0 && prior_c>0 ){
-          c2 = *(zGlob++);
-          if( c>=prior_c && c<=c2 ) seen = 1;
-          prior_c = 0;
-        }else{
-          if( c==c2 ){
-            seen = 1;
-          }
-          prior_c = c2;
-        }
-        c2 = *(zGlob++);
-      }
-      if( c2==0 || (seen ^ invert)==0 ) return 0;
-    }else if( c=='#' ){
-      if( (z[0]=='-' || z[0]=='+') && IsDigit(z[1]) ) z++;
-      if( !IsDigit(z[0]) ) return 0;
-      z++;
-      while( IsDigit(z[0]) ){ z++; }
-    }else{
-      if( c!=(*(z++)) ) return 0;
-    }
+static int import_fill(ImportCtx *p){
+  size_t nRead;
+  if( p->bEof ) return 0;
+  if( p->iRow>0 ){
+    p->nBuf -= p->iRow;
+    memmove(p->zBuf, p->zBuf+p->iRow, p->nBuf);
+    p->iBuf -= p->iRow;
+    p->iRow = 0;
+  }
+  if( p->nAlloc - p->nBuf < IMPORT_BLOCK_SIZE + 1 ){
+    size_t nNew = p->nAlloc*2;
+    if( nNew < p->nBuf + IMPORT_BLOCK_SIZE + 1 ){
+      nNew = p->nBuf + IMPORT_BLOCK_SIZE + 1;
+    }
+    p->zBuf = sqlite3_realloc64(p->zBuf, nNew);
+    if( p->zBuf==0 ) shell_out_of_memory();
+    p->nAlloc = nNew;
+  }
+  p->bRowSep = 0;
+#if SHELL_USE_DECOMPRESSION
+  if( p->pCin ){
+    nRead = cinput_read(p->pCin, p->zBuf+p->nBuf, p->nAlloc - p->nBuf - 1);
+  }else
+#endif
+  nRead = fread(p->zBuf+p->nBuf, 1, p->nAlloc - p->nBuf - 1, p->in);
+  if( nRead==0 ){
+    p->bEof = 1;
+    return 0;
   }
-  while( IsSpace(*z) ){ z++; }
-  return *z==0;
+  p->nBuf += nRead;
+  p->nRead += nRead;
+  return 1;
 }
 
+/* Read a single byte of input, or return EOF */
+static int import_getc(ImportCtx *p){
+  if( p->iBuf>=p->nBuf && !import_fill(p) ) return EOF;
+  return (unsigned char)p->zBuf[p->iBuf++];
+}
 
 /*
-** Compare the string as a command-line option with either one or two
-** initial "-" characters.
+** Begin a new record.  Text of earlier records may be discarded from
+** here on, and the fields of the new record are collected in aField[].
 */
-static int optionMatch(const char *zStr, const char *zOpt){
-  if( zStr[0]!='-' ) return 0;
-  zStr++;
-  if( zStr[0]=='-' ) zStr++;
-  return strcmp(zStr, zOpt)==0;
+static void import_begin_record(ImportCtx *p){
+  p->iRow = p->iBuf;
+  p->nField = 0;
 }
 
 /*
-** Delete a file.
+** Zero-terminate the field of n bytes starting at offset iOff from the
+** start of the current record, make it the most recent field, and add it
+** to the fields of the current record.  Return the text of the field.
 */
-int shellDeleteFile(const char *zFilename){
-  int rc;
-#ifdef _WIN32
-  wchar_t *z = sqlite3_win32_utf8_to_unicode(zFilename);
-  rc = _wunlink(z);
-  sqlite3_free(z);
-#else
-  rc = unlink(zFilename);
-#endif
-  return rc;
+static char *import_end_field(ImportCtx *p, size_t iOff, int n){
+  if( p->nField>=p->nFieldAlloc ){
+    p->nFieldAlloc += p->nFieldAlloc + 16;
+    p->aField = sqlite3_realloc64(p->aField,
+                                  p->nFieldAlloc*sizeof(p->aField[0]));
+    if( p->aField==0 ) shell_out_of_memory();
+  }
+  p->aField[p->nField].iOff = iOff;
+  p->aField[p->nField].n = n;
+  p->nField++;
+  p->z = p->zBuf + p->iRow + iOff;
+  p->n = n;
+  p->z[n] = 0;
+  return p->z;
 }
 
 /*
-** Try to delete the temporary file (if there is one) and free the
-** memory used to hold the name of the temp file.
+** Bind the fields of the current record to the first nCol parameters of
+** pStmt, as slices of the input buffer.  Parameters for which the record
+** has no field are bound to NULL.  The bindings remain valid until the
+** next record begins.
 */
-static void clearTempFile(ShellState *p){
-  if( p->zTempFile==0 ) return;
-  if( p->doXdgOpen ) return;
-  if( shellDeleteFile(p->zTempFile) ) return;
-  sqlite3_free(p->zTempFile);
-  p->zTempFile = 0;
+static void import_bind_record(ImportCtx *p, sqlite3_stmt *pStmt, int nCol){
+  int i;
+  for(i=0; i<nCol; i++){
+    if( i<p->nField ){
+      sqlite3_bind_text(pStmt, i+1, p->zBuf + p->iRow + p->aField[i].iOff,
+                        p->aField[i].n, SQLITE_STATIC);
+    }else{
+      sqlite3_bind_null(pStmt, i+1);
+    }
+  }
+}
+
+/* Return the number of times character c appears in the n bytes at z */
+static int import_count_char(const char *z, size_t n, int c){
+  int nFound = 0;
+  const char *zEnd = z + n;
+  while( (z = memchr(z, c, zEnd-z))!=0 ){
+    nFound++;
+    z++;
+  }
+  return nFound;
 }
 
 /*
-** Create a new temp file name with the given suffix.
+** Return the offset in zBuf[] of the first column or row separator at or
+** after offset i, or nBuf if there is none in the input read so far.
+** The offset of the next row separator is remembered, so that scanning
+** each field of a record doesn't scan the rest of the line again.
+** (memchr() is vectorized by most C libraries.)
 */
-static void newTempFile(ShellState *p, const char *zSuffix){
-  clearTempFile(p);
-  sqlite3_free(p->zTempFile);
-  p->zTempFile = 0;
-  if( p->db ){
-    sqlite3_file_control(p->db, 0, SQLITE_FCNTL_TEMPFILENAME, &p->zTempFile);
+static size_t import_find_separator(ImportCtx *p, size_t i){
+  const char *z;
+  if( !p->bRowSep || p->iRowSep<i ){
+    z = memchr(p->zBuf+i, p->cRowSep, p->nBuf-i);
+    p->iRowSep = z ? (size_t)(z - p->zBuf) : p->nBuf;
+    p->bRowSep = 1;
   }
-  if( p->zTempFile==0 ){
-    sqlite3_uint64 r;
-    sqlite3_randomness(sizeof(r), &r);
-    p->zTempFile = sqlite3_mprintf("temp%llx.%s", r, zSuffix);
-  }else{
-    p->zTempFile = sqlite3_mprintf("%z.%s", p->zTempFile, zSuffix);
+  z = memchr(p->zBuf+i, p->cColSep, p->iRowSep-i);
+  return z ? (size_t)(z - p->zBuf) : p->iRowSep;
+}
+
+/*
+** Read an unquoted field, which runs from the next byte of input to the
+** next column or row separator, or to end-of-file.  If bStripCr is true,
+** a carriage return before a row separator is dropped from the field.
+*/
+static char *import_read_unquoted(ImportCtx *p, int bStripCr){
+  size_t iStart = p->iBuf - p->iRow;
+  size_t iEnd;
+  int c;
+  int n;
+  while( 1 ){
+    iEnd = import_find_separator(p, p->iBuf);
+    if( iEnd<p->nBuf ){
+      c = (unsigned char)p->zBuf[iEnd];
+      p->iBuf = iEnd + 1;
+      break;
+    }
+    p->iBuf = p->nBuf;
+    if( !import_fill(p) ){
+      c = EOF;
+      iEnd = p->nBuf;
+      break;
+    }
   }
-  if( p->zTempFile==0 ){
-    raw_printf(stderr, "out of memory\n");
-    exit(1);
+  n = (int)(iEnd - p->iRow - iStart);
+  if( c==p->cRowSep ){
+    p->nLine++;
+    if( bStripCr && n>0 && p->zBuf[iEnd-1]=='\r' ) n--;
   }
+  p->cTerm = c;
+  return import_end_field(p, iStart, n);
 }
 
+/* If the CSV input begins with the UTF-8 BOM (0xEF BB BF) then skip it */
+static void import_skip_bom(ImportCtx *p){
+  while( p->nBuf - p->iBuf<3 && import_fill(p) ){}
+  if( p->nBuf - p->iBuf>=3
+   && memcmp(p->zBuf+p->iBuf, "\xef\xbb\xbf", 3)==0
+  ){
+    p->iBuf += 3;
+  }
+  p->bNotFirst = 1;
+}
 
-/*
-** The implementation of SQL scalar function fkey_collate_clause(), used
-** by the ".lint fkey-indexes" command. This scalar function is always
-** called with four arguments - the parent table name, the parent column name,
-** the child table name and the child column name.
-**
-**   fkey_collate_clause('parent-tab', 'parent-col', 'child-tab', 'child-col')
+/* Read a single field of CSV text.  Compatible with rfc4180 and extended
+** with the option of having a separator other than ",".
 **
-** If either of the named tables or columns do not exist, this function
-** returns an empty string. An empty string is also returned if both tables
-** and columns exist but have the same default collation sequence. Or,
-** if both exist but the default collation sequences are different, this
-** function returns the string " COLLATE <parent-collation>", where
-** <parent-collation> is the default collation sequence of the parent column.
+**   +  Input comes from p->in, a block at a time, into p->zBuf.
+**   +  Store results in p->z of length p->n.  The field is parsed in
+**      place, so p->z points into p->zBuf.
+**   +  Use p->cSep as the column separator.  The default is ",".
+**   +  Use p->rSep as the row separator.  The default is "\n".
+**   +  Keep track of the line number in p->nLine.
+**   +  Store the character that terminates the field in p->cTerm.  Store
+**      EOF on end-of-file.
+**   +  Report syntax errors through import_warning()
 */
-static void shellFkeyCollateClause(
-  sqlite3_context *pCtx,
-  int nVal,
-  sqlite3_value **apVal
-){
-  sqlite3 *db = sqlite3_context_db_handle(pCtx);
-  const char *zParent;
-  const char *zParentCol;
-  const char *zParentSeq;
-  const char *zChild;
-  const char *zChildCol;
-  const char *zChildSeq = 0;  /* Initialize to avoid false-positive warning */
-  int rc;
+static char *SQLITE_CDECL csv_read_one_field(ImportCtx *p){
+  int c;
+  int cSep = p->cColSep;
+  int rSep = p->cRowSep;
+  if( p->bNotFirst==0 ) import_skip_bom(p);
+  c = import_getc(p);
+  if( c==EOF || seenInterrupt ){
+    p->cTerm = EOF;
+    return 0;
+  }
+  if( c=='"' ){
+    int pc, ppc;
+    int startLine = p->nLine;
+    int cQuote = c;
+    size_t iStart = p->iBuf - p->iRow;  /* Start of the field in the record */
+    size_t iOut = iStart;               /* Where the next byte is stored */
+    pc = ppc = 0;
+    while( 1 ){
+      if( pc!=cQuote && (pc!='\r' || ppc!=cQuote) ){
+        /* Nothing special can happen before the next quote, so move
+        ** everything up to it into the field at once. */
+        char *zSpan = p->zBuf + p->iBuf;
+        char *zQuote = memchr(zSpan, cQuote, p->nBuf - p->iBuf);
+        size_t nSpan = (zQuote ? zQuote : p->zBuf + p->nBuf) - zSpan;
+        if( nSpan>0 ){
+          p->nLine += import_count_char(zSpan, nSpan, rSep);
+          ppc = nSpan>1 ? (unsigned char)zSpan[nSpan-2] : pc;
+          pc = (unsigned char)zSpan[nSpan-1];
+          memmove(p->zBuf + p->iRow + iOut, zSpan, nSpan);
+          iOut += nSpan;
+          p->iBuf += nSpan;
+          continue;
+        }
+      }
+      c = import_getc(p);
+      if( c==rSep ) p->nLine++;
+      if( c==cQuote ){
+        if( pc==cQuote ){
+          pc = 0;
+          continue;
+        }
+      }
+      if( (c==cSep && pc==cQuote)
+       || (c==rSep && pc==cQuote)
+       || (c==rSep && pc=='\r' && ppc==cQuote)
+       || (c==EOF && pc==cQuote)
+      ){
+        do{ iOut--; }while( p->zBuf[p->iRow + iOut]!=cQuote );
+        p->cTerm = c;
+        break;
+      }
+      if( pc==cQuote && c!='\r' ){
+        import_warning(p, "%s:%d: unescaped %c character\n",
+                       p->zFile, p->nLine, cQuote);
+      }
+      if( c==EOF ){
+        import_warning(p, "%s:%d: unterminated %c-quoted field\n",
+                       p->zFile, startLine, cQuote);
+        p->cTerm = c;
+        break;
+      }
+      p->zBuf[p->iRow + iOut++] = (char)c;
+      ppc = pc;
+      pc = c;
+    }
+    return import_end_field(p, iStart, (int)(iOut - iStart));
+  }
+  p->iBuf--;
+  return import_read_unquoted(p, 1);
+}
 
-  assert( nVal==4 );
-  zParent = (const char*)sqlite3_value_text(apVal[0]);
-  zParentCol = (const char*)sqlite3_value_text(apVal[1]);
-  zChild = (const char*)sqlite3_value_text(apVal[2]);
-  zChildCol = (const char*)sqlite3_value_text(apVal[3]);
+/* Read a single field of ASCII delimited text.
+**
+**   +  Input comes from p->in, a block at a time, into p->zBuf.
+**   +  Store results in p->z of length p->n.  The field is parsed in
+**      place, so p->z points into p->zBuf.
+**   +  Use p->cSep as the column separator.  The default is "\x1F".
+**   +  Use p->rSep as the row separator.  The default is "\x1E".
+**   +  Keep track of the row number in p->nLine.
+**   +  Store the character that terminates the field in p->cTerm.  Store
+**      EOF on end-of-file.
+**   +  Report syntax errors on stderr
+*/
+static char *SQLITE_CDECL ascii_read_one_field(ImportCtx *p){
+  int c = import_getc(p);
+  if( c==EOF || seenInterrupt ){
+    p->cTerm = EOF;
+    return 0;
+  }
+  p->iBuf--;
+  return import_read_unquoted(p, 0);
+}
 
-  sqlite3_result_text(pCtx, "", -1, SQLITE_STATIC);
-  rc = sqlite3_table_column_metadata(
-      db, "main", zParent, zParentCol, 0, &zParentSeq, 0, 0, 0
-  );
-  if( rc==SQLITE_OK ){
-    rc = sqlite3_table_column_metadata(
-        db, "main", zChild, zChildCol, 0, &zChildSeq, 0, 0, 0
-    );
+/*
+** Read the next record of input, of up to nCol fields, as the fields of
+** the current record.  Records with too few or too many fields are
+** reported.  bAscii is true for ASCII delimited input, in which an empty
+** line is skipped rather than imported.
+**
+** Return true if the record is to be inserted, or false if there was no
+** record before the end of the line or of the input.
+*/
+static int import_next_record(
+  ImportCtx *p,                             /* The input */
+  char *(SQLITE_CDECL *xRead)(ImportCtx*),  /* Func to read one value */
+  int nCol,                                 /* Number of columns in table */
+  int bAscii                                /* True for ASCII delimited */
+){
+  int startLine = p->nLine;
+  int i;
+  import_begin_record(p);
+  for(i=0; i<nCol; i++){
+    char *z = xRead(p);
+    /*
+    ** Did we reach end-of-file before finding any columns?
+    ** If so, stop instead of NULL filling the remaining columns.
+    */
+    if( z==0 && i==0 ) break;
+    /*
+    ** Did we reach end-of-file OR end-of-line before finding any
+    ** columns in ASCII mode?  If so, stop instead of NULL filling
+    ** the remaining columns.
+    */
+    if( bAscii && (z==0 || z[0]==0) && i==0 ) break;
+    if( i<nCol-1 && p->cTerm!=p->cColSep ){
+      import_warning(p, "%s:%d: expected %d columns but found %d - "
+                        "filling the rest with NULL\n",
+                        p->zFile, startLine, nCol, i+1);
+      i = nCol;
+      break;
+    }
   }
+  if( p->cTerm==p->cColSep ){
+    do{
+      xRead(p);
+      i++;
+    }while( p->cTerm==p->cColSep );
+    import_warning(p, "%s:%d: expected %d columns but found %d - "
+                      "extras ignored\n",
+                      p->zFile, startLine, nCol, i);
+  }
+  return i>=nCol;
+}
+
+/* A record saved in an ImportChunk */
+typedef struct ImportRow ImportRow;
+struct ImportRow {
+  int iField;         /* Index in ImportChunk.aField[] of the first field */
+  int nField;         /* Number of fields, not more than the table columns */
+  int startLine;      /* Line number on which the record begins */
+  int bInsert;        /* True if the record is to be inserted */
+  char *zWarnings;    /* Warnings to print before inserting, or NULL */
+};
 
-  if( rc==SQLITE_OK && sqlite3_stricmp(zParentSeq, zChildSeq) ){
-    char *z = sqlite3_mprintf(" COLLATE %s", zParentSeq);
-    sqlite3_result_text(pCtx, z, -1, SQLITE_TRANSIENT);
-    sqlite3_free(z);
+/*
+** A run of whole records of input, and the results of parsing them.
+** The records are read by a worker thread of a parallel .import, or are
+** the records sampled by .import --infer.
+*/
+typedef struct ImportChunk ImportChunk;
+struct ImportChunk {
+  ImportChunk *pNext; /* Next chunk in the same list */
+  int iSeq;           /* Position of the chunk in the input.  0 is first */
+  int nLine;          /* Line number on which the chunk begins */
+  char *zBuf;         /* Text of the chunk.  Fields are parsed in place */
+  size_t nBuf;        /* Number of bytes of text in zBuf[] */
+  size_t nAlloc;      /* Space allocated for zBuf[], if text is copied in */
+  ImportField *aField; /* Fields of all records.  Offsets are from zBuf */
+  int nField;         /* Number of fields in aField[] */
+  int nFieldAlloc;    /* Space allocated for aField[] */
+  ImportRow *aRow;    /* Records parsed from the chunk */
+  int nRow;           /* Number of records in aRow[] */
+  int nRowAlloc;      /* Space allocated for aRow[] */
+};
+
+/* Free an ImportChunk and everything it holds */
+static void import_chunk_free(ImportChunk *pChunk){
+  int i;
+  for(i=0; i<pChunk->nRow; i++){
+    sqlite3_free(pChunk->aRow[i].zWarnings);
   }
+  sqlite3_free(pChunk->zBuf);
+  sqlite3_free(pChunk->aField);
+  sqlite3_free(pChunk->aRow);
+  sqlite3_free(pChunk);
 }
 
-
 /*
-** The implementation of dot-command ".lint fkey-indexes".
+** Add the current record of p, which begins on line startLine, to pChunk,
+** along with any warnings about it.  Only the first nCol fields are kept,
+** and none unless bInsert is true.  If bCopy is true, the text of the
+** fields is copied into pChunk->zBuf[].  Otherwise the fields are already
+** in pChunk->zBuf[], which is the same buffer as p->zBuf[].
 */
-static int lintFkeyIndexes(
-  ShellState *pState,             /* Current shell tool state */
-  char **azArg,                   /* Array of arguments passed to dot command */
-  int nArg                        /* Number of entries in azArg[] */
+static void import_save_record(
+  ImportChunk *pChunk,        /* Add the record to this chunk */
+  ImportCtx *p,               /* The input, positioned after the record */
+  int startLine,              /* Line number on which the record begins */
+  int bInsert,                /* True if the record is to be inserted */
+  int nCol,                   /* Number of columns in the table */
+  int bCopy                   /* True to copy the text of the fields */
 ){
-  sqlite3 *db = pState->db;       /* Database handle to query "main" db of */
-  FILE *out = pState->out;        /* Stream to write non-error output to */
-  int bVerbose = 0;               /* If -verbose is present */
-  int bGroupByParent = 0;         /* If -groupbyparent is present */
-  int i;                          /* To iterate through azArg[] */
-  const char *zIndent = "";       /* How much to indent CREATE INDEX by */
-  int rc;                         /* Return code */
-  sqlite3_stmt *pSql = 0;         /* Compiled version of SQL statement below */
-
-  /*
-  ** This SELECT statement returns one row for each foreign key constraint
-  ** in the schema of the main database. The column values are:
-  **
-  ** 0. The text of an SQL statement similar to:
-  **
-  **      "EXPLAIN QUERY PLAN SELECT 1 FROM child_table WHERE child_key=?"
-  **
-  **    This SELECT is similar to the one that the foreign keys implementation
-  **    needs to run internally on child tables. If there is an index that can
-  **    be used to optimize this query, then it can also be used by the FK
-  **    implementation to optimize DELETE or UPDATE statements on the parent
-  **    table.
-  **
-  ** 1. A GLOB pattern suitable for sqlite3_strglob(). If the plan output by
-  **    the EXPLAIN QUERY PLAN command matches this pattern, then the schema
-  **    contains an index that can be used to optimize the query.
-  **
-  ** 2. Human readable text that describes the child table and columns. e.g.
-  **
-  **       "child_table(child_key1, child_key2)"
-  **
-  ** 3. Human readable text that describes the parent table and columns. e.g.
-  **
-  **       "parent_table(parent_key1, parent_key2)"
-  **
-  ** 4. A full CREATE INDEX statement for an index that could be used to
-  **    optimize DELETE or UPDATE statements on the parent table. e.g.
-  **
-  **       "CREATE INDEX child_table_child_key ON child_table(child_key)"
-  **
-  ** 5. The name of the parent table.
-  **
-  ** These six values are used by the C logic below to generate the report.
-  */
-  const char *zSql =
-  "SELECT "
-    "     'EXPLAIN QUERY PLAN SELECT 1 FROM ' || quote(s.name) || ' WHERE '"
-    "  || group_concat(quote(s.name) || '.' || quote(f.[from]) || '=?' "
-    "  || fkey_collate_clause("
-    "       f.[table], COALESCE(f.[to], p.[name]), s.name, f.[from]),' AND ')"
-    ", "
-    "     'SEARCH TABLE ' || s.name || ' USING COVERING INDEX*('"
-    "  || group_concat('*=?', ' AND ') || ')'"
-    ", "
-    "     s.name  || '(' || group_concat(f.[from],  ', ') || ')'"
-    ", "
-    "     f.[table] || '(' || group_concat(COALESCE(f.[to], p.[name])) || ')'"
-    ", "
-    "     'CREATE INDEX ' || quote(s.name ||'_'|| group_concat(f.[from], '_'))"
-    "  || ' ON ' || quote(s.name) || '('"
-    "  || group_concat(quote(f.[from]) ||"
-    "        fkey_collate_clause("
-    "          f.[table], COALESCE(f.[to], p.[name]), s.name, f.[from]), ', ')"
-    "  || ');'"
-    ", "
-    "     f.[table] "
-    "FROM sqlite_master AS s, pragma_foreign_key_list(s.name) AS f "
-    "LEFT JOIN pragma_table_info AS p ON (pk-1=seq AND p.arg=f.[table]) "
-    "GROUP BY s.name, f.id "
-    "ORDER BY (CASE WHEN ? THEN f.[table] ELSE s.name END)"
-  ;
-  const char *zGlobIPK = "SEARCH TABLE * USING INTEGER PRIMARY KEY (rowid=?)";
-
-  for(i=2; i<nArg; i++){
-    int n = strlen30(azArg[i]);
-    if( n>1 && sqlite3_strnicmp("-verbose", azArg[i], n)==0 ){
-      bVerbose = 1;
-    }
-    else if( n>1 && sqlite3_strnicmp("-groupbyparent", azArg[i], n)==0 ){
-      bGroupByParent = 1;
-      zIndent = "    ";
+  int nField = bInsert ? (p->nField<nCol ? p->nField : nCol) : 0;
+  ImportRow *pRow;
+  int i;
+  if( pChunk->nRow>=pChunk->nRowAlloc ){
+    pChunk->nRowAlloc += pChunk->nRowAlloc + 64;
+    pChunk->aRow = sqlite3_realloc64(pChunk->aRow,
+                                pChunk->nRowAlloc*sizeof(pChunk->aRow[0]));
+    if( pChunk->aRow==0 ) shell_out_of_memory();
+  }
+  if( pChunk->nField+nField>pChunk->nFieldAlloc ){
+    pChunk->nFieldAlloc += pChunk->nFieldAlloc + nField + 64;
+    pChunk->aField = sqlite3_realloc64(pChunk->aField,
+                            pChunk->nFieldAlloc*sizeof(pChunk->aField[0]));
+    if( pChunk->aField==0 ) shell_out_of_memory();
+  }
+  pRow = &pChunk->aRow[pChunk->nRow++];
+  pRow->iField = pChunk->nField;
+  pRow->nField = nField;
+  pRow->startLine = startLine;
+  pRow->bInsert = bInsert;
+  pRow->zWarnings = p->zWarnings;
+  p->zWarnings = 0;
+  for(i=0; i<nField; i++){
+    ImportField *pField = &pChunk->aField[pChunk->nField++];
+    pField->iOff = p->iRow + p->aField[i].iOff;
+    pField->n = p->aField[i].n;
+    if( bCopy ){
+      if( pChunk->nBuf + pField->n + 1 > pChunk->nAlloc ){
+        pChunk->nAlloc += pChunk->nAlloc + pField->n + 1024;
+        pChunk->zBuf = sqlite3_realloc64(pChunk->zBuf, pChunk->nAlloc);
+        if( pChunk->zBuf==0 ) shell_out_of_memory();
+      }
+      memcpy(pChunk->zBuf + pChunk->nBuf, p->zBuf + pField->iOff, pField->n);
+      pField->iOff = pChunk->nBuf;
+      pChunk->nBuf += pField->n;
+      pChunk->zBuf[pChunk->nBuf++] = 0;
+    }
+  }
+}
+
+/*
+** Types which .import --infer may give to the columns of a new table.
+** IMPORT_TYPE_NONE is for a column in which no value has been seen yet.
+** A column whose values need different types gets IMPORT_TYPE_TEXT, since
+** a REAL column would turn "3" into 3.0.
+*/
+#define IMPORT_TYPE_NONE     0
+#define IMPORT_TYPE_INTEGER  1
+#define IMPORT_TYPE_REAL     2
+#define IMPORT_TYPE_TEXT     3
+
+/*
+** Return the column type which can hold the text z without changing how
+** it reads back.  So text such as "007", "+1" or "-0", which an INTEGER
+** column would store as a different number, needs TEXT, as does text such
+** as "1.50" or "1e2", which a REAL column would read back as "1.5" or
+** "100.0".  An empty field is stored as text in any column, so it needs
+** no type.
+*/
+static int import_value_type(const char *z){
+  int bReal = 0;
+  int i = z[0]=='-';
+  if( z[0]==0 ) return IMPORT_TYPE_NONE;
+  if( z[0]=='+' || !isNumber(z, &bReal) ) return IMPORT_TYPE_TEXT;
+  if( bReal ){
+    char zBuf[50];
+    double r = atof(z);
+    if( r==0.0 && i ) return IMPORT_TYPE_TEXT;
+    sqlite3_snprintf(sizeof(zBuf), zBuf, "%!.15g", r);
+    return strcmp(z, zBuf)==0 ? IMPORT_TYPE_REAL : IMPORT_TYPE_TEXT;
+  }
+  if( z[i]=='0' && (i || z[i+1]!=0) ) return IMPORT_TYPE_TEXT;
+  if( strlen30(z+i)>18 ) return IMPORT_TYPE_TEXT;
+  return IMPORT_TYPE_INTEGER;
+}
+
+/*
+** Read up to nSample records of input p, which has nCol columns, into
+** pChunk, so that they can be inserted once the table exists.  Change
+** aType[i] to fit the i-th field of every record read.
+*/
+static void import_sample(
+  ImportCtx *p,                             /* The input */
+  char *(SQLITE_CDECL *xRead)(ImportCtx*),  /* Func to read one value */
+  int nCol,                                 /* Number of columns in table */
+  int bAscii,                               /* True for ASCII delimited */
+  int nSample,                              /* Most records to read */
+  ImportChunk *pChunk,                      /* OUT: The records read */
+  int *aType                                /* IN/OUT: Column types */
+){
+  while( nSample>0 && p->cTerm!=EOF && !seenInterrupt ){
+    int startLine = p->nLine;
+    int bInsert = import_next_record(p, xRead, nCol, bAscii);
+    if( bInsert ){
+      int i;
+      for(i=0; i<p->nField && i<nCol; i++){
+        int eType = import_value_type(p->zBuf + p->iRow + p->aField[i].iOff);
+        if( aType[i]==IMPORT_TYPE_NONE ){
+          aType[i] = eType;
+        }else if( eType!=IMPORT_TYPE_NONE && eType!=aType[i] ){
+          aType[i] = IMPORT_TYPE_TEXT;
+        }
+      }
+      nSample--;
     }
-    else{
-      raw_printf(stderr, "Usage: %s %s ?-verbose? ?-groupbyparent?\n",
-          azArg[0], azArg[1]
-      );
-      return SQLITE_ERROR;
+    if( bInsert || p->zWarnings ){
+      import_save_record(pChunk, p, startLine, bInsert, nCol, 1);
     }
   }
+}
 
-  /* Register the fkey_collate_clause() SQL function */
-  rc = sqlite3_create_function(db, "fkey_collate_clause", 4, SQLITE_UTF8,
-      0, shellFkeyCollateClause, 0, 0
-  );
-
+/*
+** Where the records of an .import go, and counts of how many have gone.
+*/
+typedef struct ImportOutput ImportOutput;
+struct ImportOutput {
+  sqlite3_stmt *pStmt;        /* The INSERT statement */
+  const char *zFile;          /* Name of the input, for error messages */
+  int nCol;                   /* Number of columns in the table */
+  int rc;                     /* Result of the most recent INSERT */
+  int nBatch;                 /* Commit after every nBatch rows.  0: never */
+  int bProgress;              /* True to report progress on stderr */
+  sqlite3_int64 nRow;         /* Number of rows inserted so far */
+  sqlite3_int64 nFail;        /* Number of rows which failed to insert */
+  sqlite3_int64 nByte;        /* Number of bytes of input consumed so far */
+  sqlite3_int64 iStart;       /* When the import started, in milliseconds */
+  sqlite3_int64 iReport;      /* When progress was last reported */
+};
 
-  if( rc==SQLITE_OK ){
-    rc = sqlite3_prepare_v2(db, zSql, -1, &pSql, 0);
+/*
+** Report how many rows and bytes have been imported, and how quickly.
+** Unless bFinal is true, do nothing if progress was reported less than a
+** second ago.
+*/
+static void import_progress(ImportOutput *pOut, int bFinal){
+  sqlite3_int64 iNow = timeOfDay();
+  double rSec;
+  double rMB;
+  if( !bFinal && iNow-pOut->iReport<1000 ) return;
+  pOut->iReport = iNow;
+  rSec = (iNow - pOut->iStart)/1000.0;
+  if( rSec<0.001 ) rSec = 0.001;
+  rMB = pOut->nByte/1048576.0;
+  utf8_printf(stderr,
+      "%s: %s%lld rows, %.1f MB in %.1f s (%.0f rows/s, %.1f MB/s)",
+      pOut->zFile, bFinal ? "imported " : "", pOut->nRow, rMB, rSec,
+      pOut->nRow/rSec, rMB/rSec);
+  if( pOut->nFail>0 ){
+    utf8_printf(stderr, ", %lld rows failed", pOut->nFail);
+  }
+  utf8_printf(stderr, "\n");
+}
+
+/*
+** Run the INSERT statement, whose parameters are bound to the fields of
+** the record beginning on line startLine.  Commit every pOut->nBatch rows
+** inserted if pOut->nBatch is set, and report progress if pOut->bProgress
+** is set.  Rows which fail to insert are counted apart from those which
+** were inserted.
+*/
+static void import_insert(ImportOutput *pOut, int startLine){
+  sqlite3 *db = sqlite3_db_handle(pOut->pStmt);
+  sqlite3_step(pOut->pStmt);
+  pOut->rc = sqlite3_reset(pOut->pStmt);
+  if( pOut->rc!=SQLITE_OK ){
+    utf8_printf(stderr, "%s:%d: INSERT failed: %s\n", pOut->zFile,
+                startLine, sqlite3_errmsg(db));
+    pOut->nFail++;
+  }else{
+    pOut->nRow++;
+    if( pOut->nBatch>0 && (pOut->nRow % pOut->nBatch)==0 ){
+      sqlite3_exec(db, "COMMIT; BEGIN", 0, 0, 0);
+    }
   }
-  if( rc==SQLITE_OK ){
-    sqlite3_bind_int(pSql, 1, bGroupByParent);
+  if( pOut->bProgress && ((pOut->nRow+pOut->nFail) & 0x3ff)==0 ){
+    import_progress(pOut, 0);
   }
+}
 
-  if( rc==SQLITE_OK ){
-    int rc2;
-    char *zPrev = 0;
-    while( SQLITE_ROW==sqlite3_step(pSql) ){
-      int res = -1;
-      sqlite3_stmt *pExplain = 0;
-      const char *zEQP = (const char*)sqlite3_column_text(pSql, 0);
-      const char *zGlob = (const char*)sqlite3_column_text(pSql, 1);
-      const char *zFrom = (const char*)sqlite3_column_text(pSql, 2);
-      const char *zTarget = (const char*)sqlite3_column_text(pSql, 3);
-      const char *zCI = (const char*)sqlite3_column_text(pSql, 4);
-      const char *zParent = (const char*)sqlite3_column_text(pSql, 5);
-
-      rc = sqlite3_prepare_v2(db, zEQP, -1, &pExplain, 0);
-      if( rc!=SQLITE_OK ) break;
-      if( SQLITE_ROW==sqlite3_step(pExplain) ){
-        const char *zPlan = (const char*)sqlite3_column_text(pExplain, 3);
-        res = (
-              0==sqlite3_strglob(zGlob, zPlan)
-           || 0==sqlite3_strglob(zGlobIPK, zPlan)
-        );
-      }
-      rc = sqlite3_finalize(pExplain);
-      if( rc!=SQLITE_OK ) break;
-
-      if( res<0 ){
-        raw_printf(stderr, "Error: internal error");
-        break;
+/*
+** Insert the records saved in pChunk, printing any warnings about each
+** record just before it is inserted.
+*/
+static void import_insert_chunk(ImportOutput *pOut, ImportChunk *pChunk){
+  int i, j;
+  for(i=0; i<pChunk->nRow && !seenInterrupt; i++){
+    ImportRow *pRow = &pChunk->aRow[i];
+    if( pRow->zWarnings ) utf8_printf(stderr, "%s", pRow->zWarnings);
+    if( !pRow->bInsert ) continue;
+    for(j=0; j<pOut->nCol; j++){
+      if( j<pRow->nField ){
+        ImportField *pField = &pChunk->aField[pRow->iField + j];
+        sqlite3_bind_text(pOut->pStmt, j+1, pChunk->zBuf + pField->iOff,
+                          pField->n, SQLITE_STATIC);
       }else{
-        if( bGroupByParent
-        && (bVerbose || res==0)
-        && (zPrev==0 || sqlite3_stricmp(zParent, zPrev))
-        ){
-          raw_printf(out, "-- Parent table %s\n", zParent);
-          sqlite3_free(zPrev);
-          zPrev = sqlite3_mprintf("%s", zParent);
-        }
-
-        if( res==0 ){
-          raw_printf(out, "%s%s --> %s\n", zIndent, zCI, zTarget);
-        }else if( bVerbose ){
-          raw_printf(out, "%s/* no extra indexes required for %s -> %s */\n",
-              zIndent, zFrom, zTarget
-          );
-        }
+        sqlite3_bind_null(pOut->pStmt, j+1);
       }
     }
-    sqlite3_free(zPrev);
-
-    if( rc!=SQLITE_OK ){
-      raw_printf(stderr, "%s\n", sqlite3_errmsg(db));
-    }
-
-    rc2 = sqlite3_finalize(pSql);
-    if( rc==SQLITE_OK && rc2!=SQLITE_OK ){
-      rc = rc2;
-      raw_printf(stderr, "%s\n", sqlite3_errmsg(db));
-    }
-  }else{
-    raw_printf(stderr, "%s\n", sqlite3_errmsg(db));
+    import_insert(pOut, pRow->startLine);
   }
-
-  return rc;
 }
 
+#if SHELL_USE_PTHREADS
 /*
-** Implementation of ".lint" dot command.
+** The .import command can spread its work over several threads.  A reader
+** thread cuts the input into chunks of whole records, worker threads parse
+** the chunks, and the main thread inserts the parsed records, a chunk at a
+** time and in input order.  So the table, and the messages printed, come
+** out exactly as if the whole input was parsed by the main thread.
 */
-static int lintDotCommand(
-  ShellState *pState,             /* Current shell tool state */
-  char **azArg,                   /* Array of arguments passed to dot command */
-  int nArg                        /* Number of entries in azArg[] */
-){
-  int n;
-  n = (nArg>=2 ? strlen30(azArg[1]) : 0);
-  if( n<1 || sqlite3_strnicmp(azArg[1], "fkey-indexes", n) ) goto usage;
-  return lintFkeyIndexes(pState, azArg, nArg);
 
- usage:
-  raw_printf(stderr, "Usage %s sub-command ?switches...?\n", azArg[0]);
-  raw_printf(stderr, "Where sub-commands are:\n");
-  raw_printf(stderr, "    fkey-indexes\n");
-  return SQLITE_ERROR;
-}
+/* Most worker threads .import uses unless told otherwise */
+#define IMPORT_MAX_THREADS 8
 
-#if !defined SQLITE_OMIT_VIRTUALTABLE
-static void shellPrepare(
-  sqlite3 *db, 
-  int *pRc, 
-  const char *zSql, 
-  sqlite3_stmt **ppStmt
-){
-  *ppStmt = 0;
-  if( *pRc==SQLITE_OK ){
-    int rc = sqlite3_prepare_v2(db, zSql, -1, ppStmt, 0);
-    if( rc!=SQLITE_OK ){
-      raw_printf(stderr, "sql error: %s (%d)\n", 
-          sqlite3_errmsg(db), sqlite3_errcode(db)
-      );
-      *pRc = rc;
-    }
-  }
+/* State shared by the threads of a parallel .import */
+typedef struct ImportPipeline ImportPipeline;
+struct ImportPipeline {
+  ImportCtx *pCtx;    /* The input.  Only used by the reader thread */
+  char *(SQLITE_CDECL *xRead)(ImportCtx*); /* Func to read one value */
+  int nCol;           /* Number of columns in the table */
+  int bAscii;         /* True for ASCII delimited input */
+  int nMaxInFlight;   /* Most chunks read but not yet inserted */
+  pthread_mutex_t mutex;  /* Protects all fields below */
+  pthread_cond_t cond;    /* Broadcast whenever a field below changes */
+  ImportChunk *pTodo;     /* Chunks waiting to be parsed, oldest first */
+  ImportChunk *pTodoLast; /* Last chunk of the pTodo list */
+  ImportChunk *pDone;     /* Chunks parsed but not yet inserted */
+  int nChunk;         /* Number of chunks read so far */
+  int nInFlight;      /* Number of chunks read but not yet inserted */
+  int bEof;           /* True once the reader has read every chunk */
+  int bAbort;         /* True to make all threads stop early */
+};
+
+/* Return the default number of worker threads for .import */
+static int import_default_threads(void){
+  int nCpu = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if( n>1 ) nCpu = n>IMPORT_MAX_THREADS ? IMPORT_MAX_THREADS+1 : (int)n;
+#endif
+  /* Leave one processor for the main thread, which does the inserts */
+  return nCpu - 1;
 }
 
 /*
-** Create a prepared statement using printf-style arguments for the SQL.
+** Return the number of bytes at the start of p->zBuf[] which hold whole
+** records, or 0 if the first record is not complete yet.
 **
-** This routine is could be marked "static".  But it is not always used,
-** depending on compile-time options.  By omitting the "static", we avoid
-** nuisance compiler warnings about "defined but not used".
-*/
-void shellPreparePrintf(
-  sqlite3 *db, 
-  int *pRc, 
-  sqlite3_stmt **ppStmt,
-  const char *zFmt, 
-  ...
-){
-  *ppStmt = 0;
-  if( *pRc==SQLITE_OK ){
-    va_list ap;
-    char *z;
-    va_start(ap, zFmt);
-    z = sqlite3_vmprintf(zFmt, ap);
-    va_end(ap);
-    if( z==0 ){
-      *pRc = SQLITE_NOMEM;
-    }else{
-      shellPrepare(db, pRc, z, ppStmt);
-      sqlite3_free(z);
-    }
+** Records end at row separators, except that CSV fields which begin with
+** a quote may contain row separators.  Such a field ends at a quote which
+** is not one of a pair of quotes and which is followed by a column or row
+** separator, or by a carriage return and a row separator, just as in
+** csv_read_one_field().  Only when the input holds quotes do fields need
+** to be traced from the start, and then memchr() does most of the work.
+*/
+static size_t import_find_cut(ImportCtx *p, int bAscii){
+  const char *z = p->zBuf;
+  size_t n = p->nBuf;
+  size_t i = 0;
+  size_t iCut = 0;
+  int cSep = p->cColSep;
+  int rSep = p->cRowSep;
+  if( bAscii || memchr(z, '"', n)==0 ){
+    while( n>0 && z[n-1]!=rSep ) n--;
+    return n;
   }
-}
-
-/* Finalize the prepared statement created using shellPreparePrintf().
-**
-** This routine is could be marked "static".  But it is not always used,
-** depending on compile-time options.  By omitting the "static", we avoid
-** nuisance compiler warnings about "defined but not used".
-*/
-void shellFinalize(
-  int *pRc, 
-  sqlite3_stmt *pStmt
-){
-  if( pStmt ){
-    sqlite3 *db = sqlite3_db_handle(pStmt);
-    int rc = sqlite3_finalize(pStmt);
-    if( *pRc==SQLITE_OK ){
-      if( rc!=SQLITE_OK ){
-        raw_printf(stderr, "SQL error: %s\n", sqlite3_errmsg(db));
+  while( i<n ){
+    if( z[i]=='"' ){
+      size_t j = i+1;
+      while( 1 ){
+        const char *zQuote = memchr(z+j, '"', n-j);
+        size_t q;
+        if( zQuote==0 ) return iCut;
+        q = zQuote - z;
+        if( q+2>=n ) return iCut;
+        if( z[q+1]=='"' ){
+          j = q+2;
+        }else if( z[q+1]==cSep ){
+          i = q+2;
+          break;
+        }else if( z[q+1]==rSep ){
+          i = iCut = q+2;
+          break;
+        }else if( z[q+1]=='\r' && z[q+2]==rSep ){
+          i = iCut = q+3;
+          break;
+        }else{
+          j = q+1;
+        }
       }
-      *pRc = rc;
+    }else{
+      size_t iEnd = import_find_separator(p, i);
+      if( iEnd>=n ) return iCut;
+      i = iEnd+1;
+      if( z[iEnd]==rSep ) iCut = i;
+    }
+  }
+  return iCut;
+}
+
+/*
+** The reader thread of a parallel .import.  Read the input, cut it into
+** chunks of whole records, and queue them to be parsed.
+*/
+static void *import_reader_main(void *pArg){
+  ImportPipeline *pPipe = (ImportPipeline*)pArg;
+  ImportCtx *p = pPipe->pCtx;
+  int nLine = p->nLine;
+  int bMore = 1;
+  if( p->iBuf>0 ){
+    /* Discard any text parsed already */
+    p->nBuf -= p->iBuf;
+    memmove(p->zBuf, p->zBuf+p->iBuf, p->nBuf);
+    p->iBuf = p->iRow = 0;
+  }
+  while( bMore ){
+    ImportChunk *pChunk;
+    size_t nCut;
+    bMore = import_fill(p);
+    if( seenInterrupt ) break;
+    nCut = bMore ? import_find_cut(p, pPipe->bAscii) : p->nBuf;
+    if( nCut==0 ) continue;
+    pChunk = sqlite3_malloc64(sizeof(*pChunk));
+    if( pChunk==0 ) shell_out_of_memory();
+    memset(pChunk, 0, sizeof(*pChunk));
+    pChunk->zBuf = p->zBuf;
+    pChunk->nBuf = nCut;
+    pChunk->nLine = nLine;
+    nLine += import_count_char(p->zBuf, nCut, p->cRowSep);
+
+    /* The chunk keeps the buffer.  The rest of the input moves to a new
+    ** buffer, which is normally short of only part of one record. */
+    p->nBuf -= nCut;
+    p->nAlloc = p->nBuf + IMPORT_BLOCK_SIZE + 1;
+    p->zBuf = sqlite3_malloc64(p->nAlloc);
+    if( p->zBuf==0 ) shell_out_of_memory();
+    memcpy(p->zBuf, pChunk->zBuf+nCut, p->nBuf);
+    p->iBuf = p->iRow = 0;
+    p->bRowSep = 0;
+
+    pthread_mutex_lock(&pPipe->mutex);
+    while( pPipe->nInFlight>=pPipe->nMaxInFlight && !pPipe->bAbort ){
+      pthread_cond_wait(&pPipe->cond, &pPipe->mutex);
+    }
+    if( pPipe->bAbort ){
+      pthread_mutex_unlock(&pPipe->mutex);
+      import_chunk_free(pChunk);
+      break;
     }
+    pChunk->iSeq = pPipe->nChunk++;
+    pPipe->nInFlight++;
+    if( pPipe->pTodoLast ){
+      pPipe->pTodoLast->pNext = pChunk;
+    }else{
+      pPipe->pTodo = pChunk;
+    }
+    pPipe->pTodoLast = pChunk;
+    pthread_cond_broadcast(&pPipe->cond);
+    pthread_mutex_unlock(&pPipe->mutex);
   }
+  pthread_mutex_lock(&pPipe->mutex);
+  pPipe->bEof = 1;
+  pthread_cond_broadcast(&pPipe->cond);
+  pthread_mutex_unlock(&pPipe->mutex);
+  return 0;
 }
 
-/* Reset the prepared statement created using shellPreparePrintf().
-**
-** This routine is could be marked "static".  But it is not always used,
-** depending on compile-time options.  By omitting the "static", we avoid
-** nuisance compiler warnings about "defined but not used".
+/*
+** Parse the records of pChunk, using p, an ImportCtx private to the
+** calling thread, and save their fields and any warnings in pChunk.
 */
-void shellReset(
-  int *pRc, 
-  sqlite3_stmt *pStmt
+static void import_parse_chunk(
+  ImportPipeline *pPipe,
+  ImportCtx *p,
+  ImportChunk *pChunk
 ){
-  int rc = sqlite3_reset(pStmt);
-  if( *pRc==SQLITE_OK ){
-    if( rc!=SQLITE_OK ){
-      sqlite3 *db = sqlite3_db_handle(pStmt);
-      raw_printf(stderr, "SQL error: %s\n", sqlite3_errmsg(db));
+  int nCol = pPipe->nCol;
+  p->zBuf = pChunk->zBuf;
+  p->nBuf = pChunk->nBuf;
+  p->nAlloc = pChunk->nBuf + 1;
+  p->iBuf = p->iRow = 0;
+  p->bRowSep = 0;
+  p->bEof = 1;
+  p->nLine = pChunk->nLine;
+  do{
+    int startLine = p->nLine;
+    int bInsert = import_next_record(p, pPipe->xRead, nCol, pPipe->bAscii);
+    if( bInsert || p->zWarnings ){
+      import_save_record(pChunk, p, startLine, bInsert, nCol, 0);
     }
-    *pRc = rc;
-  }
+  }while( p->cTerm!=EOF );
 }
-#endif /* !defined SQLITE_OMIT_VIRTUALTABLE */
-
-#if !defined(SQLITE_OMIT_VIRTUALTABLE) && defined(SQLITE_HAVE_ZLIB)
-/******************************************************************************
-** The ".archive" or ".ar" command.
-*/
-/*
-** Structure representing a single ".ar" command.
-*/
-typedef struct ArCommand ArCommand;
-struct ArCommand {
-  u8 eCmd;                        /* An AR_CMD_* value */
-  u8 bVerbose;                    /* True if --verbose */
-  u8 bZip;                        /* True if the archive is a ZIP */
-  u8 bDryRun;                     /* True if --dry-run */
-  u8 bAppend;                     /* True if --append */
-  u8 fromCmdLine;                 /* Run from -A instead of .archive */
-  int nArg;                       /* Number of command arguments */
-  char *zSrcTable;                /* "sqlar", "zipfile($file)" or "zip" */
-  const char *zFile;              /* --file argument, or NULL */
-  const char *zDir;               /* --directory argument, or NULL */
-  char **azArg;                   /* Array of command arguments */
-  ShellState *p;                  /* Shell state */
-  sqlite3 *db;                    /* Database containing the archive */
-};
 
 /*
-** Print a usage message for the .ar command to stderr and return SQLITE_ERROR.
+** A worker thread of a parallel .import.  Parse chunks until there are
+** none left.
 */
-static int arUsage(FILE *f){
-  showHelp(f,"archive");
-  return SQLITE_ERROR;
+static void *import_worker_main(void *pArg){
+  ImportPipeline *pPipe = (ImportPipeline*)pArg;
+  ImportCtx sCtx;
+  memset(&sCtx, 0, sizeof(sCtx));
+  sCtx.zFile = pPipe->pCtx->zFile;
+  sCtx.cColSep = pPipe->pCtx->cColSep;
+  sCtx.cRowSep = pPipe->pCtx->cRowSep;
+  sCtx.bNotFirst = 1;
+  sCtx.bDeferWarnings = 1;
+  while( 1 ){
+    ImportChunk *pChunk;
+    pthread_mutex_lock(&pPipe->mutex);
+    while( pPipe->pTodo==0 && !pPipe->bEof && !pPipe->bAbort ){
+      pthread_cond_wait(&pPipe->cond, &pPipe->mutex);
+    }
+    pChunk = pPipe->bAbort ? 0 : pPipe->pTodo;
+    if( pChunk ){
+      pPipe->pTodo = pChunk->pNext;
+      if( pPipe->pTodo==0 ) pPipe->pTodoLast = 0;
+    }
+    pthread_mutex_unlock(&pPipe->mutex);
+    if( pChunk==0 ) break;
+    import_parse_chunk(pPipe, &sCtx, pChunk);
+    pthread_mutex_lock(&pPipe->mutex);
+    pChunk->pNext = pPipe->pDone;
+    pPipe->pDone = pChunk;
+    pthread_cond_broadcast(&pPipe->cond);
+    pthread_mutex_unlock(&pPipe->mutex);
+  }
+  sCtx.zBuf = 0;        /* Owned by the chunks */
+  import_cleanup(&sCtx);
+  return 0;
 }
 
 /*
-** Print an error message for the .ar command to stderr and return 
-** SQLITE_ERROR.
-*/
-static int arErrorMsg(ArCommand *pAr, const char *zFmt, ...){
-  va_list ap;
-  char *z;
-  va_start(ap, zFmt);
-  z = sqlite3_vmprintf(zFmt, ap);
-  va_end(ap);
-  utf8_printf(stderr, "Error: %s\n", z);
-  if( pAr->fromCmdLine ){
-    utf8_printf(stderr, "Use \"-A\" for more help\n");
-  }else{
-    utf8_printf(stderr, "Use \".archive --help\" for more help\n");
+** Insert the remaining records of input p into pOut, with the input
+** parsed by nThread worker threads.
+**
+** Return 1 once all records have been inserted.  Return 0, without
+** having inserted anything, if the threads could not be started or the
+** separators are such that records can't be told apart without parsing
+** every field, in which case the caller must import the input itself.
+*/
+static int import_parallel(
+  ImportCtx *p,                             /* The input */
+  char *(SQLITE_CDECL *xRead)(ImportCtx*),  /* Func to read one value */
+  int bAscii,                               /* True for ASCII delimited */
+  ImportOutput *pOut,                       /* Where the records go */
+  int nThread                               /* Number of worker threads */
+){
+  ImportPipeline sPipe;
+  pthread_t reader;
+  pthread_t *aWorker;
+  int nWorker;
+  int iNext = 0;
+  int i;
+  if( sqlite3_threadsafe()==0
+   || p->cColSep==p->cRowSep
+   || (!bAscii && (p->cColSep=='"' || p->cColSep=='\r'
+                   || p->cRowSep=='"' || p->cRowSep=='\r'))
+  ){
+    return 0;
   }
-  sqlite3_free(z);
-  return SQLITE_ERROR;
+  aWorker = sqlite3_malloc64(nThread*sizeof(aWorker[0]));
+  if( aWorker==0 ) shell_out_of_memory();
+  if( !bAscii && p->bNotFirst==0 ) import_skip_bom(p);
+  memset(&sPipe, 0, sizeof(sPipe));
+  sPipe.pCtx = p;
+  sPipe.xRead = xRead;
+  sPipe.nCol = pOut->nCol;
+  sPipe.bAscii = bAscii;
+  sPipe.nMaxInFlight = nThread*2 + 2;
+  pthread_mutex_init(&sPipe.mutex, 0);
+  pthread_cond_init(&sPipe.cond, 0);
+  for(nWorker=0; nWorker<nThread; nWorker++){
+    if( pthread_create(&aWorker[nWorker], 0, import_worker_main, &sPipe) ){
+      break;
+    }
+  }
+  if( nWorker==0 || pthread_create(&reader, 0, import_reader_main, &sPipe) ){
+    pthread_mutex_lock(&sPipe.mutex);
+    sPipe.bAbort = 1;
+    pthread_cond_broadcast(&sPipe.cond);
+    pthread_mutex_unlock(&sPipe.mutex);
+    for(i=0; i<nWorker; i++) pthread_join(aWorker[i], 0);
+    pthread_cond_destroy(&sPipe.cond);
+    pthread_mutex_destroy(&sPipe.mutex);
+    sqlite3_free(aWorker);
+    return 0;
+  }
+
+  /* Insert the records of each chunk, in the order they were read */
+  while( !sPipe.bAbort ){
+    ImportChunk *pChunk = 0;
+    ImportChunk **pp;
+    pthread_mutex_lock(&sPipe.mutex);
+    while( 1 ){
+      for(pp=&sPipe.pDone; *pp && (*pp)->iSeq!=iNext; pp=&(*pp)->pNext){}
+      if( *pp ){
+        pChunk = *pp;
+        *pp = pChunk->pNext;
+        break;
+      }
+      if( sPipe.bEof && iNext>=sPipe.nChunk ) break;
+      pthread_cond_wait(&sPipe.cond, &sPipe.mutex);
+    }
+    pthread_mutex_unlock(&sPipe.mutex);
+    if( pChunk==0 ) break;
+    import_insert_chunk(pOut, pChunk);
+    pOut->nByte += pChunk->nBuf;
+    import_chunk_free(pChunk);
+    iNext++;
+    pthread_mutex_lock(&sPipe.mutex);
+    sPipe.nInFlight--;
+    if( seenInterrupt ) sPipe.bAbort = 1;
+    pthread_cond_broadcast(&sPipe.cond);
+    pthread_mutex_unlock(&sPipe.mutex);
+  }
+
+  pthread_join(reader, 0);
+  for(i=0; i<nWorker; i++) pthread_join(aWorker[i], 0);
+  while( sPipe.pTodo ){
+    ImportChunk *pChunk = sPipe.pTodo;
+    sPipe.pTodo = pChunk->pNext;
+    import_chunk_free(pChunk);
+  }
+  while( sPipe.pDone ){
+    ImportChunk *pChunk = sPipe.pDone;
+    sPipe.pDone = pChunk->pNext;
+    import_chunk_free(pChunk);
+  }
+  pthread_cond_destroy(&sPipe.cond);
+  pthread_mutex_destroy(&sPipe.mutex);
+  sqlite3_free(aWorker);
+  return 1;
 }
+#endif /* SHELL_USE_PTHREADS */
 
 /*
-** Values for ArCommand.eCmd.
+** Try to transfer data for table zTable.  If an error is seen while
+** moving forward, try to go backwards.  The backwards movement won't
+** work for WITHOUT ROWID tables.
 */
-#define AR_CMD_CREATE       1
-#define AR_CMD_UPDATE       2
-#define AR_CMD_INSERT       3
-#define AR_CMD_EXTRACT      4
-#define AR_CMD_LIST         5
-#define AR_CMD_HELP         6
-
-/*
-** Other (non-command) switches.
-*/
-#define AR_SWITCH_VERBOSE     7
-#define AR_SWITCH_FILE        8
-#define AR_SWITCH_DIRECTORY   9
-#define AR_SWITCH_APPEND     10
-#define AR_SWITCH_DRYRUN     11
+static void tryToCloneData(
+  ShellState *p,
+  sqlite3 *newDb,
+  const char *zTable
+){
+  sqlite3_stmt *pQuery = 0;
+  sqlite3_stmt *pInsert = 0;
+  char *zQuery = 0;
+  char *zInsert = 0;
+  int rc;
+  int i, j, n;
+  int nTable = strlen30(zTable);
+  int k = 0;
+  int cnt = 0;
+  const int spinRate = 10000;
 
-static int arProcessSwitch(ArCommand *pAr, int eSwitch, const char *zArg){
-  switch( eSwitch ){
-    case AR_CMD_CREATE:
-    case AR_CMD_EXTRACT:
-    case AR_CMD_LIST:
-    case AR_CMD_UPDATE:
-    case AR_CMD_INSERT:
-    case AR_CMD_HELP:
-      if( pAr->eCmd ){
-        return arErrorMsg(pAr, "multiple command options");
+  zQuery = sqlite3_mprintf("SELECT * FROM \"%w\"", zTable);
+  rc = sqlite3_prepare_v2(p->db, zQuery, -1, &pQuery, 0);
+  if( rc ){
+    utf8_printf(stderr, "Error %d: %s on [%s]\n",
+            sqlite3_extended_errcode(p->db), sqlite3_errmsg(p->db),
+            zQuery);
+    goto end_data_xfer;
+  }
+  n = sqlite3_column_count(pQuery);
+  zInsert = sqlite3_malloc64(200 + nTable + n*3);
+  if( zInsert==0 ) shell_out_of_memory();
+  sqlite3_snprintf(200+nTable,zInsert,
+                   "INSERT OR IGNORE INTO \"%s\" VALUES(?", zTable);
+  i = strlen30(zInsert);
+  for(j=1; j<n; j++){
+    memcpy(zInsert+i, ",?", 2);
+    i += 2;
+  }
+  memcpy(zInsert+i, ");", 3);
+  rc = sqlite3_prepare_v2(newDb, zInsert, -1, &pInsert, 0);
+  if( rc ){
+    utf8_printf(stderr, "Error %d: %s on [%s]\n",
+            sqlite3_extended_errcode(newDb), sqlite3_errmsg(newDb),
+            zQuery);
+    goto end_data_xfer;
+  }
+  for(k=0; k<2; k++){
+    while( (rc = sqlite3_step(pQuery))==SQLITE_ROW ){
+      for(i=0; i<n; i++){
+        switch( sqlite3_column_type(pQuery, i) ){
+          case SQLITE_NULL: {
+            sqlite3_bind_null(pInsert, i+1);
+            break;
+          }
+          case SQLITE_INTEGER: {
+            sqlite3_bind_int64(pInsert, i+1, sqlite3_column_int64(pQuery,i));
+            break;
+          }
+          case SQLITE_FLOAT: {
+            sqlite3_bind_double(pInsert, i+1, sqlite3_column_double(pQuery,i));
+            break;
+          }
+          case SQLITE_TEXT: {
+            sqlite3_bind_text(pInsert, i+1,
+                             (const char*)sqlite3_column_text(pQuery,i),
+                             -1, SQLITE_STATIC);
+            break;
+          }
+          case SQLITE_BLOB: {
+            sqlite3_bind_blob(pInsert, i+1, sqlite3_column_blob(pQuery,i),
+                                            sqlite3_column_bytes(pQuery,i),
+                                            SQLITE_STATIC);
+            break;
+          }
+        }
+      } /* End for */
+      rc = sqlite3_step(pInsert);
+      if( rc!=SQLITE_OK && rc!=SQLITE_ROW && rc!=SQLITE_DONE ){
+        utf8_printf(stderr, "Error %d: %s\n", sqlite3_extended_errcode(newDb),
+                        sqlite3_errmsg(newDb));
       }
-      pAr->eCmd = eSwitch;
-      break;
-
-    case AR_SWITCH_DRYRUN:
-      pAr->bDryRun = 1;
-      break;
-    case AR_SWITCH_VERBOSE:
-      pAr->bVerbose = 1;
-      break;
-    case AR_SWITCH_APPEND:
-      pAr->bAppend = 1;
-      /* Fall thru into --file */
-    case AR_SWITCH_FILE:
-      pAr->zFile = zArg;
-      break;
-    case AR_SWITCH_DIRECTORY:
-      pAr->zDir = zArg;
+      sqlite3_reset(pInsert);
+      cnt++;
+      if( (cnt%spinRate)==0 ){
+        printf("%c\b", "|/-\\"[(cnt/spinRate)%4]);
+        fflush(stdout);
+      }
+    } /* End while */
+    if( rc==SQLITE_DONE ) break;
+    sqlite3_finalize(pQuery);
+    sqlite3_free(zQuery);
+    zQuery = sqlite3_mprintf("SELECT * FROM \"%w\" ORDER BY rowid DESC;",
+                             zTable);
+    rc = sqlite3_prepare_v2(p->db, zQuery, -1, &pQuery, 0);
+    if( rc ){
+      utf8_printf(stderr, "Warning: cannot step \"%s\" backwards", zTable);
       break;
-  }
+    }
+  } /* End for(k=0...) */
 
-  return SQLITE_OK;
+end_data_xfer:
+  sqlite3_finalize(pQuery);
+  sqlite3_finalize(pInsert);
+  sqlite3_free(zQuery);
+  sqlite3_free(zInsert);
 }
 
+
 /*
-** Parse the command line for an ".ar" command. The results are written into
-** structure (*pAr). SQLITE_OK is returned if the command line is parsed
-** successfully, otherwise an error message is written to stderr and 
-** SQLITE_ERROR returned.
+** Try to transfer all rows of the schema that match zWhere.  For
+** each row, invoke xForEach() on the object defined by that row.
+** If an error is encountered while moving forward through the
+** sqlite_master table, try again moving backwards.
 */
-static int arParseCommand(
-  char **azArg,                   /* Array of arguments passed to dot command */
-  int nArg,                       /* Number of entries in azArg[] */
-  ArCommand *pAr                  /* Populate this object */
+static void tryToCloneSchema(
+  ShellState *p,
+  sqlite3 *newDb,
+  const char *zWhere,
+  void (*xForEach)(ShellState*,sqlite3*,const char*)
 ){
-  struct ArSwitch {
-    const char *zLong;
-    char cShort;
-    u8 eSwitch;
-    u8 bArg;
-  } aSwitch[] = {
-    { "create",    'c', AR_CMD_CREATE,       0 },
-    { "extract",   'x', AR_CMD_EXTRACT,      0 },
-    { "insert",    'i', AR_CMD_INSERT,       0 },
-    { "list",      't', AR_CMD_LIST,         0 },
-    { "update",    'u', AR_CMD_UPDATE,       0 },
-    { "help",      'h', AR_CMD_HELP,         0 },
-    { "verbose",   'v', AR_SWITCH_VERBOSE,   0 },
-    { "file",      'f', AR_SWITCH_FILE,      1 },
-    { "append",    'a', AR_SWITCH_APPEND,    1 },
-    { "directory", 'C', AR_SWITCH_DIRECTORY, 1 },
-    { "dryrun",    'n', AR_SWITCH_DRYRUN,    0 },
-  };
-  int nSwitch = sizeof(aSwitch) / sizeof(struct ArSwitch);
-  struct ArSwitch *pEnd = &aSwitch[nSwitch];
+  sqlite3_stmt *pQuery = 0;
+  char *zQuery = 0;
+  int rc;
+  const unsigned char *zName;
+  const unsigned char *zSql;
+  char *zErrMsg = 0;
 
-  if( nArg<=1 ){
-    utf8_printf(stderr, "Wrong number of arguments.  Usage:\n");
-    return arUsage(stderr);
-  }else{
-    char *z = azArg[1];
-    if( z[0]!='-' ){
-      /* Traditional style [tar] invocation */
-      int i;
-      int iArg = 2;
-      for(i=0; z[i]; i++){
-        const char *zArg = 0;
-        struct ArSwitch *pOpt;
-        for(pOpt=&aSwitch[0]; pOpt<pEnd; pOpt++){
-          if( z[i]==pOpt->cShort ) break;
-        }
-        if( pOpt==pEnd ){
-          return arErrorMsg(pAr, "unrecognized option: %c", z[i]);
-        }
-        if( pOpt->bArg ){
-          if( iArg>=nArg ){
-            return arErrorMsg(pAr, "option requires an argument: %c",z[i]);
-          }
-          zArg = azArg[iArg++];
-        }
-        if( arProcessSwitch(pAr, pOpt->eSwitch, zArg) ) return SQLITE_ERROR;
+  zQuery = sqlite3_mprintf("SELECT name, sql FROM sqlite_master"
+                           " WHERE %s", zWhere);
+  rc = sqlite3_prepare_v2(p->db, zQuery, -1, &pQuery, 0);
+  if( rc ){
+    utf8_printf(stderr, "Error: (%d) %s on [%s]\n",
+                    sqlite3_extended_errcode(p->db), sqlite3_errmsg(p->db),
+                    zQuery);
+    goto end_schema_xfer;
+  }
+  while( (rc = sqlite3_step(pQuery))==SQLITE_ROW ){
+    zName = sqlite3_column_text(pQuery, 0);
+    zSql = sqlite3_column_text(pQuery, 1);
+    printf("%s... ", zName); fflush(stdout);
+    sqlite3_exec(newDb, (const char*)zSql, 0, 0, &zErrMsg);
+    if( zErrMsg ){
+      utf8_printf(stderr, "Error: %s\nSQL: [%s]\n", zErrMsg, zSql);
+      sqlite3_free(zErrMsg);
+      zErrMsg = 0;
+    }
+    if( xForEach ){
+      xForEach(p, newDb, (const char*)zName);
+    }
+    printf("done\n");
+  }
+  if( rc!=SQLITE_DONE ){
+    sqlite3_finalize(pQuery);
+    sqlite3_free(zQuery);
+    zQuery = sqlite3_mprintf("SELECT name, sql FROM sqlite_master"
+                             " WHERE %s ORDER BY rowid DESC", zWhere);
+    rc = sqlite3_prepare_v2(p->db, zQuery, -1, &pQuery, 0);
+    if( rc ){
+      utf8_printf(stderr, "Error: (%d) %s on [%s]\n",
+                      sqlite3_extended_errcode(p->db), sqlite3_errmsg(p->db),
+                      zQuery);
+      goto end_schema_xfer;
+    }
+    while( (rc = sqlite3_step(pQuery))==SQLITE_ROW ){
+      zName = sqlite3_column_text(pQuery, 0);
+      zSql = sqlite3_column_text(pQuery, 1);
+      printf("%s... ", zName); fflush(stdout);
+      sqlite3_exec(newDb, (const char*)zSql, 0, 0, &zErrMsg);
+      if( zErrMsg ){
+        utf8_printf(stderr, "Error: %s\nSQL: [%s]\n", zErrMsg, zSql);
+        sqlite3_free(zErrMsg);
+        zErrMsg = 0;
       }
-      pAr->nArg = nArg-iArg;
-      if( pAr->nArg>0 ){
-        pAr->azArg = &azArg[iArg];
-      }
-    }else{
-      /* Non-traditional invocation */
-      int iArg;
-      for(iArg=1; iArg<nArg; iArg++){
-        int n;
-        z = azArg[iArg];
-        if( z[0]!='-' ){
-          /* All remaining command line words are command arguments. */
-          pAr->azArg = &azArg[iArg];
-          pAr->nArg = nArg-iArg;
-          break;
-        }
-        n = strlen30(z);
-
-        if( z[1]!='-' ){
-          int i;
-          /* One or more short options */
-          for(i=1; i<n; i++){
-            const char *zArg = 0;
-            struct ArSwitch *pOpt;
-            for(pOpt=&aSwitch[0]; pOpt<pEnd; pOpt++){
-              if( z[i]==pOpt->cShort ) break;
-            }
-            if( pOpt==pEnd ){
-              return arErrorMsg(pAr, "unrecognized option: %c", z[i]);
-            }
-            if( pOpt->bArg ){
-              if( i<(n-1) ){
-                zArg = &z[i+1];
-                i = n;
-              }else{
-                if( iArg>=(nArg-1) ){
-                  return arErrorMsg(pAr, "option requires an argument: %c",
-                                    z[i]);
-                }
-                zArg = azArg[++iArg];
-              }
-            }
-            if( arProcessSwitch(pAr, pOpt->eSwitch, zArg) ) return SQLITE_ERROR;
-          }
-        }else if( z[2]=='\0' ){
-          /* A -- option, indicating that all remaining command line words
-          ** are command arguments.  */
-          pAr->azArg = &azArg[iArg+1];
-          pAr->nArg = nArg-iArg-1;
-          break;
-        }else{
-          /* A long option */
-          const char *zArg = 0;             /* Argument for option, if any */
-          struct ArSwitch *pMatch = 0;      /* Matching option */
-          struct ArSwitch *pOpt;            /* Iterator */
-          for(pOpt=&aSwitch[0]; pOpt<pEnd; pOpt++){
-            const char *zLong = pOpt->zLong;
-            if( (n-2)<=strlen30(zLong) && 0==memcmp(&z[2], zLong, n-2) ){
-              if( pMatch ){
-                return arErrorMsg(pAr, "ambiguous option: %s",z);
-              }else{
-                pMatch = pOpt;
-              }
-            }
-          }
-
-          if( pMatch==0 ){
-            return arErrorMsg(pAr, "unrecognized option: %s", z);
-          }
-          if( pMatch->bArg ){
-            if( iArg>=(nArg-1) ){
-              return arErrorMsg(pAr, "option requires an argument: %s", z);
-            }
-            zArg = azArg[++iArg];
-          }
-          if( arProcessSwitch(pAr, pMatch->eSwitch, zArg) ) return SQLITE_ERROR;
-        }
+      if( xForEach ){
+        xForEach(p, newDb, (const char*)zName);
       }
+      printf("done\n");
     }
   }
-
-  return SQLITE_OK;
+end_schema_xfer:
+  sqlite3_finalize(pQuery);
+  sqlite3_free(zQuery);
 }
 
+static int clone_fast(ShellState *p, const char *zNewDb, int nThread);
+
 /*
-** This function assumes that all arguments within the ArCommand.azArg[]
-** array refer to archive members, as for the --extract or --list commands. 
-** It checks that each of them are present. If any specified file is not
-** present in the archive, an error is printed to stderr and an error
-** code returned. Otherwise, if all specified arguments are present in
-** the archive, SQLITE_OK is returned.
+** Open a new database file named "zNewDb".  Try to recover as much information
+** as possible out of the main database (which might be corrupt) and write it
+** into zNewDb.
 **
-** This function strips any trailing '/' characters from each argument.
-** This is consistent with the way the [tar] command seems to work on
-** Linux.
+** Whole tables are copied at once, on nThread threads if nThread>0, unless
+** that fails, in which case rows are copied one at a time, skipping any
+** which can't be read.
 */
-static int arCheckEntries(ArCommand *pAr){
-  int rc = SQLITE_OK;
-  if( pAr->nArg ){
-    int i, j;
-    sqlite3_stmt *pTest = 0;
-
-    shellPreparePrintf(pAr->db, &rc, &pTest,
-        "SELECT name FROM %s WHERE name=$name", 
-        pAr->zSrcTable
-    );
-    j = sqlite3_bind_parameter_index(pTest, "$name");
-    for(i=0; i<pAr->nArg && rc==SQLITE_OK; i++){
-      char *z = pAr->azArg[i];
-      int n = strlen30(z);
-      int bOk = 0;
-      while( n>0 && z[n-1]=='/' ) n--;
-      z[n] = '\0';
-      sqlite3_bind_text(pTest, j, z, -1, SQLITE_STATIC);
-      if( SQLITE_ROW==sqlite3_step(pTest) ){
-        bOk = 1;
-      }
-      shellReset(&rc, pTest);
-      if( rc==SQLITE_OK && bOk==0 ){
-        utf8_printf(stderr, "not found in archive: %s\n", z);
-        rc = SQLITE_ERROR;
-      }
-    }
-    shellFinalize(&rc, pTest);
+static void tryToClone(ShellState *p, const char *zNewDb, int nThread){
+  int rc;
+  sqlite3 *newDb = 0;
+  if( access(zNewDb,0)==0 ){
+    utf8_printf(stderr, "File \"%s\" already exists.\n", zNewDb);
+    return;
   }
-  return rc;
+  if( clone_fast(p, zNewDb, nThread)==0 || seenInterrupt ) return;
+  raw_printf(stderr, "Copying row by row instead\n");
+  rc = sqlite3_open(zNewDb, &newDb);
+  if( rc ){
+    utf8_printf(stderr, "Cannot create output database: %s\n",
+            sqlite3_errmsg(newDb));
+  }else{
+    sqlite3_exec(p->db, "PRAGMA writable_schema=ON;", 0, 0, 0);
+    sqlite3_exec(newDb, "BEGIN EXCLUSIVE;", 0, 0, 0);
+    tryToCloneSchema(p, newDb, "type='table'", tryToCloneData);
+    tryToCloneSchema(p, newDb, "type!='table'", 0);
+    sqlite3_exec(newDb, "COMMIT;", 0, 0, 0);
+    sqlite3_exec(p->db, "PRAGMA writable_schema=OFF;", 0, 0, 0);
+  }
+  close_db(newDb);
 }
 
 /*
-** Format a WHERE clause that can be used against the "sqlar" table to
-** identify all archive members that match the command arguments held
-** in (*pAr). Leave this WHERE clause in (*pzWhere) before returning.
-** The caller is responsible for eventually calling sqlite3_free() on
-** any non-NULL (*pzWhere) value.
+** Change the output file back to stdout.
+**
+** If the p->doXdgOpen flag is set, that means the output was being
+** redirected to a temporary file named by p->zTempFile.  In that case,
+** launch start/open/xdg-open on that temporary file.
 */
-static void arWhereClause(
-  int *pRc, 
-  ArCommand *pAr, 
-  char **pzWhere                  /* OUT: New WHERE clause */
-){
-  char *zWhere = 0;
-  if( *pRc==SQLITE_OK ){
-    if( pAr->nArg==0 ){
-      zWhere = sqlite3_mprintf("1");
-    }else{
-      int i;
-      const char *zSep = "";
-      for(i=0; i<pAr->nArg; i++){
-        const char *z = pAr->azArg[i];
-        zWhere = sqlite3_mprintf(
-          "%z%s name = '%q' OR substr(name,1,%d) = '%q/'", 
-          zWhere, zSep, z, strlen30(z)+1, z
-        );
-        if( zWhere==0 ){
-          *pRc = SQLITE_NOMEM;
-          break;
-        }
-        zSep = " OR ";
+static void output_reset(ShellState *p){
+  if( p->outfile[0]=='|' ){
+#ifndef SQLITE_OMIT_POPEN
+    pclose(p->out);
+#endif
+  }else{
+    output_file_close(p->out);
+#ifndef SQLITE_NOHAVE_SYSTEM
+    if( p->doXdgOpen ){
+      const char *zXdgOpenCmd =
+#if defined(_WIN32)
+      "start";
+#elif defined(__APPLE__)
+      "open";
+#else
+      "xdg-open";
+#endif
+      char *zCmd;
+      zCmd = sqlite3_mprintf("%s %s", zXdgOpenCmd, p->zTempFile);
+      if( system(zCmd) ){
+        utf8_printf(stderr, "Failed: [%s]\n", zCmd);
       }
+      sqlite3_free(zCmd);
+      outputModePop(p);
+      p->doXdgOpen = 0;
+      sqlite3_sleep(100);
     }
+#endif /* !defined(SQLITE_NOHAVE_SYSTEM) */
   }
-  *pzWhere = zWhere;
+  p->outfile[0] = 0;
+  p->out = stdout;
 }
 
 /*
-** Implementation of .ar "lisT" command. 
+** Run an SQL command and return the single integer result.
 */
-static int arListCommand(ArCommand *pAr){
-  const char *zSql = "SELECT %s FROM %s WHERE %s"; 
-  const char *azCols[] = {
-    "name",
-    "lsmode(mode), sz, datetime(mtime, 'unixepoch'), name"
-  };
-
-  char *zWhere = 0;
-  sqlite3_stmt *pSql = 0;
-  int rc;
-
-  rc = arCheckEntries(pAr);
-  arWhereClause(&rc, pAr, &zWhere);
-
-  shellPreparePrintf(pAr->db, &rc, &pSql, zSql, azCols[pAr->bVerbose],
-                     pAr->zSrcTable, zWhere);
-  if( pAr->bDryRun ){
-    utf8_printf(pAr->p->out, "%s\n", sqlite3_sql(pSql));
-  }else{
-    while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pSql) ){
-      if( pAr->bVerbose ){
-        utf8_printf(pAr->p->out, "%s % 10d  %s  %s\n",
-            sqlite3_column_text(pSql, 0),
-            sqlite3_column_int(pSql, 1), 
-            sqlite3_column_text(pSql, 2),
-            sqlite3_column_text(pSql, 3)
-        );
-      }else{
-        utf8_printf(pAr->p->out, "%s\n", sqlite3_column_text(pSql, 0));
-      }
-    }
+static int db_int(ShellState *p, const char *zSql){
+  sqlite3_stmt *pStmt;
+  int res = 0;
+  sqlite3_prepare_v2(p->db, zSql, -1, &pStmt, 0);
+  if( pStmt && sqlite3_step(pStmt)==SQLITE_ROW ){
+    res = sqlite3_column_int(pStmt,0);
   }
-  shellFinalize(&rc, pSql);
-  sqlite3_free(zWhere);
-  return rc;
+  sqlite3_finalize(pStmt);
+  return res;
 }
 
+/*
+** Convert a 2-byte or 4-byte big-endian integer into a native integer
+*/
+static unsigned int get2byteInt(unsigned char *a){
+  return (a[0]<<8) + a[1];
+}
+static unsigned int get4byteInt(unsigned char *a){
+  return (a[0]<<24) + (a[1]<<16) + (a[2]<<8) + a[3];
+}
 
 /*
-** Implementation of .ar "eXtract" command. 
+** Implementation of the ".dbinfo" command.
+**
+** Return 1 on error, 2 to exit, and 0 otherwise.
 */
-static int arExtractCommand(ArCommand *pAr){
-  const char *zSql1 = 
-    "SELECT "
-    " ($dir || name),"
-    " writefile(($dir || name), %s, mode, mtime) "
-    "FROM %s WHERE (%s) AND (data IS NULL OR $dirOnly = 0)"
-    " AND name NOT GLOB '*..[/\\]*'";
-
-  const char *azExtraArg[] = { 
-    "sqlar_uncompress(data, sz)",
-    "data"
+static int shell_dbinfo_command(ShellState *p, int nArg, char **azArg){
+  static const struct { const char *zName; int ofst; } aField[] = {
+     { "file change counter:",  24  },
+     { "database page count:",  28  },
+     { "freelist page count:",  36  },
+     { "schema cookie:",        40  },
+     { "schema format:",        44  },
+     { "default cache size:",   48  },
+     { "autovacuum top root:",  52  },
+     { "incremental vacuum:",   64  },
+     { "text encoding:",        56  },
+     { "user version:",         60  },
+     { "application id:",       68  },
+     { "software version:",     96  },
   };
-
-  sqlite3_stmt *pSql = 0;
-  int rc = SQLITE_OK;
-  char *zDir = 0;
-  char *zWhere = 0;
-  int i, j;
-
-  /* If arguments are specified, check that they actually exist within
-  ** the archive before proceeding. And formulate a WHERE clause to
-  ** match them.  */
-  rc = arCheckEntries(pAr);
-  arWhereClause(&rc, pAr, &zWhere);
-
-  if( rc==SQLITE_OK ){
-    if( pAr->zDir ){
-      zDir = sqlite3_mprintf("%s/", pAr->zDir);
+  static const struct { const char *zName; const char *zSql; } aQuery[] = {
+     { "number of tables:",
+       "SELECT count(*) FROM %s WHERE type='table'" },
+     { "number of indexes:",
+       "SELECT count(*) FROM %s WHERE type='index'" },
+     { "number of triggers:",
+       "SELECT count(*) FROM %s WHERE type='trigger'" },
+     { "number of views:",
+       "SELECT count(*) FROM %s WHERE type='view'" },
+     { "schema size:",
+       "SELECT total(length(sql)) FROM %s" },
+  };
+  int i, rc;
+  unsigned iDataVersion;
+  char *zSchemaTab;
+  char *zDb = nArg>=2 ? azArg[1] : "main";
+  sqlite3_stmt *pStmt = 0;
+  unsigned char aHdr[100];
+  open_db(p, 0);
+  if( p->db==0 ) return 1;
+  rc = sqlite3_prepare_v2(p->db,
+             "SELECT data FROM sqlite_dbpage(?1) WHERE pgno=1",
+             -1, &pStmt, 0);
+  if( rc ){
+    if( !sqlite3_compileoption_used("ENABLE_DBPAGE_VTAB") ){
+      utf8_printf(stderr, "the \".dbinfo\" command requires the "
+                          "-DSQLITE_ENABLE_DBPAGE_VTAB compile-time options\n");
     }else{
-      zDir = sqlite3_mprintf("");
+      utf8_printf(stderr, "error: %s\n", sqlite3_errmsg(p->db));
     }
-    if( zDir==0 ) rc = SQLITE_NOMEM;
+    sqlite3_finalize(pStmt);
+    return 1;
   }
-
-  shellPreparePrintf(pAr->db, &rc, &pSql, zSql1, 
-      azExtraArg[pAr->bZip], pAr->zSrcTable, zWhere
-  );
-
-  if( rc==SQLITE_OK ){
-    j = sqlite3_bind_parameter_index(pSql, "$dir");
-    sqlite3_bind_text(pSql, j, zDir, -1, SQLITE_STATIC);
-
-    /* Run the SELECT statement twice. The first time, writefile() is called
-    ** for all archive members that should be extracted. The second time,
-    ** only for the directories. This is because the timestamps for
-    ** extracted directories must be reset after they are populated (as
-    ** populating them changes the timestamp).  */
-    for(i=0; i<2; i++){
-      j = sqlite3_bind_parameter_index(pSql, "$dirOnly");
-      sqlite3_bind_int(pSql, j, i);
-      if( pAr->bDryRun ){
-        utf8_printf(pAr->p->out, "%s\n", sqlite3_sql(pSql));
-      }else{
-        while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pSql) ){
-          if( i==0 && pAr->bVerbose ){
-            utf8_printf(pAr->p->out, "%s\n", sqlite3_column_text(pSql, 0));
-          }
-        }
+  sqlite3_bind_text(pStmt, 1, zDb, -1, SQLITE_STATIC);
+  if( sqlite3_step(pStmt)==SQLITE_ROW
+   && sqlite3_column_bytes(pStmt,0)>100
+  ){
+    memcpy(aHdr, sqlite3_column_blob(pStmt,0), 100);
+    sqlite3_finalize(pStmt);
+  }else{
+    raw_printf(stderr, "unable to read database header\n");
+    sqlite3_finalize(pStmt);
+    return 1;
+  }
+  i = get2byteInt(aHdr+16);
+  if( i==1 ) i = 65536;
+  utf8_printf(p->out, "%-20s %d\n", "database page size:", i);
+  utf8_printf(p->out, "%-20s %d\n", "write format:", aHdr[18]);
+  utf8_printf(p->out, "%-20s %d\n", "read format:", aHdr[19]);
+  utf8_printf(p->out, "%-20s %d\n", "reserved bytes:", aHdr[20]);
+  for(i=0; i<ArraySize(aField); i++){
+    int ofst = aField[i].ofst;
+    unsigned int val = get4byteInt(aHdr + ofst);
+    utf8_printf(p->out, "%-20s %u", aField[i].zName, val);
+    switch( ofst ){
+      case 56: {
+        if( val==1 ) raw_printf(p->out, " (utf8)");
+        if( val==2 ) raw_printf(p->out, " (utf16le)");
+        if( val==3 ) raw_printf(p->out, " (utf16be)");
       }
-      shellReset(&rc, pSql);
     }
-    shellFinalize(&rc, pSql);
+    raw_printf(p->out, "\n");
   }
-
-  sqlite3_free(zDir);
-  sqlite3_free(zWhere);
-  return rc;
+  if( zDb==0 ){
+    zSchemaTab = sqlite3_mprintf("main.sqlite_master");
+  }else if( strcmp(zDb,"temp")==0 ){
+    zSchemaTab = sqlite3_mprintf("%s", "sqlite_temp_master");
+  }else{
+    zSchemaTab = sqlite3_mprintf("\"%w\".sqlite_master", zDb);
+  }
+  for(i=0; i<ArraySize(aQuery); i++){
+    char *zSql = sqlite3_mprintf(aQuery[i].zSql, zSchemaTab);
+    int val = db_int(p, zSql);
+    sqlite3_free(zSql);
+    utf8_printf(p->out, "%-20s %d\n", aQuery[i].zName, val);
+  }
+  sqlite3_free(zSchemaTab);
+  sqlite3_file_control(p->db, zDb, SQLITE_FCNTL_DATA_VERSION, &iDataVersion);
+  utf8_printf(p->out, "%-20s %u\n", "data version", iDataVersion);
+  return 0;
 }
 
 /*
-** Run the SQL statement in zSql.  Or if doing a --dryrun, merely print it out.
+** Print the current sqlite3_errmsg() value to stderr and return 1.
 */
-static int arExecSql(ArCommand *pAr, const char *zSql){
-  int rc;
-  if( pAr->bDryRun ){
-    utf8_printf(pAr->p->out, "%s\n", zSql);
-    rc = SQLITE_OK;
-  }else{
-    char *zErr = 0;
-    rc = sqlite3_exec(pAr->db, zSql, 0, 0, &zErr);
-    if( zErr ){
-      utf8_printf(stdout, "ERROR: %s\n", zErr);
-      sqlite3_free(zErr);
-    }
-  }
-  return rc;
+static int shellDatabaseError(sqlite3 *db){
+  const char *zErr = sqlite3_errmsg(db);
+  utf8_printf(stderr, "Error: %s\n", zErr);
+  return 1;
 }
 
-
 /*
-** Implementation of .ar "create", "insert", and "update" commands.
+** Compare the pattern in zGlob[] against the text in z[].  Return TRUE
+** if they match and FALSE (0) if they do not match.
 **
-**     create    ->     Create a new SQL archive
-**     insert    ->     Insert or reinsert all files listed
-**     update    ->     Insert files that have changed or that were not
-**                      previously in the archive
+** Globbing rules:
 **
-** Create the "sqlar" table in the database if it does not already exist.
-** Then add each file in the azFile[] array to the archive. Directories
-** are added recursively. If argument bVerbose is non-zero, a message is
-** printed on stdout for each file archived.
+**      '*'       Matches any sequence of zero or more characters.
 **
-** The create command is the same as update, except that it drops
-** any existing "sqlar" table before beginning.  The "insert" command
-** always overwrites every file named on the command-line, where as
-** "update" only overwrites if the size or mtime or mode has changed.
+**      '?'       Matches exactly one character.
+**
+**     [...]      Matches one character from the enclosed list of
+**                characters.
+**
+**     [^...]     Matches one character not in the enclosed list.
+**
+**      '#'       Matches any sequence of one or more digits with an
+**                optional + or - sign in front
+**
+**      ' '       Any span of whitespace matches any other span of
+**                whitespace.
+**
+** Extra whitespace at the end of z[] is ignored.
 */
-static int arCreateOrUpdateCommand(
-  ArCommand *pAr,                 /* Command arguments and options */
-  int bUpdate,                    /* true for a --create. */
-  int bOnlyIfChanged              /* Only update if file has changed */
-){
-  const char *zCreate = 
-      "CREATE TABLE IF NOT EXISTS sqlar(\n"
-      "  name TEXT PRIMARY KEY,  -- name of the file\n"
-      "  mode INT,               -- access permissions\n"
-      "  mtime INT,              -- last modification time\n"
-      "  sz INT,                 -- original file size\n"
-      "  data BLOB               -- compressed content\n"
-      ")";
-  const char *zDrop = "DROP TABLE IF EXISTS sqlar";
-  const char *zInsertFmt[2] = {
-     "REPLACE INTO %s(name,mode,mtime,sz,data)\n"
-     "  SELECT\n"
-     "    %s,\n"
-     "    mode,\n"
-     "    mtime,\n"
-     "    CASE substr(lsmode(mode),1,1)\n"
-     "      WHEN '-' THEN length(data)\n"
-     "      WHEN 'd' THEN 0\n"
-     "      ELSE -1 END,\n"
-     "    sqlar_compress(data)\n"
-     "  FROM fsdir(%Q,%Q) AS disk\n"
-     "  WHERE lsmode(mode) NOT LIKE '?%%'%s;"
-     ,
-     "REPLACE INTO %s(name,mode,mtime,data)\n"
-     "  SELECT\n"
-     "    %s,\n"
-     "    mode,\n"
-     "    mtime,\n"
-     "    data\n"
-     "  FROM fsdir(%Q,%Q) AS disk\n"
-     "  WHERE lsmode(mode) NOT LIKE '?%%'%s;"
-  };
-  int i;                          /* For iterating through azFile[] */
-  int rc;                         /* Return code */
-  const char *zTab = 0;           /* SQL table into which to insert */
-  char *zSql;
-  char zTemp[50];
-  char *zExists = 0;
+static int testcase_glob(const char *zGlob, const char *z){
+  int c, c2;
+  int invert;
+  int seen;
 
-  arExecSql(pAr, "PRAGMA page_size=512");
-  rc = arExecSql(pAr, "SAVEPOINT ar;");
-  if( rc!=SQLITE_OK ) return rc;
-  zTemp[0] = 0; 
-  if( pAr->bZip ){
-    /* Initialize the zipfile virtual table, if necessary */
-    if( pAr->zFile ){
-      sqlite3_uint64 r;
-      sqlite3_randomness(sizeof(r),&r);
-      sqlite3_snprintf(sizeof(zTemp),zTemp,"zip%016llx",r);
-      zTab = zTemp;
-      zSql = sqlite3_mprintf(
-         "CREATE VIRTUAL TABLE temp.%s USING zipfile(%Q)",
-         zTab, pAr->zFile
-      );
-      rc = arExecSql(pAr, zSql);
-      sqlite3_free(zSql);
+  while( (c = (*(zGlob++)))!=0 ){
+    if( IsSpace(c) ){
+      if( !IsSpace(*z) ) return 0;
+      while( IsSpace(*zGlob) ) zGlob++;
+      while( IsSpace(*z) ) z++;
+    }else if( c=='*' ){
+      while( (c=(*(zGlob++))) == '*' || c=='?' ){
+        if( c=='?' && (*(z++))==0 ) return 0;
+      }
+      if( c==0 ){
+        return 1;
+      }else if( c=='[' ){
+        while( *z && testcase_glob(zGlob-1,z)==0 ){
+          z++;
+        }
+        return (*z)!=0;
+      }
+      while( (c2 = (*(z++)))!=0 ){
+        while( c2!=c ){
+          c2 = *(z++);
+          if( c2==0 ) return 0;
+        }
+        if( testcase_glob(zGlob,z) ) return 1;
+      }
+      return 0;
+    }else if( c=='?' ){
+      if( (*(z++))==0 ) return 0;
+    }else if( c=='[' ){
+      int prior_c = 0;
+      seen = 0;
+      invert = 0;
+      c = *(z++);
+      if( c==0 ) return 0;
+      c2 = *(zGlob++);
+      if( c2=='^' ){
+        invert = 1;
+        c2 = *(zGlob++);
+      }
+      if( c2==']' ){
+        if( c==']' ) seen = 1;
+        c2 = *(zGlob++);
+      }
+      while( c2 && c2!=']' ){
+        if( c2=='-' && zGlob[0]!=']' && zGlob[0]!=0 && prior_c>0 ){
+          c2 = *(zGlob++);
+          if( c>=prior_c && c<=c2 ) seen = 1;
+          prior_c = 0;
+        }else{
+          if( c==c2 ){
+            seen = 1;
+          }
+          prior_c = c2;
+        }
+        c2 = *(zGlob++);
+      }
+      if( c2==0 || (seen ^ invert)==0 ) return 0;
+    }else if( c=='#' ){
+      if( (z[0]=='-' || z[0]=='+') && IsDigit(z[1]) ) z++;
+      if( !IsDigit(z[0]) ) return 0;
+      z++;
+      while( IsDigit(z[0]) ){ z++; }
     }else{
-      zTab = "zip";
-    }
-  }else{
-    /* Initialize the table for an SQLAR */
-    zTab = "sqlar";
-    if( bUpdate==0 ){
-      rc = arExecSql(pAr, zDrop);
-      if( rc!=SQLITE_OK ) goto end_ar_transaction;
+      if( c!=(*(z++)) ) return 0;
     }
-    rc = arExecSql(pAr, zCreate);
-  }
-  if( bOnlyIfChanged ){
-    zExists = sqlite3_mprintf(
-      " AND NOT EXISTS("
-          "SELECT 1 FROM %s AS mem"
-          " WHERE mem.name=disk.name"
-          " AND mem.mtime=disk.mtime"
-          " AND mem.mode=disk.mode)", zTab);
-  }else{
-    zExists = sqlite3_mprintf("");
   }
-  if( zExists==0 ) rc = SQLITE_NOMEM;
-  for(i=0; i<pAr->nArg && rc==SQLITE_OK; i++){
-    char *zSql2 = sqlite3_mprintf(zInsertFmt[pAr->bZip], zTab,
-        pAr->bVerbose ? "shell_putsnl(name)" : "name",
-        pAr->azArg[i], pAr->zDir, zExists);
-    rc = arExecSql(pAr, zSql2);
-    sqlite3_free(zSql2);
+  while( IsSpace(*z) ){ z++; }
+  return *z==0;
+}
+
+
+/*
+** Compare the string as a command-line option with either one or two
+** initial "-" characters.
+*/
+static int optionMatch(const char *zStr, const char *zOpt){
+  if( zStr[0]!='-' ) return 0;
+  zStr++;
+  if( zStr[0]=='-' ) zStr++;
+  return strcmp(zStr, zOpt)==0;
+}
+
+/*
+** Delete a file.
+*/
+int shellDeleteFile(const char *zFilename){
+  int rc;
+#ifdef _WIN32
+  wchar_t *z = sqlite3_win32_utf8_to_unicode(zFilename);
+  rc = _wunlink(z);
+  sqlite3_free(z);
+#else
+  rc = unlink(zFilename);
+#endif
+  return rc;
+}
+
+/*
+** Try to delete the temporary file (if there is one) and free the
+** memory used to hold the name of the temp file.
+*/
+static void clearTempFile(ShellState *p){
+  if( p->zTempFile==0 ) return;
+  if( p->doXdgOpen ) return;
+  if( shellDeleteFile(p->zTempFile) ) return;
+  sqlite3_free(p->zTempFile);
+  p->zTempFile = 0;
+}
+
+/*
+** Create a new temp file name with the given suffix.
+*/
+static void newTempFile(ShellState *p, const char *zSuffix){
+  clearTempFile(p);
+  sqlite3_free(p->zTempFile);
+  p->zTempFile = 0;
+  if( p->db ){
+    sqlite3_file_control(p->db, 0, SQLITE_FCNTL_TEMPFILENAME, &p->zTempFile);
   }
-end_ar_transaction:
-  if( rc!=SQLITE_OK ){
-    sqlite3_exec(pAr->db, "ROLLBACK TO ar; RELEASE ar;", 0, 0, 0);
+  if( p->zTempFile==0 ){
+    sqlite3_uint64 r;
+    sqlite3_randomness(sizeof(r), &r);
+    p->zTempFile = sqlite3_mprintf("temp%llx.%s", r, zSuffix);
   }else{
-    rc = arExecSql(pAr, "RELEASE ar;");
-    if( pAr->bZip && pAr->zFile ){
-      zSql = sqlite3_mprintf("DROP TABLE %s", zTemp);
-      arExecSql(pAr, zSql);
-      sqlite3_free(zSql);
-    }
+    p->zTempFile = sqlite3_mprintf("%z.%s", p->zTempFile, zSuffix);
+  }
+  if( p->zTempFile==0 ){
+    raw_printf(stderr, "out of memory\n");
+    exit(1);
   }
-  sqlite3_free(zExists);
-  return rc;
 }
 
+
 /*
-** Implementation of ".ar" dot command.
+** The implementation of SQL scalar function fkey_collate_clause(), used
+** by the ".lint fkey-indexes" command. This scalar function is always
+** called with four arguments - the parent table name, the parent column name,
+** the child table name and the child column name.
+**
+**   fkey_collate_clause('parent-tab', 'parent-col', 'child-tab', 'child-col')
+**
+** If either of the named tables or columns do not exist, this function
+** returns an empty string. An empty string is also returned if both tables
+** and columns exist but have the same default collation sequence. Or,
+** if both exist but the default collation sequences are different, this
+** function returns the string " COLLATE <parent-collation>", where
+** <parent-collation> is the default collation sequence of the parent column.
 */
-static int arDotCommand(
-  ShellState *pState,          /* Current shell tool state */
-  int fromCmdLine,             /* True if -A command-line option, not .ar cmd */
-  char **azArg,                /* Array of arguments passed to dot command */
-  int nArg                     /* Number of entries in azArg[] */
+static void shellFkeyCollateClause(
+  sqlite3_context *pCtx,
+  int nVal,
+  sqlite3_value **apVal
 ){
-  ArCommand cmd;
+  sqlite3 *db = sqlite3_context_db_handle(pCtx);
+  const char *zParent;
+  const char *zParentCol;
+  const char *zParentSeq;
+  const char *zChild;
+  const char *zChildCol;
+  const char *zChildSeq = 0;  /* Initialize to avoid false-positive warning */
   int rc;
-  memset(&cmd, 0, sizeof(cmd));
-  cmd.fromCmdLine = fromCmdLine;
-  rc = arParseCommand(azArg, nArg, &cmd);
+
+  assert( nVal==4 );
+  zParent = (const char*)sqlite3_value_text(apVal[0]);
+  zParentCol = (const char*)sqlite3_value_text(apVal[1]);
+  zChild = (const char*)sqlite3_value_text(apVal[2]);
+  zChildCol = (const char*)sqlite3_value_text(apVal[3]);
+
+  sqlite3_result_text(pCtx, "", -1, SQLITE_STATIC);
+  rc = sqlite3_table_column_metadata(
+      db, "main", zParent, zParentCol, 0, &zParentSeq, 0, 0, 0
+  );
   if( rc==SQLITE_OK ){
-    int eDbType = SHELL_OPEN_UNSPEC;
-    cmd.p = pState;
-    cmd.db = pState->db;
-    if( cmd.zFile ){
-      eDbType = deduceDatabaseType(cmd.zFile, 1);
-    }else{
-      eDbType = pState->openMode;
-    }
-    if( eDbType==SHELL_OPEN_ZIPFILE ){
-      if( cmd.eCmd==AR_CMD_EXTRACT || cmd.eCmd==AR_CMD_LIST ){
-        if( cmd.zFile==0 ){
-          cmd.zSrcTable = sqlite3_mprintf("zip");
-        }else{
-          cmd.zSrcTable = sqlite3_mprintf("zipfile(%Q)", cmd.zFile);
-        }
-      }
-      cmd.bZip = 1;
-    }else if( cmd.zFile ){
-      int flags;
-      if( cmd.bAppend ) eDbType = SHELL_OPEN_APPENDVFS;
-      if( cmd.eCmd==AR_CMD_CREATE || cmd.eCmd==AR_CMD_INSERT 
-           || cmd.eCmd==AR_CMD_UPDATE ){
-        flags = SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE;
-      }else{
-        flags = SQLITE_OPEN_READONLY;
-      }
-      cmd.db = 0;
-      if( cmd.bDryRun ){
-        utf8_printf(pState->out, "-- open database '%s'%s\n", cmd.zFile,
-             eDbType==SHELL_OPEN_APPENDVFS ? " using 'apndvfs'" : "");
-      }
-      rc = sqlite3_open_v2(cmd.zFile, &cmd.db, flags, 
-             eDbType==SHELL_OPEN_APPENDVFS ? "apndvfs" : 0);
-      if( rc!=SQLITE_OK ){
-        utf8_printf(stderr, "cannot open file: %s (%s)\n", 
-            cmd.zFile, sqlite3_errmsg(cmd.db)
-        );
-        goto end_ar_command;
+    rc = sqlite3_table_column_metadata(
+        db, "main", zChild, zChildCol, 0, &zChildSeq, 0, 0, 0
+    );
+  }
+
+  if( rc==SQLITE_OK && sqlite3_stricmp(zParentSeq, zChildSeq) ){
+    char *z = sqlite3_mprintf(" COLLATE %s", zParentSeq);
+    sqlite3_result_text(pCtx, z, -1, SQLITE_TRANSIENT);
+    sqlite3_free(z);
+  }
+}
+
+
+/*
+** The implementation of dot-command ".lint fkey-indexes".
+*/
+static int lintFkeyIndexes(
+  ShellState *pState,             /* Current shell tool state */
+  char **azArg,                   /* Array of arguments passed to dot command */
+  int nArg                        /* Number of entries in azArg[] */
+){
+  sqlite3 *db = pState->db;       /* Database handle to query "main" db of */
+  FILE *out = pState->out;        /* Stream to write non-error output to */
+  int bVerbose = 0;               /* If -verbose is present */
+  int bGroupByParent = 0;         /* If -groupbyparent is present */
+  int i;                          /* To iterate through azArg[] */
+  const char *zIndent = "";       /* How much to indent CREATE INDEX by */
+  int rc;                         /* Return code */
+  sqlite3_stmt *pSql = 0;         /* Compiled version of SQL statement below */
+
+  /*
+  ** This SELECT statement returns one row for each foreign key constraint
+  ** in the schema of the main database. The column values are:
+  **
+  ** 0. The text of an SQL statement similar to:
+  **
+  **      "EXPLAIN QUERY PLAN SELECT 1 FROM child_table WHERE child_key=?"
+  **
+  **    This SELECT is similar to the one that the foreign keys implementation
+  **    needs to run internally on child tables. If there is an index that can
+  **    be used to optimize this query, then it can also be used by the FK
+  **    implementation to optimize DELETE or UPDATE statements on the parent
+  **    table.
+  **
+  ** 1. A GLOB pattern suitable for sqlite3_strglob(). If the plan output by
+  **    the EXPLAIN QUERY PLAN command matches this pattern, then the schema
+  **    contains an index that can be used to optimize the query.
+  **
+  ** 2. Human readable text that describes the child table and columns. e.g.
+  **
+  **       "child_table(child_key1, child_key2)"
+  **
+  ** 3. Human readable text that describes the parent table and columns. e.g.
+  **
+  **       "parent_table(parent_key1, parent_key2)"
+  **
+  ** 4. A full CREATE INDEX statement for an index that could be used to
+  **    optimize DELETE or UPDATE statements on the parent table. e.g.
+  **
+  **       "CREATE INDEX child_table_child_key ON child_table(child_key)"
+  **
+  ** 5. The name of the parent table.
+  **
+  ** These six values are used by the C logic below to generate the report.
+  */
+  const char *zSql =
+  "SELECT "
+    "     'EXPLAIN QUERY PLAN SELECT 1 FROM ' || quote(s.name) || ' WHERE '"
+    "  || group_concat(quote(s.name) || '.' || quote(f.[from]) || '=?' "
+    "  || fkey_collate_clause("
+    "       f.[table], COALESCE(f.[to], p.[name]), s.name, f.[from]),' AND ')"
+    ", "
+    "     'SEARCH TABLE ' || s.name || ' USING COVERING INDEX*('"
+    "  || group_concat('*=?', ' AND ') || ')'"
+    ", "
+    "     s.name  || '(' || group_concat(f.[from],  ', ') || ')'"
+    ", "
+    "     f.[table] || '(' || group_concat(COALESCE(f.[to], p.[name])) || ')'"
+    ", "
+    "     'CREATE INDEX ' || quote(s.name ||'_'|| group_concat(f.[from], '_'))"
+    "  || ' ON ' || quote(s.name) || '('"
+    "  || group_concat(quote(f.[from]) ||"
+    "        fkey_collate_clause("
+    "          f.[table], COALESCE(f.[to], p.[name]), s.name, f.[from]), ', ')"
+    "  || ');'"
+    ", "
+    "     f.[table] "
+    "FROM sqlite_master AS s, pragma_foreign_key_list(s.name) AS f "
+    "LEFT JOIN pragma_table_info AS p ON (pk-1=seq AND p.arg=f.[table]) "
+    "GROUP BY s.name, f.id "
+    "ORDER BY (CASE WHEN ? THEN f.[table] ELSE s.name END)"
+  ;
+  const char *zGlobIPK = "SEARCH TABLE * USING INTEGER PRIMARY KEY (rowid=?)";
+
+  for(i=2; i<nArg; i++){
+    int n = strlen30(azArg[i]);
+    if( n>1 && sqlite3_strnicmp("-verbose", azArg[i], n)==0 ){
+      bVerbose = 1;
+    }
+    else if( n>1 && sqlite3_strnicmp("-groupbyparent", azArg[i], n)==0 ){
+      bGroupByParent = 1;
+      zIndent = "    ";
+    }
+    else{
+      raw_printf(stderr, "Usage: %s %s ?-verbose? ?-groupbyparent?\n",
+          azArg[0], azArg[1]
+      );
+      return SQLITE_ERROR;
+    }
+  }
+
+  /* Register the fkey_collate_clause() SQL function */
+  rc = sqlite3_create_function(db, "fkey_collate_clause", 4, SQLITE_UTF8,
+      0, shellFkeyCollateClause, 0, 0
+  );
+
+
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_prepare_v2(db, zSql, -1, &pSql, 0);
+  }
+  if( rc==SQLITE_OK ){
+    sqlite3_bind_int(pSql, 1, bGroupByParent);
+  }
+
+  if( rc==SQLITE_OK ){
+    int rc2;
+    char *zPrev = 0;
+    while( SQLITE_ROW==sqlite3_step(pSql) ){
+      int res = -1;
+      sqlite3_stmt *pExplain = 0;
+      const char *zEQP = (const char*)sqlite3_column_text(pSql, 0);
+      const char *zGlob = (const char*)sqlite3_column_text(pSql, 1);
+      const char *zFrom = (const char*)sqlite3_column_text(pSql, 2);
+      const char *zTarget = (const char*)sqlite3_column_text(pSql, 3);
+      const char *zCI = (const char*)sqlite3_column_text(pSql, 4);
+      const char *zParent = (const char*)sqlite3_column_text(pSql, 5);
+
+      rc = sqlite3_prepare_v2(db, zEQP, -1, &pExplain, 0);
+      if( rc!=SQLITE_OK ) break;
+      if( SQLITE_ROW==sqlite3_step(pExplain) ){
+        const char *zPlan = (const char*)sqlite3_column_text(pExplain, 3);
+        res = (
+              0==sqlite3_strglob(zGlob, zPlan)
+           || 0==sqlite3_strglob(zGlobIPK, zPlan)
+        );
+      }
+      rc = sqlite3_finalize(pExplain);
+      if( rc!=SQLITE_OK ) break;
+
+      if( res<0 ){
+        raw_printf(stderr, "Error: internal error");
+        break;
+      }else{
+        if( bGroupByParent
+        && (bVerbose || res==0)
+        && (zPrev==0 || sqlite3_stricmp(zParent, zPrev))
+        ){
+          raw_printf(out, "-- Parent table %s\n", zParent);
+          sqlite3_free(zPrev);
+          zPrev = sqlite3_mprintf("%s", zParent);
+        }
+
+        if( res==0 ){
+          raw_printf(out, "%s%s --> %s\n", zIndent, zCI, zTarget);
+        }else if( bVerbose ){
+          raw_printf(out, "%s/* no extra indexes required for %s -> %s */\n",
+              zIndent, zFrom, zTarget
+          );
+        }
+      }
+    }
+    sqlite3_free(zPrev);
+
+    if( rc!=SQLITE_OK ){
+      raw_printf(stderr, "%s\n", sqlite3_errmsg(db));
+    }
+
+    rc2 = sqlite3_finalize(pSql);
+    if( rc==SQLITE_OK && rc2!=SQLITE_OK ){
+      rc = rc2;
+      raw_printf(stderr, "%s\n", sqlite3_errmsg(db));
+    }
+  }else{
+    raw_printf(stderr, "%s\n", sqlite3_errmsg(db));
+  }
+
+  return rc;
+}
+
+/*
+** Implementation of ".lint" dot command.
+*/
+static int lintDotCommand(
+  ShellState *pState,             /* Current shell tool state */
+  char **azArg,                   /* Array of arguments passed to dot command */
+  int nArg                        /* Number of entries in azArg[] */
+){
+  int n;
+  n = (nArg>=2 ? strlen30(azArg[1]) : 0);
+  if( n<1 || sqlite3_strnicmp(azArg[1], "fkey-indexes", n) ) goto usage;
+  return lintFkeyIndexes(pState, azArg, nArg);
+
+ usage:
+  raw_printf(stderr, "Usage %s sub-command ?switches...?\n", azArg[0]);
+  raw_printf(stderr, "Where sub-commands are:\n");
+  raw_printf(stderr, "    fkey-indexes\n");
+  return SQLITE_ERROR;
+}
+
+#if !defined SQLITE_OMIT_VIRTUALTABLE
+static void shellPrepare(
+  sqlite3 *db, 
+  int *pRc, 
+  const char *zSql, 
+  sqlite3_stmt **ppStmt
+){
+  *ppStmt = 0;
+  if( *pRc==SQLITE_OK ){
+    int rc = sqlite3_prepare_v2(db, zSql, -1, ppStmt, 0);
+    if( rc!=SQLITE_OK ){
+      raw_printf(stderr, "sql error: %s (%d)\n", 
+          sqlite3_errmsg(db), sqlite3_errcode(db)
+      );
+      *pRc = rc;
+    }
+  }
+}
+
+/*
+** Create a prepared statement using printf-style arguments for the SQL.
+**
+** This routine is could be marked "static".  But it is not always used,
+** depending on compile-time options.  By omitting the "static", we avoid
+** nuisance compiler warnings about "defined but not used".
+*/
+void shellPreparePrintf(
+  sqlite3 *db, 
+  int *pRc, 
+  sqlite3_stmt **ppStmt,
+  const char *zFmt, 
+  ...
+){
+  *ppStmt = 0;
+  if( *pRc==SQLITE_OK ){
+    va_list ap;
+    char *z;
+    va_start(ap, zFmt);
+    z = sqlite3_vmprintf(zFmt, ap);
+    va_end(ap);
+    if( z==0 ){
+      *pRc = SQLITE_NOMEM;
+    }else{
+      shellPrepare(db, pRc, z, ppStmt);
+      sqlite3_free(z);
+    }
+  }
+}
+
+/* Finalize the prepared statement created using shellPreparePrintf().
+**
+** This routine is could be marked "static".  But it is not always used,
+** depending on compile-time options.  By omitting the "static", we avoid
+** nuisance compiler warnings about "defined but not used".
+*/
+void shellFinalize(
+  int *pRc, 
+  sqlite3_stmt *pStmt
+){
+  if( pStmt ){
+    sqlite3 *db = sqlite3_db_handle(pStmt);
+    int rc = sqlite3_finalize(pStmt);
+    if( *pRc==SQLITE_OK ){
+      if( rc!=SQLITE_OK ){
+        raw_printf(stderr, "SQL error: %s\n", sqlite3_errmsg(db));
+      }
+      *pRc = rc;
+    }
+  }
+}
+
+/* Reset the prepared statement created using shellPreparePrintf().
+**
+** This routine is could be marked "static".  But it is not always used,
+** depending on compile-time options.  By omitting the "static", we avoid
+** nuisance compiler warnings about "defined but not used".
+*/
+void shellReset(
+  int *pRc, 
+  sqlite3_stmt *pStmt
+){
+  int rc = sqlite3_reset(pStmt);
+  if( *pRc==SQLITE_OK ){
+    if( rc!=SQLITE_OK ){
+      sqlite3 *db = sqlite3_db_handle(pStmt);
+      raw_printf(stderr, "SQL error: %s\n", sqlite3_errmsg(db));
+    }
+    *pRc = rc;
+  }
+}
+#endif /* !defined SQLITE_OMIT_VIRTUALTABLE */
+
+#if !defined(SQLITE_OMIT_VIRTUALTABLE) && defined(SQLITE_HAVE_ZLIB)
+/******************************************************************************
+** The ".archive" or ".ar" command.
+*/
+/*
+** Structure representing a single ".ar" command.
+*/
+typedef struct ArCommand ArCommand;
+struct ArCommand {
+  u8 eCmd;                        /* An AR_CMD_* value */
+  u8 bVerbose;                    /* True if --verbose */
+  u8 bZip;                        /* True if the archive is a ZIP */
+  u8 bDryRun;                     /* True if --dry-run */
+  u8 bAppend;                     /* True if --append */
+  u8 fromCmdLine;                 /* Run from -A instead of .archive */
+  int nArg;                       /* Number of command arguments */
+  char *zSrcTable;                /* "sqlar", "zipfile($file)" or "zip" */
+  const char *zFile;              /* --file argument, or NULL */
+  const char *zDir;               /* --directory argument, or NULL */
+  char **azArg;                   /* Array of command arguments */
+  ShellState *p;                  /* Shell state */
+  sqlite3 *db;                    /* Database containing the archive */
+};
+
+/*
+** Print a usage message for the .ar command to stderr and return SQLITE_ERROR.
+*/
+static int arUsage(FILE *f){
+  showHelp(f,"archive");
+  return SQLITE_ERROR;
+}
+
+/*
+** Print an error message for the .ar command to stderr and return 
+** SQLITE_ERROR.
+*/
+static int arErrorMsg(ArCommand *pAr, const char *zFmt, ...){
+  va_list ap;
+  char *z;
+  va_start(ap, zFmt);
+  z = sqlite3_vmprintf(zFmt, ap);
+  va_end(ap);
+  utf8_printf(stderr, "Error: %s\n", z);
+  if( pAr->fromCmdLine ){
+    utf8_printf(stderr, "Use \"-A\" for more help\n");
+  }else{
+    utf8_printf(stderr, "Use \".archive --help\" for more help\n");
+  }
+  sqlite3_free(z);
+  return SQLITE_ERROR;
+}
+
+/*
+** Values for ArCommand.eCmd.
+*/
+#define AR_CMD_CREATE       1
+#define AR_CMD_UPDATE       2
+#define AR_CMD_INSERT       3
+#define AR_CMD_EXTRACT      4
+#define AR_CMD_LIST         5
+#define AR_CMD_HELP         6
+
+/*
+** Other (non-command) switches.
+*/
+#define AR_SWITCH_VERBOSE     7
+#define AR_SWITCH_FILE        8
+#define AR_SWITCH_DIRECTORY   9
+#define AR_SWITCH_APPEND     10
+#define AR_SWITCH_DRYRUN     11
+
+static int arProcessSwitch(ArCommand *pAr, int eSwitch, const char *zArg){
+  switch( eSwitch ){
+    case AR_CMD_CREATE:
+    case AR_CMD_EXTRACT:
+    case AR_CMD_LIST:
+    case AR_CMD_UPDATE:
+    case AR_CMD_INSERT:
+    case AR_CMD_HELP:
+      if( pAr->eCmd ){
+        return arErrorMsg(pAr, "multiple command options");
+      }
+      pAr->eCmd = eSwitch;
+      break;
+
+    case AR_SWITCH_DRYRUN:
+      pAr->bDryRun = 1;
+      break;
+    case AR_SWITCH_VERBOSE:
+      pAr->bVerbose = 1;
+      break;
+    case AR_SWITCH_APPEND:
+      pAr->bAppend = 1;
+      /* Fall thru into --file */
+    case AR_SWITCH_FILE:
+      pAr->zFile = zArg;
+      break;
+    case AR_SWITCH_DIRECTORY:
+      pAr->zDir = zArg;
+      break;
+  }
+
+  return SQLITE_OK;
+}
+
+/*
+** Parse the command line for an ".ar" command. The results are written into
+** structure (*pAr). SQLITE_OK is returned if the command line is parsed
+** successfully, otherwise an error message is written to stderr and 
+** SQLITE_ERROR returned.
+*/
+static int arParseCommand(
+  char **azArg,                   /* Array of arguments passed to dot command */
+  int nArg,                       /* Number of entries in azArg[] */
+  ArCommand *pAr                  /* Populate this object */
+){
+  struct ArSwitch {
+    const char *zLong;
+    char cShort;
+    u8 eSwitch;
+    u8 bArg;
+  } aSwitch[] = {
+    { "create",    'c', AR_CMD_CREATE,       0 },
+    { "extract",   'x', AR_CMD_EXTRACT,      0 },
+    { "insert",    'i', AR_CMD_INSERT,       0 },
+    { "list",      't', AR_CMD_LIST,         0 },
+    { "update",    'u', AR_CMD_UPDATE,       0 },
+    { "help",      'h', AR_CMD_HELP,         0 },
+    { "verbose",   'v', AR_SWITCH_VERBOSE,   0 },
+    { "file",      'f', AR_SWITCH_FILE,      1 },
+    { "append",    'a', AR_SWITCH_APPEND,    1 },
+    { "directory", 'C', AR_SWITCH_DIRECTORY, 1 },
+    { "dryrun",    'n', AR_SWITCH_DRYRUN,    0 },
+  };
+  int nSwitch = sizeof(aSwitch) / sizeof(struct ArSwitch);
+  struct ArSwitch *pEnd = &aSwitch[nSwitch];
+
+  if( nArg<=1 ){
+    utf8_printf(stderr, "Wrong number of arguments.  Usage:\n");
+    return arUsage(stderr);
+  }else{
+    char *z = azArg[1];
+    if( z[0]!='-' ){
+      /* Traditional style [tar] invocation */
+      int i;
+      int iArg = 2;
+      for(i=0; z[i]; i++){
+        const char *zArg = 0;
+        struct ArSwitch *pOpt;
+        for(pOpt=&aSwitch[0]; pOpt<pEnd; pOpt++){
+          if( z[i]==pOpt->cShort ) break;
+        }
+        if( pOpt==pEnd ){
+          return arErrorMsg(pAr, "unrecognized option: %c", z[i]);
+        }
+        if( pOpt->bArg ){
+          if( iArg>=nArg ){
+            return arErrorMsg(pAr, "option requires an argument: %c",z[i]);
+          }
+          zArg = azArg[iArg++];
+        }
+        if( arProcessSwitch(pAr, pOpt->eSwitch, zArg) ) return SQLITE_ERROR;
+      }
+      pAr->nArg = nArg-iArg;
+      if( pAr->nArg>0 ){
+        pAr->azArg = &azArg[iArg];
+      }
+    }else{
+      /* Non-traditional invocation */
+      int iArg;
+      for(iArg=1; iArg<nArg; iArg++){
+        int n;
+        z = azArg[iArg];
+        if( z[0]!='-' ){
+          /* All remaining command line words are command arguments. */
+          pAr->azArg = &azArg[iArg];
+          pAr->nArg = nArg-iArg;
+          break;
+        }
+        n = strlen30(z);
+
+        if( z[1]!='-' ){
+          int i;
+          /* One or more short options */
+          for(i=1; i<n; i++){
+            const char *zArg = 0;
+            struct ArSwitch *pOpt;
+            for(pOpt=&aSwitch[0]; pOpt<pEnd; pOpt++){
+              if( z[i]==pOpt->cShort ) break;
+            }
+            if( pOpt==pEnd ){
+              return arErrorMsg(pAr, "unrecognized option: %c", z[i]);
+            }
+            if( pOpt->bArg ){
+              if( i<(n-1) ){
+                zArg = &z[i+1];
+                i = n;
+              }else{
+                if( iArg>=(nArg-1) ){
+                  return arErrorMsg(pAr, "option requires an argument: %c",
+                                    z[i]);
+                }
+                zArg = azArg[++iArg];
+              }
+            }
+            if( arProcessSwitch(pAr, pOpt->eSwitch, zArg) ) return SQLITE_ERROR;
+          }
+        }else if( z[2]=='\0' ){
+          /* A -- option, indicating that all remaining command line words
+          ** are command arguments.  */
+          pAr->azArg = &azArg[iArg+1];
+          pAr->nArg = nArg-iArg-1;
+          break;
+        }else{
+          /* A long option */
+          const char *zArg = 0;             /* Argument for option, if any */
+          struct ArSwitch *pMatch = 0;      /* Matching option */
+          struct ArSwitch *pOpt;            /* Iterator */
+          for(pOpt=&aSwitch[0]; pOpt<pEnd; pOpt++){
+            const char *zLong = pOpt->zLong;
+            if( (n-2)<=strlen30(zLong) && 0==memcmp(&z[2], zLong, n-2) ){
+              if( pMatch ){
+                return arErrorMsg(pAr, "ambiguous option: %s",z);
+              }else{
+                pMatch = pOpt;
+              }
+            }
+          }
+
+          if( pMatch==0 ){
+            return arErrorMsg(pAr, "unrecognized option: %s", z);
+          }
+          if( pMatch->bArg ){
+            if( iArg>=(nArg-1) ){
+              return arErrorMsg(pAr, "option requires an argument: %s", z);
+            }
+            zArg = azArg[++iArg];
+          }
+          if( arProcessSwitch(pAr, pMatch->eSwitch, zArg) ) return SQLITE_ERROR;
+        }
+      }
+    }
+  }
+
+  return SQLITE_OK;
+}
+
+/*
+** This function assumes that all arguments within the ArCommand.azArg[]
+** array refer to archive members, as for the --extract or --list commands. 
+** It checks that each of them are present. If any specified file is not
+** present in the archive, an error is printed to stderr and an error
+** code returned. Otherwise, if all specified arguments are present in
+** the archive, SQLITE_OK is returned.
+**
+** This function strips any trailing '/' characters from each argument.
+** This is consistent with the way the [tar] command seems to work on
+** Linux.
+*/
+static int arCheckEntries(ArCommand *pAr){
+  int rc = SQLITE_OK;
+  if( pAr->nArg ){
+    int i, j;
+    sqlite3_stmt *pTest = 0;
+
+    shellPreparePrintf(pAr->db, &rc, &pTest,
+        "SELECT name FROM %s WHERE name=$name", 
+        pAr->zSrcTable
+    );
+    j = sqlite3_bind_parameter_index(pTest, "$name");
+    for(i=0; i<pAr->nArg && rc==SQLITE_OK; i++){
+      char *z = pAr->azArg[i];
+      int n = strlen30(z);
+      int bOk = 0;
+      while( n>0 && z[n-1]=='/' ) n--;
+      z[n] = '\0';
+      sqlite3_bind_text(pTest, j, z, -1, SQLITE_STATIC);
+      if( SQLITE_ROW==sqlite3_step(pTest) ){
+        bOk = 1;
+      }
+      shellReset(&rc, pTest);
+      if( rc==SQLITE_OK && bOk==0 ){
+        utf8_printf(stderr, "not found in archive: %s\n", z);
+        rc = SQLITE_ERROR;
+      }
+    }
+    shellFinalize(&rc, pTest);
+  }
+  return rc;
+}
+
+/*
+** Format a WHERE clause that can be used against the "sqlar" table to
+** identify all archive members that match the command arguments held
+** in (*pAr). Leave this WHERE clause in (*pzWhere) before returning.
+** The caller is responsible for eventually calling sqlite3_free() on
+** any non-NULL (*pzWhere) value.
+*/
+static void arWhereClause(
+  int *pRc, 
+  ArCommand *pAr, 
+  char **pzWhere                  /* OUT: New WHERE clause */
+){
+  char *zWhere = 0;
+  if( *pRc==SQLITE_OK ){
+    if( pAr->nArg==0 ){
+      zWhere = sqlite3_mprintf("1");
+    }else{
+      int i;
+      const char *zSep = "";
+      for(i=0; i<pAr->nArg; i++){
+        const char *z = pAr->azArg[i];
+        zWhere = sqlite3_mprintf(
+          "%z%s name = '%q' OR substr(name,1,%d) = '%q/'", 
+          zWhere, zSep, z, strlen30(z)+1, z
+        );
+        if( zWhere==0 ){
+          *pRc = SQLITE_NOMEM;
+          break;
+        }
+        zSep = " OR ";
+      }
+    }
+  }
+  *pzWhere = zWhere;
+}
+
+/*
+** Implementation of .ar "lisT" command. 
+*/
+static int arListCommand(ArCommand *pAr){
+  const char *zSql = "SELECT %s FROM %s WHERE %s"; 
+  const char *azCols[] = {
+    "name",
+    "lsmode(mode), sz, datetime(mtime, 'unixepoch'), name"
+  };
+
+  char *zWhere = 0;
+  sqlite3_stmt *pSql = 0;
+  int rc;
+
+  rc = arCheckEntries(pAr);
+  arWhereClause(&rc, pAr, &zWhere);
+
+  shellPreparePrintf(pAr->db, &rc, &pSql, zSql, azCols[pAr->bVerbose],
+                     pAr->zSrcTable, zWhere);
+  if( pAr->bDryRun ){
+    utf8_printf(pAr->p->out, "%s\n", sqlite3_sql(pSql));
+  }else{
+    while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pSql) ){
+      if( pAr->bVerbose ){
+        utf8_printf(pAr->p->out, "%s % 10d  %s  %s\n",
+            sqlite3_column_text(pSql, 0),
+            sqlite3_column_int(pSql, 1), 
+            sqlite3_column_text(pSql, 2),
+            sqlite3_column_text(pSql, 3)
+        );
+      }else{
+        utf8_printf(pAr->p->out, "%s\n", sqlite3_column_text(pSql, 0));
+      }
+    }
+  }
+  shellFinalize(&rc, pSql);
+  sqlite3_free(zWhere);
+  return rc;
+}
+
+
+/*
+** Implementation of .ar "eXtract" command. 
+*/
+static int arExtractCommand(ArCommand *pAr){
+  const char *zSql1 = 
+    "SELECT "
+    " ($dir || name),"
+    " writefile(($dir || name), %s, mode, mtime) "
+    "FROM %s WHERE (%s) AND (data IS NULL OR $dirOnly = 0)"
+    " AND name NOT GLOB '*..[/\\]*'";
+
+  const char *azExtraArg[] = { 
+    "sqlar_uncompress(data, sz)",
+    "data"
+  };
+
+  sqlite3_stmt *pSql = 0;
+  int rc = SQLITE_OK;
+  char *zDir = 0;
+  char *zWhere = 0;
+  int i, j;
+
+  /* If arguments are specified, check that they actually exist within
+  ** the archive before proceeding. And formulate a WHERE clause to
+  ** match them.  */
+  rc = arCheckEntries(pAr);
+  arWhereClause(&rc, pAr, &zWhere);
+
+  if( rc==SQLITE_OK ){
+    if( pAr->zDir ){
+      zDir = sqlite3_mprintf("%s/", pAr->zDir);
+    }else{
+      zDir = sqlite3_mprintf("");
+    }
+    if( zDir==0 ) rc = SQLITE_NOMEM;
+  }
+
+  shellPreparePrintf(pAr->db, &rc, &pSql, zSql1, 
+      azExtraArg[pAr->bZip], pAr->zSrcTable, zWhere
+  );
+
+  if( rc==SQLITE_OK ){
+    j = sqlite3_bind_parameter_index(pSql, "$dir");
+    sqlite3_bind_text(pSql, j, zDir, -1, SQLITE_STATIC);
+
+    /* Run the SELECT statement twice. The first time, writefile() is called
+    ** for all archive members that should be extracted. The second time,
+    ** only for the directories. This is because the timestamps for
+    ** extracted directories must be reset after they are populated (as
+    ** populating them changes the timestamp).  */
+    for(i=0; i<2; i++){
+      j = sqlite3_bind_parameter_index(pSql, "$dirOnly");
+      sqlite3_bind_int(pSql, j, i);
+      if( pAr->bDryRun ){
+        utf8_printf(pAr->p->out, "%s\n", sqlite3_sql(pSql));
+      }else{
+        while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pSql) ){
+          if( i==0 && pAr->bVerbose ){
+            utf8_printf(pAr->p->out, "%s\n", sqlite3_column_text(pSql, 0));
+          }
+        }
+      }
+      shellReset(&rc, pSql);
+    }
+    shellFinalize(&rc, pSql);
+  }
+
+  sqlite3_free(zDir);
+  sqlite3_free(zWhere);
+  return rc;
+}
+
+/*
+** Run the SQL statement in zSql.  Or if doing a --dryrun, merely print it out.
+*/
+static int arExecSql(ArCommand *pAr, const char *zSql){
+  int rc;
+  if( pAr->bDryRun ){
+    utf8_printf(pAr->p->out, "%s\n", zSql);
+    rc = SQLITE_OK;
+  }else{
+    char *zErr = 0;
+    rc = sqlite3_exec(pAr->db, zSql, 0, 0, &zErr);
+    if( zErr ){
+      utf8_printf(stdout, "ERROR: %s\n", zErr);
+      sqlite3_free(zErr);
+    }
+  }
+  return rc;
+}
+
+
+/*
+** Implementation of .ar "create", "insert", and "update" commands.
+**
+**     create    ->     Create a new SQL archive
+**     insert    ->     Insert or reinsert all files listed
+**     update    ->     Insert files that have changed or that were not
+**                      previously in the archive
+**
+** Create the "sqlar" table in the database if it does not already exist.
+** Then add each file in the azFile[] array to the archive. Directories
+** are added recursively. If argument bVerbose is non-zero, a message is
+** printed on stdout for each file archived.
+**
+** The create command is the same as update, except that it drops
+** any existing "sqlar" table before beginning.  The "insert" command
+** always overwrites every file named on the command-line, where as
+** "update" only overwrites if the size or mtime or mode has changed.
+*/
+static int arCreateOrUpdateCommand(
+  ArCommand *pAr,                 /* Command arguments and options */
+  int bUpdate,                    /* true for a --create. */
+  int bOnlyIfChanged              /* Only update if file has changed */
+){
+  const char *zCreate = 
+      "CREATE TABLE IF NOT EXISTS sqlar(\n"
+      "  name TEXT PRIMARY KEY,  -- name of the file\n"
+      "  mode INT,               -- access permissions\n"
+      "  mtime INT,              -- last modification time\n"
+      "  sz INT,                 -- original file size\n"
+      "  data BLOB               -- compressed content\n"
+      ")";
+  const char *zDrop = "DROP TABLE IF EXISTS sqlar";
+  const char *zInsertFmt[2] = {
+     "REPLACE INTO %s(name,mode,mtime,sz,data)\n"
+     "  SELECT\n"
+     "    %s,\n"
+     "    mode,\n"
+     "    mtime,\n"
+     "    CASE substr(lsmode(mode),1,1)\n"
+     "      WHEN '-' THEN length(data)\n"
+     "      WHEN 'd' THEN 0\n"
+     "      ELSE -1 END,\n"
+     "    sqlar_compress(data)\n"
+     "  FROM fsdir(%Q,%Q) AS disk\n"
+     "  WHERE lsmode(mode) NOT LIKE '?%%'%s;"
+     ,
+     "REPLACE INTO %s(name,mode,mtime,data)\n"
+     "  SELECT\n"
+     "    %s,\n"
+     "    mode,\n"
+     "    mtime,\n"
+     "    data\n"
+     "  FROM fsdir(%Q,%Q) AS disk\n"
+     "  WHERE lsmode(mode) NOT LIKE '?%%'%s;"
+  };
+  int i;                          /* For iterating through azFile[] */
+  int rc;                         /* Return code */
+  const char *zTab = 0;           /* SQL table into which to insert */
+  char *zSql;
+  char zTemp[50];
+  char *zExists = 0;
+
+  arExecSql(pAr, "PRAGMA page_size=512");
+  rc = arExecSql(pAr, "SAVEPOINT ar;");
+  if( rc!=SQLITE_OK ) return rc;
+  zTemp[0] = 0; 
+  if( pAr->bZip ){
+    /* Initialize the zipfile virtual table, if necessary */
+    if( pAr->zFile ){
+      sqlite3_uint64 r;
+      sqlite3_randomness(sizeof(r),&r);
+      sqlite3_snprintf(sizeof(zTemp),zTemp,"zip%016llx",r);
+      zTab = zTemp;
+      zSql = sqlite3_mprintf(
+         "CREATE VIRTUAL TABLE temp.%s USING zipfile(%Q)",
+         zTab, pAr->zFile
+      );
+      rc = arExecSql(pAr, zSql);
+      sqlite3_free(zSql);
+    }else{
+      zTab = "zip";
+    }
+  }else{
+    /* Initialize the table for an SQLAR */
+    zTab = "sqlar";
+    if( bUpdate==0 ){
+      rc = arExecSql(pAr, zDrop);
+      if( rc!=SQLITE_OK ) goto end_ar_transaction;
+    }
+    rc = arExecSql(pAr, zCreate);
+  }
+  if( bOnlyIfChanged ){
+    zExists = sqlite3_mprintf(
+      " AND NOT EXISTS("
+          "SELECT 1 FROM %s AS mem"
+          " WHERE mem.name=disk.name"
+          " AND mem.mtime=disk.mtime"
+          " AND mem.mode=disk.mode)", zTab);
+  }else{
+    zExists = sqlite3_mprintf("");
+  }
+  if( zExists==0 ) rc = SQLITE_NOMEM;
+  for(i=0; i<pAr->nArg && rc==SQLITE_OK; i++){
+    char *zSql2 = sqlite3_mprintf(zInsertFmt[pAr->bZip], zTab,
+        pAr->bVerbose ? "shell_putsnl(name)" : "name",
+        pAr->azArg[i], pAr->zDir, zExists);
+    rc = arExecSql(pAr, zSql2);
+    sqlite3_free(zSql2);
+  }
+end_ar_transaction:
+  if( rc!=SQLITE_OK ){
+    sqlite3_exec(pAr->db, "ROLLBACK TO ar; RELEASE ar;", 0, 0, 0);
+  }else{
+    rc = arExecSql(pAr, "RELEASE ar;");
+    if( pAr->bZip && pAr->zFile ){
+      zSql = sqlite3_mprintf("DROP TABLE %s", zTemp);
+      arExecSql(pAr, zSql);
+      sqlite3_free(zSql);
+    }
+  }
+  sqlite3_free(zExists);
+  return rc;
+}
+
+/*
+** Implementation of ".ar" dot command.
+*/
+static int arDotCommand(
+  ShellState *pState,          /* Current shell tool state */
+  int fromCmdLine,             /* True if -A command-line option, not .ar cmd */
+  char **azArg,                /* Array of arguments passed to dot command */
+  int nArg                     /* Number of entries in azArg[] */
+){
+  ArCommand cmd;
+  int rc;
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.fromCmdLine = fromCmdLine;
+  rc = arParseCommand(azArg, nArg, &cmd);
+  if( rc==SQLITE_OK ){
+    int eDbType = SHELL_OPEN_UNSPEC;
+    cmd.p = pState;
+    cmd.db = pState->db;
+    if( cmd.zFile ){
+      eDbType = deduceDatabaseType(cmd.zFile, 1);
+    }else{
+      eDbType = pState->openMode;
+    }
+    if( eDbType==SHELL_OPEN_ZIPFILE ){
+      if( cmd.eCmd==AR_CMD_EXTRACT || cmd.eCmd==AR_CMD_LIST ){
+        if( cmd.zFile==0 ){
+          cmd.zSrcTable = sqlite3_mprintf("zip");
+        }else{
+          cmd.zSrcTable = sqlite3_mprintf("zipfile(%Q)", cmd.zFile);
+        }
+      }
+      cmd.bZip = 1;
+    }else if( cmd.zFile ){
+      int flags;
+      if( cmd.bAppend ) eDbType = SHELL_OPEN_APPENDVFS;
+      if( cmd.eCmd==AR_CMD_CREATE || cmd.eCmd==AR_CMD_INSERT 
+           || cmd.eCmd==AR_CMD_UPDATE ){
+        flags = SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE;
+      }else{
+        flags = SQLITE_OPEN_READONLY;
+      }
+      cmd.db = 0;
+      if( cmd.bDryRun ){
+        utf8_printf(pState->out, "-- open database '%s'%s\n", cmd.zFile,
+             eDbType==SHELL_OPEN_APPENDVFS ? " using 'apndvfs'" : "");
+      }
+      rc = sqlite3_open_v2(cmd.zFile, &cmd.db, flags, 
+             eDbType==SHELL_OPEN_APPENDVFS ? "apndvfs" : 0);
+      if( rc!=SQLITE_OK ){
+        utf8_printf(stderr, "cannot open file: %s (%s)\n", 
+            cmd.zFile, sqlite3_errmsg(cmd.db)
+        );
+        goto end_ar_command;
+      }
+      sqlite3_fileio_init(cmd.db, 0, 0);
+      sqlite3_sqlar_init(cmd.db, 0, 0);
+      sqlite3_create_function(cmd.db, "shell_putsnl", 1, SQLITE_UTF8, cmd.p,
+                              shellPutsFunc, 0, 0);
+
+    }
+    if( cmd.zSrcTable==0 && cmd.bZip==0 && cmd.eCmd!=AR_CMD_HELP ){
+      if( cmd.eCmd!=AR_CMD_CREATE
+       && sqlite3_table_column_metadata(cmd.db,0,"sqlar","name",0,0,0,0,0)
+      ){
+        utf8_printf(stderr, "database does not contain an 'sqlar' table\n");
+        rc = SQLITE_ERROR;
+        goto end_ar_command;
+      }
+      cmd.zSrcTable = sqlite3_mprintf("sqlar");
+    }
+
+    switch( cmd.eCmd ){
+      case AR_CMD_CREATE:
+        rc = arCreateOrUpdateCommand(&cmd, 0, 0);
+        break;
+
+      case AR_CMD_EXTRACT:
+        rc = arExtractCommand(&cmd);
+        break;
+
+      case AR_CMD_LIST:
+        rc = arListCommand(&cmd);
+        break;
+
+      case AR_CMD_HELP:
+        arUsage(pState->out);
+        break;
+
+      case AR_CMD_INSERT:
+        rc = arCreateOrUpdateCommand(&cmd, 1, 0);
+        break;
+
+      default:
+        assert( cmd.eCmd==AR_CMD_UPDATE );
+        rc = arCreateOrUpdateCommand(&cmd, 1, 1);
+        break;
+    }
+  }
+end_ar_command:
+  if( cmd.db!=pState->db ){
+    close_db(cmd.db);
+  }
+  sqlite3_free(cmd.zSrcTable);
+
+  return rc;
+}
+/* End of the ".archive" or ".ar" command logic
+*******************************************************************************/
+#endif /* !defined(SQLITE_OMIT_VIRTUALTABLE) && defined(SQLITE_HAVE_ZLIB) */
+
+#if !defined(SQLITE_OMIT_VIRTUALTABLE) && defined(SQLITE_ENABLE_DBPAGE_VTAB)
+/*
+** If (*pRc) is not SQLITE_OK when this function is called, it is a no-op.
+** Otherwise, the SQL statement or statements in zSql are executed using
+** database connection db and the error code written to *pRc before
+** this function returns.
+*/
+static void shellExec(sqlite3 *db, int *pRc, const char *zSql){
+  int rc = *pRc;
+  if( rc==SQLITE_OK ){
+    char *zErr = 0;
+    rc = sqlite3_exec(db, zSql, 0, 0, &zErr);
+    if( rc!=SQLITE_OK ){
+      raw_printf(stderr, "SQL error: %s\n", zErr);
+    }
+    *pRc = rc;
+  }
+}
+
+/*
+** Like shellExec(), except that zFmt is a printf() style format string.
+*/
+static void shellExecPrintf(sqlite3 *db, int *pRc, const char *zFmt, ...){
+  char *z = 0;
+  if( *pRc==SQLITE_OK ){
+    va_list ap;
+    va_start(ap, zFmt);
+    z = sqlite3_vmprintf(zFmt, ap);
+    va_end(ap);
+    if( z==0 ){
+      *pRc = SQLITE_NOMEM;
+    }else{
+      shellExec(db, pRc, z);
+    }
+    sqlite3_free(z);
+  }
+}
+
+/*
+** If *pRc is not SQLITE_OK when this function is called, it is a no-op.
+** Otherwise, an attempt is made to allocate, zero and return a pointer
+** to a buffer nByte bytes in size. If an OOM error occurs, *pRc is set
+** to SQLITE_NOMEM and NULL returned.
+*/
+static void *shellMalloc(int *pRc, sqlite3_int64 nByte){
+  void *pRet = 0;
+  if( *pRc==SQLITE_OK ){
+    pRet = sqlite3_malloc64(nByte);
+    if( pRet==0 ){
+      *pRc = SQLITE_NOMEM;
+    }else{
+      memset(pRet, 0, nByte);
+    }
+  }
+  return pRet;
+}
+
+/*
+** If *pRc is not SQLITE_OK when this function is called, it is a no-op.
+** Otherwise, zFmt is treated as a printf() style string. The result of
+** formatting it along with any trailing arguments is written into a 
+** buffer obtained from sqlite3_malloc(), and pointer to which is returned.
+** It is the responsibility of the caller to eventually free this buffer
+** using a call to sqlite3_free().
+** 
+** If an OOM error occurs, (*pRc) is set to SQLITE_NOMEM and a NULL 
+** pointer returned.
+*/
+static char *shellMPrintf(int *pRc, const char *zFmt, ...){
+  char *z = 0;
+  if( *pRc==SQLITE_OK ){
+    va_list ap;
+    va_start(ap, zFmt);
+    z = sqlite3_vmprintf(zFmt, ap);
+    va_end(ap);
+    if( z==0 ){
+      *pRc = SQLITE_NOMEM;
+    }
+  }
+  return z;
+}
+
+/*
+** When running the ".recover" command, each output table, and the special
+** orphaned row table if it is required, is represented by an instance
+** of the following struct.
+*/
+typedef struct RecoverTable RecoverTable;
+struct RecoverTable {
+  char *zQuoted;                  /* Quoted version of table name */
+  int nCol;                       /* Number of columns in table */
+  char **azlCol;                  /* Array of column lists */
+  int iPk;                        /* Index of IPK column */
+};
+
+/*
+** Free a RecoverTable object allocated by recoverFindTable() or
+** recoverOrphanTable().
+*/
+static void recoverFreeTable(RecoverTable *pTab){
+  if( pTab ){
+    sqlite3_free(pTab->zQuoted);
+    if( pTab->azlCol ){
+      int i;
+      for(i=0; i<=pTab->nCol; i++){
+        sqlite3_free(pTab->azlCol[i]);
+      }
+      sqlite3_free(pTab->azlCol);
+    }
+    sqlite3_free(pTab);
+  }
+}
+
+/*
+** This function is a no-op if (*pRc) is not SQLITE_OK when it is called.
+** Otherwise, it allocates and returns a RecoverTable object based on the
+** final four arguments passed to this function. It is the responsibility
+** of the caller to eventually free the returned object using
+** recoverFreeTable().
+*/
+static RecoverTable *recoverNewTable(
+  int *pRc,                       /* IN/OUT: Error code */
+  const char *zName,              /* Name of table */
+  const char *zSql,               /* CREATE TABLE statement */
+  int bIntkey, 
+  int nCol
+){
+  sqlite3 *dbtmp = 0;             /* sqlite3 handle for testing CREATE TABLE */
+  int rc = *pRc;
+  RecoverTable *pTab = 0;
+
+  pTab = (RecoverTable*)shellMalloc(&rc, sizeof(RecoverTable));
+  if( rc==SQLITE_OK ){
+    int nSqlCol = 0;
+    int bSqlIntkey = 0;
+    sqlite3_stmt *pStmt = 0;
+    
+    rc = sqlite3_open("", &dbtmp);
+    if( rc==SQLITE_OK ){
+      sqlite3_create_function(dbtmp, "shell_idquote", 1, SQLITE_UTF8, 0,
+                              shellIdQuote, 0, 0);
+    }
+    if( rc==SQLITE_OK ){
+      rc = sqlite3_exec(dbtmp, "PRAGMA writable_schema = on", 0, 0, 0);
+    }
+    if( rc==SQLITE_OK ){
+      rc = sqlite3_exec(dbtmp, zSql, 0, 0, 0);
+      if( rc==SQLITE_ERROR ){
+        rc = SQLITE_OK;
+        goto finished;
+      }
+    }
+    shellPreparePrintf(dbtmp, &rc, &pStmt, 
+        "SELECT count(*) FROM pragma_table_info(%Q)", zName
+    );
+    if( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
+      nSqlCol = sqlite3_column_int(pStmt, 0);
+    }
+    shellFinalize(&rc, pStmt);
+
+    if( rc!=SQLITE_OK || nSqlCol<nCol ){
+      goto finished;
+    }
+
+    shellPreparePrintf(dbtmp, &rc, &pStmt, 
+      "SELECT ("
+      "  SELECT substr(data,1,1)==X'0D' FROM sqlite_dbpage WHERE pgno=rootpage"
+      ") FROM sqlite_master WHERE name = %Q", zName
+    );
+    if( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
+      bSqlIntkey = sqlite3_column_int(pStmt, 0);
+    }
+    shellFinalize(&rc, pStmt);
+
+    if( bIntkey==bSqlIntkey ){
+      int i;
+      const char *zPk = "_rowid_";
+      sqlite3_stmt *pPkFinder = 0;
+
+      /* If this is an intkey table and there is an INTEGER PRIMARY KEY,
+      ** set zPk to the name of the PK column, and pTab->iPk to the index
+      ** of the column, where columns are 0-numbered from left to right.
+      ** Or, if this is a WITHOUT ROWID table or if there is no IPK column,
+      ** leave zPk as "_rowid_" and pTab->iPk at -2.  */
+      pTab->iPk = -2;
+      if( bIntkey ){
+        shellPreparePrintf(dbtmp, &rc, &pPkFinder, 
+          "SELECT cid, name FROM pragma_table_info(%Q) "
+          "  WHERE pk=1 AND type='integer' COLLATE nocase"
+          "  AND NOT EXISTS (SELECT cid FROM pragma_table_info(%Q) WHERE pk=2)"
+          , zName, zName
+        );
+        if( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pPkFinder) ){
+          pTab->iPk = sqlite3_column_int(pPkFinder, 0);
+          zPk = (const char*)sqlite3_column_text(pPkFinder, 1);
+        }
+      }
+
+      pTab->zQuoted = shellMPrintf(&rc, "\"%w\"", zName);
+      pTab->azlCol = (char**)shellMalloc(&rc, sizeof(char*) * (nSqlCol+1));
+      pTab->nCol = nSqlCol;
+
+      if( bIntkey ){
+        pTab->azlCol[0] = shellMPrintf(&rc, "\"%w\"", zPk);
+      }else{
+        pTab->azlCol[0] = shellMPrintf(&rc, "");
+      }
+      i = 1;
+      shellPreparePrintf(dbtmp, &rc, &pStmt, 
+          "SELECT %Q || group_concat(shell_idquote(name), ', ') "
+          "  FILTER (WHERE cid!=%d) OVER (ORDER BY %s cid) "
+          "FROM pragma_table_info(%Q)", 
+          bIntkey ? ", " : "", pTab->iPk, 
+          bIntkey ? "" : "(CASE WHEN pk=0 THEN 1000000 ELSE pk END), ",
+          zName
+      );
+      while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
+        const char *zText = (const char*)sqlite3_column_text(pStmt, 0);
+        pTab->azlCol[i] = shellMPrintf(&rc, "%s%s", pTab->azlCol[0], zText);
+        i++;
+      }
+      shellFinalize(&rc, pStmt);
+
+      shellFinalize(&rc, pPkFinder);
+    }
+  }
+
+ finished:
+  sqlite3_close(dbtmp);
+  *pRc = rc;
+  if( rc!=SQLITE_OK || (pTab && pTab->zQuoted==0) ){
+    recoverFreeTable(pTab);
+    pTab = 0;
+  }
+  return pTab;
+}
+
+/*
+** This function is called to search the schema recovered from the
+** sqlite_master table of the (possibly) corrupt database as part
+** of a ".recover" command. Specifically, for a table with root page
+** iRoot and at least nCol columns. Additionally, if bIntkey is 0, the
+** table must be a WITHOUT ROWID table, or if non-zero, not one of
+** those.
+**
+** If a table is found, a (RecoverTable*) object is returned. Or, if
+** no such table is found, but bIntkey is false and iRoot is the 
+** root page of an index in the recovered schema, then (*pbNoop) is
+** set to true and NULL returned. Or, if there is no such table or
+** index, NULL is returned and (*pbNoop) set to 0, indicating that
+** the caller should write data to the orphans table.
+*/
+static RecoverTable *recoverFindTable(
+  ShellState *pState,             /* Shell state object */
+  int *pRc,                       /* IN/OUT: Error code */
+  int iRoot,                      /* Root page of table */
+  int bIntkey,                    /* True for an intkey table */
+  int nCol,                       /* Number of columns in table */
+  int *pbNoop                     /* OUT: True if iRoot is root of index */
+){
+  sqlite3_stmt *pStmt = 0;
+  RecoverTable *pRet = 0;
+  int bNoop = 0;
+  const char *zSql = 0;
+  const char *zName = 0;
+
+  /* Search the recovered schema for an object with root page iRoot. */
+  shellPreparePrintf(pState->db, pRc, &pStmt,
+      "SELECT type, name, sql FROM recovery.schema WHERE rootpage=%d", iRoot
+  );
+  while( *pRc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
+    const char *zType = (const char*)sqlite3_column_text(pStmt, 0);
+    if( bIntkey==0 && sqlite3_stricmp(zType, "index")==0 ){
+      bNoop = 1;
+      break;
+    }
+    if( sqlite3_stricmp(zType, "table")==0 ){
+      zName = (const char*)sqlite3_column_text(pStmt, 1);
+      zSql = (const char*)sqlite3_column_text(pStmt, 2);
+      pRet = recoverNewTable(pRc, zName, zSql, bIntkey, nCol);
+      break;
+    }
+  }
+
+  shellFinalize(pRc, pStmt);
+  *pbNoop = bNoop;
+  return pRet;
+}
+
+/*
+** Return a RecoverTable object representing the orphans table.
+*/
+static RecoverTable *recoverOrphanTable(
+  ShellState *pState,             /* Shell state object */
+  int *pRc,                       /* IN/OUT: Error code */
+  const char *zLostAndFound,      /* Base name for orphans table */
+  int nCol                        /* Number of user data columns */
+){
+  RecoverTable *pTab = 0;
+  if( nCol>=0 && *pRc==SQLITE_OK ){
+    int i;
+
+    /* This block determines the name of the orphan table. The prefered
+    ** name is zLostAndFound. But if that clashes with another name
+    ** in the recovered schema, try zLostAndFound_0, zLostAndFound_1
+    ** and so on until a non-clashing name is found.  */
+    int iTab = 0;
+    char *zTab = shellMPrintf(pRc, "%s", zLostAndFound);
+    sqlite3_stmt *pTest = 0;
+    shellPrepare(pState->db, pRc,
+        "SELECT 1 FROM recovery.schema WHERE name=?", &pTest
+    );
+    if( pTest ) sqlite3_bind_text(pTest, 1, zTab, -1, SQLITE_TRANSIENT);
+    while( *pRc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pTest) ){
+      shellReset(pRc, pTest);
+      sqlite3_free(zTab);
+      zTab = shellMPrintf(pRc, "%s_%d", zLostAndFound, iTab++);
+      sqlite3_bind_text(pTest, 1, zTab, -1, SQLITE_TRANSIENT);
+    }
+    shellFinalize(pRc, pTest);
+
+    pTab = (RecoverTable*)shellMalloc(pRc, sizeof(RecoverTable));
+    if( pTab ){
+      pTab->zQuoted = shellMPrintf(pRc, "\"%w\"", zTab);
+      pTab->nCol = nCol;
+      pTab->iPk = -2;
+      if( nCol>0 ){
+        pTab->azlCol = (char**)shellMalloc(pRc, sizeof(char*) * (nCol+1));
+        if( pTab->azlCol ){
+          pTab->azlCol[nCol] = shellMPrintf(pRc, "");
+          for(i=nCol-1; i>=0; i--){
+            pTab->azlCol[i] = shellMPrintf(pRc, "%s, NULL", pTab->azlCol[i+1]);
+          }
+        }
+      }
+
+      if( *pRc!=SQLITE_OK ){
+        recoverFreeTable(pTab);
+        pTab = 0;
+      }else{
+        raw_printf(pState->out, 
+            "CREATE TABLE %s(rootpgno INTEGER, "
+            "pgno INTEGER, nfield INTEGER, id INTEGER", pTab->zQuoted
+        );
+        for(i=0; i<nCol; i++){
+          raw_printf(pState->out, ", c%d", i);
+        }
+        raw_printf(pState->out, ");\n");
+      }
+    }
+    sqlite3_free(zTab);
+  }
+  return pTab;
+}
+
+/*
+** This function is called to recover data from the database. A script
+** to construct a new database containing all recovered data is output
+** on stream pState->out.
+*/
+static int recoverDatabaseCmd(ShellState *pState, int nArg, char **azArg){
+  int rc = SQLITE_OK;
+  sqlite3_stmt *pLoop = 0;        /* Loop through all root pages */
+  sqlite3_stmt *pPages = 0;       /* Loop through all pages in a group */
+  sqlite3_stmt *pCells = 0;       /* Loop through all cells in a page */
+  const char *zRecoveryDb = "";   /* Name of "recovery" database */
+  const char *zLostAndFound = "lost_and_found";
+  int i;
+  int nOrphan = -1;
+  RecoverTable *pOrphan = 0;
+
+  int bFreelist = 1;              /* 0 if --freelist-corrupt is specified */
+  int bRowids = 1;                /* 0 if --no-rowids */
+  for(i=1; i<nArg; i++){
+    char *z = azArg[i];
+    int n;
+    if( z[0]=='-' && z[1]=='-' ) z++;
+    n = strlen30(z);
+    if( n<=17 && memcmp("-freelist-corrupt", z, n)==0 ){
+      bFreelist = 0;
+    }else
+    if( n<=12 && memcmp("-recovery-db", z, n)==0 && i<(nArg-1) ){
+      i++;
+      zRecoveryDb = azArg[i];
+    }else
+    if( n<=15 && memcmp("-lost-and-found", z, n)==0 && i<(nArg-1) ){
+      i++;
+      zLostAndFound = azArg[i];
+    }else
+    if( n<=10 && memcmp("-no-rowids", z, n)==0 ){
+      bRowids = 0;
+    }
+    else{
+      utf8_printf(stderr, "unexpected option: %s\n", azArg[i]); 
+      showHelp(pState->out, azArg[0]);
+      return 1;
+    }
+  }
+
+  shellExecPrintf(pState->db, &rc,
+    /* Attach an in-memory database named 'recovery'. Create an indexed 
+    ** cache of the sqlite_dbptr virtual table. */
+    "PRAGMA writable_schema = on;"
+    "ATTACH %Q AS recovery;"
+    "DROP TABLE IF EXISTS recovery.dbptr;"
+    "DROP TABLE IF EXISTS recovery.freelist;"
+    "DROP TABLE IF EXISTS recovery.map;"
+    "DROP TABLE IF EXISTS recovery.schema;"
+    "CREATE TABLE recovery.freelist(pgno INTEGER PRIMARY KEY);", zRecoveryDb
+  );
+
+  if( bFreelist ){
+    shellExec(pState->db, &rc,
+      "WITH trunk(pgno) AS ("
+      "  SELECT shell_int32("
+      "      (SELECT data FROM sqlite_dbpage WHERE pgno=1), 8) AS x "
+      "      WHERE x>0"
+      "    UNION"
+      "  SELECT shell_int32("
+      "      (SELECT data FROM sqlite_dbpage WHERE pgno=trunk.pgno), 0) AS x "
+      "      FROM trunk WHERE x>0"
+      "),"
+      "freelist(data, n, freepgno) AS ("
+      "  SELECT data, min(16384, shell_int32(data, 1)-1), t.pgno "
+      "      FROM trunk t, sqlite_dbpage s WHERE s.pgno=t.pgno"
+      "    UNION ALL"
+      "  SELECT data, n-1, shell_int32(data, 2+n) "
+      "      FROM freelist WHERE n>=0"
+      ")"
+      "REPLACE INTO recovery.freelist SELECT freepgno FROM freelist;"
+    );
+  }
+
+  /* If this is an auto-vacuum database, add all pointer-map pages to
+  ** the freelist table. Do this regardless of whether or not 
+  ** --freelist-corrupt was specified.  */
+  shellExec(pState->db, &rc, 
+    "WITH ptrmap(pgno) AS ("
+    "  SELECT 2 WHERE shell_int32("
+    "    (SELECT data FROM sqlite_dbpage WHERE pgno=1), 13"
+    "  )"
+    "    UNION ALL "
+    "  SELECT pgno+1+(SELECT page_size FROM pragma_page_size)/5 AS pp "
+    "  FROM ptrmap WHERE pp<=(SELECT page_count FROM pragma_page_count)"
+    ")"
+    "REPLACE INTO recovery.freelist SELECT pgno FROM ptrmap"
+  );
+
+  shellExec(pState->db, &rc, 
+    "CREATE TABLE recovery.dbptr("
+    "      pgno, child, PRIMARY KEY(child, pgno)"
+    ") WITHOUT ROWID;"
+    "INSERT OR IGNORE INTO recovery.dbptr(pgno, child) "
+    "    SELECT * FROM sqlite_dbptr"
+    "      WHERE pgno NOT IN freelist AND child NOT IN freelist;"
+
+    /* Delete any pointer to page 1. This ensures that page 1 is considered
+    ** a root page, regardless of how corrupt the db is. */
+    "DELETE FROM recovery.dbptr WHERE child = 1;"
+
+    /* Delete all pointers to any pages that have more than one pointer
+    ** to them. Such pages will be treated as root pages when recovering
+    ** data.  */
+    "DELETE FROM recovery.dbptr WHERE child IN ("
+    "  SELECT child FROM recovery.dbptr GROUP BY child HAVING count(*)>1"
+    ");"
+
+    /* Create the "map" table that will (eventually) contain instructions
+    ** for dealing with each page in the db that contains one or more 
+    ** records. */
+    "CREATE TABLE recovery.map("
+      "pgno INTEGER PRIMARY KEY, maxlen INT, intkey, root INT"
+    ");"
+
+    /* Populate table [map]. If there are circular loops of pages in the
+    ** database, the following adds all pages in such a loop to the map
+    ** as individual root pages. This could be handled better.  */
+    "WITH pages(i, maxlen) AS ("
+    "  SELECT page_count, ("
+    "    SELECT max(field+1) FROM sqlite_dbdata WHERE pgno=page_count"
+    "  ) FROM pragma_page_count WHERE page_count>0"
+    "    UNION ALL"
+    "  SELECT i-1, ("
+    "    SELECT max(field+1) FROM sqlite_dbdata WHERE pgno=i-1"
+    "  ) FROM pages WHERE i>=2"
+    ")"
+    "INSERT INTO recovery.map(pgno, maxlen, intkey, root) "
+    "  SELECT i, maxlen, NULL, ("
+    "    WITH p(orig, pgno, parent) AS ("
+    "      SELECT 0, i, (SELECT pgno FROM recovery.dbptr WHERE child=i)"
+    "        UNION "
+    "      SELECT i, p.parent, "
+    "        (SELECT pgno FROM recovery.dbptr WHERE child=p.parent) FROM p"
+    "    )"
+    "    SELECT pgno FROM p WHERE (parent IS NULL OR pgno = orig)"
+    ") "
+    "FROM pages WHERE maxlen IS NOT NULL AND i NOT IN freelist;"
+    "UPDATE recovery.map AS o SET intkey = ("
+    "  SELECT substr(data, 1, 1)==X'0D' FROM sqlite_dbpage WHERE pgno=o.pgno"
+    ");"
+
+    /* Extract data from page 1 and any linked pages into table
+    ** recovery.schema. With the same schema as an sqlite_master table.  */
+    "CREATE TABLE recovery.schema(type, name, tbl_name, rootpage, sql);"
+    "INSERT INTO recovery.schema SELECT "
+    "  max(CASE WHEN field=0 THEN value ELSE NULL END),"
+    "  max(CASE WHEN field=1 THEN value ELSE NULL END),"
+    "  max(CASE WHEN field=2 THEN value ELSE NULL END),"
+    "  max(CASE WHEN field=3 THEN value ELSE NULL END),"
+    "  max(CASE WHEN field=4 THEN value ELSE NULL END)"
+    "FROM sqlite_dbdata WHERE pgno IN ("
+    "  SELECT pgno FROM recovery.map WHERE root=1"
+    ")"
+    "GROUP BY pgno, cell;"
+    "CREATE INDEX recovery.schema_rootpage ON schema(rootpage);"
+  );
+
+  /* Open a transaction, then print out all non-virtual, non-"sqlite_%" 
+  ** CREATE TABLE statements that extracted from the existing schema.  */
+  if( rc==SQLITE_OK ){
+    sqlite3_stmt *pStmt = 0;
+    /* ".recover" might output content in an order which causes immediate
+    ** foreign key constraints to be violated. So disable foreign-key
+    ** constraint enforcement to prevent problems when running the output
+    ** script. */
+    raw_printf(pState->out, "PRAGMA foreign_keys=OFF;\n");
+    raw_printf(pState->out, "BEGIN;\n");
+    raw_printf(pState->out, "PRAGMA writable_schema = on;\n");
+    shellPrepare(pState->db, &rc,
+        "SELECT sql FROM recovery.schema "
+        "WHERE type='table' AND sql LIKE 'create table%'", &pStmt
+    );
+    while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
+      const char *zCreateTable = (const char*)sqlite3_column_text(pStmt, 0);
+      raw_printf(pState->out, "CREATE TABLE IF NOT EXISTS %s;\n", 
+          &zCreateTable[12]
+      );
+    }
+    shellFinalize(&rc, pStmt);
+  }
+
+  /* Figure out if an orphan table will be required. And if so, how many
+  ** user columns it should contain */
+  shellPrepare(pState->db, &rc, 
+      "SELECT coalesce(max(maxlen), -2) FROM recovery.map WHERE root>1"
+      , &pLoop
+  );
+  if( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pLoop) ){
+    nOrphan = sqlite3_column_int(pLoop, 0);
+  }
+  shellFinalize(&rc, pLoop);
+  pLoop = 0;
+
+  shellPrepare(pState->db, &rc,
+      "SELECT pgno FROM recovery.map WHERE root=?", &pPages
+  );
+
+  shellPrepare(pState->db, &rc,
+      "SELECT max(field), group_concat(shell_escape_crnl(quote"
+      "(case when (? AND field<0) then NULL else value end)"
+      "), ', ')"
+      ", min(field) "
+      "FROM sqlite_dbdata WHERE pgno = ? AND field != ?"
+      "GROUP BY cell", &pCells
+  );
+
+  /* Loop through each root page. */
+  shellPrepare(pState->db, &rc, 
+      "SELECT root, intkey, max(maxlen) FROM recovery.map" 
+      " WHERE root>1 GROUP BY root, intkey ORDER BY root=("
+      "  SELECT rootpage FROM recovery.schema WHERE name='sqlite_sequence'"
+      ")", &pLoop
+  );
+  while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pLoop) ){
+    int iRoot = sqlite3_column_int(pLoop, 0);
+    int bIntkey = sqlite3_column_int(pLoop, 1);
+    int nCol = sqlite3_column_int(pLoop, 2);
+    int bNoop = 0;
+    RecoverTable *pTab;
+
+    assert( bIntkey==0 || bIntkey==1 );
+    pTab = recoverFindTable(pState, &rc, iRoot, bIntkey, nCol, &bNoop);
+    if( bNoop || rc ) continue;
+    if( pTab==0 ){
+      if( pOrphan==0 ){
+        pOrphan = recoverOrphanTable(pState, &rc, zLostAndFound, nOrphan);
+      }
+      pTab = pOrphan;
+      if( pTab==0 ) break;
+    }
+
+    if( 0==sqlite3_stricmp(pTab->zQuoted, "\"sqlite_sequence\"") ){
+      raw_printf(pState->out, "DELETE FROM sqlite_sequence;\n");
+    }
+    sqlite3_bind_int(pPages, 1, iRoot);
+    if( bRowids==0 && pTab->iPk<0 ){
+      sqlite3_bind_int(pCells, 1, 1);
+    }else{
+      sqlite3_bind_int(pCells, 1, 0);
+    }
+    sqlite3_bind_int(pCells, 3, pTab->iPk);
+
+    while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pPages) ){
+      int iPgno = sqlite3_column_int(pPages, 0);
+      sqlite3_bind_int(pCells, 2, iPgno);
+      while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pCells) ){
+        int nField = sqlite3_column_int(pCells, 0);
+        int iMin = sqlite3_column_int(pCells, 2);
+        const char *zVal = (const char*)sqlite3_column_text(pCells, 1);
+
+        RecoverTable *pTab2 = pTab;
+        if( pTab!=pOrphan && (iMin<0)!=bIntkey ){
+          if( pOrphan==0 ){
+            pOrphan = recoverOrphanTable(pState, &rc, zLostAndFound, nOrphan);
+          }
+          pTab2 = pOrphan;
+          if( pTab2==0 ) break;
+        }
+
+        nField = nField+1;
+        if( pTab2==pOrphan ){
+          raw_printf(pState->out, 
+              "INSERT INTO %s VALUES(%d, %d, %d, %s%s%s);\n",
+              pTab2->zQuoted, iRoot, iPgno, nField,
+              iMin<0 ? "" : "NULL, ", zVal, pTab2->azlCol[nField]
+          );
+        }else{
+          raw_printf(pState->out, "INSERT INTO %s(%s) VALUES( %s );\n", 
+              pTab2->zQuoted, pTab2->azlCol[nField], zVal
+          );
+        }
       }
-      sqlite3_fileio_init(cmd.db, 0, 0);
-      sqlite3_sqlar_init(cmd.db, 0, 0);
-      sqlite3_create_function(cmd.db, "shell_putsnl", 1, SQLITE_UTF8, cmd.p,
-                              shellPutsFunc, 0, 0);
-
+      shellReset(&rc, pCells);
     }
-    if( cmd.zSrcTable==0 && cmd.bZip==0 && cmd.eCmd!=AR_CMD_HELP ){
-      if( cmd.eCmd!=AR_CMD_CREATE
-       && sqlite3_table_column_metadata(cmd.db,0,"sqlar","name",0,0,0,0,0)
-      ){
-        utf8_printf(stderr, "database does not contain an 'sqlar' table\n");
-        rc = SQLITE_ERROR;
-        goto end_ar_command;
+    shellReset(&rc, pPages);
+    if( pTab!=pOrphan ) recoverFreeTable(pTab);
+  }
+  shellFinalize(&rc, pLoop);
+  shellFinalize(&rc, pPages);
+  shellFinalize(&rc, pCells);
+  recoverFreeTable(pOrphan);
+
+  /* The rest of the schema */
+  if( rc==SQLITE_OK ){
+    sqlite3_stmt *pStmt = 0;
+    shellPrepare(pState->db, &rc, 
+        "SELECT sql, name FROM recovery.schema "
+        "WHERE sql NOT LIKE 'create table%'", &pStmt
+    );
+    while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
+      const char *zSql = (const char*)sqlite3_column_text(pStmt, 0);
+      if( sqlite3_strnicmp(zSql, "create virt", 11)==0 ){
+        const char *zName = (const char*)sqlite3_column_text(pStmt, 1);
+        char *zPrint = shellMPrintf(&rc, 
+          "INSERT INTO sqlite_master VALUES('table', %Q, %Q, 0, %Q)",
+          zName, zName, zSql
+        );
+        raw_printf(pState->out, "%s;\n", zPrint);
+        sqlite3_free(zPrint);
+      }else{
+        raw_printf(pState->out, "%s;\n", zSql);
       }
-      cmd.zSrcTable = sqlite3_mprintf("sqlar");
     }
+    shellFinalize(&rc, pStmt);
+  }
 
-    switch( cmd.eCmd ){
-      case AR_CMD_CREATE:
-        rc = arCreateOrUpdateCommand(&cmd, 0, 0);
-        break;
+  if( rc==SQLITE_OK ){
+    raw_printf(pState->out, "PRAGMA writable_schema = off;\n");
+    raw_printf(pState->out, "COMMIT;\n");
+  }
+  sqlite3_exec(pState->db, "DETACH recovery", 0, 0, 0);
+  return rc;
+}
+#endif /* !(SQLITE_OMIT_VIRTUALTABLE) && defined(SQLITE_ENABLE_DBPAGE_VTAB) */
 
-      case AR_CMD_EXTRACT:
-        rc = arExtractCommand(&cmd);
-        break;
 
-      case AR_CMD_LIST:
-        rc = arListCommand(&cmd);
-        break;
+/*
+** ".dump --binary" writes the same logical content as ".dump", but as a
+** stream of typed, length-prefixed records rather than SQL text, and
+** ".restore-dump" loads it again.  Values go in and out of SQLite as they
+** are, with no conversion to or from text.  The format is in terms of SQL
+** and rows rather than pages, so a dump can be restored into a later
+** version of SQLite or a schema which has been upgraded since.
+**
+** A binary dump begins with the 8 bytes of DUMPBIN_MAGIC.  Each record
+** that follows is a type byte, the size of the payload as a varint, the
+** payload, and a 4-byte big-endian FNV-1a checksum of the type byte and
+** payload.  Varints are unsigned LEB128.  The types of record are:
+**
+**    'S'   SQL to run, in order with the content of the tables
+**    'T'   Start of the content of a table: the number of columns as a
+**          varint, the size and text of the name of the table, and then
+**          the text which follows "INSERT INTO" for the content
+**    'R'   Rows of the table last started: the number of rows as a
+**          varint, and then each value of each row
+**    'L'   SQL to run once the content of every table is loaded, which
+**          creates indexes, triggers and views
+**    'E'   End of the dump: the number of errors seen while dumping,
+**          as a varint
+**
+** Each value begins with a varint much like a record serial type: 0 for
+** NULL, 1 for an integer, which follows as a zigzag varint, 2 for a real,
+** which follows as 8 big-endian bytes, and N*2+12 for a blob or N*2+13
+** for text of N bytes, which follow.
+*/
+#define DUMPBIN_MAGIC       "SQLdump\001"
 
-      case AR_CMD_HELP:
-        arUsage(pState->out);
-        break;
+/* Rows of a table are written in records of about this many bytes */
+#define DUMPBIN_CHUNK_SIZE  262144
 
-      case AR_CMD_INSERT:
-        rc = arCreateOrUpdateCommand(&cmd, 1, 0);
-        break;
+/* Starting value of the checksum of each record */
+#define DUMPBIN_CHECKSUM    2166136261u
 
-      default:
-        assert( cmd.eCmd==AR_CMD_UPDATE );
-        rc = arCreateOrUpdateCommand(&cmd, 1, 1);
-        break;
-    }
+/* A growable buffer of bytes */
+typedef struct DumpBuf DumpBuf;
+struct DumpBuf {
+  unsigned char *a;     /* The bytes */
+  size_t n;             /* Number of bytes used */
+  size_t nAlloc;        /* Space allocated for a[] */
+};
+
+/* Make room for at least n more bytes in buffer p */
+static void dumpbuf_reserve(DumpBuf *p, size_t n){
+  if( p->n+n>p->nAlloc ){
+    size_t nNew = p->nAlloc*2 + n + 256;
+    unsigned char *aNew = sqlite3_realloc64(p->a, nNew);
+    if( aNew==0 ) shell_out_of_memory();
+    p->a = aNew;
+    p->nAlloc = nNew;
   }
-end_ar_command:
-  if( cmd.db!=pState->db ){
-    close_db(cmd.db);
+}
+
+/* Append n bytes to buffer p */
+static void dumpbuf_append(DumpBuf *p, const void *pData, size_t n){
+  dumpbuf_reserve(p, n);
+  if( n ) memcpy(&p->a[p->n], pData, n);
+  p->n += n;
+}
+
+/* Store v in a[] as a varint.  Return the number of bytes used */
+static int dumpbin_put_varint(unsigned char *a, sqlite3_uint64 v){
+  int n = 0;
+  while( v>=0x80 ){
+    a[n++] = (unsigned char)(v|0x80);
+    v >>= 7;
   }
-  sqlite3_free(cmd.zSrcTable);
+  a[n++] = (unsigned char)v;
+  return n;
+}
 
-  return rc;
+/* Append v to buffer p as a varint */
+static void dumpbuf_varint(DumpBuf *p, sqlite3_uint64 v){
+  unsigned char a[10];
+  dumpbuf_append(p, a, dumpbin_put_varint(a, v));
 }
-/* End of the ".archive" or ".ar" command logic
-*******************************************************************************/
-#endif /* !defined(SQLITE_OMIT_VIRTUALTABLE) && defined(SQLITE_HAVE_ZLIB) */
 
-#if !defined(SQLITE_OMIT_VIRTUALTABLE) && defined(SQLITE_ENABLE_DBPAGE_VTAB)
 /*
-** If (*pRc) is not SQLITE_OK when this function is called, it is a no-op.
-** Otherwise, the SQL statement or statements in zSql are executed using
-** database connection db and the error code written to *pRc before
-** this function returns.
+** Read a varint from *pz, which must end before zEnd, into *pV and advance
+** *pz past it.  Return 0 if the varint is malformed.
 */
-static void shellExec(sqlite3 *db, int *pRc, const char *zSql){
-  int rc = *pRc;
-  if( rc==SQLITE_OK ){
-    char *zErr = 0;
-    rc = sqlite3_exec(db, zSql, 0, 0, &zErr);
-    if( rc!=SQLITE_OK ){
-      raw_printf(stderr, "SQL error: %s\n", zErr);
+static int dumpbin_get_varint(
+  const unsigned char **pz,
+  const unsigned char *zEnd,
+  sqlite3_uint64 *pV
+){
+  const unsigned char *z = *pz;
+  sqlite3_uint64 v = 0;
+  int iShift;
+  for(iShift=0; z<zEnd && iShift<64; iShift+=7){
+    unsigned char c = *(z++);
+    v |= (sqlite3_uint64)(c&0x7f)<<iShift;
+    if( (c&0x80)==0 ){
+      *pz = z;
+      *pV = v;
+      return 1;
     }
-    *pRc = rc;
   }
+  return 0;
 }
 
-/*
-** Like shellExec(), except that zFmt is a printf() style format string.
-*/
-static void shellExecPrintf(sqlite3 *db, int *pRc, const char *zFmt, ...){
-  char *z = 0;
-  if( *pRc==SQLITE_OK ){
-    va_list ap;
-    va_start(ap, zFmt);
-    z = sqlite3_vmprintf(zFmt, ap);
-    va_end(ap);
-    if( z==0 ){
-      *pRc = SQLITE_NOMEM;
-    }else{
-      shellExec(db, pRc, z);
+/* Continue checksum h over the n bytes of a[] */
+static unsigned int dumpbin_checksum(
+  unsigned int h,
+  const unsigned char *a,
+  size_t n
+){
+  size_t i;
+  for(i=0; i<n; i++){
+    h = (h ^ a[i])*16777619u;
+  }
+  return h;
+}
+
+/* State of a binary .dump */
+typedef struct DumpBinWriter DumpBinWriter;
+struct DumpBinWriter {
+  ShellState *p;        /* The shell, with the database and output */
+  DumpBuf rec;          /* Payload of the record being built */
+  DumpBuf rows;         /* Rows not yet written */
+  int nRow;             /* Number of rows in rows */
+  int bWriteErr;        /* True once a write has failed */
+};
+
+/* Write a record of type eType whose payload is aHead[] then aBody[] */
+static void dumpbin_write(
+  DumpBinWriter *w,
+  int eType,
+  const unsigned char *aHead,
+  size_t nHead,
+  const unsigned char *aBody,
+  size_t nBody
+){
+  FILE *out = w->p->out;
+  unsigned char a[16];
+  unsigned int h;
+  int n;
+  a[0] = (unsigned char)eType;
+  h = dumpbin_checksum(DUMPBIN_CHECKSUM, a, 1);
+  h = dumpbin_checksum(h, aHead, nHead);
+  h = dumpbin_checksum(h, aBody, nBody);
+  n = 1 + dumpbin_put_varint(&a[1], nHead+nBody);
+  if( fwrite(a, 1, n, out)!=(size_t)n
+   || (nHead>0 && fwrite(aHead, 1, nHead, out)!=nHead)
+   || (nBody>0 && fwrite(aBody, 1, nBody, out)!=nBody)
+  ){
+    w->bWriteErr = 1;
+  }
+  a[0] = (unsigned char)(h>>24);
+  a[1] = (unsigned char)(h>>16);
+  a[2] = (unsigned char)(h>>8);
+  a[3] = (unsigned char)h;
+  if( fwrite(a, 1, 4, out)!=4 ) w->bWriteErr = 1;
+}
+
+/* Write a record of type eType whose payload is the text zSql */
+static void dumpbin_write_sql(DumpBinWriter *w, int eType, const char *zSql){
+  dumpbin_write(w, eType, (const unsigned char*)zSql, strlen(zSql), 0, 0);
+}
+
+/* Write the rows gathered so far, if any */
+static void dumpbin_flush_rows(DumpBinWriter *w){
+  unsigned char a[10];
+  if( w->nRow==0 ) return;
+  dumpbin_write(w, 'R', a, dumpbin_put_varint(a, w->nRow), w->rows.a,
+                w->rows.n);
+  w->rows.n = 0;
+  w->nRow = 0;
+}
+
+/* Gather the values of the current row of pStmt, which has nCol columns */
+static void dumpbin_add_row(DumpBinWriter *w, sqlite3_stmt *pStmt, int nCol){
+  DumpBuf *pRows = &w->rows;
+  int i;
+  for(i=0; i<nCol; i++){
+    switch( sqlite3_column_type(pStmt, i) ){
+      case SQLITE_INTEGER: {
+        sqlite3_int64 v = sqlite3_column_int64(pStmt, i);
+        sqlite3_uint64 u = ((sqlite3_uint64)v)<<1;
+        dumpbuf_varint(pRows, 1);
+        dumpbuf_varint(pRows, v<0 ? ~u : u);
+        break;
+      }
+      case SQLITE_FLOAT: {
+        double r = sqlite3_column_double(pStmt, i);
+        sqlite3_uint64 u;
+        unsigned char a[8];
+        int j;
+        memcpy(&u, &r, sizeof(u));
+        for(j=7; j>=0; j--){
+          a[j] = (unsigned char)u;
+          u >>= 8;
+        }
+        dumpbuf_varint(pRows, 2);
+        dumpbuf_append(pRows, a, 8);
+        break;
+      }
+      case SQLITE_TEXT: {
+        const unsigned char *z = sqlite3_column_text(pStmt, i);
+        size_t n = sqlite3_column_bytes(pStmt, i);
+        dumpbuf_varint(pRows, n*2+13);
+        dumpbuf_append(pRows, z, n);
+        break;
+      }
+      case SQLITE_BLOB: {
+        const void *z = sqlite3_column_blob(pStmt, i);
+        size_t n = sqlite3_column_bytes(pStmt, i);
+        dumpbuf_varint(pRows, n*2+12);
+        dumpbuf_append(pRows, z, n);
+        break;
+      }
+      default: {
+        dumpbuf_varint(pRows, 0);
+        break;
+      }
     }
-    sqlite3_free(z);
   }
+  w->nRow++;
+  if( pRows->n>=DUMPBIN_CHUNK_SIZE ) dumpbin_flush_rows(w);
 }
 
 /*
-** If *pRc is not SQLITE_OK when this function is called, it is a no-op.
-** Otherwise, an attempt is made to allocate, zero and return a pointer
-** to a buffer nByte bytes in size. If an OOM error occurs, *pRc is set
-** to SQLITE_NOMEM and NULL returned.
+** The counterpart of dump_callback() for a binary dump.  Each row
+** received consists of a table name, the table type and SQL to create
+** the table, as for dump_callback().
 */
-static void *shellMalloc(int *pRc, sqlite3_int64 nByte){
-  void *pRet = 0;
-  if( *pRc==SQLITE_OK ){
-    pRet = sqlite3_malloc64(nByte);
-    if( pRet==0 ){
-      *pRc = SQLITE_NOMEM;
-    }else{
-      memset(pRet, 0, nByte);
+static int dumpbin_callback(
+  void *pArg,
+  int nArg,
+  char **azArg,
+  char **azNotUsed
+){
+  DumpBinWriter *w = (DumpBinWriter*)pArg;
+  ShellState *p = w->p;
+  const char *zTable;
+  const char *zType;
+  const char *zSql;
+
+  UNUSED_PARAMETER(azNotUsed);
+  if( nArg!=3 || azArg==0 ) return 0;
+  zTable = azArg[0];
+  zType = azArg[1];
+  zSql = azArg[2];
+
+  if( strcmp(zTable, "sqlite_sequence")==0 ){
+    dumpbin_write_sql(w, 'S', "DELETE FROM sqlite_sequence;");
+  }else if( sqlite3_strglob("sqlite_stat?", zTable)==0 ){
+    dumpbin_write_sql(w, 'S', "ANALYZE sqlite_master;");
+  }else if( strncmp(zTable, "sqlite_", 7)==0 ){
+    return 0;
+  }else if( strncmp(zSql, "CREATE VIRTUAL TABLE", 20)==0 ){
+    char *zIns;
+    if( !p->writableSchema ){
+      dumpbin_write_sql(w, 'S', "PRAGMA writable_schema=ON;");
+      p->writableSchema = 1;
+    }
+    zIns = sqlite3_mprintf(
+       "INSERT INTO sqlite_master(type,name,tbl_name,rootpage,sql)"
+       "VALUES('table','%q','%q',0,'%q');",
+       zTable, zTable, zSql);
+    if( zIns==0 ) shell_out_of_memory();
+    dumpbin_write_sql(w, 'S', zIns);
+    sqlite3_free(zIns);
+    return w->bWriteErr;
+  }else if( sqlite3_strglob("CREATE TABLE ['\"]*", zSql)==0 ){
+    char *zCreate = sqlite3_mprintf("CREATE TABLE IF NOT EXISTS %s", zSql+13);
+    if( zCreate==0 ) shell_out_of_memory();
+    dumpbin_write_sql(w, 'S', zCreate);
+    sqlite3_free(zCreate);
+  }else{
+    dumpbin_write_sql(w, 'S', zSql);
+  }
+
+  if( strcmp(zType, "table")==0 ){
+    ShellText sSelect;
+    ShellText sTable;
+    sqlite3_stmt *pStmt = 0;
+    int nCol;
+    int rc;
+
+    if( !dump_table_text(p, zTable, &sTable, &sSelect) ){
+      p->nErr++;
+      return w->bWriteErr;
+    }
+    rc = sqlite3_prepare_v2(p->db, sSelect.z, -1, &pStmt, 0);
+    if( rc==SQLITE_OK ){
+      size_t nTable = strlen(zTable);
+      nCol = sqlite3_column_count(pStmt);
+      w->rec.n = 0;
+      dumpbuf_varint(&w->rec, nCol);
+      dumpbuf_varint(&w->rec, nTable);
+      dumpbuf_append(&w->rec, zTable, nTable);
+      dumpbuf_append(&w->rec, sTable.z, strlen(sTable.z));
+      dumpbin_write(w, 'T', w->rec.a, w->rec.n, 0, 0);
+      while( !w->bWriteErr && (rc = sqlite3_step(pStmt))==SQLITE_ROW ){
+        dumpbin_add_row(w, pStmt, nCol);
+      }
+      dumpbin_flush_rows(w);
+      if( rc==SQLITE_ROW || rc==SQLITE_DONE ) rc = SQLITE_OK;
+    }
+    if( rc!=SQLITE_OK ){
+      utf8_printf(stderr, "Error: %s: %s\n", zTable, sqlite3_errmsg(p->db));
+      p->nErr++;
     }
+    sqlite3_finalize(pStmt);
+    freeText(&sTable);
+    freeText(&sSelect);
   }
-  return pRet;
+  return w->bWriteErr;
+}
+
+/* Callback which writes the SQL of indexes, triggers and views */
+static int dumpbin_late_callback(
+  void *pArg,
+  int nArg,
+  char **azArg,
+  char **azNotUsed
+){
+  DumpBinWriter *w = (DumpBinWriter*)pArg;
+  UNUSED_PARAMETER(azNotUsed);
+  if( nArg!=1 || azArg==0 || azArg[0]==0 ) return 0;
+  dumpbin_write_sql(w, 'L', azArg[0]);
+  return w->bWriteErr;
+}
+
+/* Run zQuery on p->db with callback xCallback, counting any error */
+static void dumpbin_query(
+  DumpBinWriter *w,
+  const char *zQuery,
+  int (*xCallback)(void*,int,char**,char**)
+){
+  char *zErr = 0;
+  int rc = sqlite3_exec(w->p->db, zQuery, xCallback, w, &zErr);
+  if( rc!=SQLITE_OK && !w->bWriteErr ){
+    utf8_printf(stderr, "Error: %s\n", zErr ? zErr : sqlite3_errmsg(w->p->db));
+    w->p->nErr++;
+  }
+  sqlite3_free(zErr);
 }
 
 /*
-** If *pRc is not SQLITE_OK when this function is called, it is a no-op.
-** Otherwise, zFmt is treated as a printf() style string. The result of
-** formatting it along with any trailing arguments is written into a 
-** buffer obtained from sqlite3_malloc(), and pointer to which is returned.
-** It is the responsibility of the caller to eventually free this buffer
-** using a call to sqlite3_free().
-** 
-** If an OOM error occurs, (*pRc) is set to SQLITE_NOMEM and a NULL 
-** pointer returned.
+** Write a binary dump of the database to p->out, of the tables whose names
+** are LIKE zLike, or of every table if zLike is NULL.  Return 0 on success,
+** or 1 if the dump could not be written.
 */
-static char *shellMPrintf(int *pRc, const char *zFmt, ...){
-  char *z = 0;
-  if( *pRc==SQLITE_OK ){
-    va_list ap;
-    va_start(ap, zFmt);
-    z = sqlite3_vmprintf(zFmt, ap);
-    va_end(ap);
-    if( z==0 ){
-      *pRc = SQLITE_NOMEM;
-    }
+static int dump_binary(ShellState *p, const char *zLike){
+  DumpBinWriter w;
+  unsigned char a[10];
+  char *zSql;
+
+  memset(&w, 0, sizeof(w));
+  w.p = p;
+  setBinaryMode(p->out, 1);
+  if( fwrite(DUMPBIN_MAGIC, 1, 8, p->out)!=8 ) w.bWriteErr = 1;
+  p->writableSchema = 0;
+  p->nErr = 0;
+  sqlite3_exec(p->db, "SAVEPOINT dump; PRAGMA writable_schema=ON", 0, 0, 0);
+  if( zLike==0 ){
+    dumpbin_query(&w,
+      "SELECT name, type, sql FROM sqlite_master "
+      "WHERE sql NOT NULL AND type=='table' AND name!='sqlite_sequence'",
+      dumpbin_callback
+    );
+    dumpbin_query(&w,
+      "SELECT name, type, sql FROM sqlite_master "
+      "WHERE name=='sqlite_sequence'",
+      dumpbin_callback
+    );
+    dumpbin_query(&w,
+      "SELECT sql FROM sqlite_master "
+      "WHERE sql NOT NULL AND type IN ('index','trigger','view')",
+      dumpbin_late_callback
+    );
+  }else{
+    zSql = sqlite3_mprintf(
+      "SELECT name, type, sql FROM sqlite_master "
+      "WHERE tbl_name LIKE %Q AND type=='table'"
+      "  AND sql NOT NULL", zLike);
+    dumpbin_query(&w, zSql, dumpbin_callback);
+    sqlite3_free(zSql);
+    zSql = sqlite3_mprintf(
+      "SELECT sql FROM sqlite_master "
+      "WHERE sql NOT NULL"
+      "  AND type IN ('index','trigger','view')"
+      "  AND tbl_name LIKE %Q", zLike);
+    dumpbin_query(&w, zSql, dumpbin_late_callback);
+    sqlite3_free(zSql);
+  }
+  if( p->writableSchema ){
+    dumpbin_write_sql(&w, 'L', "PRAGMA writable_schema=OFF;");
+    p->writableSchema = 0;
+  }
+  sqlite3_exec(p->db, "PRAGMA writable_schema=OFF;", 0, 0, 0);
+  sqlite3_exec(p->db, "RELEASE dump;", 0, 0, 0);
+  dumpbin_write(&w, 'E', a, dumpbin_put_varint(a, p->nErr), 0, 0);
+  if( fflush(p->out) ) w.bWriteErr = 1;
+  setTextMode(p->out, 1);
+  sqlite3_free(w.rec.a);
+  sqlite3_free(w.rows.a);
+  if( w.bWriteErr ){
+    raw_printf(stderr, "Error: cannot write the dump\n");
+    return 1;
   }
-  return z;
+  return 0;
 }
 
-/*
-** When running the ".recover" command, each output table, and the special
-** orphaned row table if it is required, is represented by an instance
-** of the following struct.
-*/
-typedef struct RecoverTable RecoverTable;
-struct RecoverTable {
-  char *zQuoted;                  /* Quoted version of table name */
-  int nCol;                       /* Number of columns in table */
-  char **azlCol;                  /* Array of column lists */
-  int iPk;                        /* Index of IPK column */
+/* A reader of the records of a binary dump */
+typedef struct DumpBinReader DumpBinReader;
+struct DumpBinReader {
+  FILE *in;             /* The dump */
+  const char *zFile;    /* Name of the dump, for error messages */
+  int eType;            /* Type of the last record read */
+  DumpBuf rec;          /* Payload of the last record read */
 };
 
 /*
-** Free a RecoverTable object allocated by recoverFindTable() or
-** recoverOrphanTable().
+** Read the next record of a binary dump.  Its payload is followed by a
+** zero byte, so SQL text may be used as is.  Return 1 on success, or
+** print an error and return 0 if the dump is truncated or corrupt.
 */
-static void recoverFreeTable(RecoverTable *pTab){
-  if( pTab ){
-    sqlite3_free(pTab->zQuoted);
-    if( pTab->azlCol ){
-      int i;
-      for(i=0; i<=pTab->nCol; i++){
-        sqlite3_free(pTab->azlCol[i]);
-      }
-      sqlite3_free(pTab->azlCol);
-    }
-    sqlite3_free(pTab);
+static int dumpbin_read(DumpBinReader *r){
+  unsigned char a[4];
+  sqlite3_uint64 n = 0;
+  unsigned char t;
+  unsigned int h;
+  int iShift = 0;
+  int c;
+  r->eType = fgetc(r->in);
+  if( r->eType==EOF ) goto dumpbin_read_truncated;
+  do{
+    c = fgetc(r->in);
+    if( c==EOF ) goto dumpbin_read_truncated;
+    if( iShift>=35 ) goto dumpbin_read_corrupt;
+    n |= (sqlite3_uint64)(c&0x7f)<<iShift;
+    iShift += 7;
+  }while( c&0x80 );
+  if( n>0x7fffffff ) goto dumpbin_read_corrupt;
+
+  /* The length comes from the dump, so grow the buffer only as the bytes
+  ** of the payload arrive.  A corrupt length then reads as a truncated
+  ** dump, rather than asking for more memory than the dump could fill. */
+  r->rec.n = 0;
+  while( r->rec.n<n ){
+    size_t nChunk = (size_t)n - r->rec.n;
+    if( nChunk>DUMPBIN_CHUNK_SIZE ) nChunk = DUMPBIN_CHUNK_SIZE;
+    dumpbuf_reserve(&r->rec, nChunk+1);
+    if( fread(r->rec.a + r->rec.n, 1, nChunk, r->in)!=nChunk ){
+      goto dumpbin_read_truncated;
+    }
+    r->rec.n += nChunk;
+  }
+  if( fread(a, 1, 4, r->in)!=4 ) goto dumpbin_read_truncated;
+  dumpbuf_reserve(&r->rec, 1);
+  r->rec.a[n] = 0;
+  t = (unsigned char)r->eType;
+  h = dumpbin_checksum(DUMPBIN_CHECKSUM, &t, 1);
+  h = dumpbin_checksum(h, r->rec.a, r->rec.n);
+  if( h!=(((unsigned int)a[0]<<24) | ((unsigned int)a[1]<<16)
+          | ((unsigned int)a[2]<<8) | a[3]) ){
+    goto dumpbin_read_corrupt;
   }
+  return 1;
+
+dumpbin_read_truncated:
+  utf8_printf(stderr, "Error: %s: dump is truncated\n", r->zFile);
+  return 0;
+
+dumpbin_read_corrupt:
+  utf8_printf(stderr, "Error: %s: dump is corrupt\n", r->zFile);
+  return 0;
 }
 
 /*
-** This function is a no-op if (*pRc) is not SQLITE_OK when it is called.
-** Otherwise, it allocates and returns a RecoverTable object based on the
-** final four arguments passed to this function. It is the responsibility
-** of the caller to eventually free the returned object using
-** recoverFreeTable().
+** Prepare a statement on db which inserts a row of nCol values into
+** zTarget, which is the text following "INSERT INTO" from a 'T' record.
+** Print an error and return NULL if it can't be prepared.
 */
-static RecoverTable *recoverNewTable(
-  int *pRc,                       /* IN/OUT: Error code */
-  const char *zName,              /* Name of table */
-  const char *zSql,               /* CREATE TABLE statement */
-  int bIntkey, 
+static sqlite3_stmt *dumpbin_prepare_insert(
+  sqlite3 *db,
+  const char *zTarget,
   int nCol
 ){
-  sqlite3 *dbtmp = 0;             /* sqlite3 handle for testing CREATE TABLE */
-  int rc = *pRc;
-  RecoverTable *pTab = 0;
-
-  pTab = (RecoverTable*)shellMalloc(&rc, sizeof(RecoverTable));
-  if( rc==SQLITE_OK ){
-    int nSqlCol = 0;
-    int bSqlIntkey = 0;
-    sqlite3_stmt *pStmt = 0;
-    
-    rc = sqlite3_open("", &dbtmp);
-    if( rc==SQLITE_OK ){
-      sqlite3_create_function(dbtmp, "shell_idquote", 1, SQLITE_UTF8, 0,
-                              shellIdQuote, 0, 0);
-    }
-    if( rc==SQLITE_OK ){
-      rc = sqlite3_exec(dbtmp, "PRAGMA writable_schema = on", 0, 0, 0);
-    }
-    if( rc==SQLITE_OK ){
-      rc = sqlite3_exec(dbtmp, zSql, 0, 0, 0);
-      if( rc==SQLITE_ERROR ){
-        rc = SQLITE_OK;
-        goto finished;
-      }
-    }
-    shellPreparePrintf(dbtmp, &rc, &pStmt, 
-        "SELECT count(*) FROM pragma_table_info(%Q)", zName
-    );
-    if( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
-      nSqlCol = sqlite3_column_int(pStmt, 0);
-    }
-    shellFinalize(&rc, pStmt);
-
-    if( rc!=SQLITE_OK || nSqlCol<nCol ){
-      goto finished;
-    }
-
-    shellPreparePrintf(dbtmp, &rc, &pStmt, 
-      "SELECT ("
-      "  SELECT substr(data,1,1)==X'0D' FROM sqlite_dbpage WHERE pgno=rootpage"
-      ") FROM sqlite_master WHERE name = %Q", zName
-    );
-    if( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
-      bSqlIntkey = sqlite3_column_int(pStmt, 0);
-    }
-    shellFinalize(&rc, pStmt);
+  sqlite3_stmt *pStmt = 0;
+  ShellText s;
+  int i;
+  initText(&s);
+  appendText(&s, "INSERT INTO ", 0);
+  appendText(&s, zTarget, 0);
+  appendText(&s, " VALUES(?", 0);
+  for(i=1; i<nCol; i++) appendText(&s, ",?", 0);
+  appendText(&s, ")", 0);
+  if( sqlite3_prepare_v2(db, s.z, -1, &pStmt, 0)!=SQLITE_OK ){
+    utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(db));
+  }
+  freeText(&s);
+  return pStmt;
+}
 
-    if( bIntkey==bSqlIntkey ){
-      int i;
-      const char *zPk = "_rowid_";
-      sqlite3_stmt *pPkFinder = 0;
+/*
+** Insert the rows of the payload a[0..n-1] of an 'R' record through pStmt,
+** which takes nCol values.  A row which can't be inserted is reported and
+** counted in *pnErr.  Return 0 on success, or 1 if the payload is corrupt.
+*/
+static int dumpbin_insert_rows(
+  sqlite3_stmt *pStmt,
+  int nCol,
+  const unsigned char *a,
+  size_t n,
+  int *pnErr
+){
+  const unsigned char *z = a;
+  const unsigned char *zEnd = a+n;
+  sqlite3_uint64 nRow;
+  sqlite3_uint64 iRow;
+  sqlite3_uint64 t;
+  sqlite3_uint64 v;
+  int i;
 
-      /* If this is an intkey table and there is an INTEGER PRIMARY KEY,
-      ** set zPk to the name of the PK column, and pTab->iPk to the index
-      ** of the column, where columns are 0-numbered from left to right.
-      ** Or, if this is a WITHOUT ROWID table or if there is no IPK column,
-      ** leave zPk as "_rowid_" and pTab->iPk at -2.  */
-      pTab->iPk = -2;
-      if( bIntkey ){
-        shellPreparePrintf(dbtmp, &rc, &pPkFinder, 
-          "SELECT cid, name FROM pragma_table_info(%Q) "
-          "  WHERE pk=1 AND type='integer' COLLATE nocase"
-          "  AND NOT EXISTS (SELECT cid FROM pragma_table_info(%Q) WHERE pk=2)"
-          , zName, zName
-        );
-        if( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pPkFinder) ){
-          pTab->iPk = sqlite3_column_int(pPkFinder, 0);
-          zPk = (const char*)sqlite3_column_text(pPkFinder, 1);
+  if( !dumpbin_get_varint(&z, zEnd, &nRow) ) return 1;
+  for(iRow=0; iRow<nRow; iRow++){
+    for(i=1; i<=nCol; i++){
+      if( !dumpbin_get_varint(&z, zEnd, &t) ) return 1;
+      if( t==0 ){
+        sqlite3_bind_null(pStmt, i);
+      }else if( t==1 ){
+        if( !dumpbin_get_varint(&z, zEnd, &v) ) return 1;
+        sqlite3_bind_int64(pStmt, i, (sqlite3_int64)((v>>1) ^ (0-(v&1))));
+      }else if( t==2 ){
+        double r;
+        int j;
+        if( zEnd-z<8 ) return 1;
+        for(j=0, v=0; j<8; j++) v = (v<<8) | z[j];
+        memcpy(&r, &v, sizeof(r));
+        sqlite3_bind_double(pStmt, i, r);
+        z += 8;
+      }else if( t>=12 ){
+        sqlite3_uint64 nByte = (t-12)/2;
+        if( nByte>(sqlite3_uint64)(zEnd-z) ) return 1;
+        if( t&1 ){
+          sqlite3_bind_text(pStmt, i, (const char*)z, (int)nByte,
+                            SQLITE_STATIC);
+        }else{
+          sqlite3_bind_blob(pStmt, i, z, (int)nByte, SQLITE_STATIC);
         }
-      }
-
-      pTab->zQuoted = shellMPrintf(&rc, "\"%w\"", zName);
-      pTab->azlCol = (char**)shellMalloc(&rc, sizeof(char*) * (nSqlCol+1));
-      pTab->nCol = nSqlCol;
-
-      if( bIntkey ){
-        pTab->azlCol[0] = shellMPrintf(&rc, "\"%w\"", zPk);
+        z += nByte;
       }else{
-        pTab->azlCol[0] = shellMPrintf(&rc, "");
-      }
-      i = 1;
-      shellPreparePrintf(dbtmp, &rc, &pStmt, 
-          "SELECT %Q || group_concat(shell_idquote(name), ', ') "
-          "  FILTER (WHERE cid!=%d) OVER (ORDER BY %s cid) "
-          "FROM pragma_table_info(%Q)", 
-          bIntkey ? ", " : "", pTab->iPk, 
-          bIntkey ? "" : "(CASE WHEN pk=0 THEN 1000000 ELSE pk END), ",
-          zName
-      );
-      while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
-        const char *zText = (const char*)sqlite3_column_text(pStmt, 0);
-        pTab->azlCol[i] = shellMPrintf(&rc, "%s%s", pTab->azlCol[0], zText);
-        i++;
+        return 1;
       }
-      shellFinalize(&rc, pStmt);
-
-      shellFinalize(&rc, pPkFinder);
     }
+    if( sqlite3_step(pStmt)!=SQLITE_DONE ){
+      utf8_printf(stderr, "Error: %s\n",
+                  sqlite3_errmsg(sqlite3_db_handle(pStmt)));
+      (*pnErr)++;
+    }
+    sqlite3_reset(pStmt);
   }
-
- finished:
-  sqlite3_close(dbtmp);
-  *pRc = rc;
-  if( rc!=SQLITE_OK || (pTab && pTab->zQuoted==0) ){
-    recoverFreeTable(pTab);
-    pTab = 0;
-  }
-  return pTab;
+  return z!=zEnd;
 }
 
 /*
-** This function is called to search the schema recovered from the
-** sqlite_master table of the (possibly) corrupt database as part
-** of a ".recover" command. Specifically, for a table with root page
-** iRoot and at least nCol columns. Additionally, if bIntkey is 0, the
-** table must be a WITHOUT ROWID table, or if non-zero, not one of
-** those.
-**
-** If a table is found, a (RecoverTable*) object is returned. Or, if
-** no such table is found, but bIntkey is false and iRoot is the 
-** root page of an index in the recovered schema, then (*pbNoop) is
-** set to true and NULL returned. Or, if there is no such table or
-** index, NULL is returned and (*pbNoop) set to 0, indicating that
-** the caller should write data to the orphans table.
+** Parse the payload of the 'T' record last read by r into the number of
+** columns, the table name and the INSERT target, which are to be freed
+** with sqlite3_free().  Return 0 if the payload is corrupt.
 */
-static RecoverTable *recoverFindTable(
-  ShellState *pState,             /* Shell state object */
-  int *pRc,                       /* IN/OUT: Error code */
-  int iRoot,                      /* Root page of table */
-  int bIntkey,                    /* True for an intkey table */
-  int nCol,                       /* Number of columns in table */
-  int *pbNoop                     /* OUT: True if iRoot is root of index */
+static int dumpbin_parse_table(
+  DumpBinReader *r,
+  int *pnCol,
+  char **pzName,
+  char **pzTarget
 ){
-  sqlite3_stmt *pStmt = 0;
-  RecoverTable *pRet = 0;
-  int bNoop = 0;
-  const char *zSql = 0;
-  const char *zName = 0;
-
-  /* Search the recovered schema for an object with root page iRoot. */
-  shellPreparePrintf(pState->db, pRc, &pStmt,
-      "SELECT type, name, sql FROM recovery.schema WHERE rootpage=%d", iRoot
-  );
-  while( *pRc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
-    const char *zType = (const char*)sqlite3_column_text(pStmt, 0);
-    if( bIntkey==0 && sqlite3_stricmp(zType, "index")==0 ){
-      bNoop = 1;
-      break;
-    }
-    if( sqlite3_stricmp(zType, "table")==0 ){
-      zName = (const char*)sqlite3_column_text(pStmt, 1);
-      zSql = (const char*)sqlite3_column_text(pStmt, 2);
-      pRet = recoverNewTable(pRc, zName, zSql, bIntkey, nCol);
-      break;
-    }
+  const unsigned char *z = r->rec.a;
+  const unsigned char *zEnd = z + r->rec.n;
+  sqlite3_uint64 nCol;
+  sqlite3_uint64 nName;
+  if( !dumpbin_get_varint(&z, zEnd, &nCol)
+   || !dumpbin_get_varint(&z, zEnd, &nName)
+   || nCol==0 || nCol>32767
+   || nName>=(sqlite3_uint64)(zEnd-z)
+  ){
+    return 0;
   }
+  *pnCol = (int)nCol;
+  *pzName = sqlite3_mprintf("%.*s", (int)nName, z);
+  *pzTarget = sqlite3_mprintf("%s", z+nName);
+  if( *pzName==0 || *pzTarget==0 ) shell_out_of_memory();
+  return 1;
+}
 
-  shellFinalize(pRc, pStmt);
-  *pbNoop = bNoop;
-  return pRet;
+#if SHELL_USE_PTHREADS
+/*
+** Return a name for the i-th scratch database zTag of the shell, next to
+** the database zBase, made unique by a random suffix.  Return NULL if a
+** file of that name exists anyway, since that file isn't the shell's to
+** overwrite or to delete.
+*/
+static char *shell_scratch_name(const char *zBase, const char *zTag, int i){
+  sqlite3_vfs *pVfs = sqlite3_vfs_find(0);
+  sqlite3_uint64 r;
+  int bExists = 1;
+  char *z;
+  sqlite3_randomness(sizeof(r), &r);
+  z = sqlite3_mprintf("%s-%s%d-%016llx", zBase, zTag, i, r);
+  if( z==0 ) shell_out_of_memory();
+  if( pVfs==0
+   || pVfs->xAccess(pVfs, z, SQLITE_ACCESS_EXISTS, &bExists)!=SQLITE_OK
+   || bExists
+  ){
+    sqlite3_free(z);
+    return 0;
+  }
+  return z;
 }
 
 /*
-** Return a RecoverTable object representing the orphans table.
+** A parallel .restore-dump loads the content of ordinary tables on worker
+** threads.  Each worker has a scratch database of its own, next to the
+** database being restored, and loads each table it is given into a copy
+** of that table there.  The scratch databases are attached to the main
+** connection before its transaction begins.  Once every table is loaded,
+** the main thread copies each one into place with "INSERT INTO ... SELECT
+** *", which SQLite does by copying whole records, within the same
+** transaction as the rest of the restore.
 */
-static RecoverTable *recoverOrphanTable(
-  ShellState *pState,             /* Shell state object */
-  int *pRc,                       /* IN/OUT: Error code */
-  const char *zLostAndFound,      /* Base name for orphans table */
-  int nCol                        /* Number of user data columns */
-){
-  RecoverTable *pTab = 0;
-  if( nCol>=0 && *pRc==SQLITE_OK ){
-    int i;
 
-    /* This block determines the name of the orphan table. The prefered
-    ** name is zLostAndFound. But if that clashes with another name
-    ** in the recovered schema, try zLostAndFound_0, zLostAndFound_1
-    ** and so on until a non-clashing name is found.  */
-    int iTab = 0;
-    char *zTab = shellMPrintf(pRc, "%s", zLostAndFound);
-    sqlite3_stmt *pTest = 0;
-    shellPrepare(pState->db, pRc,
-        "SELECT 1 FROM recovery.schema WHERE name=?", &pTest
-    );
-    if( pTest ) sqlite3_bind_text(pTest, 1, zTab, -1, SQLITE_TRANSIENT);
-    while( *pRc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pTest) ){
-      shellReset(pRc, pTest);
-      sqlite3_free(zTab);
-      zTab = shellMPrintf(pRc, "%s_%d", zLostAndFound, iTab++);
-      sqlite3_bind_text(pTest, 1, zTab, -1, SQLITE_TRANSIENT);
+/* An 'R' record waiting to be inserted by a worker */
+typedef struct RestoreChunk RestoreChunk;
+struct RestoreChunk {
+  RestoreChunk *pNext;    /* Next chunk of the same table */
+  size_t n;               /* Size of the payload */
+  unsigned char *a;       /* The payload */
+};
+
+/* A table whose content is loaded by a worker */
+typedef struct RestoreJob RestoreJob;
+struct RestoreJob {
+  RestoreJob *pNext;      /* Next table in the dump */
+  char *zName;            /* Name of the table */
+  char *zTarget;          /* Text which follows "INSERT INTO" */
+  char *zCreate;          /* SQL which created the table */
+  int nCol;               /* Number of values in each row */
+  RestoreChunk *pFirst;   /* Chunks waiting to be inserted, oldest first */
+  RestoreChunk *pLast;    /* Last chunk of the pFirst list */
+  int bEof;               /* True once every chunk has been queued */
+  int bDone;              /* True once the worker has finished */
+  int iWorker;            /* Worker whose scratch database has the table */
+  int nErr;               /* Errors seen by the worker */
+};
+
+typedef struct RestorePipeline RestorePipeline;
+
+/* A worker thread of a parallel .restore-dump */
+typedef struct RestoreWorker RestoreWorker;
+struct RestoreWorker {
+  RestorePipeline *pPipe; /* The work to share */
+  char *zScratch;         /* Name of the scratch database */
+  sqlite3 *db;            /* Connection to the scratch database */
+  pthread_t thread;       /* The thread itself */
+  int bAttached;          /* True once attached to the main connection */
+};
+
+/* State shared by the threads of a parallel .restore-dump */
+struct RestorePipeline {
+  RestoreWorker *aWorker; /* The workers */
+  int nWorker;            /* Number of workers started */
+  size_t mxQueued;        /* Most bytes of chunks queued at once */
+  RestoreJob *pFirst;     /* Every table handed to the workers, in order */
+  RestoreJob *pLast;      /* Last table of the pFirst list */
+  pthread_mutex_t mutex;  /* Protects all fields below */
+  pthread_cond_t cond;    /* Broadcast whenever a field below changes */
+  RestoreJob *pNextJob;   /* First table no worker has claimed yet */
+  size_t nQueued;         /* Bytes of chunks queued and not yet taken */
+  int bEof;               /* True once no more tables will be added */
+};
+
+/* Most bytes of rows queued for the workers of a parallel .restore-dump */
+#define RESTORE_MAX_QUEUED  (64*1024*1024)
+
+/* Body of each worker thread of a parallel .restore-dump */
+static void *restore_worker_main(void *pArg){
+  RestoreWorker *pWorker = (RestoreWorker*)pArg;
+  RestorePipeline *pPipe = pWorker->pPipe;
+  pthread_mutex_lock(&pPipe->mutex);
+  while( 1 ){
+    RestoreJob *pJob;
+    sqlite3_stmt *pStmt = 0;
+    int nErr = 0;
+    while( pPipe->pNextJob==0 && !pPipe->bEof ){
+      pthread_cond_wait(&pPipe->cond, &pPipe->mutex);
+    }
+    pJob = pPipe->pNextJob;
+    if( pJob==0 ) break;
+    pPipe->pNextJob = pJob->pNext;
+    pJob->iWorker = (int)(pWorker - pPipe->aWorker);
+    pthread_mutex_unlock(&pPipe->mutex);
+
+    if( sqlite3_exec(pWorker->db, pJob->zCreate, 0, 0, 0)==SQLITE_OK ){
+      pStmt = dumpbin_prepare_insert(pWorker->db, pJob->zTarget, pJob->nCol);
+    }else{
+      utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(pWorker->db));
     }
-    shellFinalize(pRc, pTest);
+    if( pStmt==0 ) nErr++;
+    sqlite3_exec(pWorker->db, "BEGIN", 0, 0, 0);
 
-    pTab = (RecoverTable*)shellMalloc(pRc, sizeof(RecoverTable));
-    if( pTab ){
-      pTab->zQuoted = shellMPrintf(pRc, "\"%w\"", zTab);
-      pTab->nCol = nCol;
-      pTab->iPk = -2;
-      if( nCol>0 ){
-        pTab->azlCol = (char**)shellMalloc(pRc, sizeof(char*) * (nCol+1));
-        if( pTab->azlCol ){
-          pTab->azlCol[nCol] = shellMPrintf(pRc, "");
-          for(i=nCol-1; i>=0; i--){
-            pTab->azlCol[i] = shellMPrintf(pRc, "%s, NULL", pTab->azlCol[i+1]);
-          }
-        }
+    pthread_mutex_lock(&pPipe->mutex);
+    while( 1 ){
+      RestoreChunk *pChunk;
+      while( pJob->pFirst==0 && !pJob->bEof ){
+        pthread_cond_wait(&pPipe->cond, &pPipe->mutex);
+      }
+      pChunk = pJob->pFirst;
+      if( pChunk==0 ) break;
+      pJob->pFirst = pChunk->pNext;
+      if( pJob->pFirst==0 ) pJob->pLast = 0;
+      pPipe->nQueued -= pChunk->n;
+      pthread_cond_broadcast(&pPipe->cond);
+      pthread_mutex_unlock(&pPipe->mutex);
+      if( pStmt
+       && dumpbin_insert_rows(pStmt, pJob->nCol, pChunk->a, pChunk->n, &nErr)
+      ){
+        utf8_printf(stderr, "Error: rows of %s are corrupt\n", pJob->zName);
+        nErr++;
       }
+      sqlite3_free(pChunk);
+      pthread_mutex_lock(&pPipe->mutex);
+    }
+    pthread_mutex_unlock(&pPipe->mutex);
 
-      if( *pRc!=SQLITE_OK ){
-        recoverFreeTable(pTab);
-        pTab = 0;
-      }else{
-        raw_printf(pState->out, 
-            "CREATE TABLE %s(rootpgno INTEGER, "
-            "pgno INTEGER, nfield INTEGER, id INTEGER", pTab->zQuoted
-        );
-        for(i=0; i<nCol; i++){
-          raw_printf(pState->out, ", c%d", i);
-        }
-        raw_printf(pState->out, ");\n");
-      }
+    sqlite3_finalize(pStmt);
+    if( sqlite3_exec(pWorker->db, "COMMIT", 0, 0, 0)!=SQLITE_OK ){
+      utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(pWorker->db));
+      nErr++;
     }
-    sqlite3_free(zTab);
+    pthread_mutex_lock(&pPipe->mutex);
+    pJob->nErr = nErr;
+    pJob->bDone = 1;
+    pthread_cond_broadcast(&pPipe->cond);
   }
-  return pTab;
+  pthread_mutex_unlock(&pPipe->mutex);
+  return 0;
 }
 
 /*
-** This function is called to recover data from the database. A script
-** to construct a new database containing all recovered data is output
-** on stream pState->out.
+** Start nThread workers to restore a dump into p->db, attaching their
+** scratch databases to it.  There must be no transaction open on p->db.
+** Return NULL if they can't be started, in which case the dump must be
+** restored on the main thread.
 */
-static int recoverDatabaseCmd(ShellState *pState, int nArg, char **azArg){
-  int rc = SQLITE_OK;
-  sqlite3_stmt *pLoop = 0;        /* Loop through all root pages */
-  sqlite3_stmt *pPages = 0;       /* Loop through all pages in a group */
-  sqlite3_stmt *pCells = 0;       /* Loop through all cells in a page */
-  const char *zRecoveryDb = "";   /* Name of "recovery" database */
-  const char *zLostAndFound = "lost_and_found";
+static RestorePipeline *restore_start(ShellState *p, int nThread){
+  RestorePipeline *pPipe;
+  const char *zMain = sqlite3_db_filename(p->db, "main");
+  int nAttach;
   int i;
-  int nOrphan = -1;
-  RecoverTable *pOrphan = 0;
 
-  int bFreelist = 1;              /* 0 if --freelist-corrupt is specified */
-  int bRowids = 1;                /* 0 if --no-rowids */
-  for(i=1; i<nArg; i++){
-    char *z = azArg[i];
-    int n;
-    if( z[0]=='-' && z[1]=='-' ) z++;
-    n = strlen30(z);
-    if( n<=17 && memcmp("-freelist-corrupt", z, n)==0 ){
-      bFreelist = 0;
-    }else
-    if( n<=12 && memcmp("-recovery-db", z, n)==0 && i<(nArg-1) ){
-      i++;
-      zRecoveryDb = azArg[i];
-    }else
-    if( n<=15 && memcmp("-lost-and-found", z, n)==0 && i<(nArg-1) ){
-      i++;
-      zLostAndFound = azArg[i];
-    }else
-    if( n<=10 && memcmp("-no-rowids", z, n)==0 ){
-      bRowids = 0;
+  /* Each scratch database is attached to p->db in the end */
+  nAttach = sqlite3_limit(p->db, SQLITE_LIMIT_ATTACHED, -1)
+          - (db_int(p, "SELECT count(*) FROM pragma_database_list") - 2);
+  if( nThread>nAttach ) nThread = nAttach;
+  if( sqlite3_threadsafe()==0 || zMain==0 || zMain[0]==0 || nThread<=0 ){
+    return 0;
+  }
+  pPipe = sqlite3_malloc64(sizeof(*pPipe));
+  if( pPipe==0 ) shell_out_of_memory();
+  memset(pPipe, 0, sizeof(*pPipe));
+  pPipe->aWorker = sqlite3_malloc64(nThread*sizeof(pPipe->aWorker[0]));
+  if( pPipe->aWorker==0 ) shell_out_of_memory();
+  memset(pPipe->aWorker, 0, nThread*sizeof(pPipe->aWorker[0]));
+  pPipe->mxQueued = RESTORE_MAX_QUEUED;
+  pthread_mutex_init(&pPipe->mutex, 0);
+  pthread_cond_init(&pPipe->cond, 0);
+  for(i=0; i<nThread; i++){
+    RestoreWorker *pWorker = &pPipe->aWorker[i];
+    char *zSql;
+    pWorker->pPipe = pPipe;
+    pWorker->zScratch = shell_scratch_name(zMain, "restore", i);
+    if( pWorker->zScratch==0 ) break;
+    zSql = sqlite3_mprintf("ATTACH %Q AS restore%d", pWorker->zScratch, i);
+    if( zSql==0 ) shell_out_of_memory();
+    if( sqlite3_open_v2(pWorker->zScratch, &pWorker->db,
+                        SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE
+                        |SQLITE_OPEN_NOMUTEX, 0)==SQLITE_OK
+     && sqlite3_exec(pWorker->db,
+                     "PRAGMA journal_mode=OFF; PRAGMA synchronous=OFF",
+                     0, 0, 0)==SQLITE_OK
+     && sqlite3_exec(p->db, zSql, 0, 0, 0)==SQLITE_OK
+    ){
+      pWorker->bAttached = 1;
     }
-    else{
-      utf8_printf(stderr, "unexpected option: %s\n", azArg[i]); 
-      showHelp(pState->out, azArg[0]);
-      return 1;
+    sqlite3_free(zSql);
+    if( !pWorker->bAttached
+     || pthread_create(&pWorker->thread, 0, restore_worker_main, pWorker)
+    ){
+      if( pWorker->bAttached ){
+        zSql = sqlite3_mprintf("DETACH restore%d", i);
+        sqlite3_exec(p->db, zSql, 0, 0, 0);
+        sqlite3_free(zSql);
+        pWorker->bAttached = 0;
+      }
+      sqlite3_close(pWorker->db);
+      pWorker->db = 0;
+      shellDeleteFile(pWorker->zScratch);
+      sqlite3_free(pWorker->zScratch);
+      pWorker->zScratch = 0;
+      break;
     }
+    pPipe->nWorker++;
+  }
+  if( pPipe->nWorker==0 ){
+    pthread_cond_destroy(&pPipe->cond);
+    pthread_mutex_destroy(&pPipe->mutex);
+    sqlite3_free(pPipe->aWorker);
+    sqlite3_free(pPipe);
+    return 0;
   }
+  return pPipe;
+}
 
-  shellExecPrintf(pState->db, &rc,
-    /* Attach an in-memory database named 'recovery'. Create an indexed 
-    ** cache of the sqlite_dbptr virtual table. */
-    "PRAGMA writable_schema = on;"
-    "ATTACH %Q AS recovery;"
-    "DROP TABLE IF EXISTS recovery.dbptr;"
-    "DROP TABLE IF EXISTS recovery.freelist;"
-    "DROP TABLE IF EXISTS recovery.map;"
-    "DROP TABLE IF EXISTS recovery.schema;"
-    "CREATE TABLE recovery.freelist(pgno INTEGER PRIMARY KEY);", zRecoveryDb
-  );
+/*
+** Hand the content of table zName to the workers, if they can load it.
+** Return the new job, or NULL if the main thread must load the table.
+*/
+static RestoreJob *restore_add_job(
+  ShellState *p,
+  RestorePipeline *pPipe,
+  const char *zName,
+  const char *zTarget,
+  int nCol
+){
+  RestoreJob *pJob;
+  sqlite3_stmt *pStmt = 0;
+  char *zCreate = 0;
+  size_t nTarget = strlen(zTarget);
+  /* "SELECT *" copies all of the columns, but not rowids which a column
+  ** list asks for, nor the content of sqlite_sequence or sqlite_stat1. */
+  if( strncmp(zName, "sqlite_", 7)==0
+   || (nTarget>0 && zTarget[nTarget-1]==')')
+  ){
+    return 0;
+  }
+  sqlite3_prepare_v2(p->db, "SELECT sql FROM main.sqlite_master"
+                            " WHERE type='table' AND name=?1", -1, &pStmt, 0);
+  if( pStmt ){
+    sqlite3_bind_text(pStmt, 1, zName, -1, SQLITE_STATIC);
+    if( sqlite3_step(pStmt)==SQLITE_ROW ){
+      zCreate = sqlite3_mprintf("%s", sqlite3_column_text(pStmt, 0));
+    }
+    sqlite3_finalize(pStmt);
+  }
+  if( zCreate==0 ) return 0;
+  pJob = sqlite3_malloc64(sizeof(*pJob));
+  if( pJob==0 ) shell_out_of_memory();
+  memset(pJob, 0, sizeof(*pJob));
+  pJob->zName = sqlite3_mprintf("%s", zName);
+  pJob->zTarget = sqlite3_mprintf("%s", zTarget);
+  if( pJob->zName==0 || pJob->zTarget==0 ) shell_out_of_memory();
+  pJob->zCreate = zCreate;
+  pJob->nCol = nCol;
+  pJob->iWorker = -1;
+  pthread_mutex_lock(&pPipe->mutex);
+  if( pPipe->pLast ){
+    pPipe->pLast->pNext = pJob;
+  }else{
+    pPipe->pFirst = pJob;
+  }
+  pPipe->pLast = pJob;
+  if( pPipe->pNextJob==0 ) pPipe->pNextJob = pJob;
+  pthread_cond_broadcast(&pPipe->cond);
+  pthread_mutex_unlock(&pPipe->mutex);
+  return pJob;
+}
 
-  if( bFreelist ){
-    shellExec(pState->db, &rc,
-      "WITH trunk(pgno) AS ("
-      "  SELECT shell_int32("
-      "      (SELECT data FROM sqlite_dbpage WHERE pgno=1), 8) AS x "
-      "      WHERE x>0"
-      "    UNION"
-      "  SELECT shell_int32("
-      "      (SELECT data FROM sqlite_dbpage WHERE pgno=trunk.pgno), 0) AS x "
-      "      FROM trunk WHERE x>0"
-      "),"
-      "freelist(data, n, freepgno) AS ("
-      "  SELECT data, min(16384, shell_int32(data, 1)-1), t.pgno "
-      "      FROM trunk t, sqlite_dbpage s WHERE s.pgno=t.pgno"
-      "    UNION ALL"
-      "  SELECT data, n-1, shell_int32(data, 2+n) "
-      "      FROM freelist WHERE n>=0"
-      ")"
-      "REPLACE INTO recovery.freelist SELECT freepgno FROM freelist;"
-    );
+/* Queue a copy of the n bytes of 'R' payload a[] for pJob */
+static void restore_add_rows(
+  RestorePipeline *pPipe,
+  RestoreJob *pJob,
+  const unsigned char *a,
+  size_t n
+){
+  RestoreChunk *pChunk = sqlite3_malloc64(sizeof(*pChunk)+n);
+  if( pChunk==0 ) shell_out_of_memory();
+  pChunk->pNext = 0;
+  pChunk->n = n;
+  pChunk->a = (unsigned char*)&pChunk[1];
+  memcpy(pChunk->a, a, n);
+  pthread_mutex_lock(&pPipe->mutex);
+  while( pPipe->nQueued>0 && pPipe->nQueued+n>pPipe->mxQueued ){
+    pthread_cond_wait(&pPipe->cond, &pPipe->mutex);
+  }
+  if( pJob->pLast ){
+    pJob->pLast->pNext = pChunk;
+  }else{
+    pJob->pFirst = pChunk;
   }
+  pJob->pLast = pChunk;
+  pPipe->nQueued += n;
+  pthread_cond_broadcast(&pPipe->cond);
+  pthread_mutex_unlock(&pPipe->mutex);
+}
 
-  /* If this is an auto-vacuum database, add all pointer-map pages to
-  ** the freelist table. Do this regardless of whether or not 
-  ** --freelist-corrupt was specified.  */
-  shellExec(pState->db, &rc, 
-    "WITH ptrmap(pgno) AS ("
-    "  SELECT 2 WHERE shell_int32("
-    "    (SELECT data FROM sqlite_dbpage WHERE pgno=1), 13"
-    "  )"
-    "    UNION ALL "
-    "  SELECT pgno+1+(SELECT page_size FROM pragma_page_size)/5 AS pp "
-    "  FROM ptrmap WHERE pp<=(SELECT page_count FROM pragma_page_count)"
-    ")"
-    "REPLACE INTO recovery.freelist SELECT pgno FROM ptrmap"
-  );
+/* Mark that every row of pJob has been queued */
+static void restore_end_job(RestorePipeline *pPipe, RestoreJob *pJob){
+  pthread_mutex_lock(&pPipe->mutex);
+  pJob->bEof = 1;
+  pthread_cond_broadcast(&pPipe->cond);
+  pthread_mutex_unlock(&pPipe->mutex);
+}
 
-  shellExec(pState->db, &rc, 
-    "CREATE TABLE recovery.dbptr("
-    "      pgno, child, PRIMARY KEY(child, pgno)"
-    ") WITHOUT ROWID;"
-    "INSERT OR IGNORE INTO recovery.dbptr(pgno, child) "
-    "    SELECT * FROM sqlite_dbptr"
-    "      WHERE pgno NOT IN freelist AND child NOT IN freelist;"
+/*
+** Wait for the workers to load every table, then copy the tables into
+** p->db, within the transaction open on it.  Tables are only copied if
+** bErr is false and the workers saw no errors.  Return the number of
+** errors seen.
+*/
+static int restore_merge(ShellState *p, RestorePipeline *pPipe, int bErr){
+  RestoreJob *pJob;
+  int nErr = 0;
+  int i;
+  pthread_mutex_lock(&pPipe->mutex);
+  pPipe->bEof = 1;
+  pthread_cond_broadcast(&pPipe->cond);
+  pthread_mutex_unlock(&pPipe->mutex);
+  for(i=0; i<pPipe->nWorker; i++){
+    pthread_join(pPipe->aWorker[i].thread, 0);
+    sqlite3_close(pPipe->aWorker[i].db);
+    pPipe->aWorker[i].db = 0;
+  }
+  for(pJob=pPipe->pFirst; pJob; pJob=pJob->pNext) nErr += pJob->nErr;
+  if( bErr || nErr>0 ) return nErr;
+  for(pJob=pPipe->pFirst; pJob && nErr==0; pJob=pJob->pNext){
+    char *zSql = sqlite3_mprintf(
+        "INSERT INTO main.\"%w\" SELECT * FROM restore%d.\"%w\"",
+        pJob->zName, pJob->iWorker, pJob->zName);
+    if( sqlite3_exec(p->db, zSql, 0, 0, 0)!=SQLITE_OK ){
+      utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(p->db));
+      nErr++;
+    }
+    sqlite3_free(zSql);
+  }
+  return nErr;
+}
 
-    /* Delete any pointer to page 1. This ensures that page 1 is considered
-    ** a root page, regardless of how corrupt the db is. */
-    "DELETE FROM recovery.dbptr WHERE child = 1;"
+/*
+** Detach and delete the scratch databases and free pPipe.  This is only
+** called once the transaction on p->db has ended.
+*/
+static void restore_cleanup(ShellState *p, RestorePipeline *pPipe){
+  int i;
+  for(i=0; i<pPipe->nWorker; i++){
+    RestoreWorker *pWorker = &pPipe->aWorker[i];
+    if( pWorker->bAttached ){
+      char *zSql = sqlite3_mprintf("DETACH restore%d", i);
+      sqlite3_exec(p->db, zSql, 0, 0, 0);
+      sqlite3_free(zSql);
+    }
+    shellDeleteFile(pWorker->zScratch);
+    sqlite3_free(pWorker->zScratch);
+  }
+  while( pPipe->pFirst ){
+    RestoreJob *pJob = pPipe->pFirst;
+    pPipe->pFirst = pJob->pNext;
+    while( pJob->pFirst ){
+      RestoreChunk *pChunk = pJob->pFirst;
+      pJob->pFirst = pChunk->pNext;
+      sqlite3_free(pChunk);
+    }
+    sqlite3_free(pJob->zName);
+    sqlite3_free(pJob->zTarget);
+    sqlite3_free(pJob->zCreate);
+    sqlite3_free(pJob);
+  }
+  pthread_cond_destroy(&pPipe->cond);
+  pthread_mutex_destroy(&pPipe->mutex);
+  sqlite3_free(pPipe->aWorker);
+  sqlite3_free(pPipe);
+}
+#endif /* SHELL_USE_PTHREADS */
+
+/*
+** Restore the binary dump in file zFile into p->db, with the content of
+** ordinary tables loaded on nThread worker threads if nThread>0.  Return
+** the number of errors seen.  Unless there are errors, the content is
+** restored in a single transaction.
+*/
+static int restore_dump(ShellState *p, const char *zFile, int nThread){
+  DumpBinReader r;
+  char zMagic[8];
+  sqlite3_stmt *pStmt = 0;      /* Inserts the rows of the current table */
+  int nCol = 0;                 /* Number of columns of the current table */
+  char *zTable = 0;             /* Name of the current table */
+  int bForeignKeys;             /* Prior foreign_keys setting */
+  int bLate = 0;                /* True once the 'L' records have begun */
+  int bEnd = 0;                 /* True once the 'E' record is read */
+  int bCorrupt = 0;             /* True if the dump is corrupt */
+  int nErr = 0;                 /* Errors seen while restoring */
+  sqlite3_uint64 nDumpErr = 0;  /* Errors seen while dumping */
+#if SHELL_USE_PTHREADS
+  RestorePipeline *pPipe = 0;   /* The workers, if any */
+  RestoreJob *pJob = 0;         /* The worker job for the current table */
+#endif
 
-    /* Delete all pointers to any pages that have more than one pointer
-    ** to them. Such pages will be treated as root pages when recovering
-    ** data.  */
-    "DELETE FROM recovery.dbptr WHERE child IN ("
-    "  SELECT child FROM recovery.dbptr GROUP BY child HAVING count(*)>1"
-    ");"
+  memset(&r, 0, sizeof(r));
+  r.zFile = zFile;
+  r.in = fopen(zFile, "rb");
+  if( r.in==0 ){
+    utf8_printf(stderr, "Error: cannot open \"%s\"\n", zFile);
+    return 1;
+  }
+  if( fread(zMagic, 1, 8, r.in)!=8 || memcmp(zMagic, DUMPBIN_MAGIC, 8)!=0 ){
+    utf8_printf(stderr, "Error: \"%s\" is not a binary dump\n", zFile);
+    fclose(r.in);
+    return 1;
+  }
+  if( !sqlite3_get_autocommit(p->db) ){
+    raw_printf(stderr, "Error: cannot restore a dump within a transaction\n");
+    fclose(r.in);
+    return 1;
+  }
 
-    /* Create the "map" table that will (eventually) contain instructions
-    ** for dealing with each page in the db that contains one or more 
-    ** records. */
-    "CREATE TABLE recovery.map("
-      "pgno INTEGER PRIMARY KEY, maxlen INT, intkey, root INT"
-    ");"
+  /* The content might appear in an order which violates immediate
+  ** foreign key constraints, as for a text dump. */
+  bForeignKeys = db_int(p, "PRAGMA foreign_keys");
+  sqlite3_exec(p->db, "PRAGMA foreign_keys=OFF", 0, 0, 0);
+#if SHELL_USE_PTHREADS
+  if( nThread>0 ) pPipe = restore_start(p, nThread);
+#else
+  UNUSED_PARAMETER(nThread);
+#endif
+  sqlite3_exec(p->db, "BEGIN", 0, 0, 0);
 
-    /* Populate table [map]. If there are circular loops of pages in the
-    ** database, the following adds all pages in such a loop to the map
-    ** as individual root pages. This could be handled better.  */
-    "WITH pages(i, maxlen) AS ("
-    "  SELECT page_count, ("
-    "    SELECT max(field+1) FROM sqlite_dbdata WHERE pgno=page_count"
-    "  ) FROM pragma_page_count WHERE page_count>0"
-    "    UNION ALL"
-    "  SELECT i-1, ("
-    "    SELECT max(field+1) FROM sqlite_dbdata WHERE pgno=i-1"
-    "  ) FROM pages WHERE i>=2"
-    ")"
-    "INSERT INTO recovery.map(pgno, maxlen, intkey, root) "
-    "  SELECT i, maxlen, NULL, ("
-    "    WITH p(orig, pgno, parent) AS ("
-    "      SELECT 0, i, (SELECT pgno FROM recovery.dbptr WHERE child=i)"
-    "        UNION "
-    "      SELECT i, p.parent, "
-    "        (SELECT pgno FROM recovery.dbptr WHERE child=p.parent) FROM p"
-    "    )"
-    "    SELECT pgno FROM p WHERE (parent IS NULL OR pgno = orig)"
-    ") "
-    "FROM pages WHERE maxlen IS NOT NULL AND i NOT IN freelist;"
-    "UPDATE recovery.map AS o SET intkey = ("
-    "  SELECT substr(data, 1, 1)==X'0D' FROM sqlite_dbpage WHERE pgno=o.pgno"
-    ");"
+  while( !bEnd && !bCorrupt && !seenInterrupt ){
+    if( !dumpbin_read(&r) ){
+      nErr++;
+      break;
+    }
+    /* Any record but 'R' ends the content of the current table */
+    if( r.eType!='R' ){
+      sqlite3_finalize(pStmt);
+      pStmt = 0;
+      sqlite3_free(zTable);
+      zTable = 0;
+#if SHELL_USE_PTHREADS
+      if( pJob ) restore_end_job(pPipe, pJob);
+      pJob = 0;
+#endif
+    }
+    switch( r.eType ){
+      case 'L':
+      case 'S': {
+        char *zErr = 0;
+        if( r.eType=='L' && !bLate ){
+          bLate = 1;
+#if SHELL_USE_PTHREADS
+          if( pPipe ) nErr += restore_merge(p, pPipe, nErr>0);
+#endif
+        }
+        if( sqlite3_exec(p->db, (const char*)r.rec.a, 0, 0, &zErr) ){
+          utf8_printf(stderr, "Error: %s\n", zErr);
+          nErr++;
+        }
+        sqlite3_free(zErr);
+        break;
+      }
+      case 'T': {
+        char *zTarget;
+        if( !dumpbin_parse_table(&r, &nCol, &zTable, &zTarget) ){
+          bCorrupt = 1;
+          break;
+        }
+#if SHELL_USE_PTHREADS
+        if( pPipe ) pJob = restore_add_job(p, pPipe, zTable, zTarget, nCol);
+        if( pJob==0 )
+#endif
+        {
+          pStmt = dumpbin_prepare_insert(p->db, zTarget, nCol);
+          if( pStmt==0 ) nErr++;
+        }
+        sqlite3_free(zTarget);
+        break;
+      }
+      case 'R': {
+#if SHELL_USE_PTHREADS
+        if( pJob ){
+          restore_add_rows(pPipe, pJob, r.rec.a, r.rec.n);
+        }else
+#endif
+        if( pStmt ){
+          bCorrupt = dumpbin_insert_rows(pStmt, nCol, r.rec.a, r.rec.n, &nErr);
+        }else if( zTable==0 ){
+          bCorrupt = 1;
+        }
+        break;
+      }
+      case 'E': {
+        const unsigned char *z = r.rec.a;
+        bCorrupt = !dumpbin_get_varint(&z, z+r.rec.n, &nDumpErr);
+        bEnd = 1;
+        break;
+      }
+      default: {
+        bCorrupt = 1;
+        break;
+      }
+    }
+  }
+  sqlite3_finalize(pStmt);
+  sqlite3_free(zTable);
+#if SHELL_USE_PTHREADS
+  if( pJob ) restore_end_job(pPipe, pJob);
+  if( pPipe && !bLate ) nErr += restore_merge(p, pPipe, nErr>0 || !bEnd);
+#endif
+  if( bCorrupt ){
+    utf8_printf(stderr, "Error: %s: dump is corrupt\n", zFile);
+    nErr++;
+  }else if( nDumpErr>0 ){
+    utf8_printf(stderr, "Error: %s: %llu errors while dumping\n", zFile,
+                nDumpErr);
+    nErr++;
+  }else if( seenInterrupt ){
+    nErr++;
+  }
+  if( nErr>0 ){
+    sqlite3_exec(p->db, "ROLLBACK", 0, 0, 0);
+    raw_printf(stderr, "Error: the restore was rolled back\n");
+  }else if( sqlite3_exec(p->db, "COMMIT", 0, 0, 0)!=SQLITE_OK ){
+    utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(p->db));
+    nErr++;
+  }
+#if SHELL_USE_PTHREADS
+  if( pPipe ) restore_cleanup(p, pPipe);
+#endif
+  if( bForeignKeys ) sqlite3_exec(p->db, "PRAGMA foreign_keys=ON", 0, 0, 0);
+  sqlite3_free(r.rec.a);
+  fclose(r.in);
+  return nErr;
+}
 
-    /* Extract data from page 1 and any linked pages into table
-    ** recovery.schema. With the same schema as an sqlite_master table.  */
-    "CREATE TABLE recovery.schema(type, name, tbl_name, rootpage, sql);"
-    "INSERT INTO recovery.schema SELECT "
-    "  max(CASE WHEN field=0 THEN value ELSE NULL END),"
-    "  max(CASE WHEN field=1 THEN value ELSE NULL END),"
-    "  max(CASE WHEN field=2 THEN value ELSE NULL END),"
-    "  max(CASE WHEN field=3 THEN value ELSE NULL END),"
-    "  max(CASE WHEN field=4 THEN value ELSE NULL END)"
-    "FROM sqlite_dbdata WHERE pgno IN ("
-    "  SELECT pgno FROM recovery.map WHERE root=1"
-    ")"
-    "GROUP BY pgno, cell;"
-    "CREATE INDEX recovery.schema_rootpage ON schema(rootpage);"
-  );
+/*
+** A fast .clone copies each table with "INSERT INTO ... SELECT *" from the
+** database being cloned, which is attached to the new one, rather than a
+** row at a time.  The tables and indexes of the new database are created
+** first, exactly as in the original, so that SQLite's transfer optimization
+** applies and whole records are copied without being decoded.  Views and
+** triggers are created once the content is in place.
+**
+** With --threads, worker threads each copy tables into a staging database
+** of their own, all reading the original database as it was when the clone
+** began.  The main thread then copies the staged tables into the new
+** database the same way, inside the read transaction which pinned that
+** view of the original, along with sqlite_sequence and the sqlite_stat
+** tables.
+*/
+
+/* A table whose content is copied by a fast .clone */
+typedef struct CloneTable CloneTable;
+struct CloneTable {
+  char *zName;            /* Name of the table */
+  char *zCreate;          /* SQL which creates the table and its indexes */
+  int iWorker;            /* Worker whose staging database has the table */
+  int nErr;               /* Errors seen by that worker */
+};
 
-  /* Open a transaction, then print out all non-virtual, non-"sqlite_%" 
-  ** CREATE TABLE statements that extracted from the existing schema.  */
-  if( rc==SQLITE_OK ){
-    sqlite3_stmt *pStmt = 0;
-    /* ".recover" might output content in an order which causes immediate
-    ** foreign key constraints to be violated. So disable foreign-key
-    ** constraint enforcement to prevent problems when running the output
-    ** script. */
-    raw_printf(pState->out, "PRAGMA foreign_keys=OFF;\n");
-    raw_printf(pState->out, "BEGIN;\n");
-    raw_printf(pState->out, "PRAGMA writable_schema = on;\n");
-    shellPrepare(pState->db, &rc,
-        "SELECT sql FROM recovery.schema "
-        "WHERE type='table' AND sql LIKE 'create table%'", &pStmt
-    );
-    while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
-      const char *zCreateTable = (const char*)sqlite3_column_text(pStmt, 0);
-      raw_printf(pState->out, "CREATE TABLE IF NOT EXISTS %s;\n", 
-          &zCreateTable[12]
-      );
+#if SHELL_USE_PTHREADS
+typedef struct ClonePipeline ClonePipeline;
+
+/* A worker thread of a parallel .clone */
+typedef struct CloneWorker CloneWorker;
+struct CloneWorker {
+  ClonePipeline *pPipe;   /* The work to share */
+  char *zStage;           /* Name of the staging database */
+  sqlite3 *db;            /* Connection to zStage, with the original as "src" */
+  pthread_t thread;       /* The thread itself */
+  int nErr;               /* Errors seen outside of any one table */
+};
+
+/* State shared by the threads of a parallel .clone */
+struct ClonePipeline {
+  CloneTable *aTable;     /* Tables to copy */
+  int nTable;             /* Number of entries in aTable[] */
+  CloneWorker *aWorker;   /* The workers */
+  pthread_mutex_t mutex;  /* Protects iNext */
+  int iNext;              /* First table no worker has claimed yet */
+};
+
+/* Body of each worker thread of a parallel .clone */
+static void *clone_worker_main(void *pArg){
+  CloneWorker *pWorker = (CloneWorker*)pArg;
+  ClonePipeline *pPipe = pWorker->pPipe;
+  while( 1 ){
+    CloneTable *pTab;
+    char *zSql;
+    int rc;
+    pthread_mutex_lock(&pPipe->mutex);
+    if( pPipe->iNext>=pPipe->nTable || seenInterrupt ){
+      pthread_mutex_unlock(&pPipe->mutex);
+      break;
     }
-    shellFinalize(&rc, pStmt);
+    pTab = &pPipe->aTable[pPipe->iNext++];
+    pthread_mutex_unlock(&pPipe->mutex);
+
+    pTab->iWorker = (int)(pWorker - pPipe->aWorker);
+    rc = sqlite3_exec(pWorker->db, pTab->zCreate, 0, 0, 0);
+    if( rc==SQLITE_OK ){
+      zSql = sqlite3_mprintf("INSERT INTO main.\"%w\" SELECT * FROM src.\"%w\"",
+                             pTab->zName, pTab->zName);
+      rc = zSql ? sqlite3_exec(pWorker->db, zSql, 0, 0, 0) : SQLITE_NOMEM;
+      sqlite3_free(zSql);
+    }
+    if( rc!=SQLITE_OK ){
+      utf8_printf(stderr, "Error: %s: %s\n", pTab->zName,
+                  sqlite3_errmsg(pWorker->db));
+      pTab->nErr++;
+    }
+  }
+  if( sqlite3_exec(pWorker->db, "COMMIT", 0, 0, 0)!=SQLITE_OK ){
+    utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(pWorker->db));
+    pWorker->nErr++;
   }
+  return 0;
+}
 
-  /* Figure out if an orphan table will be required. And if so, how many
-  ** user columns it should contain */
-  shellPrepare(pState->db, &rc, 
-      "SELECT coalesce(max(maxlen), -2) FROM recovery.map WHERE root>1"
-      , &pLoop
-  );
-  if( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pLoop) ){
-    nOrphan = sqlite3_column_int(pLoop, 0);
+/*
+** Open the staging database zStage for a worker of a parallel .clone, with
+** the original database zSrc attached as "src", and begin a transaction
+** which reads zSrc on pSnapshot if that is not NULL.  Return NULL if that
+** can't be done.
+*/
+static sqlite3 *clone_open_stage(
+  const char *zStage,           /* Name of the staging database */
+  const char *zSrc,             /* Name of the database being cloned */
+  const char *zEncoding,        /* Text encoding of zSrc */
+  void *pSnapshot               /* The snapshot to open, or NULL */
+){
+  sqlite3 *db = 0;
+  char *zSql;
+  int rc;
+  rc = sqlite3_open_v2(zStage, &db,
+                       SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE
+                       |SQLITE_OPEN_NOMUTEX, 0);
+  if( rc==SQLITE_OK ){
+    sqlite3_busy_timeout(db, 2000);
+    /* Load the schema of zSrc before the transaction, as snapshots need */
+    zSql = sqlite3_mprintf("PRAGMA encoding=%Q;"
+                           "PRAGMA journal_mode=OFF;"
+                           "PRAGMA synchronous=OFF;"
+                           "ATTACH %Q AS src;"
+                           "SELECT count(*) FROM src.sqlite_master",
+                           zEncoding, zSrc);
+    rc = zSql ? sqlite3_exec(db, zSql, 0, 0, 0) : SQLITE_NOMEM;
+    sqlite3_free(zSql);
   }
-  shellFinalize(&rc, pLoop);
-  pLoop = 0;
+  if( rc==SQLITE_OK ) rc = sqlite3_exec(db, "BEGIN", 0, 0, 0);
+#ifdef SQLITE_ENABLE_SNAPSHOT
+  if( rc==SQLITE_OK && pSnapshot ){
+    rc = sqlite3_snapshot_open(db, "src", (sqlite3_snapshot*)pSnapshot);
+  }
+#else
+  UNUSED_PARAMETER(pSnapshot);
+#endif
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_exec(db, "SELECT count(*) FROM src.sqlite_master", 0, 0, 0);
+  }
+  if( rc!=SQLITE_OK ){
+    sqlite3_close(db);
+    return 0;
+  }
+  sqlite3_progress_handler(db, 1000, dump_progress_handler, 0);
+  return db;
+}
 
-  shellPrepare(pState->db, &rc,
-      "SELECT pgno FROM recovery.map WHERE root=?", &pPages
-  );
+/*
+** Start a worker for each staging database of pPipe, to copy the tables of
+** pPipe.  p->db must be in a read transaction which pins the view of the
+** database that the workers are to copy.  Return the number of workers
+** started, which are the first entries of pPipe->aWorker[].
+*/
+static int clone_start(ShellState *p, ClonePipeline *pPipe, int nStage,
+                       const char *zEncoding){
+  const char *zSrc = sqlite3_db_filename(p->db, "main");
+  sqlite3_stmt *pStmt = 0;
+  void *pSnapshot = 0;
+  int bWal = 0;
+  int nWorker = 0;
 
-  shellPrepare(pState->db, &rc,
-      "SELECT max(field), group_concat(shell_escape_crnl(quote"
-      "(case when (? AND field<0) then NULL else value end)"
-      "), ', ')"
-      ", min(field) "
-      "FROM sqlite_dbdata WHERE pgno = ? AND field != ?"
-      "GROUP BY cell", &pCells
-  );
+  sqlite3_prepare_v2(p->db, "PRAGMA main.journal_mode", -1, &pStmt, 0);
+  if( pStmt && sqlite3_step(pStmt)==SQLITE_ROW ){
+    bWal = sqlite3_stricmp((const char*)sqlite3_column_text(pStmt,0),
+                           "wal")==0;
+  }
+  sqlite3_finalize(pStmt);
+  if( bWal ){
+#ifdef SQLITE_ENABLE_SNAPSHOT
+    sqlite3_snapshot *pSnap = 0;
+    if( sqlite3_snapshot_get(p->db, "main", &pSnap)==SQLITE_OK ){
+      pSnapshot = pSnap;
+    }
+#endif
+    /* Without a snapshot, WAL readers may each see different commits */
+    if( pSnapshot==0 ) return 0;
+  }
+  for(nWorker=0; nWorker<nStage; nWorker++){
+    CloneWorker *pWorker = &pPipe->aWorker[nWorker];
+    pWorker->db = clone_open_stage(pWorker->zStage, zSrc, zEncoding,
+                                   pSnapshot);
+    if( pWorker->db==0 ) break;
+  }
+#ifdef SQLITE_ENABLE_SNAPSHOT
+  if( pSnapshot ) sqlite3_snapshot_free((sqlite3_snapshot*)pSnapshot);
+#endif
+  if( nWorker<nStage ){
+    while( nWorker>0 ){
+      nWorker--;
+      sqlite3_close(pPipe->aWorker[nWorker].db);
+      pPipe->aWorker[nWorker].db = 0;
+    }
+    return 0;
+  }
+  pthread_mutex_init(&pPipe->mutex, 0);
+  for(nWorker=0; nWorker<nStage; nWorker++){
+    CloneWorker *pWorker = &pPipe->aWorker[nWorker];
+    if( pthread_create(&pWorker->thread, 0, clone_worker_main, pWorker) ){
+      break;
+    }
+  }
+  if( nWorker==0 ) pthread_mutex_destroy(&pPipe->mutex);
+  return nWorker;
+}
+#endif /* SHELL_USE_PTHREADS */
 
-  /* Loop through each root page. */
-  shellPrepare(pState->db, &rc, 
-      "SELECT root, intkey, max(maxlen) FROM recovery.map" 
-      " WHERE root>1 GROUP BY root, intkey ORDER BY root=("
-      "  SELECT rootpage FROM recovery.schema WHERE name='sqlite_sequence'"
-      ")", &pLoop
-  );
-  while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pLoop) ){
-    int iRoot = sqlite3_column_int(pLoop, 0);
-    int bIntkey = sqlite3_column_int(pLoop, 1);
-    int nCol = sqlite3_column_int(pLoop, 2);
-    int bNoop = 0;
-    RecoverTable *pTab;
+/*
+** Clone p->db into the new database file zNewDb, copying table content on
+** nThread worker threads if nThread>0.  Return 0 on success.  Otherwise
+** report the problem, delete zNewDb and return non-zero.
+*/
+static int clone_fast(ShellState *p, const char *zNewDb, int nThread){
+  sqlite3 *newDb = 0;
+  sqlite3_stmt *pStmt = 0;
+  CloneTable *aTable = 0;
+  int nTable = 0;
+  char *zEncoding = 0;
+  char *zSql;
+  int bForeignKeys;
+  int bAttached = 0;
+  int nWorker = 0;
+  int nErr = 0;
+  int i;
+#if SHELL_USE_PTHREADS
+  ClonePipeline sPipe;
+  int nStage = 0;
+  memset(&sPipe, 0, sizeof(sPipe));
+#endif
 
-    assert( bIntkey==0 || bIntkey==1 );
-    pTab = recoverFindTable(pState, &rc, iRoot, bIntkey, nCol, &bNoop);
-    if( bNoop || rc ) continue;
-    if( pTab==0 ){
-      if( pOrphan==0 ){
-        pOrphan = recoverOrphanTable(pState, &rc, zLostAndFound, nOrphan);
+  /* The new database is attached to p->db, which is not allowed inside
+  ** a transaction */
+  if( !sqlite3_get_autocommit(p->db) ) return 1;
+  sqlite3_prepare_v2(p->db, "PRAGMA main.encoding", -1, &pStmt, 0);
+  if( pStmt && sqlite3_step(pStmt)==SQLITE_ROW ){
+    zEncoding = sqlite3_mprintf("%s", sqlite3_column_text(pStmt, 0));
+  }
+  sqlite3_finalize(pStmt);
+  pStmt = 0;
+  if( zEncoding==0 ){
+    utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(p->db));
+    return 1;
+  }
+
+  /* Create the tables and indexes of the new database, in the same format
+  ** as the original so that whole records can be copied between them.
+  ** Virtual tables go straight into sqlite_master, as .dump has them, so
+  ** their modules need not be loaded. */
+  if( sqlite3_open(zNewDb, &newDb)!=SQLITE_OK ){
+    utf8_printf(stderr, "Cannot create output database: %s\n",
+                sqlite3_errmsg(newDb));
+    nErr++;
+    goto clone_fast_end;
+  }
+  zSql = sqlite3_mprintf("PRAGMA page_size=%d;"
+                         "PRAGMA auto_vacuum=%d;"
+                         "PRAGMA encoding=%Q;"
+                         "PRAGMA writable_schema=ON;"
+                         "BEGIN EXCLUSIVE",
+                         db_int(p, "PRAGMA main.page_size"),
+                         db_int(p, "PRAGMA main.auto_vacuum"), zEncoding);
+  if( zSql==0 ) shell_out_of_memory();
+  if( sqlite3_exec(newDb, zSql, 0, 0, 0)!=SQLITE_OK ){
+    utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(newDb));
+    nErr++;
+  }
+  sqlite3_free(zSql);
+  if( nErr==0 ){
+    sqlite3_prepare_v2(p->db,
+        "SELECT type, name, tbl_name, sql FROM main.sqlite_master"
+        " WHERE type IN ('table','index') AND sql IS NOT NULL"
+        "   AND name NOT LIKE 'sqlite\\_%' ESCAPE '\\'"
+        " ORDER BY rowid", -1, &pStmt, 0);
+    if( pStmt==0 ){
+      utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(p->db));
+      nErr++;
+    }
+  }
+  while( nErr==0 && sqlite3_step(pStmt)==SQLITE_ROW ){
+    const char *zType = (const char*)sqlite3_column_text(pStmt, 0);
+    const char *zName = (const char*)sqlite3_column_text(pStmt, 1);
+    const char *zTbl = (const char*)sqlite3_column_text(pStmt, 2);
+    const char *zCreate = (const char*)sqlite3_column_text(pStmt, 3);
+    if( sqlite3_strnicmp(zCreate, "CREATE VIRTUAL TABLE", 20)==0 ){
+      zSql = sqlite3_mprintf(
+          "INSERT INTO sqlite_master(type,name,tbl_name,rootpage,sql)"
+          "VALUES('table',%Q,%Q,0,%Q)", zName, zName, zCreate);
+    }else{
+      zSql = sqlite3_mprintf("%s", zCreate);
+      if( strcmp(zType, "table")==0 ){
+        if( (nTable & (nTable-1))==0 ){
+          aTable = sqlite3_realloc64(aTable,
+                                     (nTable ? 2*nTable : 16)*sizeof(aTable[0]));
+          if( aTable==0 ) shell_out_of_memory();
+        }
+        aTable[nTable].zName = sqlite3_mprintf("%s", zName);
+        aTable[nTable].zCreate = sqlite3_mprintf("%s", zCreate);
+        aTable[nTable].iWorker = -1;
+        aTable[nTable].nErr = 0;
+        if( aTable[nTable].zName==0 || aTable[nTable].zCreate==0 ){
+          shell_out_of_memory();
+        }
+        nTable++;
+      }else{
+        /* Staged copies of a table need its indexes too */
+        for(i=0; i<nTable && strcmp(aTable[i].zName, zTbl)!=0; i++){}
+        if( i<nTable ){
+          aTable[i].zCreate = sqlite3_mprintf("%z;\n%s", aTable[i].zCreate,
+                                              zCreate);
+          if( aTable[i].zCreate==0 ) shell_out_of_memory();
+        }
+      }
+    }
+    if( zSql==0 ) shell_out_of_memory();
+    if( sqlite3_exec(newDb, zSql, 0, 0, 0)!=SQLITE_OK ){
+      utf8_printf(stderr, "Error: %s\nSQL: [%s]\n", sqlite3_errmsg(newDb),
+                  zCreate);
+      nErr++;
+    }
+    sqlite3_free(zSql);
+  }
+  sqlite3_finalize(pStmt);
+  pStmt = 0;
+  if( nErr==0 && sqlite3_exec(newDb, "COMMIT", 0, 0, 0)!=SQLITE_OK ){
+    utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(newDb));
+    nErr++;
+  }
+  close_db(newDb);
+  newDb = 0;
+  if( nErr ) goto clone_fast_end;
+
+  /* Attach the new database, and the staging databases of the workers */
+  zSql = sqlite3_mprintf("ATTACH %Q AS clone;"
+                         "PRAGMA clone.journal_mode=OFF;"
+                         "PRAGMA clone.synchronous=OFF", zNewDb);
+  if( zSql==0 ) shell_out_of_memory();
+  if( sqlite3_exec(p->db, zSql, 0, 0, 0)!=SQLITE_OK ){
+    utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(p->db));
+    nErr++;
+  }else{
+    bAttached = 1;
+  }
+  sqlite3_free(zSql);
+#if SHELL_USE_PTHREADS
+  if( nErr==0 && nThread>0 && nTable>0 && sqlite3_threadsafe() ){
+    const char *zSrc = sqlite3_db_filename(p->db, "main");
+    int nAttach = sqlite3_limit(p->db, SQLITE_LIMIT_ATTACHED, -1)
+          - (db_int(p, "SELECT count(*) FROM pragma_database_list") - 2);
+    if( nThread>nAttach ) nThread = nAttach;
+    if( nThread>nTable ) nThread = nTable;
+    if( zSrc==0 || zSrc[0]==0 ) nThread = 0;
+    if( nThread>0 ){
+      sPipe.aTable = aTable;
+      sPipe.nTable = nTable;
+      sPipe.aWorker = sqlite3_malloc64(nThread*sizeof(sPipe.aWorker[0]));
+      if( sPipe.aWorker==0 ) shell_out_of_memory();
+      memset(sPipe.aWorker, 0, nThread*sizeof(sPipe.aWorker[0]));
+    }
+    for(nStage=0; nStage<nThread; nStage++){
+      CloneWorker *pWorker = &sPipe.aWorker[nStage];
+      pWorker->pPipe = &sPipe;
+      pWorker->zStage = shell_scratch_name(zNewDb, "clone", nStage);
+      if( pWorker->zStage==0 ) break;
+      zSql = sqlite3_mprintf("ATTACH %Q AS stage%d", pWorker->zStage, nStage);
+      if( zSql==0 ) shell_out_of_memory();
+      i = sqlite3_exec(p->db, zSql, 0, 0, 0);
+      sqlite3_free(zSql);
+      if( i!=SQLITE_OK ){
+        sqlite3_free(pWorker->zStage);
+        pWorker->zStage = 0;
+        break;
       }
-      pTab = pOrphan;
-      if( pTab==0 ) break;
     }
+  }
+#else
+  UNUSED_PARAMETER(nThread);
+#endif
 
-    if( 0==sqlite3_stricmp(pTab->zQuoted, "\"sqlite_sequence\"") ){
-      raw_printf(pState->out, "DELETE FROM sqlite_sequence;\n");
+  /* Copy everything inside one read transaction on p->db, which the
+  ** workers are also pinned to */
+  bForeignKeys = db_int(p, "PRAGMA foreign_keys");
+  if( bForeignKeys ) sqlite3_exec(p->db, "PRAGMA foreign_keys=OFF", 0, 0, 0);
+  if( nErr==0
+   && sqlite3_exec(p->db, "BEGIN; SELECT count(*) FROM main.sqlite_master",
+                   0, 0, 0)!=SQLITE_OK
+  ){
+    utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(p->db));
+    nErr++;
+  }
+#if SHELL_USE_PTHREADS
+  if( nErr==0 && nStage>0 ){
+    nWorker = clone_start(p, &sPipe, nStage, zEncoding);
+    for(i=0; i<nWorker; i++){
+      pthread_join(sPipe.aWorker[i].thread, 0);
+      nErr += sPipe.aWorker[i].nErr;
+    }
+    for(i=0; i<nStage; i++){
+      sqlite3_close(sPipe.aWorker[i].db);
+      sPipe.aWorker[i].db = 0;
+    }
+    if( nWorker>0 ) pthread_mutex_destroy(&sPipe.mutex);
+    for(i=0; i<nTable; i++) nErr += aTable[i].nErr;
+    /* p->db has only seen the staging databases empty, so far */
+    for(i=0; i<nWorker && nErr==0; i++){
+      zSql = sqlite3_mprintf("SELECT count(*) FROM stage%d.sqlite_master", i);
+      if( zSql==0 ) shell_out_of_memory();
+      sqlite3_exec(p->db, zSql, 0, 0, 0);
+      sqlite3_free(zSql);
     }
-    sqlite3_bind_int(pPages, 1, iRoot);
-    if( bRowids==0 && pTab->iPk<0 ){
-      sqlite3_bind_int(pCells, 1, 1);
+  }
+#endif
+  for(i=0; i<nTable && nErr==0; i++){
+    char zSrc[30];
+    if( seenInterrupt ){
+      nErr++;
+      break;
+    }
+    if( nWorker==0 ){
+      sqlite3_snprintf(sizeof(zSrc), zSrc, "main");
+    }else if( aTable[i].iWorker>=0 ){
+      sqlite3_snprintf(sizeof(zSrc), zSrc, "stage%d", aTable[i].iWorker);
     }else{
-      sqlite3_bind_int(pCells, 1, 0);
+      nErr++;
+      break;
     }
-    sqlite3_bind_int(pCells, 3, pTab->iPk);
-
-    while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pPages) ){
-      int iPgno = sqlite3_column_int(pPages, 0);
-      sqlite3_bind_int(pCells, 2, iPgno);
-      while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pCells) ){
-        int nField = sqlite3_column_int(pCells, 0);
-        int iMin = sqlite3_column_int(pCells, 2);
-        const char *zVal = (const char*)sqlite3_column_text(pCells, 1);
+    printf("%s... ", aTable[i].zName); fflush(stdout);
+    zSql = sqlite3_mprintf("INSERT INTO clone.\"%w\" SELECT * FROM %s.\"%w\"",
+                           aTable[i].zName, zSrc, aTable[i].zName);
+    if( zSql==0 ) shell_out_of_memory();
+    if( sqlite3_exec(p->db, zSql, 0, 0, 0)!=SQLITE_OK ){
+      utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(p->db));
+      nErr++;
+    }
+    sqlite3_free(zSql);
+    printf("done\n");
+  }
 
-        RecoverTable *pTab2 = pTab;
-        if( pTab!=pOrphan && (iMin<0)!=bIntkey ){
-          if( pOrphan==0 ){
-            pOrphan = recoverOrphanTable(pState, &rc, zLostAndFound, nOrphan);
-          }
-          pTab2 = pOrphan;
-          if( pTab2==0 ) break;
-        }
+  /* The content of sqlite_sequence and the sqlite_stat tables.  The stat
+  ** tables are created with "ANALYZE sqlite_master", as .dump does. */
+  if( nErr==0 ){
+    int bAnalyzed = 0;
+    sqlite3_prepare_v2(p->db,
+        "SELECT name FROM main.sqlite_master WHERE type='table'"
+        "   AND (name='sqlite_sequence' OR name LIKE 'sqlite\\_stat%' ESCAPE '\\')"
+        " ORDER BY rowid", -1, &pStmt, 0);
+    while( pStmt && sqlite3_step(pStmt)==SQLITE_ROW ){
+      const char *zName = (const char*)sqlite3_column_text(pStmt, 0);
+      int bStat = strcmp(zName, "sqlite_sequence")!=0;
+      if( bStat && !bAnalyzed ){
+        sqlite3_exec(p->db, "ANALYZE clone.sqlite_master", 0, 0, 0);
+        bAnalyzed = 1;
+      }
+      zSql = sqlite3_mprintf("DELETE FROM clone.\"%w\";"
+                             "INSERT INTO clone.\"%w\" SELECT * FROM main.\"%w\"",
+                             zName, zName, zName);
+      if( zSql==0 ) shell_out_of_memory();
+      if( sqlite3_exec(p->db, zSql, 0, 0, 0)!=SQLITE_OK ){
+        /* Statistics are only a hint, so missing ones are not an error */
+        utf8_printf(stderr, "%s: %s: %s\n", bStat ? "Warning" : "Error",
+                    zName, sqlite3_errmsg(p->db));
+        if( !bStat ) nErr++;
+      }
+      sqlite3_free(zSql);
+    }
+    sqlite3_finalize(pStmt);
+    pStmt = 0;
+  }
+  if( !sqlite3_get_autocommit(p->db) ){
+    if( nErr==0 && sqlite3_exec(p->db, "COMMIT", 0, 0, 0)!=SQLITE_OK ){
+      utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(p->db));
+      nErr++;
+    }
+    if( nErr ) sqlite3_exec(p->db, "ROLLBACK", 0, 0, 0);
+  }
+  if( bForeignKeys ) sqlite3_exec(p->db, "PRAGMA foreign_keys=ON", 0, 0, 0);
+#if SHELL_USE_PTHREADS
+  for(i=0; i<nStage; i++){
+    zSql = sqlite3_mprintf("DETACH stage%d", i);
+    if( zSql==0 ) shell_out_of_memory();
+    sqlite3_exec(p->db, zSql, 0, 0, 0);
+    sqlite3_free(zSql);
+    shellDeleteFile(sPipe.aWorker[i].zStage);
+    sqlite3_free(sPipe.aWorker[i].zStage);
+  }
+  sqlite3_free(sPipe.aWorker);
+#endif
+  if( bAttached ) sqlite3_exec(p->db, "DETACH clone", 0, 0, 0);
 
-        nField = nField+1;
-        if( pTab2==pOrphan ){
-          raw_printf(pState->out, 
-              "INSERT INTO %s VALUES(%d, %d, %d, %s%s%s);\n",
-              pTab2->zQuoted, iRoot, iPgno, nField,
-              iMin<0 ? "" : "NULL, ", zVal, pTab2->azlCol[nField]
-          );
-        }else{
-          raw_printf(pState->out, "INSERT INTO %s(%s) VALUES( %s );\n", 
-              pTab2->zQuoted, pTab2->azlCol[nField], zVal
-          );
+  /* Views and triggers last, so that triggers don't fire during the copy */
+  if( nErr==0 ){
+    if( sqlite3_open(zNewDb, &newDb)!=SQLITE_OK
+     || sqlite3_exec(newDb, "BEGIN EXCLUSIVE", 0, 0, 0)!=SQLITE_OK
+    ){
+      utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(newDb));
+      nErr++;
+    }else{
+      sqlite3_prepare_v2(p->db,
+          "SELECT name, sql FROM main.sqlite_master"
+          " WHERE type IN ('view','trigger') AND sql IS NOT NULL"
+          " ORDER BY rowid", -1, &pStmt, 0);
+      while( pStmt && sqlite3_step(pStmt)==SQLITE_ROW ){
+        const char *zCreate = (const char*)sqlite3_column_text(pStmt, 1);
+        printf("%s... ", sqlite3_column_text(pStmt, 0)); fflush(stdout);
+        if( sqlite3_exec(newDb, zCreate, 0, 0, 0)!=SQLITE_OK ){
+          utf8_printf(stderr, "Error: %s\nSQL: [%s]\n", sqlite3_errmsg(newDb),
+                      zCreate);
+          nErr++;
         }
+        printf("done\n");
+      }
+      sqlite3_finalize(pStmt);
+      pStmt = 0;
+      if( sqlite3_exec(newDb, nErr ? "ROLLBACK" : "COMMIT", 0, 0, 0)
+           !=SQLITE_OK
+      ){
+        utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(newDb));
+        nErr++;
       }
-      shellReset(&rc, pCells);
     }
-    shellReset(&rc, pPages);
-    if( pTab!=pOrphan ) recoverFreeTable(pTab);
   }
-  shellFinalize(&rc, pLoop);
-  shellFinalize(&rc, pPages);
-  shellFinalize(&rc, pCells);
-  recoverFreeTable(pOrphan);
 
-  /* The rest of the schema */
-  if( rc==SQLITE_OK ){
-    sqlite3_stmt *pStmt = 0;
-    shellPrepare(pState->db, &rc, 
-        "SELECT sql, name FROM recovery.schema "
-        "WHERE sql NOT LIKE 'create table%'", &pStmt
-    );
-    while( rc==SQLITE_OK && SQLITE_ROW==sqlite3_step(pStmt) ){
-      const char *zSql = (const char*)sqlite3_column_text(pStmt, 0);
-      if( sqlite3_strnicmp(zSql, "create virt", 11)==0 ){
-        const char *zName = (const char*)sqlite3_column_text(pStmt, 1);
-        char *zPrint = shellMPrintf(&rc, 
-          "INSERT INTO sqlite_master VALUES('table', %Q, %Q, 0, %Q)",
-          zName, zName, zSql
-        );
-        raw_printf(pState->out, "%s;\n", zPrint);
-        sqlite3_free(zPrint);
-      }else{
-        raw_printf(pState->out, "%s;\n", zSql);
-      }
+clone_fast_end:
+  close_db(newDb);
+  for(i=0; i<nTable; i++){
+    sqlite3_free(aTable[i].zName);
+    sqlite3_free(aTable[i].zCreate);
+  }
+  sqlite3_free(aTable);
+  sqlite3_free(zEncoding);
+  if( nErr ) shellDeleteFile(zNewDb);
+  return nErr;
+}
+
+/*
+** An online .backup copies the database a few pages at a time with
+** sqlite3_backup_step(), so that other connections can use the database
+** in between steps.  --pages sets how many pages each step copies and
+** --sleep how long to pause between steps, which throttles the backup of
+** a busy database.  When the backup is throttled or runs in the
+** background, a step which finds either database locked is retried after
+** a pause, for up to BACKUP_BUSY_TIMEOUT milliseconds, rather than failing
+** the backup at once.  With --progress, the
+** pages copied and left to copy, along with the rate of copying, are
+** shown on stderr as the backup runs.
+**
+** With --background, the steps run on a thread of their own, through a
+** connection of their own to the database file, leaving the shell free
+** for other commands.  Like changes made by any other connection, changes
+** made through the shell restart the backup.  Unless --sleep says
+** otherwise, it pauses BACKUP_BACKGROUND_SLEEP milliseconds between steps,
+** so that the shell's own statements seldom find the database locked;
+** with ".timeout", they wait out the brief locks the steps take instead.
+** ".backup --status" shows how far it has got and ".backup --cancel" stops
+** it.  The shell waits for it to finish before exiting.
+*/
+
+/* Milliseconds to wait before retrying a step which found a lock */
+#define BACKUP_BUSY_SLEEP 10
+
+/* Most milliseconds to keep retrying steps which find a lock */
+#define BACKUP_BUSY_TIMEOUT 5000
+
+/* Default milliseconds between the steps of a --background backup */
+#define BACKUP_BACKGROUND_SLEEP 20
+
+/* Milliseconds between updates of the --progress line */
+#define BACKUP_PROGRESS_INTERVAL 250
+
+/* A .backup, running either on the main thread or in the background */
+typedef struct BackupJob BackupJob;
+struct BackupJob {
+  sqlite3 *pDest;           /* Connection to the destination */
+  sqlite3 *pSrc;            /* Source connection of a --background backup */
+  sqlite3_backup *pBackup;  /* The backup itself */
+  char *zDestFile;          /* Name of the destination file */
+  int nPage;                /* Pages copied per step, or -1 for all */
+  int msSleep;              /* Milliseconds to pause between steps, or -1
+                            ** for the default */
+  int msBusy;               /* Most milliseconds to retry steps which find
+                            ** a lock, or 0 to fail at once */
+  int bProgress;            /* Show progress on stderr */
+  int bBackground;          /* Running on a thread of its own */
+  sqlite3_int64 szPage;     /* Page size of the source database */
+  sqlite3_int64 iStart;     /* timeOfDay() when the backup began */
+#if SHELL_USE_PTHREADS
+  pthread_t thread;         /* The thread running a --background backup */
+  pthread_mutex_t mutex;    /* Protects all fields below */
+#endif
+  int nRemaining;           /* Pages left to copy after the last step */
+  int nPageCount;           /* Pages in the source after the last step, or
+                            ** -1 before the first step */
+  int bCancel;              /* Set to stop the backup early */
+  int bDone;                /* True once the backup has stopped */
+  int rc;                   /* Result of the last step */
+};
+
+static void backup_job_lock(BackupJob *pJob){
+#if SHELL_USE_PTHREADS
+  if( pJob->bBackground ) pthread_mutex_lock(&pJob->mutex);
+#else
+  (void)pJob;
+#endif
+}
+
+static void backup_job_unlock(BackupJob *pJob){
+#if SHELL_USE_PTHREADS
+  if( pJob->bBackground ) pthread_mutex_unlock(&pJob->mutex);
+#else
+  (void)pJob;
+#endif
+}
+
+/*
+** Write a line to out describing how far the backup has got, ending with
+** zEnd.
+*/
+static void backup_job_report(FILE *out, BackupJob *pJob, const char *zEnd){
+  int nRemaining, nPageCount;
+  sqlite3_int64 iElapsed = timeOfDay() - pJob->iStart;
+  double rMBps = 0.0;
+  backup_job_lock(pJob);
+  nRemaining = pJob->nRemaining;
+  nPageCount = pJob->nPageCount;
+  backup_job_unlock(pJob);
+  if( nPageCount<0 ){
+    utf8_printf(out, "%s: starting%s", pJob->zDestFile, zEnd);
+    fflush(out);
+    return;
+  }
+  if( iElapsed>0 ){
+    rMBps = (double)(nPageCount - nRemaining)*(double)pJob->szPage
+              / (double)iElapsed / 1000.0;
+  }
+  utf8_printf(out, "%s: %d of %d pages copied, %d remaining, %.2f MB/s%s",
+              pJob->zDestFile, nPageCount - nRemaining, nPageCount,
+              nRemaining, rMBps, zEnd);
+  fflush(out);
+}
+
+/*
+** Copy pages until the backup is finished, fails or is cancelled.  Return
+** the result of the last step, which is SQLITE_DONE on success.
+*/
+static int backup_job_run(BackupJob *pJob){
+  sqlite3_int64 iLastReport = 0;
+  sqlite3_int64 iBusy = 0;  /* When steps began finding a lock, or 0 */
+  int rc;
+  int bCancel;
+  for(;;){
+    rc = sqlite3_backup_step(pJob->pBackup, pJob->nPage);
+    backup_job_lock(pJob);
+    pJob->nRemaining = sqlite3_backup_remaining(pJob->pBackup);
+    pJob->nPageCount = sqlite3_backup_pagecount(pJob->pBackup);
+    pJob->rc = rc;
+    bCancel = pJob->bCancel;
+    backup_job_unlock(pJob);
+    if( rc!=SQLITE_OK && rc!=SQLITE_BUSY && rc!=SQLITE_LOCKED ) break;
+    if( rc==SQLITE_OK ){
+      iBusy = 0;
+    }else if( iBusy==0 ){
+      iBusy = timeOfDay();
+    }
+    if( rc!=SQLITE_OK && timeOfDay() - iBusy >= pJob->msBusy ) break;
+    if( !pJob->bBackground && seenInterrupt ) bCancel = 1;
+    if( bCancel ){
+      rc = SQLITE_INTERRUPT;
+      break;
+    }
+    if( pJob->bProgress
+     && timeOfDay() - iLastReport >= BACKUP_PROGRESS_INTERVAL
+    ){
+      backup_job_report(stderr, pJob, "\r");
+      iLastReport = timeOfDay();
+    }
+    if( pJob->msSleep>0 ){
+      sqlite3_sleep(pJob->msSleep);
+    }else if( rc!=SQLITE_OK ){
+      sqlite3_sleep(BACKUP_BUSY_SLEEP);
     }
-    shellFinalize(&rc, pStmt);
   }
+  if( pJob->bProgress ) backup_job_report(stderr, pJob, "\n");
+  return rc;
+}
 
-  if( rc==SQLITE_OK ){
-    raw_printf(pState->out, "PRAGMA writable_schema = off;\n");
-    raw_printf(pState->out, "COMMIT;\n");
+/*
+** Finish a backup which has stopped, report how it ended and free it.
+** Return 0 if it succeeded, or 1 otherwise.
+*/
+static int backup_job_finish(BackupJob *pJob, int rc){
+  sqlite3_backup_finish(pJob->pBackup);
+  if( rc==SQLITE_DONE ){
+    rc = 0;
+  }else if( rc==SQLITE_INTERRUPT ){
+    utf8_printf(stderr, "Error: backup to \"%s\" cancelled\n",
+                pJob->zDestFile);
+    rc = 1;
+  }else{
+    utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(pJob->pDest));
+    rc = 1;
   }
-  sqlite3_exec(pState->db, "DETACH recovery", 0, 0, 0);
+  close_db(pJob->pDest);
+  if( pJob->pSrc ) close_db(pJob->pSrc);
+#if SHELL_USE_PTHREADS
+  if( pJob->bBackground ) pthread_mutex_destroy(&pJob->mutex);
+#endif
+  sqlite3_free(pJob->zDestFile);
+  sqlite3_free(pJob);
   return rc;
 }
-#endif /* !(SQLITE_OMIT_VIRTUALTABLE) && defined(SQLITE_ENABLE_DBPAGE_VTAB) */
 
+#if SHELL_USE_PTHREADS
+static void *backup_job_main(void *pArg){
+  BackupJob *pJob = (BackupJob*)pArg;
+  int rc;
+  /* Let the shell's next statement run before the first step, too */
+  sqlite3_sleep(pJob->msSleep);
+  rc = backup_job_run(pJob);
+  backup_job_lock(pJob);
+  pJob->rc = rc;
+  pJob->bDone = 1;
+  backup_job_unlock(pJob);
+  return 0;
+}
+
+/*
+** Wait for the background backup, if there is one, to stop, and finish
+** it.  If bCancel is true, or if the user interrupts the wait, cancel it
+** first.  Return 0 if there was no background backup or it succeeded,
+** and 1 otherwise.
+*/
+static int backup_background_finish(ShellState *p, int bCancel){
+  BackupJob *pJob = p->pBackupJob;
+  int bDone = 0;
+  if( pJob==0 ) return 0;
+  p->pBackupJob = 0;
+  while( !bDone ){
+    backup_job_lock(pJob);
+    if( bCancel || seenInterrupt ) pJob->bCancel = 1;
+    bDone = pJob->bDone;
+    backup_job_unlock(pJob);
+    if( !bDone ) sqlite3_sleep(BACKUP_PROGRESS_INTERVAL/5);
+  }
+  pthread_join(pJob->thread, 0);
+  return backup_job_finish(pJob, pJob->rc);
+}
+
+/*
+** Return true if the background backup, if there is one, has stopped.
+*/
+static int backup_background_done(ShellState *p){
+  int bDone;
+  if( p->pBackupJob==0 ) return 1;
+  backup_job_lock(p->pBackupJob);
+  bDone = p->pBackupJob->bDone;
+  backup_job_unlock(p->pBackupJob);
+  return bDone;
+}
+#else
+static int backup_background_finish(ShellState *p, int bCancel){
+  (void)p;
+  (void)bCancel;
+  return 0;
+}
+static int backup_background_done(ShellState *p){
+  (void)p;
+  return 1;
+}
+#endif /* SHELL_USE_PTHREADS */
+
+/*
+** Back up database zDb of the shell's connection to pJob->pDest, with the
+** options already set in pJob, which must come from sqlite3_malloc() and
+** which this frees, along with its destination connection and file name.
+** Unless the backup runs in the background, it is finished before this
+** returns.  Return 0 on success or 1 on failure.
+*/
+static int backup_start(ShellState *p, BackupJob *pJob, const char *zDb){
+  sqlite3 *pSrc = p->db;
+  char *zSql;
+  zSql = sqlite3_mprintf("PRAGMA \"%w\".page_size", zDb);
+  if( zSql==0 ) shell_out_of_memory();
+  pJob->szPage = db_int(p, zSql);
+  sqlite3_free(zSql);
+#if SHELL_USE_PTHREADS
+  if( pJob->bBackground ){
+    const char *zFile = sqlite3_db_filename(p->db, zDb);
+    if( zFile==0 || zFile[0]==0
+     || (p->openMode!=SHELL_OPEN_NORMAL && p->openMode!=SHELL_OPEN_READONLY)
+     || sqlite3_open_v2(zFile, &pJob->pSrc,
+                        SQLITE_OPEN_READONLY|SQLITE_OPEN_NOMUTEX, 0)!=SQLITE_OK
+    ){
+      raw_printf(stderr, "Cannot reopen the database on another thread; "
+                         "backing up in the foreground instead\n");
+      close_db(pJob->pSrc);
+      pJob->pSrc = 0;
+      pJob->bBackground = 0;
+    }else{
+      pSrc = pJob->pSrc;
+      zDb = "main";
+    }
+  }
+#endif
+  /* A lock held by the shell's own transaction won't go away by waiting */
+  if( pSrc==p->db && !sqlite3_get_autocommit(p->db) ) pJob->msBusy = 0;
+  if( pJob->msSleep<0 ){
+    pJob->msSleep = pJob->bBackground ? BACKUP_BACKGROUND_SLEEP : 0;
+  }
+  pJob->pBackup = sqlite3_backup_init(pJob->pDest, "main", pSrc, zDb);
+  if( pJob->pBackup==0 ){
+    utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(pJob->pDest));
+    close_db(pJob->pDest);
+    if( pJob->pSrc ) close_db(pJob->pSrc);
+    sqlite3_free(pJob->zDestFile);
+    sqlite3_free(pJob);
+    return 1;
+  }
+  pJob->iStart = timeOfDay();
+  pJob->nPageCount = -1;
+#if SHELL_USE_PTHREADS
+  if( pJob->bBackground ){
+    /* Progress would garble the prompt.  Use ".backup --status" */
+    pJob->bProgress = 0;
+    pthread_mutex_init(&pJob->mutex, 0);
+    if( pthread_create(&pJob->thread, 0, backup_job_main, pJob)==0 ){
+      p->pBackupJob = pJob;
+      return 0;
+    }
+    pthread_mutex_destroy(&pJob->mutex);
+    pJob->bBackground = 0;
+  }
+#else
+  pJob->bBackground = 0;
+#endif
+  return backup_job_finish(pJob, backup_job_run(pJob));
+}
 
 /*
 ** If an input line begins with "." then invoke this routine to
@@ -15552,9 +19742,14 @@ static int do_meta_command(char *zLine, ShellState *p){
     const char *zDestFile = 0;
     const char *zDb = 0;
     sqlite3 *pDest;
-    sqlite3_backup *pBackup;
+    BackupJob *pJob;
     int j;
     int bAsync = 0;
+    int nPage = 100;
+    int msSleep = -1;
+    int bThrottle = 0;
+    int bProgress = 0;
+    int bBackground = 0;
     const char *zVfs = 0;
     for(j=1; j<nArg; j++){
       const char *z = azArg[j];
@@ -15566,6 +19761,36 @@ static int do_meta_command(char *zLine, ShellState *p){
         if( strcmp(z, "-async")==0 ){
           bAsync = 1;
         }else
+        if( strcmp(z, "-pages")==0 && j+1<nArg ){
+          nPage = (int)integerValue(azArg[++j]);
+          if( nPage<=0 ) nPage = -1;
+          bThrottle = 1;
+        }else
+        if( strcmp(z, "-sleep")==0 && j+1<nArg ){
+          msSleep = (int)integerValue(azArg[++j]);
+          if( msSleep<0 ) msSleep = 0;
+          bThrottle = 1;
+        }else
+        if( strcmp(z, "-progress")==0 ){
+          bProgress = 1;
+        }else
+        if( strcmp(z, "-background")==0 ){
+          bBackground = 1;
+        }else
+        if( strcmp(z, "-status")==0 && nArg==2 ){
+          if( p->pBackupJob==0 ){
+            raw_printf(p->out, "No background backup\n");
+          }else if( !backup_background_done(p) ){
+            backup_job_report(p->out, p->pBackupJob, "\n");
+          }else{
+            backup_job_report(p->out, p->pBackupJob, ", finished\n");
+            return backup_background_finish(p, 0);
+          }
+          return 0;
+        }else
+        if( strcmp(z, "-cancel")==0 && nArg==2 ){
+          return backup_background_finish(p, 1);
+        }else
         {
           utf8_printf(stderr, "unknown option: %s\n", azArg[j]);
           return 1;
@@ -15584,6 +19809,13 @@ static int do_meta_command(char *zLine, ShellState *p){
       raw_printf(stderr, "missing FILENAME argument on .backup\n");
       return 1;
     }
+    if( bBackground && p->pBackupJob ){
+      if( !backup_background_done(p) ){
+        raw_printf(stderr, "Error: a background backup is already running\n");
+        return 1;
+      }
+      backup_background_finish(p, 0);
+    }
     if( zDb==0 ) zDb = "main";
     rc = sqlite3_open_v2(zDestFile, &pDest, 
                   SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE, zVfs);
@@ -15597,21 +19829,18 @@ static int do_meta_command(char *zLine, ShellState *p){
                    0, 0, 0);
     }
     open_db(p, 0);
-    pBackup = sqlite3_backup_init(pDest, "main", p->db, zDb);
-    if( pBackup==0 ){
-      utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(pDest));
-      close_db(pDest);
-      return 1;
-    }
-    while(  (rc = sqlite3_backup_step(pBackup,100))==SQLITE_OK ){}
-    sqlite3_backup_finish(pBackup);
-    if( rc==SQLITE_DONE ){
-      rc = 0;
-    }else{
-      utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(pDest));
-      rc = 1;
-    }
-    close_db(pDest);
+    pJob = sqlite3_malloc64(sizeof(*pJob));
+    if( pJob==0 ) shell_out_of_memory();
+    memset(pJob, 0, sizeof(*pJob));
+    pJob->pDest = pDest;
+    pJob->zDestFile = sqlite3_mprintf("%s", zDestFile);
+    if( pJob->zDestFile==0 ) shell_out_of_memory();
+    pJob->nPage = nPage;
+    pJob->msSleep = msSleep;
+    pJob->msBusy = (bThrottle || bBackground) ? BACKUP_BUSY_TIMEOUT : 0;
+    pJob->bProgress = bProgress;
+    pJob->bBackground = bBackground;
+    rc = backup_start(p, pJob, zDb);
   }else
 
   if( c=='b' && n>=3 && strncmp(azArg[0], "bail", n)==0 ){
@@ -15697,10 +19926,32 @@ static int do_meta_command(char *zLine, ShellState *p){
   }else
 
   if( c=='c' && strncmp(azArg[0], "clone", n)==0 ){
-    if( nArg==2 ){
-      tryToClone(p, azArg[1]);
+    const char *zFile = 0;
+    int nThread = 0;
+    int i;
+    for(i=1; i<nArg; i++){
+      const char *z = azArg[i];
+      if( z[0]=='-' && z[1]!=0 ){
+        if( z[1]=='-' ) z++;
+        if( strcmp(z, "-threads")==0 && i+1<nArg ){
+          nThread = (int)integerValue(azArg[++i]);
+        }else
+        {
+          utf8_printf(stderr, "unknown option: %s\n", azArg[i]);
+          rc = 1;
+          goto meta_command_exit;
+        }
+      }else if( zFile==0 ){
+        zFile = z;
+      }else{
+        zFile = 0;
+        break;
+      }
+    }
+    if( zFile ){
+      tryToClone(p, zFile, nThread);
     }else{
-      raw_printf(stderr, "Usage: .clone FILENAME\n");
+      raw_printf(stderr, "Usage: .clone ?--threads N? FILENAME\n");
       rc = 1;
     }
   }else
@@ -15775,9 +20026,17 @@ static int do_meta_command(char *zLine, ShellState *p){
 
   if( c=='d' && strncmp(azArg[0], "dump", n)==0 ){
     const char *zLike = 0;
+    char *zSql;
     int i;
+    int nThread = 0;
+    int bDone = 0;
+    int nRows = 1;
+    int nBatch = 0;
+    int bBinary = 0;
     int savedShowHeader = p->showHeader;
     int savedShellFlags = p->shellFlgs;
+    int savedInsertRows = p->nInsertRows;
+    int savedInsertBatch = p->nInsertBatch;
     ShellClearFlag(p, SHFLG_PreserveRowid|SHFLG_Newlines|SHFLG_Echo);
     for(i=1; i<nArg; i++){
       if( azArg[i][0]=='-' ){
@@ -15796,6 +20055,19 @@ static int do_meta_command(char *zLine, ShellState *p){
         if( strcmp(z,"newlines")==0 ){
           ShellSetFlag(p, SHFLG_Newlines);
         }else
+        if( strcmp(z,"threads")==0 && i+1<nArg ){
+          nThread = (int)integerValue(azArg[++i]);
+          if( nThread<0 ) nThread = 0;
+        }else
+        if( strcmp(z,"multirow")==0 && i+1<nArg ){
+          nRows = (int)integerValue(azArg[++i]);
+        }else
+        if( strcmp(z,"batch")==0 && i+1<nArg ){
+          nBatch = (int)integerValue(azArg[++i]);
+        }else
+        if( strcmp(z,"binary")==0 ){
+          bBinary = 1;
+        }else
         {
           raw_printf(stderr, "Unknown option \"%s\" on \".dump\"\n", azArg[i]);
           rc = 1;
@@ -15803,7 +20075,8 @@ static int do_meta_command(char *zLine, ShellState *p){
         }
       }else if( zLike ){
         raw_printf(stderr, "Usage: .dump ?--preserve-rowids? "
-                           "?--newlines? ?LIKE-PATTERN?\n");
+                           "?--newlines? ?--multirow N? ?--batch N? "
+                           "?--threads N? ?--binary? ?LIKE-PATTERN?\n");
         rc = 1;
         goto meta_command_exit;
       }else{
@@ -15813,23 +20086,47 @@ static int do_meta_command(char *zLine, ShellState *p){
 
     open_db(p, 0);
 
+    if( bBinary ){
+      /* Only --preserve-rowids matters to a binary dump */
+      rc = dump_binary(p, zLike);
+      p->shellFlgs = savedShellFlags;
+      goto meta_command_exit;
+    }
+
     /* When playing back a "dump", the content might appear in an order
     ** which causes immediate foreign key constraints to be violated.
     ** So disable foreign-key constraint enforcement to prevent problems. */
     raw_printf(p->out, "PRAGMA foreign_keys=OFF;\n");
     raw_printf(p->out, "BEGIN TRANSACTION;\n");
+    /* Other connections can't see changes in a transaction left open */
+    if( !sqlite3_get_autocommit(p->db) ) nThread = 0;
     p->writableSchema = 0;
     p->showHeader = 0;
+    p->nInsertRows = nRows>1 ? nRows : 1;
+    p->nInsertBatch = nBatch>0 ? nBatch : 0;
+    p->nInsertCommit = 0;
+    p->bInsertInTxn = 1;
     /* Set writable_schema=ON since doing so forces SQLite to initialize
     ** as much of the schema as it can even if the sqlite_master table is
     ** corrupt. */
     sqlite3_exec(p->db, "SAVEPOINT dump; PRAGMA writable_schema=ON", 0, 0, 0);
     p->nErr = 0;
     if( zLike==0 ){
-      run_schema_dump_query(p,
+      zSql = sqlite3_mprintf(
         "SELECT name, type, sql FROM sqlite_master "
-        "WHERE sql NOT NULL AND type=='table' AND name!='sqlite_sequence'"
-      );
+        "WHERE sql NOT NULL AND type=='table' AND name!='sqlite_sequence'");
+    }else{
+      zSql = sqlite3_mprintf(
+        "SELECT name, type, sql FROM sqlite_master "
+        "WHERE tbl_name LIKE %Q AND type=='table'"
+        "  AND sql NOT NULL", zLike);
+    }
+#if SHELL_USE_PTHREADS
+    if( nThread>0 ) bDone = dump_parallel(p, zSql, nThread);
+#endif
+    if( !bDone ) run_schema_dump_query(p, zSql);
+    sqlite3_free(zSql);
+    if( zLike==0 ){
       run_schema_dump_query(p,
         "SELECT name, type, sql FROM sqlite_master "
         "WHERE name=='sqlite_sequence'"
@@ -15839,13 +20136,6 @@ static int do_meta_command(char *zLine, ShellState *p){
         "WHERE sql NOT NULL AND type IN ('index','trigger','view')", 0
       );
     }else{
-      char *zSql;
-      zSql = sqlite3_mprintf(
-        "SELECT name, type, sql FROM sqlite_master "
-        "WHERE tbl_name LIKE %Q AND type=='table'"
-        "  AND sql NOT NULL", zLike);
-      run_schema_dump_query(p,zSql);
-      sqlite3_free(zSql);
       zSql = sqlite3_mprintf(
         "SELECT sql FROM sqlite_master "
         "WHERE sql NOT NULL"
@@ -15861,8 +20151,19 @@ static int do_meta_command(char *zLine, ShellState *p){
     sqlite3_exec(p->db, "PRAGMA writable_schema=OFF;", 0, 0, 0);
     sqlite3_exec(p->db, "RELEASE dump;", 0, 0, 0);
     raw_printf(p->out, p->nErr?"ROLLBACK; -- due to errors\n":"COMMIT;\n");
+    if( p->nErr && p->nInsertCommit>0 ){
+      /* The ROLLBACK only undoes the last batch, so say so in the dump,
+      ** where whoever loads it can see, and here. */
+      raw_printf(p->out, "-- ERROR: only the last batch was rolled back, "
+                         "so this dump loads in part\n");
+      raw_printf(stderr, "Warning: errors in a dump with --batch, "
+                         "whose earlier batches load anyway\n");
+    }
     p->showHeader = savedShowHeader;
     p->shellFlgs = savedShellFlags;
+    p->nInsertRows = savedInsertRows;
+    p->nInsertBatch = savedInsertBatch;
+    p->bInsertInTxn = 0;
   }else
 
   if( c=='e' && strncmp(azArg[0], "echo", n)==0 ){
@@ -15906,7 +20207,10 @@ static int do_meta_command(char *zLine, ShellState *p){
   }else
 
   if( c=='e' && strncmp(azArg[0], "exit", n)==0 ){
-    if( nArg>1 && (rc = (int)integerValue(azArg[1]))!=0 ) exit(rc);
+    if( nArg>1 && (rc = (int)integerValue(azArg[1]))!=0 ){
+      backup_background_finish(p, 0);
+      exit(rc);
+    }
     rc = 2;
   }else
 
@@ -16145,15 +20449,61 @@ static int do_meta_command(char *zLine, ShellState *p){
     ImportCtx sCtx;             /* Reader context */
     char *(SQLITE_CDECL *xRead)(ImportCtx*); /* Func to read one value */
     int (SQLITE_CDECL *xCloser)(FILE*);      /* Func to close file */
-
-    if( nArg!=3 ){
-      raw_printf(stderr, "Usage: .import FILE TABLE\n");
+    int nThread = -1;           /* Worker threads to parse with.  -1: auto */
+    int bDone = 0;              /* True once every record is inserted */
+    int nBatch = 0;             /* Rows per transaction.  0: all in one */
+    int nSample = 0;            /* Rows to infer new column types from */
+    int bProgress = 0;          /* True to report progress */
+    ImportChunk *pSample = 0;   /* Rows read to infer column types from */
+    ImportOutput sOut;          /* Where the rows go */
+
+    zFile = 0;
+    zTable = 0;
+    for(i=1; i<nArg; i++){
+      const char *z = azArg[i];
+      if( z[0]=='-' && z[1]!=0 ){
+        if( z[1]=='-' ) z++;
+        if( (strcmp(z, "-batch")==0 || strcmp(z, "-infer")==0
+             || strcmp(z, "-threads")==0) && i+1>=nArg ){
+          utf8_printf(stderr, "missing argument to %s\n", azArg[i]);
+          rc = 1;
+          goto meta_command_exit;
+        }else
+        if( strcmp(z, "-batch")==0 ){
+          nBatch = (int)integerValue(azArg[++i]);
+        }else
+        if( strcmp(z, "-infer")==0 ){
+          nSample = (int)integerValue(azArg[++i]);
+        }else
+        if( strcmp(z, "-progress")==0 ){
+          bProgress = 1;
+        }else
+        if( strcmp(z, "-threads")==0 ){
+          nThread = (int)integerValue(azArg[++i]);
+          if( nThread<0 ) nThread = 0;
+        }else
+        {
+          utf8_printf(stderr, "unknown option: %s\n", azArg[i]);
+          rc = 1;
+          goto meta_command_exit;
+        }
+      }else if( zFile==0 ){
+        zFile = azArg[i];
+      }else if( zTable==0 ){
+        zTable = azArg[i];
+      }else{
+        zTable = 0;
+        break;
+      }
+    }
+    if( zTable==0 ){
+      raw_printf(stderr, "Usage: .import ?OPTIONS? FILE TABLE\n");
       goto meta_command_exit;
     }
-    zFile = azArg[1];
-    zTable = azArg[2];
     seenInterrupt = 0;
     memset(&sCtx, 0, sizeof(sCtx));
+    memset(&sOut, 0, sizeof(sOut));
+    sOut.iStart = sOut.iReport = timeOfDay();
     open_db(p, 0);
     nSep = strlen30(p->colSeparator);
     if( nSep==0 ){
@@ -16208,6 +20558,9 @@ static int do_meta_command(char *zLine, ShellState *p){
       utf8_printf(stderr, "Error: cannot open \"%s\"\n", zFile);
       return 1;
     }
+#if SHELL_USE_DECOMPRESSION
+    if( zFile[0]!='|' ) sCtx.pCin = cinput_open(sCtx.in, sCtx.zFile);
+#endif
     sCtx.cColSep = p->colSeparator[0];
     sCtx.cRowSep = p->rowSeparator[0];
     zSql = sqlite3_mprintf("SELECT * FROM %s", zTable);
@@ -16217,29 +20570,56 @@ static int do_meta_command(char *zLine, ShellState *p){
     }
     nByte = strlen30(zSql);
     rc = sqlite3_prepare_v2(p->db, zSql, -1, &pStmt, 0);
-    import_append_char(&sCtx, 0);    /* To ensure sCtx.z is allocated */
     if( rc && sqlite3_strglob("no such table: *", sqlite3_errmsg(p->db))==0 ){
+      static const char *const azType[] = { "TEXT", "INTEGER", "REAL", "TEXT" };
       char *zCreate = sqlite3_mprintf("CREATE TABLE %s", zTable);
-      char cSep = '(';
-      while( xRead(&sCtx) ){
-        zCreate = sqlite3_mprintf("%z%c\n  \"%w\" TEXT", zCreate, cSep, sCtx.z);
-        cSep = ',';
+      char **azName = 0;        /* Names of the new columns */
+      int *aType;               /* IMPORT_TYPE_* of each new column */
+      int nName = 0;            /* Number of new columns */
+      char *z;
+      while( (z = xRead(&sCtx))!=0 ){
+        if( (nName & 15)==0 ){
+          azName = sqlite3_realloc64(azName, (nName+16)*sizeof(azName[0]));
+          if( azName==0 ) shell_out_of_memory();
+        }
+        azName[nName] = sqlite3_mprintf("%s", z);
+        if( azName[nName]==0 ) shell_out_of_memory();
+        nName++;
         if( sCtx.cTerm!=sCtx.cColSep ) break;
       }
-      if( cSep=='(' ){
+      if( nName==0 ){
         sqlite3_free(zCreate);
-        sqlite3_free(sCtx.z);
+        import_cleanup(&sCtx);
         xCloser(sCtx.in);
         utf8_printf(stderr,"%s: empty file\n", sCtx.zFile);
         return 1;
       }
+      aType = sqlite3_malloc64(nName*sizeof(aType[0]));
+      if( aType==0 ) shell_out_of_memory();
+      memset(aType, 0, nName*sizeof(aType[0]));
+      if( nSample>0 ){
+        pSample = sqlite3_malloc64(sizeof(*pSample));
+        if( pSample==0 ) shell_out_of_memory();
+        memset(pSample, 0, sizeof(*pSample));
+        import_sample(&sCtx, xRead, nName, p->mode==MODE_Ascii, nSample,
+                      pSample, aType);
+      }
+      for(i=0; i<nName; i++){
+        zCreate = sqlite3_mprintf("%z%c\n  \"%w\" %s", zCreate,
+                                  i==0 ? '(' : ',', azName[i],
+                                  azType[aType[i]]);
+        sqlite3_free(azName[i]);
+      }
+      sqlite3_free(azName);
+      sqlite3_free(aType);
       zCreate = sqlite3_mprintf("%z\n)", zCreate);
       rc = sqlite3_exec(p->db, zCreate, 0, 0, 0);
       sqlite3_free(zCreate);
       if( rc ){
         utf8_printf(stderr, "CREATE TABLE %s(...) failed: %s\n", zTable,
                 sqlite3_errmsg(p->db));
-        sqlite3_free(sCtx.z);
+        if( pSample ) import_chunk_free(pSample);
+        import_cleanup(&sCtx);
         xCloser(sCtx.in);
         return 1;
       }
@@ -16249,13 +20629,20 @@ static int do_meta_command(char *zLine, ShellState *p){
     if( rc ){
       if (pStmt) sqlite3_finalize(pStmt);
       utf8_printf(stderr,"Error: %s\n", sqlite3_errmsg(p->db));
+      if( pSample ) import_chunk_free(pSample);
+      import_cleanup(&sCtx);
       xCloser(sCtx.in);
       return 1;
     }
     nCol = sqlite3_column_count(pStmt);
     sqlite3_finalize(pStmt);
     pStmt = 0;
-    if( nCol==0 ) return 0; /* no columns, no error */
+    if( nCol==0 ){
+      /* no columns, no error */
+      import_cleanup(&sCtx);
+      xCloser(sCtx.in);
+      return 0;
+    }
     zSql = sqlite3_malloc64( nByte*2 + 20 + nCol*2 );
     if( zSql==0 ){
       xCloser(sCtx.in);
@@ -16274,56 +20661,45 @@ static int do_meta_command(char *zLine, ShellState *p){
     if( rc ){
       utf8_printf(stderr, "Error: %s\n", sqlite3_errmsg(p->db));
       if (pStmt) sqlite3_finalize(pStmt);
+      if( pSample ) import_chunk_free(pSample);
+      import_cleanup(&sCtx);
       xCloser(sCtx.in);
       return 1;
     }
     needCommit = sqlite3_get_autocommit(p->db);
     if( needCommit ) sqlite3_exec(p->db, "BEGIN", 0, 0, 0);
-    do{
+    sOut.pStmt = pStmt;
+    sOut.zFile = sCtx.zFile;
+    sOut.nCol = nCol;
+    sOut.nBatch = needCommit && nBatch>0 ? nBatch : 0;
+    sOut.bProgress = bProgress;
+    sOut.nByte = sCtx.nRead - (sqlite3_int64)(sCtx.nBuf - sCtx.iBuf);
+    if( pSample ){
+      import_insert_chunk(&sOut, pSample);
+      import_chunk_free(pSample);
+    }
+#if SHELL_USE_PTHREADS
+    if( nThread<0 ) nThread = import_default_threads();
+    if( nThread>0 ){
+      bDone = import_parallel(&sCtx, xRead, p->mode==MODE_Ascii, &sOut,
+                              nThread);
+    }
+#endif
+    while( !bDone ){
       int startLine = sCtx.nLine;
-      for(i=0; i<nCol; i++){
-        char *z = xRead(&sCtx);
-        /*
-        ** Did we reach end-of-file before finding any columns?
-        ** If so, stop instead of NULL filling the remaining columns.
-        */
-        if( z==0 && i==0 ) break;
-        /*
-        ** Did we reach end-of-file OR end-of-line before finding any
-        ** columns in ASCII mode?  If so, stop instead of NULL filling
-        ** the remaining columns.
-        */
-        if( p->mode==MODE_Ascii && (z==0 || z[0]==0) && i==0 ) break;
-        sqlite3_bind_text(pStmt, i+1, z, -1, SQLITE_TRANSIENT);
-        if( i<nCol-1 && sCtx.cTerm!=sCtx.cColSep ){
-          utf8_printf(stderr, "%s:%d: expected %d columns but found %d - "
-                          "filling the rest with NULL\n",
-                          sCtx.zFile, startLine, nCol, i+1);
-          i += 2;
-          while( i<=nCol ){ sqlite3_bind_null(pStmt, i); i++; }
-        }
-      }
-      if( sCtx.cTerm==sCtx.cColSep ){
-        do{
-          xRead(&sCtx);
-          i++;
-        }while( sCtx.cTerm==sCtx.cColSep );
-        utf8_printf(stderr, "%s:%d: expected %d columns but found %d - "
-                        "extras ignored\n",
-                        sCtx.zFile, startLine, nCol, i);
-      }
-      if( i>=nCol ){
-        sqlite3_step(pStmt);
-        rc = sqlite3_reset(pStmt);
-        if( rc!=SQLITE_OK ){
-          utf8_printf(stderr, "%s:%d: INSERT failed: %s\n", sCtx.zFile,
-                      startLine, sqlite3_errmsg(p->db));
-        }
+      if( import_next_record(&sCtx, xRead, nCol, p->mode==MODE_Ascii) ){
+        /* Missing fields are bound to NULL */
+        import_bind_record(&sCtx, pStmt, nCol);
+        sOut.nByte = sCtx.nRead - (sqlite3_int64)(sCtx.nBuf - sCtx.iBuf);
+        import_insert(&sOut, startLine);
       }
-    }while( sCtx.cTerm!=EOF );
+      bDone = sCtx.cTerm==EOF;
+    }
+    rc = sOut.rc;
+    if( bProgress ) import_progress(&sOut, 1);
 
     xCloser(sCtx.in);
-    sqlite3_free(sCtx.z);
+    import_cleanup(&sCtx);
     sqlite3_finalize(pStmt);
     if( needCommit ) sqlite3_exec(p->db, "COMMIT", 0, 0, 0);
   }else
@@ -16576,10 +20952,39 @@ static int do_meta_command(char *zLine, ShellState *p){
       p->mode = MODE_List;
       sqlite3_snprintf(sizeof(p->colSeparator), p->colSeparator, SEP_Tab);
     }else if( c2=='i' && strncmp(azArg[1],"insert",n2)==0 ){
+      const char *zTab = "table";
+      int i;
+      int nRows = 1;
+      int nBatch = 0;
+      for(i=2; i<nArg; i++){
+        const char *z = azArg[i];
+        if( z[0]=='-' && z[1]!=0 ){
+          if( z[1]=='-' ) z++;
+          if( strcmp(z, "-multirow")==0 && i+1<nArg ){
+            nRows = (int)integerValue(azArg[++i]);
+          }else
+          if( strcmp(z, "-batch")==0 && i+1<nArg ){
+            nBatch = (int)integerValue(azArg[++i]);
+          }else
+          {
+            utf8_printf(stderr, "unknown option: %s\n", azArg[i]);
+            rc = 1;
+            goto meta_command_exit;
+          }
+        }else{
+          zTab = z;
+        }
+      }
       p->mode = MODE_Insert;
-      set_table_name(p, nArg>=3 ? azArg[2] : "table");
+      p->nInsertRows = nRows>1 ? nRows : 1;
+      p->nInsertBatch = nBatch>0 ? nBatch : 0;
+      set_table_name(p, zTab);
     }else if( c2=='q' && strncmp(azArg[1],"quote",n2)==0 ){
       p->mode = MODE_Quote;
+    }else if( c2=='j' && strncmp(azArg[1],"json",n2)==0 ){
+      p->mode = MODE_Json;
+    }else if( c2=='n' && strncmp(azArg[1],"ndjson",n2)==0 ){
+      p->mode = MODE_NdJson;
     }else if( c2=='a' && strncmp(azArg[1],"ascii",n2)==0 ){
       p->mode = MODE_Ascii;
       sqlite3_snprintf(sizeof(p->colSeparator), p->colSeparator, SEP_Unit);
@@ -16588,7 +20993,7 @@ static int do_meta_command(char *zLine, ShellState *p){
       raw_printf(p->out, "current output mode: %s\n", modeDescr[p->mode]);
     }else{
       raw_printf(stderr, "Error: mode should be one of: "
-         "ascii column csv html insert line list quote tabs tcl\n");
+         "ascii column csv html insert json line list ndjson quote tabs tcl\n");
       rc = 1;
     }
     p->cMode = p->mode;
@@ -16725,6 +21130,7 @@ static int do_meta_command(char *zLine, ShellState *p){
         p->out = stdout;
         rc = 1;
       }else{
+        output_set_buffer(p->out);
         sqlite3_snprintf(sizeof(p->outfile), p->outfile, "%s", zFile);
       }
 #endif
@@ -16916,6 +21322,7 @@ static int do_meta_command(char *zLine, ShellState *p){
 
   if( c=='r' && n>=3 && strncmp(azArg[0], "read", n)==0 ){
     FILE *inSaved = p->in;
+    struct CompressedInput *pCinSaved = p->pCin;
     int savedLineno = p->lineno;
     if( nArg!=2 ){
       raw_printf(stderr, "Usage: .read FILE\n");
@@ -16927,13 +21334,58 @@ static int do_meta_command(char *zLine, ShellState *p){
       utf8_printf(stderr,"Error: cannot open \"%s\"\n", azArg[1]);
       rc = 1;
     }else{
+#if SHELL_USE_DECOMPRESSION
+      p->pCin = cinput_open(p->in, azArg[1]);
+#else
+      p->pCin = 0;
+#endif
+      nTimerReadDepth++;
       rc = process_input(p);
+      if( --nTimerReadDepth==0 && enableTimer==SHELL_TIMER_SUMMARY ){
+        timer_summary(p);
+      }
+#if SHELL_USE_DECOMPRESSION
+      cinput_close(p->pCin);
+#endif
       fclose(p->in);
     }
     p->in = inSaved;
+    p->pCin = pCinSaved;
     p->lineno = savedLineno;
   }else
 
+  if( c=='r' && n>=8 && strncmp(azArg[0], "restore-dump", n)==0 ){
+    const char *zFile = 0;
+    int nThread = 0;
+    int i;
+    for(i=1; i<nArg; i++){
+      const char *z = azArg[i];
+      if( z[0]=='-' && z[1]!=0 ){
+        if( z[1]=='-' ) z++;
+        if( strcmp(z, "-threads")==0 && i+1<nArg ){
+          nThread = (int)integerValue(azArg[++i]);
+        }else
+        {
+          utf8_printf(stderr, "unknown option: %s\n", azArg[i]);
+          rc = 1;
+          goto meta_command_exit;
+        }
+      }else if( zFile==0 ){
+        zFile = z;
+      }else{
+        zFile = 0;
+        break;
+      }
+    }
+    if( zFile==0 ){
+      raw_printf(stderr, "Usage: .restore-dump ?--threads N? FILE\n");
+      rc = 1;
+      goto meta_command_exit;
+    }
+    open_db(p, 0);
+    rc = restore_dump(p, zFile, nThread)>0;
+  }else
+
   if( c=='r' && n>=3 && strncmp(azArg[0], "restore", n)==0 ){
     const char *zSrcFile;
     const char *zDb;
@@ -17964,15 +22416,62 @@ static int do_meta_command(char *zLine, ShellState *p){
   }else
 
   if( c=='t' && n>=5 && strncmp(azArg[0], "timer", n)==0 ){
-    if( nArg==2 ){
-      enableTimer = booleanValue(azArg[1]);
-      if( enableTimer && !HAS_TIMER ){
-        raw_printf(stderr, "Error: timer not available on this system.\n");
-        enableTimer = 0;
+    const char *zCsv = 0;
+    int eMode = -1;
+    int bReport = 0;
+    int i;
+    for(i=1; i<nArg; i++){
+      const char *z = azArg[i];
+      if( z[0]=='-' && z[1]!=0 ){
+        if( z[1]=='-' ) z++;
+        if( strcmp(z, "-csv")==0 && i+1<nArg ){
+          zCsv = azArg[++i];
+        }else
+        {
+          utf8_printf(stderr, "unknown option: %s\n", azArg[i]);
+          rc = 1;
+          goto meta_command_exit;
+        }
+      }else if( eMode<0 && !bReport ){
+        if( strcmp(z, "summary")==0 ){
+          eMode = SHELL_TIMER_SUMMARY;
+        }else if( strcmp(z, "report")==0 ){
+          bReport = 1;
+        }else{
+          eMode = booleanValue(z) ? SHELL_TIMER_ON : 0;
+        }
+      }else{
+        eMode = -1;
+        bReport = 0;
+        break;
       }
-    }else{
-      raw_printf(stderr, "Usage: .timer on|off\n");
+    }
+    if( bReport && zCsv==0 ){
+      timer_summary(p);
+    }else if( eMode<0 || (eMode==0 && zCsv) ){
+      raw_printf(stderr, "Usage: .timer on|off|summary|report ?--csv FILE?\n");
       rc = 1;
+    }else if( eMode==SHELL_TIMER_ON && !HAS_TIMER ){
+      raw_printf(stderr, "Error: timer not available on this system.\n");
+      rc = 1;
+    }else{
+      timer_end(p);
+      enableTimer = eMode;
+      if( eMode ){
+        p->pTimerStats = sqlite3_malloc64(sizeof(*p->pTimerStats));
+        if( p->pTimerStats==0 ) shell_out_of_memory();
+        memset(p->pTimerStats, 0, sizeof(*p->pTimerStats));
+      }
+      if( zCsv ){
+        p->pTimerStats->pCsv = fopen(zCsv, "wb");
+        if( p->pTimerStats->pCsv==0 ){
+          utf8_printf(stderr, "Error: cannot open \"%s\"\n", zCsv);
+          rc = 1;
+        }else{
+          fputs("statement,prepare_ns,step_ns,total_ns,rc,sql\n",
+                p->pTimerStats->pCsv);
+        }
+      }
     }
   }else
 
@@ -18290,9 +22789,10 @@ static int runOneSqlLine(ShellState *p, char *zSql, FILE *in, int startline){
   open_db(p, 0);
   if( ShellHasFlag(p,SHFLG_Backslash) ) resolve_backslashes(zSql);
   if( p->flgProgress & SHELL_PROGRESS_RESET ) p->nProgress = 0;
+  p->iTimerPrepare = p->iTimerStep = 0;
   BEGIN_TIMER;
   rc = shell_exec(p, zSql, &zErrMsg);
-  END_TIMER;
+  END_TIMER(p->iTimerPrepare, p->iTimerStep);
   if( rc || zErrMsg ){
     char zPrefix[100];
     if( in!=0 || !stdin_is_interactive ){
@@ -18340,6 +22840,11 @@ static int process_input(ShellState *p){
   p->lineno = 0;
   while( errCnt==0 || !bail_on_error || (p->in==0 && stdin_is_interactive) ){
     fflush(p->out);
+#if SHELL_USE_DECOMPRESSION
+    if( p->pCin ){
+      zLine = cinput_getline(p->pCin, zLine);
+    }else
+#endif
     zLine = one_input_line(p->in, zLine, nSql>0);
     if( zLine==0 ){
       /* End of input */
@@ -18546,6 +23051,7 @@ static const char zOptions[] =
   "   -help                show this message\n"
   "   -html                set output mode to HTML\n"
   "   -interactive         force interactive I/O\n"
+  "   -json                set output mode to 'json'\n"
   "   -line                set output mode to 'line'\n"
   "   -list                set output mode to 'list'\n"
   "   -lookaside SIZE N    use N entries of SZ bytes for lookaside memory\n"
@@ -18557,6 +23063,7 @@ static const char zOptions[] =
 #ifdef SQLITE_ENABLE_MULTIPLEX
   "   -multiplex           enable the multiplexor VFS\n"
 #endif
+  "   -ndjson              set output mode to 'ndjson'\n"
   "   -newline SEP         set output row separator. Default: '\\n'\n"
   "   -nofollow            refuse to open symbolic links to database files\n"
   "   -nullvalue TEXT      set text string for NULL values. Default ''\n"
@@ -18686,6 +23193,8 @@ int SQLITE_CDECL wmain(int argc, wchar_t **wargv){
   setvbuf(stderr, 0, _IONBF, 0); /* Make sure stderr is unbuffered */
   stdin_is_interactive = isatty(0);
   stdout_is_console = isatty(1);
+  shellScanInit();
+  if( !stdout_is_console ) output_set_buffer(stdout);
 
 #if !defined(_WIN32_WCE)
   if( getenv("SQLITE_DEBUG_BREAK") ){
@@ -18960,6 +23469,10 @@ int SQLITE_CDECL wmain(int argc, wchar_t **wargv){
     }else if( strcmp(z,"-csv")==0 ){
       data.mode = MODE_Csv;
       memcpy(data.colSeparator,",",2);
+    }else if( strcmp(z,"-json")==0 ){
+      data.mode = MODE_Json;
+    }else if( strcmp(z,"-ndjson")==0 ){
+      data.mode = MODE_NdJson;
 #ifdef SQLITE_HAVE_ZLIB
     }else if( strcmp(z,"-zip")==0 ){
       data.openMode = SHELL_OPEN_ZIPFILE;
@@ -19056,16 +23569,22 @@ int SQLITE_CDECL wmain(int argc, wchar_t **wargv){
       z = cmdline_option_value(argc,argv,++i);
       if( z[0]=='.' ){
         rc = do_meta_command(z, &data);
-        if( rc && bail_on_error ) return rc==2 ? 0 : rc;
+        if( rc && bail_on_error ){
+          if( rc==2 ) rc = 0;
+          goto shell_main_exit;
+        }
       }else{
         open_db(&data, 0);
         rc = shell_exec(&data, z, &zErrMsg);
         if( zErrMsg!=0 ){
           utf8_printf(stderr,"Error: %s\n", zErrMsg);
-          if( bail_on_error ) return rc!=0 ? rc : 1;
+          if( bail_on_error ){
+            if( rc==0 ) rc = 1;
+            goto shell_main_exit;
+          }
         }else if( rc!=0 ){
           utf8_printf(stderr,"Error: unable to process SQL \"%s\"\n", z);
-          if( bail_on_error ) return rc;
+          if( bail_on_error ) goto shell_main_exit;
         }
       }
 #if !defined(SQLITE_OMIT_VIRTUALTABLE) && defined(SQLITE_HAVE_ZLIB)
@@ -19073,7 +23592,8 @@ int SQLITE_CDECL wmain(int argc, wchar_t **wargv){
       if( nCmd>0 ){
         utf8_printf(stderr, "Error: cannot mix regular SQL or dot-commands"
                             " with \"%s\"\n", z);
-        return 1;
+        rc = 1;
+        goto shell_main_exit;
       }
       open_db(&data, OPEN_DB_ZIPFILE);
       if( z[2] ){
@@ -19088,7 +23608,8 @@ int SQLITE_CDECL wmain(int argc, wchar_t **wargv){
     }else{
       utf8_printf(stderr,"%s: Error: unknown option: %s\n", Argv0, z);
       raw_printf(stderr,"Use -help for a list of options.\n");
-      return 1;
+      rc = 1;
+      goto shell_main_exit;
     }
     data.cMode = data.mode;
   }
@@ -19101,20 +23622,23 @@ int SQLITE_CDECL wmain(int argc, wchar_t **wargv){
     for(i=0; i<nCmd; i++){
       if( azCmd[i][0]=='.' ){
         rc = do_meta_command(azCmd[i], &data);
-        if( rc ) return rc==2 ? 0 : rc;
+        if( rc ){
+          if( rc==2 ) rc = 0;
+          goto shell_main_exit;
+        }
       }else{
         open_db(&data, 0);
         rc = shell_exec(&data, azCmd[i], &zErrMsg);
         if( zErrMsg!=0 ){
           utf8_printf(stderr,"Error: %s\n", zErrMsg);
-          return rc!=0 ? rc : 1;
+          if( rc==0 ) rc = 1;
+          goto shell_main_exit;
         }else if( rc!=0 ){
           utf8_printf(stderr,"Error: unable to process SQL: %s\n", azCmd[i]);
-          return rc;
+          goto shell_main_exit;
         }
       }
     }
-    free(azCmd);
   }else{
     /* Run commands received from standard input
     */
@@ -19160,8 +23684,14 @@ int SQLITE_CDECL wmain(int argc, wchar_t **wargv){
       rc = process_input(&data);
     }
   }
+shell_main_exit:
+  /* Every way out of main() after the first command has run comes here,
+  ** so that a --background .backup is always finished */
+  free(azCmd);
   set_table_name(&data, 0);
+  timer_end(&data);
   if( data.db ){
+    backup_background_finish(&data, 0);
     session_close_all(&data);
     close_db(data.db);
   }
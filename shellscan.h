@@ -0,0 +1,371 @@
+/*
+** 2026 October 16
+**
+** The author disclaims copyright to this source code.  In place of
+** a legal notice, here is a blessing:
+**
+**    May you do good and not evil.
+**    May you find forgiveness for yourself and forgive others.
+**    May you share freely, never taking more than you give.
+**
+*************************************************************************
+**
+** This file contains the scanning and encoding kernels used by the
+** command-line shell to output CSV fields, SQL string literals and
+** hex-encoded blobs.  Each kernel has a portable scalar version and,
+** where the compiler supports them, versions which use SSE2 or AVX2 on
+** x86 and NEON on 64-bit ARM.  The best set of kernels for the CPU the
+** shell runs on is chosen at runtime by shellScanInit().
+**
+** All functions are static, so the file is meant to be #included by the
+** one translation unit which uses it.  It compiles as either C or C++.
+*/
+#ifndef SHELLSCAN_H
+#define SHELLSCAN_H
+
+#include <stddef.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define SHELL_SCAN_AVX2 1
+#else
+# define SHELL_SCAN_AVX2 0
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) \
+ || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+# define SHELL_SCAN_SSE2 1
+#else
+# define SHELL_SCAN_SSE2 0
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+# define SHELL_SCAN_NEON 1
+#else
+# define SHELL_SCAN_NEON 0
+#endif
+
+#if SHELL_SCAN_AVX2
+# include <immintrin.h>
+#elif SHELL_SCAN_SSE2
+# include <emmintrin.h>
+#endif
+#if SHELL_SCAN_SSE2 && defined(_MSC_VER)
+# include <intrin.h>
+#endif
+#if SHELL_SCAN_NEON
+# include <arm_neon.h>
+#endif
+
+/*
+** A set of kernels.  xScanCsv() and xScanQuote() return the offset of the
+** first byte of z[0..n-1] which is of interest, or n if there is none:
+**
+**   xScanCsv      A byte which makes a CSV field need quoting: a control
+**                 character, space, DEL, '"', '\'' or any byte with the
+**                 high bit set, or else the first byte of the separator,
+**                 cSep.
+**
+**   xScanQuote    A '\'' character, which must be doubled in an SQL
+**                 string literal, or also a '\n' or '\r' if bEscapeNL
+**                 is true.
+**
+** xHexEncode() writes the 2*n lower-case hexadecimal digits of a[0..n-1]
+** into zOut.  No nul terminator is written.
+*/
+typedef struct ShellScanKernels ShellScanKernels;
+struct ShellScanKernels {
+  const char *zName;       /* Name of the instruction set used */
+  size_t (*xScanCsv)(const char *z, size_t n, char cSep);
+  size_t (*xScanQuote)(const char *z, size_t n, int bEscapeNL);
+  void (*xHexEncode)(char *zOut, const unsigned char *a, size_t n);
+};
+
+static const char shellScanHexDigits[] = "0123456789abcdef";
+
+/*
+** If a field contains any character identified by a 1 in the following
+** array, then the string must be quoted for CSV.
+*/
+static const char shellScanNeedCsvQuote[256] = {
+  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+  1, 0, 1, 0, 0, 0, 0, 1,   0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,   0, 0, 0, 0, 0, 0, 0, 1,
+  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1,   1, 1, 1, 1, 1, 1, 1, 1,
+};
+
+/* Scalar kernels, which work everywhere */
+static size_t shellScanCsvScalar(const char *z, size_t n, char cSep){
+  size_t i;
+  for(i=0; i<n; i++){
+    if( shellScanNeedCsvQuote[(unsigned char)z[i]] || z[i]==cSep ) break;
+  }
+  return i;
+}
+static size_t shellScanQuoteScalar(const char *z, size_t n, int bEscapeNL){
+  size_t i;
+  if( bEscapeNL ){
+    for(i=0; i<n && z[i]!='\'' && z[i]!='\n' && z[i]!='\r'; i++){}
+  }else{
+    for(i=0; i<n && z[i]!='\''; i++){}
+  }
+  return i;
+}
+static void shellHexEncodeScalar(char *zOut, const unsigned char *a, size_t n){
+  size_t i;
+  for(i=0; i<n; i++){
+    zOut[2*i] = shellScanHexDigits[a[i]>>4];
+    zOut[2*i+1] = shellScanHexDigits[a[i]&0xf];
+  }
+}
+static const ShellScanKernels shellScanScalar = {
+  "scalar", shellScanCsvScalar, shellScanQuoteScalar, shellHexEncodeScalar
+};
+
+#if SHELL_SCAN_SSE2 || SHELL_SCAN_AVX2
+/* Return the index of the least significant set bit of m, which is not 0 */
+static int shellScanCtz(unsigned int m){
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long i;
+  _BitScanForward(&i, m);
+  return (int)i;
+#else
+  return __builtin_ctz(m);
+#endif
+}
+#endif
+
+#if SHELL_SCAN_SSE2
+/* SSE2 kernels, which every x86-64 CPU has */
+static size_t shellScanCsvSse2(const char *z, size_t n, char cSep){
+  const __m128i vLimit = _mm_set1_epi8(0x21);
+  const __m128i vDel = _mm_set1_epi8(0x7f);
+  const __m128i vDquote = _mm_set1_epi8('"');
+  const __m128i vSquote = _mm_set1_epi8('\'');
+  const __m128i vSep = _mm_set1_epi8(cSep);
+  size_t i;
+  for(i=0; i+16<=n; i+=16){
+    __m128i v = _mm_loadu_si128((const __m128i*)(z+i));
+    /* A signed compare catches both control characters and high bytes */
+    __m128i m = _mm_or_si128(_mm_cmplt_epi8(v, vLimit),
+                             _mm_cmpeq_epi8(v, vDel));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, vDquote));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, vSquote));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, vSep));
+    if( _mm_movemask_epi8(m) ){
+      return i + shellScanCtz((unsigned)_mm_movemask_epi8(m));
+    }
+  }
+  return i + shellScanCsvScalar(z+i, n-i, cSep);
+}
+static size_t shellScanQuoteSse2(const char *z, size_t n, int bEscapeNL){
+  const __m128i vQuote = _mm_set1_epi8('\'');
+  const __m128i vNL = _mm_set1_epi8(bEscapeNL ? '\n' : '\'');
+  const __m128i vCR = _mm_set1_epi8(bEscapeNL ? '\r' : '\'');
+  size_t i;
+  for(i=0; i+16<=n; i+=16){
+    __m128i v = _mm_loadu_si128((const __m128i*)(z+i));
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, vQuote),
+                  _mm_or_si128(_mm_cmpeq_epi8(v, vNL), _mm_cmpeq_epi8(v, vCR)));
+    if( _mm_movemask_epi8(m) ){
+      return i + shellScanCtz((unsigned)_mm_movemask_epi8(m));
+    }
+  }
+  return i + shellScanQuoteScalar(z+i, n-i, bEscapeNL);
+}
+static void shellHexEncodeSse2(char *zOut, const unsigned char *a, size_t n){
+  const __m128i vLow = _mm_set1_epi8(0x0f);
+  const __m128i vNine = _mm_set1_epi8(9);
+  const __m128i vZero = _mm_set1_epi8('0');
+  const __m128i vAlpha = _mm_set1_epi8('a'-'0'-10);
+  size_t i;
+  for(i=0; i+16<=n; i+=16){
+    __m128i v = _mm_loadu_si128((const __m128i*)(a+i));
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), vLow);
+    __m128i lo = _mm_and_si128(v, vLow);
+    hi = _mm_add_epi8(_mm_add_epi8(hi, vZero),
+                      _mm_and_si128(_mm_cmpgt_epi8(hi, vNine), vAlpha));
+    lo = _mm_add_epi8(_mm_add_epi8(lo, vZero),
+                      _mm_and_si128(_mm_cmpgt_epi8(lo, vNine), vAlpha));
+    _mm_storeu_si128((__m128i*)(zOut+2*i), _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*)(zOut+2*i+16), _mm_unpackhi_epi8(hi, lo));
+  }
+  shellHexEncodeScalar(zOut+2*i, a+i, n-i);
+}
+static const ShellScanKernels shellScanSse2 = {
+  "sse2", shellScanCsvSse2, shellScanQuoteSse2, shellHexEncodeSse2
+};
+#endif /* SHELL_SCAN_SSE2 */
+
+#if SHELL_SCAN_AVX2
+/*
+** AVX2 kernels.  These are compiled for AVX2 whatever the target of the
+** rest of the program, and only used if the CPU turns out to have it.
+*/
+#define SHELL_SCAN_AVX2_FUNC __attribute__((target("avx2")))
+SHELL_SCAN_AVX2_FUNC
+static size_t shellScanCsvAvx2(const char *z, size_t n, char cSep){
+  const __m256i vLimit = _mm256_set1_epi8(0x21);
+  const __m256i vDel = _mm256_set1_epi8(0x7f);
+  const __m256i vDquote = _mm256_set1_epi8('"');
+  const __m256i vSquote = _mm256_set1_epi8('\'');
+  const __m256i vSep = _mm256_set1_epi8(cSep);
+  size_t i;
+  for(i=0; i+32<=n; i+=32){
+    __m256i v = _mm256_loadu_si256((const __m256i*)(z+i));
+    __m256i m = _mm256_or_si256(_mm256_cmpgt_epi8(vLimit, v),
+                                _mm256_cmpeq_epi8(v, vDel));
+    unsigned int mask;
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, vDquote));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, vSquote));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, vSep));
+    mask = (unsigned)_mm256_movemask_epi8(m);
+    if( mask ) return i + shellScanCtz(mask);
+  }
+  return i + shellScanCsvScalar(z+i, n-i, cSep);
+}
+SHELL_SCAN_AVX2_FUNC
+static size_t shellScanQuoteAvx2(const char *z, size_t n, int bEscapeNL){
+  const __m256i vQuote = _mm256_set1_epi8('\'');
+  const __m256i vNL = _mm256_set1_epi8(bEscapeNL ? '\n' : '\'');
+  const __m256i vCR = _mm256_set1_epi8(bEscapeNL ? '\r' : '\'');
+  size_t i;
+  for(i=0; i+32<=n; i+=32){
+    __m256i v = _mm256_loadu_si256((const __m256i*)(z+i));
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, vQuote),
+                  _mm256_or_si256(_mm256_cmpeq_epi8(v, vNL),
+                                  _mm256_cmpeq_epi8(v, vCR)));
+    unsigned int mask = (unsigned)_mm256_movemask_epi8(m);
+    if( mask ) return i + shellScanCtz(mask);
+  }
+  return i + shellScanQuoteScalar(z+i, n-i, bEscapeNL);
+}
+SHELL_SCAN_AVX2_FUNC
+static void shellHexEncodeAvx2(char *zOut, const unsigned char *a, size_t n){
+  const __m256i vLow = _mm256_set1_epi8(0x0f);
+  const __m256i vNine = _mm256_set1_epi8(9);
+  const __m256i vZero = _mm256_set1_epi8('0');
+  const __m256i vAlpha = _mm256_set1_epi8('a'-'0'-10);
+  size_t i;
+  for(i=0; i+32<=n; i+=32){
+    __m256i v = _mm256_loadu_si256((const __m256i*)(a+i));
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), vLow);
+    __m256i lo = _mm256_and_si256(v, vLow);
+    __m256i r0, r1;
+    hi = _mm256_add_epi8(_mm256_add_epi8(hi, vZero),
+                         _mm256_and_si256(_mm256_cmpgt_epi8(hi, vNine), vAlpha));
+    lo = _mm256_add_epi8(_mm256_add_epi8(lo, vZero),
+                         _mm256_and_si256(_mm256_cmpgt_epi8(lo, vNine), vAlpha));
+    /* The unpacks work within each 128-bit lane, so put the lanes back
+    ** in order afterwards */
+    r0 = _mm256_unpacklo_epi8(hi, lo);
+    r1 = _mm256_unpackhi_epi8(hi, lo);
+    _mm256_storeu_si256((__m256i*)(zOut+2*i),
+                        _mm256_permute2x128_si256(r0, r1, 0x20));
+    _mm256_storeu_si256((__m256i*)(zOut+2*i+32),
+                        _mm256_permute2x128_si256(r0, r1, 0x31));
+  }
+  shellHexEncodeScalar(zOut+2*i, a+i, n-i);
+}
+static const ShellScanKernels shellScanAvx2 = {
+  "avx2", shellScanCsvAvx2, shellScanQuoteAvx2, shellHexEncodeAvx2
+};
+#endif /* SHELL_SCAN_AVX2 */
+
+#if SHELL_SCAN_NEON
+/* NEON kernels, which every 64-bit ARM CPU has */
+static size_t shellScanCsvNeon(const char *z, size_t n, char cSep){
+  const uint8x16_t vSpace = vdupq_n_u8(0x20);
+  const uint8x16_t vDel = vdupq_n_u8(0x7f);
+  const uint8x16_t vDquote = vdupq_n_u8('"');
+  const uint8x16_t vSquote = vdupq_n_u8('\'');
+  const uint8x16_t vSep = vdupq_n_u8((unsigned char)cSep);
+  size_t i;
+  for(i=0; i+16<=n; i+=16){
+    uint8x16_t v = vld1q_u8((const unsigned char*)(z+i));
+    uint8x16_t m = vorrq_u8(vcleq_u8(v, vSpace), vcgeq_u8(v, vDel));
+    m = vorrq_u8(m, vceqq_u8(v, vDquote));
+    m = vorrq_u8(m, vceqq_u8(v, vSquote));
+    m = vorrq_u8(m, vceqq_u8(v, vSep));
+    if( vmaxvq_u8(m) ) break;
+  }
+  return i + shellScanCsvScalar(z+i, n-i, cSep);
+}
+static size_t shellScanQuoteNeon(const char *z, size_t n, int bEscapeNL){
+  const uint8x16_t vQuote = vdupq_n_u8('\'');
+  const uint8x16_t vNL = vdupq_n_u8(bEscapeNL ? '\n' : '\'');
+  const uint8x16_t vCR = vdupq_n_u8(bEscapeNL ? '\r' : '\'');
+  size_t i;
+  for(i=0; i+16<=n; i+=16){
+    uint8x16_t v = vld1q_u8((const unsigned char*)(z+i));
+    uint8x16_t m = vorrq_u8(vceqq_u8(v, vQuote),
+                            vorrq_u8(vceqq_u8(v, vNL), vceqq_u8(v, vCR)));
+    if( vmaxvq_u8(m) ) break;
+  }
+  return i + shellScanQuoteScalar(z+i, n-i, bEscapeNL);
+}
+static void shellHexEncodeNeon(char *zOut, const unsigned char *a, size_t n){
+  const uint8x16_t vLow = vdupq_n_u8(0x0f);
+  const uint8x16_t vNine = vdupq_n_u8(9);
+  const uint8x16_t vZero = vdupq_n_u8('0');
+  const uint8x16_t vAlpha = vdupq_n_u8('a'-'0'-10);
+  size_t i;
+  for(i=0; i+16<=n; i+=16){
+    uint8x16_t v = vld1q_u8(a+i);
+    uint8x16x2_t r;
+    uint8x16_t hi = vshrq_n_u8(v, 4);
+    uint8x16_t lo = vandq_u8(v, vLow);
+    r.val[0] = vaddq_u8(vaddq_u8(hi, vZero),
+                        vandq_u8(vcgtq_u8(hi, vNine), vAlpha));
+    r.val[1] = vaddq_u8(vaddq_u8(lo, vZero),
+                        vandq_u8(vcgtq_u8(lo, vNine), vAlpha));
+    /* The interleaving store puts each pair of digits together */
+    vst2q_u8((unsigned char*)(zOut+2*i), r);
+  }
+  shellHexEncodeScalar(zOut+2*i, a+i, n-i);
+}
+static const ShellScanKernels shellScanNeon = {
+  "neon", shellScanCsvNeon, shellScanQuoteNeon, shellHexEncodeNeon
+};
+#endif /* SHELL_SCAN_NEON */
+
+/*
+** The kernels in use.  These are the scalar ones until shellScanInit()
+** has been called, so the kernels are always safe to call.
+*/
+static const ShellScanKernels *shellScan = &shellScanScalar;
+
+/*
+** Return the best set of kernels for the CPU this is running on.
+*/
+static const ShellScanKernels *shellScanBest(void){
+#if SHELL_SCAN_AVX2
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports("avx2") ) return &shellScanAvx2;
+#endif
+#if SHELL_SCAN_SSE2
+  return &shellScanSse2;
+#elif SHELL_SCAN_NEON
+  return &shellScanNeon;
+#endif
+  return &shellScanScalar;
+}
+
+/*
+** Choose the kernels which shellScan points to.  This should be called
+** once, before any other threads are started.
+*/
+static void shellScanInit(void){
+  shellScan = shellScanBest();
+}
+
+#endif /* SHELLSCAN_H */
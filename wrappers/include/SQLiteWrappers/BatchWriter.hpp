@@ -0,0 +1,344 @@
+#ifndef SQLITE_WRAPPERS_BATCH_WRITER_HPP
+#define SQLITE_WRAPPERS_BATCH_WRITER_HPP
+
+/**
+ * @file BatchWriter.hpp
+ *
+ * This module declares the SQLiteWrappers::BatchWriter class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "BindGuard.hpp"
+#include "Value.hpp"
+#include "Wrappers.hpp"
+
+#include <chrono>
+#include <memory>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This writes many rows through one reused statement, grouping the
+     * writes into explicit transactions so that the cost of committing
+     * (and syncing the journal) is paid once per group of rows rather than
+     * once per row, as it would be in autocommit mode.
+     *
+     * A transaction is committed once it holds a configured number of rows,
+     * or once it has been open for longer than a configured time budget,
+     * whichever comes first.  The time budget is checked as rows are added.
+     * Any open transaction is committed when the writer is flushed or
+     * destroyed.
+     *
+     * When constructed for a table and list of columns, the writer can also
+     * insert several rows with each execution of the statement, using
+     * a multi-row "INSERT ... VALUES (...),(...)" statement.
+     *
+     * @note
+     *     The connection must outlive the writer, and nothing else should
+     *     begin or end transactions on the connection while the writer
+     *     holds rows which haven't been committed.
+     */
+    class BatchWriter {
+        // Types
+    public:
+        /**
+         * This holds the settings which control how the writer groups
+         * its writes.
+         */
+        struct Configuration {
+            /**
+             * This is the maximum number of rows to write in each
+             * transaction.
+             */
+            size_t rowsPerTransaction = 1000;
+
+            /**
+             * This is the maximum time to keep a transaction open.
+             * Zero means there is no time budget.
+             */
+            std::chrono::milliseconds transactionTimeBudget{0};
+
+            /**
+             * This is the number of rows to insert with each execution of
+             * the statement, for writers constructed for a table.  It's
+             * reduced if necessary to stay within SQLite's limit on the
+             * number of statement parameters.
+             */
+            size_t rowsPerStatement = 1;
+        };
+
+        /**
+         * This holds counters which describe the work done by the writer.
+         */
+        struct Statistics {
+            /**
+             * This is the number of rows written, not counting any lost
+             * when a transaction which failed to commit was rolled back.
+             */
+            size_t rows = 0;
+
+            /**
+             * This is the number of rows which could not be written,
+             * including any lost when a transaction was rolled back.
+             */
+            size_t failedRows = 0;
+
+            /**
+             * This is the number of statements executed to write rows.
+             */
+            size_t statements = 0;
+
+            /**
+             * This is the number of transactions committed.
+             */
+            size_t commits = 0;
+
+            /**
+             * This is the time, in seconds, from when the first row was
+             * added until the most recent transaction was committed.
+             */
+            double seconds = 0.0;
+
+            /**
+             * Return the average rate at which rows were written.
+             *
+             * @return
+             *     The average number of rows written per second
+             *     is returned.
+             */
+            double RowsPerSecond() const;
+
+            /**
+             * Return the average rate at which transactions were committed.
+             *
+             * @return
+             *     The average number of transactions committed per second
+             *     is returned.
+             */
+            double CommitsPerSecond() const;
+        };
+
+        // Lifecycle Methods
+    public:
+        ~BatchWriter() noexcept;
+        BatchWriter(const BatchWriter&) = delete;
+        BatchWriter(BatchWriter&&) noexcept;
+        BatchWriter& operator=(const BatchWriter&) = delete;
+        BatchWriter& operator=(BatchWriter&&) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * Construct a writer which executes the given statement once for
+         * each row added.  This works for any kind of statement, such as
+         * INSERT, UPDATE, or DELETE.
+         *
+         * @param[in] db
+         *     This is the database connection through which to write.
+         *
+         * @param[in] sql
+         *     This is the SQL text of the statement to execute for each row.
+         *
+         * @param[in] configuration
+         *     These are the settings which control how writes are grouped.
+         *     The rowsPerStatement setting is ignored.  If not given,
+         *     the default settings are used.
+         */
+        BatchWriter(
+            const DatabaseConnection& db,
+            const std::string& sql
+        );
+        BatchWriter(
+            const DatabaseConnection& db,
+            const std::string& sql,
+            const Configuration& configuration
+        );
+
+        /**
+         * Construct a writer which inserts rows into the given table.
+         *
+         * @param[in] db
+         *     This is the database connection through which to write.
+         *
+         * @param[in] table
+         *     This is the name of the table into which to insert rows.
+         *
+         * @param[in] columns
+         *     These are the names of the columns to set in each row,
+         *     in the order in which values are given when adding rows.
+         *
+         * @param[in] configuration
+         *     These are the settings which control how writes are grouped.
+         *     If not given, the default settings are used.
+         */
+        BatchWriter(
+            const DatabaseConnection& db,
+            const std::string& table,
+            const std::vector< std::string >& columns
+        );
+        BatchWriter(
+            const DatabaseConnection& db,
+            const std::string& table,
+            const std::vector< std::string >& columns,
+            const Configuration& configuration
+        );
+
+        /**
+         * Indicate whether or not the writer's statement compiled.  A
+         * writer which has been moved from is unable to write rows.
+         *
+         * @return
+         *     An indication of whether or not the writer is able to
+         *     write rows is returned.
+         */
+        explicit operator bool() const;
+
+        /**
+         * Add a row to write, binding the given values to the statement
+         * parameters in order.
+         *
+         * For a writer which inserts several rows per statement, the values
+         * are copied and held until enough rows are collected to execute the
+         * statement.  Otherwise, the statement is executed right away, with
+         * text and blobs bound without copying them.
+         *
+         * @param[in] values
+         *     These are the values to bind to the statement parameters.
+         *
+         * @return
+         *     An indication of whether or not the statement executed
+         *     successfully (or the row was held for later) is returned.
+         *     When several rows are inserted per statement, a failure
+         *     applies to all the rows held for that statement.
+         */
+        template< typename... Values >
+        bool Add(const Values&... values) {
+            if (!BeginRow()) {
+                return false;
+            }
+            bool success;
+            if (IsHoldingRows()) {
+                success = HoldRow({MakeValue(values)...});
+            } else {
+                {
+                    BindGuard bindings(GetStatement());
+                    bindings.BindAll(values...);
+                    success = !bindings.Step().error;
+                }
+                CountWrite(success, 1);
+            }
+            return EndRow(success);
+        }
+
+        /**
+         * Write any rows being held and commit the current transaction,
+         * if any.
+         *
+         * @return
+         *     An indication of whether or not everything was written and
+         *     committed successfully is returned.
+         */
+        bool Flush();
+
+        /**
+         * Return counters which describe the work done by the writer.
+         *
+         * @return
+         *     Counters which describe the work done by the writer
+         *     are returned.
+         */
+        Statistics GetStatistics() const;
+
+        // Private Methods
+    private:
+        /**
+         * Begin a transaction if one isn't already open.
+         *
+         * @return
+         *     An indication of whether or not the writer is ready to
+         *     write a row is returned.
+         */
+        bool BeginRow();
+
+        /**
+         * Indicate whether or not rows are held and inserted several at
+         * a time.
+         *
+         * @return
+         *     An indication of whether or not rows are held and inserted
+         *     several at a time is returned.
+         */
+        bool IsHoldingRows() const;
+
+        /**
+         * Hold the values of a row until enough rows are collected to
+         * execute the multi-row statement.
+         *
+         * @param[in] values
+         *     These are the values of the row.
+         *
+         * @return
+         *     An indication of whether or not the row was held, or written
+         *     successfully along with the other rows held, is returned.
+         */
+        bool HoldRow(std::vector< Value >&& values);
+
+        /**
+         * Return the statement used to write one row at a time.
+         *
+         * @return
+         *     The statement used to write one row at a time is returned.
+         */
+        const PreparedStatement& GetStatement() const;
+
+        /**
+         * Update the counters which describe the work done by the writer,
+         * to account for one execution of the statement.
+         *
+         * @param[in] success
+         *     This indicates whether or not the statement executed
+         *     successfully.
+         *
+         * @param[in] numRows
+         *     This is the number of rows the statement wrote (or would
+         *     have written).
+         */
+        void CountWrite(bool success, size_t numRows);
+
+        /**
+         * Count the row just added toward the current transaction, and
+         * commit the transaction if it's full or has used up its
+         * time budget.
+         *
+         * @param[in] success
+         *     This indicates whether or not the row was written or held.
+         *
+         * @return
+         *     An indication of whether or not the row was written or held,
+         *     and the transaction (if committed) was committed successfully,
+         *     is returned.
+         */
+        bool EndRow(bool success);
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* SQLITE_WRAPPERS_BATCH_WRITER_HPP */
@@ -0,0 +1,245 @@
+#ifndef SQLITE_WRAPPERS_BIND_GUARD_HPP
+#define SQLITE_WRAPPERS_BIND_GUARD_HPP
+
+/**
+ * @file BindGuard.hpp
+ *
+ * This module declares the SQLiteWrappers::BindGuard class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Value.hpp"
+#include "Wrappers.hpp"
+
+#include <optional>
+#include <sqlite3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#endif
+#endif
+
+namespace SQLiteWrappers {
+
+    /**
+     * This binds values to the parameters of a prepared statement for the
+     * duration of a scope.
+     *
+     * Text and blobs are bound with SQLITE_STATIC, so SQLite refers to the
+     * caller's buffers directly rather than making its own private copies.
+     * To keep that safe, the guard resets the statement and clears its
+     * bindings when it's destroyed, so SQLite lets go of the buffers at
+     * the end of the scope in which the statement is stepped.  The buffers
+     * must outlive the guard, which is why the guard can't be copied or
+     * moved, and why binding temporary strings or vectors is not allowed.
+     *
+     * For example:
+     *
+     * @code
+     * {
+     *     BindGuard bindings(stmt);
+     *     bindings.BindAll(std::string_view(payload), entity);
+     *     const auto results = bindings.Step();
+     *     ...
+     * } // statement reset, SQLite no longer refers to payload
+     * @endcode
+     */
+    class BindGuard {
+        // Lifecycle Methods
+    public:
+        ~BindGuard() noexcept;
+        BindGuard(const BindGuard&) = delete;
+        BindGuard(BindGuard&&) = delete;
+        BindGuard& operator=(const BindGuard&) = delete;
+        BindGuard& operator=(BindGuard&&) = delete;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor.
+         *
+         * @param[in] stmt
+         *     This is the statement whose parameters to bind.
+         *     It must outlive the guard.
+         */
+        explicit BindGuard(const PreparedStatement& stmt);
+
+        /**
+         * Bind NULL to a parameter of the statement.
+         *
+         * @param[in] index
+         *     This is the one-based index of the parameter to bind.
+         *
+         * @return
+         *     A reference to the guard is returned, so that bindings
+         *     can be chained.
+         */
+        BindGuard& BindNull(int index);
+
+        /**
+         * Bind a value to a parameter of the statement.
+         *
+         * @param[in] index
+         *     This is the one-based index of the parameter to bind.
+         *
+         * @param[in] value
+         *     This is the value to bind to the parameter.  Text and blobs
+         *     are not copied, and must outlive the guard.
+         *
+         * @return
+         *     A reference to the guard is returned, so that bindings
+         *     can be chained.
+         */
+        template< typename T >
+        auto Bind(int index, T value) -> typename std::enable_if<
+            std::is_integral< T >::value,
+            BindGuard&
+        >::type {
+            // Unsigned values as wide as int may not fit in one.
+            if (
+                (sizeof(T) < sizeof(int))
+                || (std::is_signed< T >::value && (sizeof(T) == sizeof(int)))
+            ) {
+                (void)sqlite3_bind_int(stmt_.get(), index, (int)value);
+            } else {
+                (void)sqlite3_bind_int64(stmt_.get(), index, (sqlite3_int64)value);
+            }
+            return *this;
+        }
+        BindGuard& Bind(int index, double value);
+        BindGuard& Bind(int index, std::string_view value);
+        BindGuard& Bind(int index, const std::string& value);
+        BindGuard& Bind(int index, const char* value);
+        BindGuard& Bind(int index, BlobView value);
+        BindGuard& Bind(int index, const std::vector< uint8_t >& value);
+        BindGuard& Bind(int index, const Value& value);
+#if defined(__cpp_lib_span)
+        BindGuard& Bind(int index, std::span< const uint8_t > value);
+#endif
+
+        /**
+         * Binding a temporary would leave SQLite referring to a buffer
+         * which is destroyed before the statement is stepped, so these
+         * overloads are deleted to catch that at compile time.
+         */
+        BindGuard& Bind(int index, std::string&& value) = delete;
+        BindGuard& Bind(int index, std::vector< uint8_t >&& value) = delete;
+        BindGuard& Bind(int index, Value&& value) = delete;
+        template< typename T >
+        auto Bind(int index, std::optional< T >&& value) -> typename std::enable_if<
+            !std::is_arithmetic< T >::value,
+            BindGuard&
+        >::type = delete;
+
+        /**
+         * Bind an optional value to a parameter of the statement, binding
+         * NULL if there is no value.
+         *
+         * @param[in] index
+         *     This is the one-based index of the parameter to bind.
+         *
+         * @param[in] value
+         *     This is the optional value to bind to the parameter.
+         *
+         * @return
+         *     A reference to the guard is returned, so that bindings
+         *     can be chained.
+         */
+        template< typename T >
+        BindGuard& Bind(int index, const std::optional< T >& value) {
+            if (value) {
+                return Bind(index, *value);
+            }
+            return BindNull(index);
+        }
+
+        /**
+         * Bind the given values to the parameters of the statement,
+         * in order, starting with the first parameter.
+         *
+         * @param[in] values
+         *     These are the values to bind.
+         *
+         * @return
+         *     A reference to the guard is returned, so that bindings
+         *     can be chained.
+         */
+        template< typename... Values >
+        BindGuard& BindAll(Values&&... values) {
+            int index = 0;
+            (void)index;
+            (Bind(++index, std::forward< Values >(values)), ...);
+            return *this;
+        }
+
+        /**
+         * Bind the elements of the given tuple to the parameters of the
+         * statement, in order, starting with the first parameter.
+         *
+         * @param[in] values
+         *     This is the tuple of values to bind.  A tuple of references,
+         *     such as one made with std::tie, avoids copying.
+         *
+         * @return
+         *     A reference to the guard is returned, so that bindings
+         *     can be chained.
+         */
+        template< typename... Values >
+        BindGuard& BindTuple(const std::tuple< Values... >& values) {
+            return std::apply(
+                [this](const auto&... elements) -> BindGuard& {
+                    return BindAll(elements...);
+                },
+                values
+            );
+        }
+
+        /**
+         * Bind the members of the given structure to the parameters of the
+         * statement, in order, starting with the first parameter.
+         *
+         * The structure provides its members, in parameter order, through
+         * a Tie() const method which returns a std::tie of them.
+         *
+         * @param[in] row
+         *     This is the structure whose members to bind.
+         *
+         * @return
+         *     A reference to the guard is returned, so that bindings
+         *     can be chained.
+         */
+        template< typename Struct >
+        auto BindStruct(const Struct& row) -> decltype(row.Tie(), *this) {
+            return BindTuple(row.Tie());
+        }
+
+        /**
+         * Execute the statement until it either produces the next row
+         * of results, runs to completion, or fails.
+         *
+         * @return
+         *     The outcome of stepping the statement is returned.
+         */
+        StepStatementResults Step();
+
+        // Private Properties
+    private:
+        /**
+         * This is the statement whose parameters are bound.
+         */
+        const PreparedStatement& stmt_;
+    };
+
+}
+
+#endif /* SQLITE_WRAPPERS_BIND_GUARD_HPP */
@@ -0,0 +1,361 @@
+#ifndef SQLITE_WRAPPERS_COLUMN_BATCH_HPP
+#define SQLITE_WRAPPERS_COLUMN_BATCH_HPP
+
+/**
+ * @file ColumnBatch.hpp
+ *
+ * This module declares the SQLiteWrappers::ColumnBatch class template,
+ * along with the FetchBatch function which fills it with rows of results
+ * from a prepared statement, one contiguous array per column.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Query.hpp"
+#include "Wrappers.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <initializer_list>
+#include <sqlite3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace SQLiteWrappers {
+
+    template< typename... Columns > class ColumnBatch;
+
+    /**
+     * Step the given statement until it produces the given number of rows
+     * of results, or runs to completion, decoding the rows into the given
+     * batch.  Whatever the batch held before is discarded, although its
+     * memory is reused.
+     *
+     * For example, to add up a column:
+     *
+     * @code
+     * ColumnBatch< int, int > batch;
+     * StepStatementResults results;
+     * do {
+     *     results = FetchBatch(stmt, 1024, batch);
+     *     const auto& hp = batch.GetColumn< 1 >();
+     *     for (size_t i = 0; i < batch.GetSize(); ++i) {
+     *         total += hp[i];
+     *     }
+     * } while (!results.done && !results.error);
+     * @endcode
+     *
+     * @tparam Columns
+     *     These are the C++ types into which to decode the columns,
+     *     in order.
+     *
+     * @param[in] stmt
+     *     This is the statement to step.
+     *
+     * @param[in] maxRows
+     *     This is the maximum number of rows to fetch.  If it's zero,
+     *     the statement isn't stepped at all, so it never becomes done.
+     *
+     * @param[out] batch
+     *     This is where to store the rows fetched.
+     *
+     * @return
+     *     The outcome of stepping the statement is returned.  It's done
+     *     once the statement has run to completion or has failed, in which
+     *     case the batch holds whatever rows were fetched before that.
+     */
+    template< typename... Columns >
+    StepStatementResults FetchBatch(
+        const PreparedStatement& stmt,
+        size_t maxRows,
+        ColumnBatch< Columns... >& batch
+    );
+
+    /**
+     * This holds a batch of rows of results, stored column by column rather
+     * than row by row: the values of each column are kept together in one
+     * contiguous array, so that code which aggregates a column can loop
+     * over plain arrays, which compilers can vectorize, rather than making
+     * calls into SQLite for each row.
+     *
+     * Which values are NULL is recorded separately for each column in a
+     * bitmap, with one bit per row, set when the value is NULL.  A NULL
+     * value is also stored in the column array as a value-initialized
+     * element (zero, for numbers), so sums may be taken without consulting
+     * the bitmap.
+     *
+     * @tparam Columns
+     *     These are the C++ types into which to decode the columns,
+     *     in order.  Each column type must be one supported by ColumnTraits,
+     *     other than std::string_view, which would not outlive the next step
+     *     of the statement.  NULL values are recorded in the bitmaps, so
+     *     there's no need for std::optional column types.
+     */
+    template< typename... Columns >
+    class ColumnBatch {
+        static_assert(
+            !std::disjunction< std::is_same< Columns, std::string_view >... >::value,
+            "string_view columns are only valid until the statement is stepped again"
+        );
+
+        // Types
+    public:
+        /**
+         * This is the C++ type into which the column with the given index
+         * is decoded.
+         *
+         * @tparam Index
+         *     This is the zero-based index of the column.
+         */
+        template< size_t Index >
+        using Column = typename std::tuple_element< Index, std::tuple< Columns... > >::type;
+
+        /**
+         * This is the number of rows recorded in each word of a NULL bitmap.
+         */
+        static constexpr size_t ROWS_PER_NULL_WORD = 64;
+
+        // Public Methods
+    public:
+        /**
+         * Return the number of rows held in the batch.
+         *
+         * @return
+         *     The number of rows held in the batch is returned.
+         */
+        size_t GetSize() const {
+            return size_;
+        }
+
+        /**
+         * Return the values of the column with the given index, one per row.
+         *
+         * @tparam Index
+         *     This is the zero-based index of the column.
+         *
+         * @return
+         *     The values of the column are returned.
+         */
+        template< size_t Index >
+        const std::vector< Column< Index > >& GetColumn() const {
+            return std::get< Index >(columns_);
+        }
+
+        /**
+         * Return the bitmap which records which values of the column
+         * with the given index are NULL.  Bit (row % 64) of word (row / 64)
+         * is set if the value in that row is NULL.
+         *
+         * @tparam Index
+         *     This is the zero-based index of the column.
+         *
+         * @return
+         *     The NULL bitmap of the column is returned.
+         */
+        template< size_t Index >
+        const std::vector< uint64_t >& GetNulls() const {
+            return nulls_[Index];
+        }
+
+        /**
+         * Indicate whether or not the value in the given row of the column
+         * with the given index is NULL.
+         *
+         * @tparam Index
+         *     This is the zero-based index of the column.
+         *
+         * @param[in] row
+         *     This is the zero-based index of the row.
+         *
+         * @return
+         *     An indication of whether or not the value is NULL
+         *     is returned.
+         */
+        template< size_t Index >
+        bool IsNull(size_t row) const {
+            return (
+                (
+                    nulls_[Index][row / ROWS_PER_NULL_WORD]
+                    >> (row % ROWS_PER_NULL_WORD)
+                ) & 1
+            ) != 0;
+        }
+
+        /**
+         * Return the number of NULL values in the column with the
+         * given index.
+         *
+         * @tparam Index
+         *     This is the zero-based index of the column.
+         *
+         * @return
+         *     The number of NULL values in the column is returned.
+         */
+        template< size_t Index >
+        size_t CountNulls() const {
+            size_t count = 0;
+            for (const auto word: nulls_[Index]) {
+                count += std::bitset< ROWS_PER_NULL_WORD >(word).count();
+            }
+            return count;
+        }
+
+        /**
+         * Discard all rows held in the batch, keeping its memory
+         * for reuse.
+         */
+        void Clear() {
+            Resize(0, std::index_sequence_for< Columns... >());
+        }
+
+        // Private Methods
+    private:
+        template< typename... BatchColumns >
+        friend StepStatementResults FetchBatch(
+            const PreparedStatement& stmt,
+            size_t maxRows,
+            ColumnBatch< BatchColumns... >& batch
+        );
+
+        /**
+         * Set the number of rows held in the batch.
+         *
+         * @param[in] numRows
+         *     This is the number of rows to hold.
+         */
+        template< size_t... Indexes >
+        void Resize(
+            size_t numRows,
+            std::index_sequence< Indexes... >
+        ) {
+            const auto numNullWords = (
+                (numRows + ROWS_PER_NULL_WORD - 1)
+                / ROWS_PER_NULL_WORD
+            );
+            (void)std::initializer_list< int >{
+                (std::get< Indexes >(columns_).resize(numRows), 0)...
+            };
+            for (auto& nulls: nulls_) {
+                nulls.resize(numNullWords);
+            }
+            size_ = numRows;
+        }
+
+        /**
+         * Mark every row of the batch as not NULL.
+         */
+        void ClearNulls() {
+            for (auto& nulls: nulls_) {
+                std::fill(nulls.begin(), nulls.end(), 0);
+            }
+        }
+
+        /**
+         * Decode one column of the current row of results of the given
+         * statement into the given row of the batch.
+         *
+         * @tparam Index
+         *     This is the zero-based index of the column.
+         *
+         * @param[in] stmt
+         *     This is the statement from which to fetch the column.
+         *
+         * @param[in] row
+         *     This is the zero-based index of the row of the batch
+         *     in which to store the column.
+         */
+        template< size_t Index >
+        void FetchCell(
+            sqlite3_stmt* stmt,
+            size_t row
+        ) {
+            auto& column = std::get< Index >(columns_);
+            if (sqlite3_column_type(stmt, (int)Index) == SQLITE_NULL) {
+                column[row] = Column< Index >();
+                nulls_[Index][row / ROWS_PER_NULL_WORD] |= (
+                    (uint64_t)1 << (row % ROWS_PER_NULL_WORD)
+                );
+            } else {
+                column[row] = ColumnTraits< Column< Index > >::Fetch(stmt, (int)Index);
+            }
+        }
+
+        /**
+         * Decode the current row of results of the given statement into
+         * the given row of the batch.
+         *
+         * @param[in] stmt
+         *     This is the statement from which to fetch the row.
+         *
+         * @param[in] row
+         *     This is the zero-based index of the row of the batch
+         *     in which to store the row of results.
+         */
+        template< size_t... Indexes >
+        void FetchRow(
+            sqlite3_stmt* stmt,
+            size_t row,
+            std::index_sequence< Indexes... >
+        ) {
+            (void)std::initializer_list< int >{
+                (FetchCell< Indexes >(stmt, row), 0)...
+            };
+        }
+
+        // Private Properties
+    private:
+        /**
+         * These are the values of each column, one per row.
+         */
+        std::tuple< std::vector< Columns >... > columns_;
+
+        /**
+         * These are the bitmaps which record which values of each column
+         * are NULL.
+         */
+        std::array< std::vector< uint64_t >, sizeof...(Columns) > nulls_;
+
+        /**
+         * This is the number of rows held in the batch.
+         */
+        size_t size_ = 0;
+    };
+
+    template< typename... Columns >
+    StepStatementResults FetchBatch(
+        const PreparedStatement& stmt,
+        size_t maxRows,
+        ColumnBatch< Columns... >& batch
+    ) {
+        // Size the arrays for a full batch up front, so that each row is
+        // stored in place, and trim them to the number of rows fetched
+        // afterwards.
+        const auto indexes = std::index_sequence_for< Columns... >();
+        batch.Resize(maxRows, indexes);
+        batch.ClearNulls();
+        StepStatementResults results;
+        size_t numRows = 0;
+        while (numRows < maxRows) {
+            const auto step = sqlite3_step(stmt.get());
+            if (step == SQLITE_ROW) {
+                batch.FetchRow(stmt.get(), numRows, indexes);
+                ++numRows;
+            } else {
+                results.done = true;
+                results.error = (step != SQLITE_DONE);
+                break;
+            }
+        }
+        batch.Resize(numRows, indexes);
+        return results;
+    }
+
+}
+
+#endif /* SQLITE_WRAPPERS_COLUMN_BATCH_HPP */
@@ -0,0 +1,272 @@
+#ifndef SQLITE_WRAPPERS_CONNECTION_POOL_HPP
+#define SQLITE_WRAPPERS_CONNECTION_POOL_HPP
+
+/**
+ * @file ConnectionPool.hpp
+ *
+ * This module declares the SQLiteWrappers::ConnectionPool class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "StatementCache.hpp"
+#include "Value.hpp"
+#include "Wrappers.hpp"
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This shares one database among many threads.
+     *
+     * The database is put into write-ahead log (WAL) mode, so that readers
+     * don't block the writer and the writer doesn't block readers.  The
+     * pool opens a fixed number of read-only connections, each with its own
+     * statement cache, which threads check out for as long as they need
+     * them.  Checking out a reader is lock-free: each thread starts looking
+     * at a slot chosen by its thread ID, so as long as there are at least as
+     * many readers as threads, each thread tends to find its own reader
+     * waiting for it without touching any other thread's slot.  Threads
+     * which find every reader checked out sleep until one is returned.
+     *
+     * All writes go through one writer connection, owned by a dedicated
+     * thread which executes queued write jobs in the order they were
+     * submitted.  Optionally, the writer can group all the jobs waiting in
+     * its queue into one transaction.
+     *
+     * @note
+     *     Every reader must be returned before the pool is destroyed.
+     *     Destroying the pool waits for queued write jobs to finish.
+     */
+    class ConnectionPool {
+        // Types
+    public:
+        /**
+         * This holds the settings which control how the pool is set up.
+         */
+        struct Configuration {
+            /**
+             * This is the number of read-only connections to open.
+             */
+            size_t numReaders = 4;
+
+            /**
+             * This is the maximum number of idle statements to hold in
+             * the statement cache of each connection.
+             */
+            size_t statementCacheCapacity = StatementCache::DEFAULT_CAPACITY;
+
+            /**
+             * This is how long, in milliseconds, a connection waits for
+             * a lock held by another connection before giving up.
+             */
+            int busyTimeoutMilliseconds = 5000;
+
+            /**
+             * This indicates whether or not the writer performs all the
+             * write jobs waiting in its queue within a single transaction,
+             * so that they share the cost of one commit.  The outcome of
+             * each job is only delivered once the transaction commits.
+             * Jobs must not begin or end transactions themselves when this
+             * is set, although they may use savepoints.
+             */
+            bool groupCommit = false;
+        };
+
+        /**
+         * This is a read-only connection checked out of the pool.
+         * It's returned to the pool when destroyed.
+         */
+        class Reader {
+            // Lifecycle Methods
+        public:
+            ~Reader() noexcept;
+            Reader(const Reader&) = delete;
+            Reader(Reader&& other) noexcept;
+            Reader& operator=(const Reader&) = delete;
+            Reader& operator=(Reader&& other) noexcept;
+
+            // Public Methods
+        public:
+            /**
+             * Return the checked-out connection.
+             *
+             * @return
+             *     The checked-out connection is returned.
+             */
+            const DatabaseConnection& GetConnection() const;
+
+            /**
+             * Return the statement cache of the checked-out connection.
+             *
+             * @return
+             *     The statement cache of the checked-out connection
+             *     is returned.
+             */
+            StatementCache& GetStatements() const;
+
+            /**
+             * Indicate whether or not a connection is checked out.
+             *
+             * @return
+             *     An indication of whether or not a connection is checked
+             *     out is returned.
+             */
+            explicit operator bool() const;
+
+            // Private Methods
+        private:
+            friend class ConnectionPool;
+
+            /**
+             * This is the type of structure which holds one of the pool's
+             * read-only connections.  It is defined in the implementation.
+             */
+            struct Slot;
+
+            /**
+             * This constructor is used by the pool to check out a reader.
+             *
+             * @param[in] slot
+             *     This holds the connection being checked out.
+             */
+            explicit Reader(Slot* slot);
+
+            /**
+             * Return the connection to the pool, if any.
+             */
+            void Release();
+
+            // Private Properties
+        private:
+            /**
+             * This holds the connection checked out, or is nullptr if
+             * no connection is checked out.
+             */
+            Slot* slot_ = nullptr;
+        };
+
+        /**
+         * This is the type of function which performs a write job, given the
+         * writer connection and its statement cache.  It returns an
+         * indication of whether or not the job succeeded.
+         */
+        using WriteJob = std::function<
+            bool(
+                const DatabaseConnection& db,
+                StatementCache& statements
+            )
+        >;
+
+        // Lifecycle Methods
+    public:
+        ~ConnectionPool() noexcept;
+        ConnectionPool(const ConnectionPool&) = delete;
+        ConnectionPool(ConnectionPool&&) noexcept;
+        ConnectionPool& operator=(const ConnectionPool&) = delete;
+        ConnectionPool& operator=(ConnectionPool&&) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor.
+         *
+         * @param[in] path
+         *     This is the path to the database file to open.
+         *     It's created if it doesn't already exist.
+         *
+         * @param[in] configuration
+         *     These are the settings which control how the pool is set up.
+         *     If not given, the default settings are used.
+         */
+        explicit ConnectionPool(const std::string& path);
+        ConnectionPool(
+            const std::string& path,
+            const Configuration& configuration
+        );
+
+        /**
+         * Indicate whether or not all the pool's connections were opened
+         * and the database was put into WAL mode.  A pool which has been
+         * moved from is not usable.
+         *
+         * @return
+         *     An indication of whether or not the pool is usable
+         *     is returned.
+         */
+        explicit operator bool() const;
+
+        /**
+         * Check out a read-only connection, waiting for one to be returned
+         * if they are all checked out.
+         *
+         * @param[in] timeoutMilliseconds
+         *     This is the longest time, in milliseconds, to wait for a
+         *     connection to be returned.  If negative, or not given, there
+         *     is no limit.
+         *
+         * @return
+         *     The checked-out connection is returned.  It converts to false
+         *     if the pool is not usable, or if the wait timed out.
+         */
+        Reader CheckOutReader();
+        Reader CheckOutReader(int timeoutMilliseconds);
+
+        /**
+         * Queue a job to be performed with the writer connection.
+         *
+         * @param[in] job
+         *     This is the function which performs the write job.  It's
+         *     called on the writer thread.
+         *
+         * @return
+         *     A future which will hold an indication of whether or not
+         *     the job succeeded is returned.  If the job throws an
+         *     exception, the future holds the exception instead, as do
+         *     the futures of any jobs grouped into the same transaction.
+         */
+        std::future< bool > Write(WriteJob job);
+
+        /**
+         * Queue a statement to be executed with the writer connection.
+         *
+         * @param[in] sql
+         *     This is the SQL text of the statement to execute.
+         *
+         * @param[in] values
+         *     These are the values to bind to the statement parameters,
+         *     in order.
+         *
+         * @return
+         *     A future which will hold an indication of whether or not
+         *     the statement executed successfully is returned.
+         */
+        std::future< bool > Write(
+            const std::string& sql,
+            std::vector< Value >&& values
+        );
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* SQLITE_WRAPPERS_CONNECTION_POOL_HPP */
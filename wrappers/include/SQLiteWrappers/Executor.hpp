@@ -0,0 +1,362 @@
+#ifndef SQLITE_WRAPPERS_EXECUTOR_HPP
+#define SQLITE_WRAPPERS_EXECUTOR_HPP
+
+/**
+ * @file Executor.hpp
+ *
+ * This module declares the SQLiteWrappers::Executor class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "BindGuard.hpp"
+#include "ConnectionPool.hpp"
+#include "Query.hpp"
+#include "StatementCache.hpp"
+#include "Value.hpp"
+#include "Wrappers.hpp"
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stddef.h>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This holds the rows of results produced by a query executed
+     * asynchronously.
+     *
+     * @tparam Columns
+     *     These are the C++ types into which the columns were decoded,
+     *     in order.
+     */
+    template< typename... Columns >
+    struct QueryResults {
+        /**
+         * This is the type of function to which the results of a query
+         * may be delivered.
+         */
+        using Callback = std::function< void(QueryResults&&) >;
+
+        /**
+         * This indicates whether or not the query failed, either because
+         * its SQL text didn't compile or because stepping it failed.
+         */
+        bool error = false;
+
+        /**
+         * These are the rows of results produced by the query.
+         */
+        std::vector< std::tuple< Columns... > > rows;
+    };
+
+    /**
+     * This executes statements on its own threads, so that the threads
+     * submitting them never block inside sqlite3_step, whether on disk
+     * I/O for a long scan or on syncing a commit.
+     *
+     * Queries are executed by a small set of worker threads, each using
+     * a read-only connection from a ConnectionPool.  Writes are queued to
+     * the pool's writer thread, which groups all the writes waiting for it
+     * into one transaction, so a burst of writes from many threads pays
+     * for one commit rather than one per write.
+     *
+     * Results are delivered either through futures or through callbacks,
+     * which are called on the executor's threads.
+     *
+     * @note
+     *     Destroying the executor waits for all submitted work to finish.
+     */
+    class Executor {
+        // Types
+    public:
+        /**
+         * This holds the settings which control how the executor is set up.
+         */
+        struct Configuration {
+            /**
+             * This is the number of worker threads which execute queries.
+             * Each has its own read-only connection.
+             */
+            size_t numReaderThreads = 2;
+
+            /**
+             * This is the maximum number of idle statements to hold in
+             * the statement cache of each connection.
+             */
+            size_t statementCacheCapacity = StatementCache::DEFAULT_CAPACITY;
+
+            /**
+             * This is how long, in milliseconds, a connection waits for
+             * a lock held by another connection before giving up.
+             */
+            int busyTimeoutMilliseconds = 5000;
+        };
+
+        /**
+         * This is the type of function which performs a read job, given a
+         * read-only connection and its statement cache.
+         */
+        using ReadJob = std::function<
+            void(
+                const DatabaseConnection& db,
+                StatementCache& statements
+            )
+        >;
+
+        // Lifecycle Methods
+    public:
+        ~Executor() noexcept;
+        Executor(const Executor&) = delete;
+        Executor(Executor&&) noexcept;
+        Executor& operator=(const Executor&) = delete;
+        Executor& operator=(Executor&&) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor.
+         *
+         * @param[in] path
+         *     This is the path to the database file to open.
+         *     It's created if it doesn't already exist.
+         *
+         * @param[in] configuration
+         *     These are the settings which control how the executor is
+         *     set up.  If not given, the default settings are used.
+         */
+        explicit Executor(const std::string& path);
+        Executor(
+            const std::string& path,
+            const Configuration& configuration
+        );
+
+        /**
+         * Indicate whether or not the executor's connections were opened.
+         * An executor which has been moved from is not usable.
+         *
+         * @return
+         *     An indication of whether or not the executor is usable
+         *     is returned.
+         */
+        explicit operator bool() const;
+
+        /**
+         * Queue a query to be executed by a worker thread, delivering its
+         * rows of results to the given callback.
+         *
+         * @tparam Columns
+         *     These are the C++ types into which to decode the columns,
+         *     in order, other than std::string_view, which would not
+         *     outlive the next step of the statement.
+         *
+         * @param[in] sql
+         *     This is the SQL text of the query.
+         *
+         * @param[in] values
+         *     These are the values to bind to the query parameters,
+         *     in order.
+         *
+         * @param[in] callback
+         *     This is the function to call, on the worker thread,
+         *     with the results of the query.
+         */
+        template< typename... Columns >
+        void Query(
+            const std::string& sql,
+            std::vector< Value >&& values,
+            typename QueryResults< Columns... >::Callback callback
+        ) {
+            if (!*this) {
+                QueryResults< Columns... > results;
+                results.error = true;
+                callback(std::move(results));
+                return;
+            }
+            Read(
+                [sql, values = std::move(values), callback = std::move(callback)](
+                    const DatabaseConnection&,
+                    StatementCache& statements
+                ){
+                    callback(RunQuery< Columns... >(statements, sql, values));
+                }
+            );
+        }
+
+        /**
+         * Queue a query to be executed by a worker thread.
+         *
+         * @tparam Columns
+         *     These are the C++ types into which to decode the columns,
+         *     in order, other than std::string_view, which would not
+         *     outlive the next step of the statement.
+         *
+         * @param[in] sql
+         *     This is the SQL text of the query.
+         *
+         * @param[in] values
+         *     These are the values to bind to the query parameters,
+         *     in order.
+         *
+         * @return
+         *     A future which will hold the results of the query
+         *     is returned.  If collecting the results throws an exception,
+         *     the future holds the exception instead.
+         */
+        template< typename... Columns >
+        std::future< QueryResults< Columns... > > Query(
+            const std::string& sql,
+            std::vector< Value >&& values = {}
+        ) {
+            const auto promise = std::make_shared<
+                std::promise< QueryResults< Columns... > >
+            >();
+            auto future = promise->get_future();
+            if (!*this) {
+                QueryResults< Columns... > results;
+                results.error = true;
+                promise->set_value(std::move(results));
+                return future;
+            }
+            Read(
+                [sql, values = std::move(values), promise](
+                    const DatabaseConnection&,
+                    StatementCache& statements
+                ){
+                    try {
+                        promise->set_value(
+                            RunQuery< Columns... >(statements, sql, values)
+                        );
+                    } catch (...) {
+                        promise->set_exception(std::current_exception());
+                    }
+                }
+            );
+            return future;
+        }
+
+        /**
+         * Queue a job to be performed by a worker thread, with one of the
+         * read-only connections.  The job is dropped if the executor
+         * isn't usable.  Any exception the job throws is caught and
+         * discarded, so that it doesn't end the worker thread.
+         *
+         * @param[in] job
+         *     This is the function which performs the read job.
+         */
+        void Read(ReadJob job);
+
+        /**
+         * Queue a statement to be executed by the writer thread.
+         *
+         * @param[in] sql
+         *     This is the SQL text of the statement to execute.
+         *
+         * @param[in] values
+         *     These are the values to bind to the statement parameters,
+         *     in order.
+         *
+         * @return
+         *     A future which will hold an indication of whether or not
+         *     the statement executed and was committed successfully
+         *     is returned.
+         */
+        std::future< bool > Execute(
+            const std::string& sql,
+            std::vector< Value >&& values = {}
+        );
+
+        /**
+         * Queue a job to be performed by the writer thread.  The job must
+         * not begin or end transactions itself, although it may use
+         * savepoints.
+         *
+         * @param[in] job
+         *     This is the function which performs the write job.
+         *
+         * @return
+         *     A future which will hold an indication of whether or not
+         *     the job succeeded and was committed is returned.  If the job,
+         *     or another in the same transaction, throws an exception,
+         *     the future holds the exception instead.
+         */
+        std::future< bool > Execute(ConnectionPool::WriteJob job);
+
+        // Private Methods
+    private:
+        /**
+         * Execute a query and collect all its rows of results.
+         *
+         * @tparam Columns
+         *     These are the C++ types into which to decode the columns,
+         *     in order.  They must not be std::string_view, since the
+         *     rows outlive the steps of the statement which produced them.
+         *
+         * @param[in] statements
+         *     This is the statement cache from which to take the query.
+         *
+         * @param[in] sql
+         *     This is the SQL text of the query.
+         *
+         * @param[in] values
+         *     These are the values to bind to the query parameters,
+         *     in order.
+         *
+         * @return
+         *     The results of the query are returned.
+         */
+        template< typename... Columns >
+        static QueryResults< Columns... > RunQuery(
+            StatementCache& statements,
+            const std::string& sql,
+            const std::vector< Value >& values
+        ) {
+            static_assert(
+                !std::disjunction< std::is_same< Columns, std::string_view >... >::value,
+                "string_view columns are only valid until the statement is stepped again"
+            );
+            QueryResults< Columns... > results;
+            const auto stmt = statements.Acquire(sql);
+            if (!stmt) {
+                results.error = true;
+                return results;
+            }
+            BindGuard bindings(stmt);
+            for (size_t i = 0; i < values.size(); ++i) {
+                bindings.Bind((int)(i + 1), values[i]);
+            }
+            SQLiteWrappers::Query< Columns... > query(stmt);
+            std::tuple< Columns... > row;
+            while (query.Next(row)) {
+                results.rows.push_back(std::move(row));
+            }
+            results.error = query.HasError();
+            return results;
+        }
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* SQLITE_WRAPPERS_EXECUTOR_HPP */
@@ -0,0 +1,324 @@
+#ifndef SQLITE_WRAPPERS_GENERATOR_HPP
+#define SQLITE_WRAPPERS_GENERATOR_HPP
+
+/**
+ * @file Generator.hpp
+ *
+ * This module declares the SQLiteWrappers::Generator class template, a
+ * C++20 coroutine which lazily yields values, along with coroutines which
+ * stream the rows of a statement and compose streams into pipelines.
+ *
+ * Everything here requires compiler support for coroutines.  In builds
+ * without it, this header declares nothing, and Rows (see Rows.hpp) is
+ * the way to consume rows lazily.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define SQLITE_WRAPPERS_HAVE_COROUTINES
+#endif
+#endif
+
+#ifdef SQLITE_WRAPPERS_HAVE_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This is a coroutine which lazily yields a sequence of values.  The
+     * coroutine only runs as far as needed to produce the next value each
+     * time the consumer advances, and destroying the generator abandons
+     * the coroutine wherever it's suspended.
+     *
+     * Values are yielded by reference, so they're not copied; each value
+     * is only valid until the consumer advances again.
+     *
+     * @tparam T
+     *     This is the type of values yielded.
+     */
+    template< typename T >
+    class Generator {
+        // Types
+    public:
+        /**
+         * This is the type of values yielded, with any reference removed.
+         */
+        using value_type = std::remove_cv_t< std::remove_reference_t< T > >;
+
+        /**
+         * This is what the coroutine machinery uses to communicate between
+         * the coroutine and the generator.
+         */
+        struct promise_type {
+            /**
+             * This points to the value most recently yielded.
+             */
+            std::add_pointer_t< std::remove_reference_t< T > > value = nullptr;
+
+            Generator get_return_object() {
+                return Generator(
+                    std::coroutine_handle< promise_type >::from_promise(*this)
+                );
+            }
+
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+
+            std::suspend_always final_suspend() noexcept {
+                return {};
+            }
+
+            std::suspend_always yield_value(std::remove_reference_t< T >& yielded) noexcept {
+                value = std::addressof(yielded);
+                return {};
+            }
+
+            std::suspend_always yield_value(std::remove_reference_t< T >&& yielded) noexcept {
+                value = std::addressof(yielded);
+                return {};
+            }
+
+            void return_void() noexcept {
+            }
+
+            void unhandled_exception() noexcept {
+                std::terminate();
+            }
+        };
+
+        /**
+         * This is used to visit each value in turn.
+         */
+        class Iterator {
+            // Types
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = Generator::value_type;
+            using difference_type = ptrdiff_t;
+            using pointer = std::add_pointer_t< std::remove_reference_t< T > >;
+            using reference = std::remove_reference_t< T >&;
+
+            // Public Methods
+        public:
+            Iterator() = default;
+
+            explicit Iterator(std::coroutine_handle< promise_type > coroutine)
+                : coroutine_(coroutine)
+            {
+            }
+
+            reference operator*() const {
+                return *coroutine_.promise().value;
+            }
+
+            pointer operator->() const {
+                return coroutine_.promise().value;
+            }
+
+            Iterator& operator++() {
+                coroutine_.resume();
+                return *this;
+            }
+
+            void operator++(int) {
+                coroutine_.resume();
+            }
+
+            bool operator==(std::default_sentinel_t) const {
+                return (
+                    !coroutine_
+                    || coroutine_.done()
+                );
+            }
+
+            // Private Properties
+        private:
+            /**
+             * This is the coroutine producing the values.
+             */
+            std::coroutine_handle< promise_type > coroutine_;
+        };
+
+        // Lifecycle Methods
+    public:
+        ~Generator() noexcept {
+            if (coroutine_) {
+                coroutine_.destroy();
+            }
+        }
+        Generator(const Generator&) = delete;
+        Generator(Generator&& other) noexcept
+            : coroutine_(std::exchange(other.coroutine_, nullptr))
+        {
+        }
+        Generator& operator=(const Generator&) = delete;
+        Generator& operator=(Generator&& other) noexcept {
+            if (this != &other) {
+                if (coroutine_) {
+                    coroutine_.destroy();
+                }
+                coroutine_ = std::exchange(other.coroutine_, nullptr);
+            }
+            return *this;
+        }
+
+        // Public Methods
+    public:
+        /**
+         * Run the coroutine until it yields its first value, and return
+         * an iterator which visits it.
+         *
+         * @note
+         *     The generator can only be traversed once.
+         *
+         * @return
+         *     An iterator which visits the first value is returned.
+         */
+        Iterator begin() {
+            if (coroutine_) {
+                coroutine_.resume();
+            }
+            return Iterator(coroutine_);
+        }
+
+        /**
+         * Return a sentinel which marks the end of the values.
+         *
+         * @return
+         *     A sentinel which marks the end of the values is returned.
+         */
+        std::default_sentinel_t end() const noexcept {
+            return {};
+        }
+
+        // Private Methods
+    private:
+        /**
+         * This constructor is used by the promise to make the generator
+         * for a new coroutine.
+         *
+         * @param[in] coroutine
+         *     This is the new coroutine.
+         */
+        explicit Generator(std::coroutine_handle< promise_type > coroutine)
+            : coroutine_(coroutine)
+        {
+        }
+
+        // Private Properties
+    private:
+        /**
+         * This is the coroutine producing the values.
+         */
+        std::coroutine_handle< promise_type > coroutine_;
+    };
+
+    /**
+     * Lazily yield the elements of the given range.  This is typically
+     * used to begin a pipeline with the rows of a statement, through
+     * a Rows range; the statement is only stepped as far as the pipeline
+     * pulls rows through.  Check the range for errors once the pipeline
+     * is finished.
+     *
+     * @param[in] range
+     *     This is the range whose elements to yield.  It must outlive
+     *     the generator.
+     *
+     * @return
+     *     A generator which yields the elements of the range is returned.
+     */
+    template< typename Range >
+    auto Stream(Range& range) -> Generator< decltype(*std::begin(range)) > {
+        for (auto&& element: range) {
+            co_yield element;
+        }
+    }
+
+    /**
+     * Lazily yield only the values from the given generator which satisfy
+     * the given predicate.
+     *
+     * @param[in] source
+     *     This is the generator whose values to filter.
+     *
+     * @param[in] predicate
+     *     This is the function which returns true for each value to yield.
+     *
+     * @return
+     *     A generator which yields the values which satisfy the predicate
+     *     is returned.
+     */
+    template< typename T, typename Predicate >
+    Generator< T > Filter(Generator< T > source, Predicate predicate) {
+        for (auto&& value: source) {
+            if (predicate(value)) {
+                co_yield value;
+            }
+        }
+    }
+
+    /**
+     * Lazily yield the result of applying the given function to each value
+     * from the given generator.
+     *
+     * @param[in] source
+     *     This is the generator whose values to transform.
+     *
+     * @param[in] function
+     *     This is the function to apply to each value.
+     *
+     * @return
+     *     A generator which yields the transformed values is returned.
+     */
+    template< typename T, typename Function >
+    auto Transform(Generator< T > source, Function function)
+        -> Generator< std::invoke_result_t< Function&, std::remove_reference_t< T >& > >
+    {
+        for (auto&& value: source) {
+            co_yield function(value);
+        }
+    }
+
+    /**
+     * Lazily yield at most the given number of values from the given
+     * generator.  The source generator isn't advanced past the last
+     * value taken.
+     *
+     * @param[in] source
+     *     This is the generator whose values to take.
+     *
+     * @param[in] count
+     *     This is the maximum number of values to take.
+     *
+     * @return
+     *     A generator which yields at most the given number of values
+     *     is returned.
+     */
+    template< typename T >
+    Generator< T > Take(Generator< T > source, size_t count) {
+        if (count == 0) {
+            co_return;
+        }
+        for (auto&& value: source) {
+            co_yield value;
+            if (--count == 0) {
+                co_return;
+            }
+        }
+    }
+
+}
+
+#endif /* SQLITE_WRAPPERS_HAVE_COROUTINES */
+
+#endif /* SQLITE_WRAPPERS_GENERATOR_HPP */
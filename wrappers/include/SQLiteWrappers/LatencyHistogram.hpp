@@ -0,0 +1,181 @@
+#ifndef SQLITE_WRAPPERS_LATENCY_HISTOGRAM_HPP
+#define SQLITE_WRAPPERS_LATENCY_HISTOGRAM_HPP
+
+/**
+ * @file LatencyHistogram.hpp
+ *
+ * This module declares the SQLiteWrappers::LatencyHistogram class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This records the distribution of a set of durations, such as how long
+     * each run of a statement took, in the style of an HDR histogram:
+     * buckets are spaced logarithmically, by powers of two, and each power
+     * of two is split into linearly-spaced sub-buckets.  This keeps the
+     * relative error of any percentile within 1/16th (6.25%) whether the
+     * durations are nanoseconds or hours, while recording a duration costs
+     * only a few bit operations and an increment.
+     *
+     * Buckets are only allocated up to the largest duration recorded.
+     */
+    class LatencyHistogram {
+        // Types
+    public:
+        /**
+         * This is the number of bits of each duration, after its leading
+         * one bit, which select its sub-bucket.
+         */
+        static constexpr unsigned int SUB_BUCKET_BITS = 4;
+
+        /**
+         * This is the number of sub-buckets into which each power of two
+         * is split.
+         */
+        static constexpr uint64_t SUB_BUCKET_COUNT = (uint64_t)1 << SUB_BUCKET_BITS;
+
+        // Public Methods
+    public:
+        /**
+         * Record one duration.
+         *
+         * @param[in] nanoseconds
+         *     This is the duration to record, in nanoseconds.
+         */
+        void Record(uint64_t nanoseconds);
+
+        /**
+         * Add all the durations recorded in another histogram to this one.
+         *
+         * @param[in] other
+         *     This is the histogram whose durations to add.
+         */
+        void Merge(const LatencyHistogram& other);
+
+        /**
+         * Discard all recorded durations.
+         */
+        void Reset();
+
+        /**
+         * Return the number of durations recorded.
+         *
+         * @return
+         *     The number of durations recorded is returned.
+         */
+        uint64_t GetCount() const;
+
+        /**
+         * Return the smallest duration recorded.
+         *
+         * @return
+         *     The smallest duration recorded, in nanoseconds, is returned,
+         *     or zero if none were recorded.
+         */
+        uint64_t GetMin() const;
+
+        /**
+         * Return the largest duration recorded.
+         *
+         * @return
+         *     The largest duration recorded, in nanoseconds, is returned,
+         *     or zero if none were recorded.
+         */
+        uint64_t GetMax() const;
+
+        /**
+         * Return the sum of all durations recorded.
+         *
+         * @return
+         *     The sum of all durations recorded, in nanoseconds,
+         *     is returned.
+         */
+        uint64_t GetTotal() const;
+
+        /**
+         * Return the mean of all durations recorded.
+         *
+         * @return
+         *     The mean of all durations recorded, in nanoseconds,
+         *     is returned, or zero if none were recorded.
+         */
+        double GetMean() const;
+
+        /**
+         * Return the duration below which the given percentage of the
+         * recorded durations fall.
+         *
+         * @param[in] percentile
+         *     This is the percentage, from 0 to 100.
+         *
+         * @return
+         *     The upper bound, in nanoseconds, of the bucket holding the
+         *     duration at the given percentile is returned, or zero if
+         *     no durations were recorded.
+         */
+        uint64_t GetValueAtPercentile(double percentile) const;
+
+        // Private Methods
+    private:
+        /**
+         * Return the index of the bucket which counts the given duration.
+         *
+         * @param[in] nanoseconds
+         *     This is the duration.
+         *
+         * @return
+         *     The index of the bucket which counts the duration
+         *     is returned.
+         */
+        static size_t GetBucketIndex(uint64_t nanoseconds);
+
+        /**
+         * Return the largest duration counted by the bucket with the
+         * given index.
+         *
+         * @param[in] index
+         *     This is the index of the bucket.
+         *
+         * @return
+         *     The largest duration counted by the bucket is returned.
+         */
+        static uint64_t GetBucketUpperBound(size_t index);
+
+        // Private Properties
+    private:
+        /**
+         * These count the durations recorded in each bucket.
+         */
+        std::vector< uint64_t > buckets_;
+
+        /**
+         * This is the number of durations recorded.
+         */
+        uint64_t count_ = 0;
+
+        /**
+         * This is the smallest duration recorded.
+         */
+        uint64_t min_ = 0;
+
+        /**
+         * This is the largest duration recorded.
+         */
+        uint64_t max_ = 0;
+
+        /**
+         * This is the sum of all durations recorded.
+         */
+        uint64_t total_ = 0;
+    };
+
+}
+
+#endif /* SQLITE_WRAPPERS_LATENCY_HISTOGRAM_HPP */
@@ -0,0 +1,219 @@
+#ifndef SQLITE_WRAPPERS_PROFILER_HPP
+#define SQLITE_WRAPPERS_PROFILER_HPP
+
+/**
+ * @file Profiler.hpp
+ *
+ * This module declares the SQLiteWrappers::Profiler class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "LatencyHistogram.hpp"
+#include "Wrappers.hpp"
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This measures the cost of every statement executed on a database
+     * connection, and aggregates the measurements by SQL text, so that
+     * expensive statements, and statements which have regressed to scanning
+     * whole tables, can be spotted in a running program.
+     *
+     * Runs are observed through the connection's trace hook
+     * (sqlite3_trace_v2), so every statement is measured, however it was
+     * prepared, including those run by sqlite3_exec.  At the end of each
+     * run, the statement's sqlite3_stmt_status counters are collected and
+     * reset.  The trace hook only sees when a run starts and ends, not
+     * when each step returns, so runs are timed from start to end; the
+     * time spent inside SQLite itself is only measured for statements
+     * stepped through the profiler's Step method.  Preparation can't be
+     * observed through the trace hook, so only statements prepared
+     * through the profiler, or through a StatementCache given the
+     * profiler, have their prepare time measured.
+     *
+     * @note
+     *     A connection has only one trace hook, so the profiler replaces
+     *     any other installed on the connection, and the connection must
+     *     not be traced by anything else while the profiler is attached.
+     *     The profiler must be destroyed before the connection is closed.
+     *     The connection must only be used by one thread at a time, although
+     *     profiles may be polled from any thread.
+     */
+    class Profiler {
+        // Types
+    public:
+        /**
+         * This holds the measurements aggregated for one SQL text.
+         */
+        struct StatementProfile {
+            /**
+             * This is the SQL text of the statement.
+             */
+            std::string sql;
+
+            /**
+             * This is the number of times the statement was run, from its
+             * first step until it was reset or finalized.
+             */
+            uint64_t runs = 0;
+
+            /**
+             * This is the number of rows of results the statement produced.
+             */
+            uint64_t rows = 0;
+
+            /**
+             * This records how long each compilation of the statement took.
+             */
+            LatencyHistogram prepareTime;
+
+            /**
+             * This records how long each run of the statement lasted, from
+             * the start of its first step until it was reset or finalized.
+             * This is the statement's whole lifetime, so it includes
+             * whatever the program did between steps, such as processing
+             * the rows of results, and not just the time spent in SQLite.
+             */
+            LatencyHistogram runTime;
+
+            /**
+             * This records how long each run of the statement spent inside
+             * sqlite3_step, summed over all its steps.  Only runs stepped
+             * through Profiler::Step are recorded, so this may hold fewer
+             * runs than runTime.
+             */
+            LatencyHistogram stepTime;
+
+            /**
+             * This is the number of times the statement stepped forward
+             * through a table as part of a full table scan
+             * (SQLITE_STMTSTATUS_FULLSCAN_STEP).  If this is large, an
+             * index may be missing.
+             */
+            uint64_t fullscanSteps = 0;
+
+            /**
+             * This is the number of sort operations the statement performed
+             * (SQLITE_STMTSTATUS_SORT).
+             */
+            uint64_t sorts = 0;
+
+            /**
+             * This is the number of rows inserted into automatic indexes
+             * built by the statement (SQLITE_STMTSTATUS_AUTOINDEX).
+             */
+            uint64_t autoindexRows = 0;
+
+            /**
+             * This is the number of virtual machine operations the statement
+             * executed (SQLITE_STMTSTATUS_VM_STEP).
+             */
+            uint64_t vmSteps = 0;
+
+            /**
+             * This is the number of times the statement was automatically
+             * recompiled because of a schema change
+             * (SQLITE_STMTSTATUS_REPREPARE).
+             */
+            uint64_t reprepares = 0;
+        };
+
+        // Lifecycle Methods
+    public:
+        ~Profiler() noexcept;
+        Profiler(const Profiler&) = delete;
+        Profiler(Profiler&&) noexcept;
+        Profiler& operator=(const Profiler&) = delete;
+        Profiler& operator=(Profiler&& other) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor.
+         *
+         * @param[in] db
+         *     This is the database connection to profile.  The connection
+         *     must outlive the profiler, but the handle which owns it
+         *     may be moved.
+         */
+        explicit Profiler(const DatabaseConnection& db);
+
+        /**
+         * Compile the given SQL text into a prepared statement, measuring
+         * how long it took.
+         *
+         * @param[in] sql
+         *     This is the SQL text to compile.
+         *
+         * @return
+         *     The prepared statement is returned, or nullptr if the SQL
+         *     text could not be compiled, or if the profiler has been
+         *     moved from.
+         */
+        PreparedStatement Prepare(const std::string& sql);
+
+        /**
+         * Execute the given statement until it either produces the next
+         * row of results, runs to completion, or fails, measuring how long
+         * the step took.  The time is added to the statement's stepTime
+         * when its run finishes.
+         *
+         * @param[in] stmt
+         *     This is the statement to step.  It must have been prepared
+         *     on the connection being profiled.
+         *
+         * @return
+         *     The outcome of stepping the statement is returned.
+         */
+        StepStatementResults Step(const PreparedStatement& stmt);
+
+        /**
+         * Return a snapshot of the measurements aggregated for each
+         * SQL text, ordered from the most total time spent running to
+         * the least.
+         *
+         * @return
+         *     The measurements aggregated for each SQL text are returned.
+         */
+        std::vector< StatementProfile > GetProfiles() const;
+
+        /**
+         * Format a report of the measurements aggregated for each SQL text,
+         * one line per statement, ordered from the most total time spent
+         * running to the least.  Statements which scanned whole tables or
+         * built automatic indexes are flagged.
+         *
+         * @return
+         *     The report is returned.
+         */
+        std::string Dump() const;
+
+        /**
+         * Discard all measurements.
+         */
+        void Reset();
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+    };
+
+}
+
+#endif /* SQLITE_WRAPPERS_PROFILER_HPP */
@@ -0,0 +1,328 @@
+#ifndef SQLITE_WRAPPERS_QUERY_HPP
+#define SQLITE_WRAPPERS_QUERY_HPP
+
+/**
+ * @file Query.hpp
+ *
+ * This module declares the SQLiteWrappers::Query class template, along with
+ * the column traits it uses to decode rows of results directly into tuples
+ * or aggregate structures, with the type of each column resolved at
+ * compile time.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Wrappers.hpp"
+
+#include <optional>
+#include <sqlite3.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This template is specialized for each C++ type into which a column
+     * of results may be decoded.  Each specialization provides a static
+     * Fetch function which decodes the column using exactly the
+     * sqlite3_column_* calls needed for that type.
+     *
+     * @tparam T
+     *     This is the C++ type into which to decode the column.
+     */
+    template< typename T, typename Enable = void > struct ColumnTraits;
+
+    /**
+     * This decodes integer (and boolean) columns.  The whole 64-bit value
+     * is fetched with sqlite3_column_int64 and then converted, so that a
+     * boolean is true for any nonzero value, rather than only for those
+     * with nonzero low 32 bits.  A NULL column decodes as zero.
+     */
+    template< typename T > struct ColumnTraits<
+        T,
+        typename std::enable_if< std::is_integral< T >::value >::type
+    > {
+        static T Fetch(sqlite3_stmt* stmt, int index) {
+            const auto value = sqlite3_column_int64(stmt, index);
+            if (std::is_same< T, bool >::value) {
+                return (T)(value != 0);
+            } else {
+                return (T)value;
+            }
+        }
+    };
+
+    /**
+     * This decodes floating-point columns.  A NULL column decodes as zero.
+     */
+    template< typename T > struct ColumnTraits<
+        T,
+        typename std::enable_if< std::is_floating_point< T >::value >::type
+    > {
+        static T Fetch(sqlite3_stmt* stmt, int index) {
+            return (T)sqlite3_column_double(stmt, index);
+        }
+    };
+
+    /**
+     * This decodes text columns into strings which own a copy of the text.
+     * A NULL column decodes as an empty string.
+     */
+    template<> struct ColumnTraits< std::string > {
+        static std::string Fetch(sqlite3_stmt* stmt, int index) {
+            const auto text = (const char*)sqlite3_column_text(stmt, index);
+            if (text == NULL) {
+                return std::string();
+            }
+            return std::string(text, (size_t)sqlite3_column_bytes(stmt, index));
+        }
+    };
+
+    /**
+     * This decodes text columns into views of SQLite's own copy of the
+     * text, avoiding a copy.  A NULL column decodes as an empty view.
+     *
+     * @note
+     *     The view is only valid until the statement is stepped again,
+     *     reset, or finalized.
+     */
+    template<> struct ColumnTraits< std::string_view > {
+        static std::string_view Fetch(sqlite3_stmt* stmt, int index) {
+            const auto text = (const char*)sqlite3_column_text(stmt, index);
+            if (text == NULL) {
+                return std::string_view();
+            }
+            return std::string_view(text, (size_t)sqlite3_column_bytes(stmt, index));
+        }
+    };
+
+    /**
+     * This decodes blob columns into byte vectors.  A NULL column decodes
+     * as an empty vector.
+     */
+    template<> struct ColumnTraits< std::vector< uint8_t > > {
+        static std::vector< uint8_t > Fetch(sqlite3_stmt* stmt, int index) {
+            const auto data = (const uint8_t*)sqlite3_column_blob(stmt, index);
+            if (data == NULL) {
+                return std::vector< uint8_t >();
+            }
+            return std::vector< uint8_t >(
+                data,
+                data + sqlite3_column_bytes(stmt, index)
+            );
+        }
+    };
+
+    /**
+     * This decodes columns which may be NULL.  The column type is looked
+     * up once, and only if the column isn't NULL is the value decoded.
+     */
+    template< typename T > struct ColumnTraits< std::optional< T > > {
+        static std::optional< T > Fetch(sqlite3_stmt* stmt, int index) {
+            if (sqlite3_column_type(stmt, index) == SQLITE_NULL) {
+                return std::nullopt;
+            }
+            return ColumnTraits< T >::Fetch(stmt, index);
+        }
+    };
+
+    /**
+     * This is the helper used to decode a row of results into an aggregate
+     * structure.  The index sequence pairs each column type with the
+     * zero-based index of the column.
+     */
+    template< typename Struct, typename... Columns, size_t... Indexes >
+    Struct FetchRowAs(
+        sqlite3_stmt* stmt,
+        std::index_sequence< Indexes... >
+    ) {
+        // Braced initialization guarantees the columns are fetched in order.
+        return Struct{ColumnTraits< Columns >::Fetch(stmt, (int)Indexes)...};
+    }
+
+    /**
+     * Decode the current row of results of the given statement into
+     * an aggregate structure, initializing its members in order from
+     * the columns of the row.
+     *
+     * @tparam Struct
+     *     This is the type of aggregate structure into which to decode
+     *     the row.
+     *
+     * @tparam Columns
+     *     These are the C++ types into which to decode the columns,
+     *     in order.
+     *
+     * @param[in] stmt
+     *     This is the statement from which to fetch the row.
+     *
+     * @return
+     *     The decoded row is returned.
+     */
+    template< typename Struct, typename... Columns >
+    Struct FetchRowAs(const PreparedStatement& stmt) {
+        return FetchRowAs< Struct, Columns... >(
+            stmt.get(),
+            std::index_sequence_for< Columns... >()
+        );
+    }
+
+    /**
+     * Decode the current row of results of the given statement into
+     * a tuple.
+     *
+     * @tparam Columns
+     *     These are the C++ types into which to decode the columns,
+     *     in order.
+     *
+     * @param[in] stmt
+     *     This is the statement from which to fetch the row.
+     *
+     * @return
+     *     The decoded row is returned.
+     */
+    template< typename... Columns >
+    std::tuple< Columns... > FetchRow(const PreparedStatement& stmt) {
+        return FetchRowAs< std::tuple< Columns... >, Columns... >(stmt);
+    }
+
+    /**
+     * This steps a prepared statement and decodes each row of results
+     * it produces, with the type of each column fixed at compile time.
+     *
+     * For example:
+     *
+     * @code
+     * Query< int, int, std::optional< int > > query(stmt);
+     * std::tuple< int, int, std::optional< int > > row;
+     * while (query.Next(row)) {
+     *     ...
+     * }
+     * if (query.HasError()) {
+     *     ...
+     * }
+     * @endcode
+     *
+     * @tparam Columns
+     *     These are the C++ types into which to decode the columns,
+     *     in order.
+     */
+    template< typename... Columns >
+    class Query {
+        // Types
+    public:
+        /**
+         * This is the type of tuple into which each row is decoded
+         * by default.
+         */
+        using Row = std::tuple< Columns... >;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor.
+         *
+         * @param[in] stmt
+         *     This is the statement to step.  It must outlive the query.
+         */
+        explicit Query(const PreparedStatement& stmt)
+            : stmt_(stmt.get())
+        {
+        }
+
+        /**
+         * Step the statement and decode the next row of results, if any.
+         *
+         * @tparam Target
+         *     This is the type into which to decode the row.  It may be
+         *     the Row tuple type, or any aggregate structure whose members
+         *     can be initialized in order from the column types.
+         *
+         * @param[out] row
+         *     This is where to store the decoded row.
+         *
+         * @return
+         *     An indication of whether or not a row was decoded is
+         *     returned.  This is false once the statement has run to
+         *     completion or has failed; HasError tells which.
+         */
+        template< typename Target >
+        bool Next(Target& row) {
+            if (done_) {
+                return false;
+            }
+            switch (sqlite3_step(stmt_)) {
+                case SQLITE_ROW: {
+                    row = FetchRowAs< Target, Columns... >(
+                        stmt_,
+                        std::index_sequence_for< Columns... >()
+                    );
+                    return true;
+                }
+
+                case SQLITE_DONE: {
+                    done_ = true;
+                } break;
+
+                default: {
+                    done_ = true;
+                    error_ = true;
+                } break;
+            }
+            return false;
+        }
+
+        /**
+         * Step the statement and decode the next row of results, if any,
+         * into a tuple.
+         *
+         * @return
+         *     The decoded row is returned, or nothing if the statement
+         *     has run to completion or has failed.
+         */
+        std::optional< Row > Next() {
+            Row row;
+            if (Next(row)) {
+                return row;
+            }
+            return std::nullopt;
+        }
+
+        /**
+         * Indicate whether or not the statement failed while stepping it.
+         *
+         * @return
+         *     An indication of whether or not the statement failed
+         *     is returned.
+         */
+        bool HasError() const {
+            return error_;
+        }
+
+        // Private Properties
+    private:
+        /**
+         * This is the statement to step.
+         */
+        sqlite3_stmt* stmt_;
+
+        /**
+         * This indicates whether or not the statement has run to
+         * completion or failed.
+         */
+        bool done_ = false;
+
+        /**
+         * This indicates whether or not the statement failed.
+         */
+        bool error_ = false;
+    };
+
+}
+
+#endif /* SQLITE_WRAPPERS_QUERY_HPP */
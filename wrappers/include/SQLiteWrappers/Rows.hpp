@@ -0,0 +1,223 @@
+#ifndef SQLITE_WRAPPERS_ROWS_HPP
+#define SQLITE_WRAPPERS_ROWS_HPP
+
+/**
+ * @file Rows.hpp
+ *
+ * This module declares the SQLiteWrappers::Rows class template.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Query.hpp"
+#include "Wrappers.hpp"
+
+#include <stddef.h>
+#include <iterator>
+#include <tuple>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This presents the rows of results produced by a prepared statement
+     * as a single-pass range, so they can be consumed with a range-based
+     * for loop.  The statement is stepped lazily: one row is fetched each
+     * time the loop advances, so breaking out of the loop early stops
+     * stepping the statement.
+     *
+     * For example:
+     *
+     * @code
+     * Rows< int, int, std::optional< int > > rows(stmt);
+     * for (const auto& row: rows) {
+     *     ...
+     * }
+     * if (rows.HasError()) {
+     *     ...
+     * }
+     * @endcode
+     *
+     * The iterators are standard input iterators, so the range can also be
+     * composed with the C++20 range adaptors, which likewise only step the
+     * statement as far as the consumer pulls rows through them.
+     *
+     * @tparam Columns
+     *     These are the C++ types into which to decode the columns,
+     *     in order.
+     */
+    template< typename... Columns >
+    class Rows {
+        // Types
+    public:
+        /**
+         * This is the type of tuple into which each row is decoded.
+         */
+        using Row = std::tuple< Columns... >;
+
+        /**
+         * This is used to visit each row in turn.
+         */
+        class Iterator {
+            // Types
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = Row;
+            using difference_type = ptrdiff_t;
+            using pointer = const Row*;
+            using reference = const Row&;
+
+            // Public Methods
+        public:
+            /**
+             * This constructs an iterator which marks the end of the rows.
+             */
+            Iterator() = default;
+
+            /**
+             * This constructs an iterator which visits the current row
+             * of the given range.
+             *
+             * @param[in] rows
+             *     This is the range whose rows to visit.
+             */
+            explicit Iterator(Rows* rows)
+                : rows_(rows)
+            {
+            }
+
+            reference operator*() const {
+                return rows_->row_;
+            }
+
+            pointer operator->() const {
+                return &rows_->row_;
+            }
+
+            Iterator& operator++() {
+                rows_->Advance();
+                return *this;
+            }
+
+            void operator++(int) {
+                rows_->Advance();
+            }
+
+            bool operator==(const Iterator& other) const {
+                return IsAtEnd() == other.IsAtEnd();
+            }
+
+            bool operator!=(const Iterator& other) const {
+                return !(*this == other);
+            }
+
+            // Private Methods
+        private:
+            /**
+             * Indicate whether or not there are no more rows to visit.
+             *
+             * @return
+             *     An indication of whether or not there are no more rows
+             *     to visit is returned.
+             */
+            bool IsAtEnd() const {
+                return (
+                    (rows_ == nullptr)
+                    || !rows_->hasRow_
+                );
+            }
+
+            // Private Properties
+        private:
+            /**
+             * This is the range whose rows are visited, or nullptr for
+             * an iterator which marks the end of the rows.
+             */
+            Rows* rows_ = nullptr;
+        };
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor.
+         *
+         * @param[in] stmt
+         *     This is the statement to step.  It must outlive the range.
+         */
+        explicit Rows(const PreparedStatement& stmt)
+            : query_(stmt)
+        {
+        }
+
+        /**
+         * Fetch the first row and return an iterator which visits it.
+         *
+         * @note
+         *     The range can only be traversed once.
+         *
+         * @return
+         *     An iterator which visits the first row is returned.
+         */
+        Iterator begin() {
+            if (!started_) {
+                started_ = true;
+                Advance();
+            }
+            return Iterator(this);
+        }
+
+        /**
+         * Return an iterator which marks the end of the rows.
+         *
+         * @return
+         *     An iterator which marks the end of the rows is returned.
+         */
+        Iterator end() {
+            return Iterator();
+        }
+
+        /**
+         * Indicate whether or not the statement failed while stepping it.
+         *
+         * @return
+         *     An indication of whether or not the statement failed
+         *     is returned.
+         */
+        bool HasError() const {
+            return query_.HasError();
+        }
+
+        // Private Methods
+    private:
+        /**
+         * Step the statement and decode the next row of results, if any.
+         */
+        void Advance() {
+            hasRow_ = query_.Next(row_);
+        }
+
+        // Private Properties
+    private:
+        /**
+         * This steps the statement and decodes its rows.
+         */
+        Query< Columns... > query_;
+
+        /**
+         * This is the most recently decoded row.
+         */
+        Row row_;
+
+        /**
+         * This indicates whether or not row_ holds a row to visit.
+         */
+        bool hasRow_ = false;
+
+        /**
+         * This indicates whether or not the first row has been fetched.
+         */
+        bool started_ = false;
+    };
+
+}
+
+#endif /* SQLITE_WRAPPERS_ROWS_HPP */
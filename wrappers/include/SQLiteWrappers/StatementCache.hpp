@@ -0,0 +1,253 @@
+#ifndef SQLITE_WRAPPERS_STATEMENT_CACHE_HPP
+#define SQLITE_WRAPPERS_STATEMENT_CACHE_HPP
+
+/**
+ * @file StatementCache.hpp
+ *
+ * This module declares the SQLiteWrappers::StatementCache class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include "Wrappers.hpp"
+
+#include <memory>
+#include <stddef.h>
+#include <string>
+
+namespace SQLiteWrappers {
+
+    // Forward declarations
+    class CachedStatement;
+    class Profiler;
+
+    /**
+     * This holds prepared statements for one database connection, keyed by
+     * their SQL text, so that frequently-executed statements are compiled
+     * only once.  When the cache is full, the least recently used statement
+     * is finalized to make room.
+     *
+     * @note
+     *     Like the connection itself, a cache should only be used by one
+     *     thread at a time.  The connection must outlive the cache, and
+     *     every statement borrowed from the cache must be released before
+     *     the cache is destroyed.
+     */
+    class StatementCache {
+        // Types
+    public:
+        /**
+         * This holds counters which describe how effective the cache has
+         * been at avoiding statement compilation.
+         */
+        struct Statistics {
+            /**
+             * This is the number of times a statement was found in
+             * the cache.
+             */
+            size_t hits = 0;
+
+            /**
+             * This is the number of times a statement had to be compiled
+             * because it wasn't found in the cache.
+             */
+            size_t misses = 0;
+
+            /**
+             * This is the number of statements finalized to make room
+             * for others.
+             */
+            size_t evictions = 0;
+        };
+
+        /**
+         * This is the number of statements held by a cache unless
+         * a different capacity is given when the cache is constructed.
+         */
+        static constexpr size_t DEFAULT_CAPACITY = 32;
+
+        // Lifecycle Methods
+    public:
+        ~StatementCache() noexcept;
+        StatementCache(const StatementCache&) = delete;
+        StatementCache(StatementCache&&) noexcept;
+        StatementCache& operator=(const StatementCache&) = delete;
+        StatementCache& operator=(StatementCache&&) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * This is the constructor.
+         *
+         * @param[in] db
+         *     This is the database connection for which to prepare
+         *     statements.  The connection must outlive the cache, but
+         *     the handle which owns it may be moved.
+         *
+         * @param[in] capacity
+         *     This is the maximum number of idle statements to hold.
+         */
+        explicit StatementCache(
+            const DatabaseConnection& db,
+            size_t capacity = DEFAULT_CAPACITY
+        );
+
+        /**
+         * Borrow a prepared statement for the given SQL text, compiling
+         * it only if no idle statement for the same text is being held.
+         *
+         * @param[in] sql
+         *     This is the SQL text of the statement to borrow.
+         *
+         * @return
+         *     The borrowed statement is returned.  It's handed back to the
+         *     cache when destroyed.  It converts to false if the SQL text
+         *     could not be compiled, or if the cache has been moved from.
+         */
+        CachedStatement Acquire(const std::string& sql);
+
+        /**
+         * Compile statements through the given profiler from now on,
+         * so that it measures how long each compilation takes.
+         *
+         * @param[in] profiler
+         *     This is the profiler to use, which must be profiling the
+         *     cache's connection and must outlive the cache, or nullptr
+         *     to stop using a profiler.
+         */
+        void SetProfiler(Profiler* profiler);
+
+        /**
+         * Finalize all idle statements held by the cache.
+         */
+        void Clear();
+
+        /**
+         * Return the number of idle statements held by the cache.
+         *
+         * @return
+         *     The number of idle statements held by the cache is returned.
+         */
+        size_t GetSize() const;
+
+        /**
+         * Return counters which describe how effective the cache has been.
+         *
+         * @return
+         *     Counters which describe how effective the cache has been
+         *     are returned.
+         */
+        Statistics GetStatistics() const;
+
+        // Private properties
+    private:
+        /**
+         * This is the type of structure that contains the private
+         * properties of the instance.  It is defined in the implementation
+         * and declared here to ensure that it is scoped inside the class.
+         */
+        struct Impl;
+
+        /**
+         * This contains the private properties of the instance.
+         */
+        std::unique_ptr< Impl > impl_;
+
+        friend class CachedStatement;
+    };
+
+    /**
+     * This is a prepared statement borrowed from a StatementCache.
+     *
+     * When the object is destroyed, the statement is reset, its parameter
+     * bindings are cleared, and it's handed back to the cache so that the
+     * next request for the same SQL text can reuse it instead of compiling
+     * it again.
+     */
+    class CachedStatement {
+        // Lifecycle Methods
+    public:
+        ~CachedStatement() noexcept;
+        CachedStatement(const CachedStatement&) = delete;
+        CachedStatement(CachedStatement&& other) noexcept;
+        CachedStatement& operator=(const CachedStatement&) = delete;
+        CachedStatement& operator=(CachedStatement&& other) noexcept;
+
+        // Public Methods
+    public:
+        /**
+         * Return the borrowed prepared statement.
+         *
+         * @return
+         *     The borrowed prepared statement is returned.
+         */
+        const PreparedStatement& Get() const;
+
+        /**
+         * This allows the borrowed statement to be passed directly to any
+         * of the wrapper functions which operate on a PreparedStatement.
+         *
+         * @return
+         *     The borrowed prepared statement is returned.
+         */
+        operator const PreparedStatement&() const;
+
+        /**
+         * Indicate whether or not a statement was successfully borrowed.
+         *
+         * @return
+         *     An indication of whether or not the SQL text compiled into
+         *     a valid prepared statement is returned.
+         */
+        explicit operator bool() const;
+
+        // Private Methods
+    private:
+        friend class StatementCache;
+
+        /**
+         * This constructor is used by the cache to lend out a statement.
+         *
+         * @param[in] owner
+         *     This is the internal state of the cache to which the
+         *     statement should be returned.
+         *
+         * @param[in] sql
+         *     This is the SQL text from which the statement was compiled.
+         *
+         * @param[in] stmt
+         *     This is the prepared statement being lent out.
+         */
+        CachedStatement(
+            StatementCache::Impl* owner,
+            std::string&& sql,
+            PreparedStatement&& stmt
+        );
+
+        /**
+         * Hand the borrowed statement back to the cache, if any.
+         */
+        void Release();
+
+        // Private Properties
+    private:
+        /**
+         * This is the internal state of the cache to which the statement
+         * should be returned, or nullptr if nothing is borrowed.
+         */
+        StatementCache::Impl* owner_ = nullptr;
+
+        /**
+         * This is the SQL text from which the statement was compiled.
+         */
+        std::string sql_;
+
+        /**
+         * This is the borrowed statement.
+         */
+        PreparedStatement stmt_;
+    };
+
+}
+
+#endif /* SQLITE_WRAPPERS_STATEMENT_CACHE_HPP */
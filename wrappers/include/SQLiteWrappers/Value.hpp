@@ -0,0 +1,130 @@
+#ifndef SQLITE_WRAPPERS_VALUE_HPP
+#define SQLITE_WRAPPERS_VALUE_HPP
+
+/**
+ * @file Value.hpp
+ *
+ * This module declares the SQLiteWrappers::Value type, which holds its own
+ * copy of a value to be bound to a statement parameter later, along with
+ * functions which make values from ordinary C++ types.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <optional>
+#include <sqlite3.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This refers to a range of bytes owned by the caller, to be bound
+     * to a statement parameter as a blob.
+     */
+    struct BlobView {
+        /**
+         * This points to the first byte of the blob.
+         */
+        const void* data = nullptr;
+
+        /**
+         * This is the number of bytes in the blob.
+         */
+        size_t size = 0;
+    };
+
+    /**
+     * This holds a copy of a value of any of the fundamental SQLite
+     * datatypes: NULL, INTEGER, REAL, TEXT, or BLOB.
+     */
+    using Value = std::variant<
+        std::nullptr_t,
+        sqlite3_int64,
+        double,
+        std::string,
+        std::vector< uint8_t >
+    >;
+
+    /**
+     * Make a value holding a copy of the given C++ value.
+     *
+     * @param[in] value
+     *     This is the C++ value to copy.
+     *
+     * @return
+     *     The new value is returned.
+     */
+    inline Value MakeValue(std::nullptr_t) {
+        return nullptr;
+    }
+
+    template< typename T >
+    auto MakeValue(T value) -> typename std::enable_if<
+        std::is_integral< T >::value,
+        Value
+    >::type {
+        return (sqlite3_int64)value;
+    }
+
+    inline Value MakeValue(double value) {
+        return value;
+    }
+
+    inline Value MakeValue(std::string_view value) {
+        return std::string(value);
+    }
+
+    inline Value MakeValue(const std::string& value) {
+        return value;
+    }
+
+    inline Value MakeValue(std::string&& value) {
+        return std::move(value);
+    }
+
+    inline Value MakeValue(const char* value) {
+        if (value == nullptr) {
+            return nullptr;
+        }
+        return std::string(value);
+    }
+
+    inline Value MakeValue(const std::vector< uint8_t >& value) {
+        return value;
+    }
+
+    inline Value MakeValue(std::vector< uint8_t >&& value) {
+        return std::move(value);
+    }
+
+    inline Value MakeValue(BlobView value) {
+        const auto data = (const uint8_t*)value.data;
+        return std::vector< uint8_t >(data, data + value.size);
+    }
+
+    inline Value MakeValue(const Value& value) {
+        return value;
+    }
+
+    inline Value MakeValue(Value&& value) {
+        return std::move(value);
+    }
+
+    template< typename T >
+    Value MakeValue(const std::optional< T >& value) {
+        if (value) {
+            return MakeValue(*value);
+        }
+        return nullptr;
+    }
+
+}
+
+#endif /* SQLITE_WRAPPERS_VALUE_HPP */
@@ -0,0 +1,297 @@
+#ifndef SQLITE_WRAPPERS_WRAPPERS_HPP
+#define SQLITE_WRAPPERS_WRAPPERS_HPP
+
+/**
+ * @file Wrappers.hpp
+ *
+ * This module declares thin C++ wrappers around the SQLite C API, which
+ * manage the lifetimes of database connections and prepared statements,
+ * and smooth over some of the rougher edges of binding parameters,
+ * stepping statements, and fetching columns.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <memory>
+#include <sqlite3.h>
+#include <string>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This closes a database connection.  It's stateless, so a
+     * DatabaseConnection is no bigger than a raw connection pointer, and
+     * closing one is a direct call.
+     */
+    struct CloseDatabase {
+        void operator()(sqlite3* db) const noexcept {
+            (void)sqlite3_close(db);
+        }
+    };
+
+    /**
+     * This finalizes a prepared statement.  It's stateless, so a
+     * PreparedStatement is no bigger than a raw statement pointer, and
+     * finalizing one is a direct call.
+     */
+    struct FinalizeStatement {
+        void operator()(sqlite3_stmt* stmt) const noexcept {
+            (void)sqlite3_finalize(stmt);
+        }
+    };
+
+    /**
+     * This is an open connection to a database.  The connection is closed
+     * when the object is destroyed.
+     */
+    using DatabaseConnection = std::unique_ptr< sqlite3, CloseDatabase >;
+
+    /**
+     * This is a compiled SQL statement.  The statement is finalized when
+     * the object is destroyed.
+     */
+    using PreparedStatement = std::unique_ptr< sqlite3_stmt, FinalizeStatement >;
+
+    /**
+     * This holds the outcome of stepping a prepared statement once.
+     */
+    struct StepStatementResults {
+        /**
+         * This indicates whether or not the statement has run to
+         * completion, meaning there are no more rows to fetch.
+         */
+        bool done = false;
+
+        /**
+         * This indicates whether or not the statement failed.
+         */
+        bool error = false;
+    };
+
+    /**
+     * Open a connection to the database at the given path.
+     *
+     * @param[in] path
+     *     This is the path to the database file to open.
+     *
+     * @return
+     *     The new database connection is returned.
+     *
+     * @retval nullptr
+     *     This is returned if the database could not be opened.
+     */
+    DatabaseConnection OpenDatabase(const std::string& path);
+
+    /**
+     * Open a connection to the database at the given path, with the
+     * given sqlite3_open_v2 flags.
+     *
+     * @param[in] path
+     *     This is the path to the database file to open.
+     *
+     * @param[in] flags
+     *     These are the SQLITE_OPEN_* flags which control how the
+     *     database is opened.
+     *
+     * @return
+     *     The new database connection is returned.
+     *
+     * @retval nullptr
+     *     This is returned if the database could not be opened.
+     */
+    DatabaseConnection OpenDatabase(
+        const std::string& path,
+        int flags
+    );
+
+    /**
+     * Compile the given SQL text into a prepared statement.
+     *
+     * @param[in] db
+     *     This is the database connection for which to prepare
+     *     the statement.
+     *
+     * @param[in] statement
+     *     This is the SQL text to compile.
+     *
+     * @return
+     *     The new prepared statement is returned.
+     *
+     * @retval nullptr
+     *     This is returned if the statement could not be compiled.
+     */
+    PreparedStatement BuildStatement(
+        const DatabaseConnection& db,
+        const std::string& statement
+    );
+
+    /**
+     * Compile the given SQL text into a prepared statement, on a
+     * connection given by its raw pointer, as held by objects which
+     * must not depend on the DatabaseConnection which owns it staying put.
+     *
+     * @param[in] db
+     *     This is the database connection for which to prepare
+     *     the statement.
+     *
+     * @param[in] statement
+     *     This is the SQL text to compile.
+     *
+     * @return
+     *     The new prepared statement is returned.
+     *
+     * @retval nullptr
+     *     This is returned if the statement could not be compiled.
+     */
+    PreparedStatement BuildStatement(
+        sqlite3* db,
+        const std::string& statement
+    );
+
+    /**
+     * Bind an integer value to a parameter of the given statement.
+     *
+     * @param[in] stmt
+     *     This is the statement whose parameter to bind.
+     *
+     * @param[in] index
+     *     This is the one-based index of the parameter to bind.
+     *
+     * @param[in] value
+     *     This is the value to bind to the parameter.
+     */
+    void BindStatementParameter(
+        const PreparedStatement& stmt,
+        int index,
+        int value
+    );
+
+    /**
+     * Bind a text value to a parameter of the given statement.
+     *
+     * @note
+     *     SQLite makes its own copy of the text, so the caller's string
+     *     doesn't need to outlive the binding.
+     *
+     * @param[in] stmt
+     *     This is the statement whose parameter to bind.
+     *
+     * @param[in] index
+     *     This is the one-based index of the parameter to bind.
+     *
+     * @param[in] value
+     *     This is the value to bind to the parameter.
+     */
+    void BindStatementParameter(
+        const PreparedStatement& stmt,
+        int index,
+        const std::string& value
+    );
+
+    /**
+     * Execute the given statement until it either produces the next row
+     * of results, runs to completion, or fails.
+     *
+     * @param[in] stmt
+     *     This is the statement to step.
+     *
+     * @return
+     *     The outcome of stepping the statement is returned.
+     */
+    StepStatementResults StepStatement(const PreparedStatement& stmt);
+
+    /**
+     * Rewind the given statement so that it can be executed again, and
+     * clear any values bound to its parameters.
+     *
+     * @param[in] stmt
+     *     This is the statement to reset.
+     */
+    void ResetStatement(const PreparedStatement& stmt);
+
+    /**
+     * Return the number of columns in each row produced by the
+     * given statement.
+     *
+     * @param[in] stmt
+     *     This is the statement to inspect.
+     *
+     * @return
+     *     The number of columns in each row produced by the statement
+     *     is returned.
+     */
+    int CountColumns(const PreparedStatement& stmt);
+
+    /**
+     * Return the name of a column produced by the given statement.
+     *
+     * @param[in] stmt
+     *     This is the statement to inspect.
+     *
+     * @param[in] index
+     *     This is the zero-based index of the column to inspect.
+     *
+     * @return
+     *     The name of the column is returned.
+     */
+    std::string ColumnName(
+        const PreparedStatement& stmt,
+        int index
+    );
+
+    /**
+     * Fetch a column of the current row of results as an integer.
+     *
+     * @param[in] stmt
+     *     This is the statement from which to fetch the column.
+     *
+     * @param[in] index
+     *     This is the zero-based index of the column to fetch.
+     *
+     * @return
+     *     The value of the column is returned, or zero if it's NULL.
+     */
+    int FetchColumnInt(
+        const PreparedStatement& stmt,
+        int index
+    );
+
+    /**
+     * Fetch a column of the current row of results as text.
+     *
+     * @param[in] stmt
+     *     This is the statement from which to fetch the column.
+     *
+     * @param[in] index
+     *     This is the zero-based index of the column to fetch.
+     *
+     * @return
+     *     The value of the column is returned, or an empty string
+     *     if it's NULL.
+     */
+    std::string FetchColumnString(
+        const PreparedStatement& stmt,
+        int index
+    );
+
+    /**
+     * Determine whether or not a column of the current row of results
+     * is NULL.
+     *
+     * @param[in] stmt
+     *     This is the statement from which to inspect the column.
+     *
+     * @param[in] index
+     *     This is the zero-based index of the column to inspect.
+     *
+     * @return
+     *     An indication of whether or not the column is NULL is returned.
+     */
+    bool IsColumnNull(
+        const PreparedStatement& stmt,
+        int index
+    );
+
+}
+
+#endif /* SQLITE_WRAPPERS_WRAPPERS_HPP */
@@ -0,0 +1,523 @@
+/**
+ * @file BatchWriter.cpp
+ *
+ * This module contains the implementation of the
+ * SQLiteWrappers::BatchWriter class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <algorithm>
+#include <SQLiteWrappers/BatchWriter.hpp>
+
+namespace {
+
+    /**
+     * This is the type of clock used to time transactions.
+     */
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Return the given SQL identifier, quoted so that it can be used
+     * regardless of what characters it contains.
+     *
+     * @param[in] identifier
+     *     This is the identifier to quote.
+     *
+     * @return
+     *     The quoted identifier is returned.
+     */
+    std::string QuoteIdentifier(const std::string& identifier) {
+        std::string quoted("\"");
+        for (const auto c: identifier) {
+            if (c == '"') {
+                quoted += '"';
+            }
+            quoted += c;
+        }
+        quoted += '"';
+        return quoted;
+    }
+
+    /**
+     * Return the SQL text of a statement which inserts the given number
+     * of rows into a table.
+     *
+     * @param[in] table
+     *     This is the name of the table into which to insert rows.
+     *
+     * @param[in] columns
+     *     These are the names of the columns to set in each row.
+     *
+     * @param[in] numRows
+     *     This is the number of rows to insert.
+     *
+     * @return
+     *     The SQL text of the statement is returned.
+     */
+    std::string MakeInsertStatement(
+        const std::string& table,
+        const std::vector< std::string >& columns,
+        size_t numRows
+    ) {
+        std::string row("(");
+        for (size_t i = 0; i < columns.size(); ++i) {
+            row += ((i == 0) ? "?" : ",?");
+        }
+        row += ')';
+        std::string sql = "INSERT INTO " + QuoteIdentifier(table) + " (";
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (i != 0) {
+                sql += ',';
+            }
+            sql += QuoteIdentifier(columns[i]);
+        }
+        sql += ") VALUES ";
+        for (size_t i = 0; i < numRows; ++i) {
+            if (i != 0) {
+                sql += ',';
+            }
+            sql += row;
+        }
+        return sql;
+    }
+
+}
+
+namespace SQLiteWrappers {
+
+    /**
+     * This contains the private properties of a BatchWriter instance.
+     */
+    struct BatchWriter::Impl {
+        // Properties
+
+        /**
+         * This is the database connection through which to write.  The
+         * raw connection is held, rather than the caller's handle, so that
+         * the handle may be moved while the connection stays open.
+         */
+        sqlite3* db;
+
+        /**
+         * These are the settings which control how writes are grouped.
+         */
+        Configuration configuration;
+
+        /**
+         * This is the name of the table into which rows are inserted,
+         * for writers constructed for a table.
+         */
+        std::string table;
+
+        /**
+         * These are the names of the columns set in each row, for writers
+         * constructed for a table.
+         */
+        std::vector< std::string > columns;
+
+        /**
+         * This is the statement used to write one row at a time.
+         */
+        PreparedStatement statement;
+
+        /**
+         * This is the statement used to insert several rows at a time,
+         * if rows are held.
+         */
+        PreparedStatement multiRowStatement;
+
+        /**
+         * This is the statement most recently used to insert fewer rows
+         * than the multi-row statement does, kept because the same number
+         * of rows is usually left over at the end of every transaction.
+         */
+        PreparedStatement partialStatement;
+
+        /**
+         * This is the number of rows partialStatement inserts, or zero
+         * if there isn't one.
+         */
+        size_t partialStatementRows = 0;
+
+        /**
+         * This is used to begin transactions.
+         */
+        PreparedStatement begin;
+
+        /**
+         * This is used to commit transactions.
+         */
+        PreparedStatement commit;
+
+        /**
+         * These are the values of the rows being held until enough rows
+         * are collected to execute the multi-row statement.
+         */
+        std::vector< Value > heldValues;
+
+        /**
+         * This is the number of rows being held.
+         */
+        size_t heldRows = 0;
+
+        /**
+         * This is the number of rows added since the current transaction
+         * began.
+         */
+        size_t rowsInTransaction = 0;
+
+        /**
+         * This is the number of rows written when the current transaction
+         * began, so that rows lost if SQLite rolls it back can be counted
+         * as failed.
+         */
+        size_t rowsBeforeTransaction = 0;
+
+        /**
+         * This indicates whether or not the writer has begun a transaction
+         * which hasn't yet been committed.
+         */
+        bool inTransaction = false;
+
+        /**
+         * This indicates whether or not any rows have been added yet.
+         */
+        bool started = false;
+
+        /**
+         * This is when the first row was added.
+         */
+        Clock::time_point firstRowTime;
+
+        /**
+         * This is when the current transaction began.
+         */
+        Clock::time_point transactionStartTime;
+
+        /**
+         * These are counters which describe the work done by the writer.
+         */
+        Statistics statistics;
+
+        // Methods
+
+        /**
+         * This is the constructor.
+         *
+         * @param[in] db
+         *     This is the database connection through which to write.
+         *
+         * @param[in] configuration
+         *     These are the settings which control how writes are grouped.
+         */
+        Impl(
+            sqlite3* db,
+            const Configuration& configuration
+        )
+            : db(db)
+            , configuration(configuration)
+            , begin(BuildStatement(db, "BEGIN"))
+            , commit(BuildStatement(db, "COMMIT"))
+        {
+        }
+
+        /**
+         * Update the counters which describe the work done by the writer,
+         * to account for one execution of the statement.
+         *
+         * @param[in] success
+         *     This indicates whether or not the statement executed
+         *     successfully.
+         *
+         * @param[in] numRows
+         *     This is the number of rows the statement wrote (or would
+         *     have written).
+         */
+        void CountWrite(bool success, size_t numRows) {
+            ++statistics.statements;
+            if (success) {
+                statistics.rows += numRows;
+            } else {
+                statistics.failedRows += numRows;
+            }
+        }
+
+        /**
+         * Insert all the rows being held.
+         *
+         * @return
+         *     An indication of whether or not the rows were inserted
+         *     successfully is returned.
+         */
+        bool WriteHeldRows() {
+            if (heldRows == 0) {
+                return true;
+            }
+            const PreparedStatement* stmt = &multiRowStatement;
+            if (heldRows == 1) {
+                stmt = &statement;
+            } else if (heldRows < configuration.rowsPerStatement) {
+                if (partialStatementRows != heldRows) {
+                    partialStatement = BuildStatement(
+                        db,
+                        MakeInsertStatement(table, columns, heldRows)
+                    );
+                    partialStatementRows = (
+                        (partialStatement == nullptr)
+                        ? 0
+                        : heldRows
+                    );
+                }
+                stmt = &partialStatement;
+            }
+            bool success = (*stmt != nullptr);
+            if (success) {
+                BindGuard bindings(*stmt);
+                for (size_t i = 0; i < heldValues.size(); ++i) {
+                    bindings.Bind((int)(i + 1), heldValues[i]);
+                }
+                success = !bindings.Step().error;
+            }
+            CountWrite(success, heldRows);
+            heldValues.clear();
+            heldRows = 0;
+            return success;
+        }
+
+        /**
+         * Insert any rows being held, and commit the current transaction,
+         * if any.
+         *
+         * @return
+         *     An indication of whether or not everything was written and
+         *     committed successfully is returned.
+         */
+        bool Commit() {
+            bool success = WriteHeldRows();
+            if (inTransaction) {
+                const auto results = StepStatement(commit);
+                ResetStatement(commit);
+                inTransaction = (sqlite3_get_autocommit(db) == 0);
+                if (results.done) {
+                    ++statistics.commits;
+                    rowsInTransaction = 0;
+                    statistics.seconds = std::chrono::duration< double >(
+                        Clock::now() - firstRowTime
+                    ).count();
+                } else {
+                    success = false;
+
+                    // If SQLite rolled the transaction back, the rows
+                    // written in it are lost.
+                    if (!inTransaction) {
+                        const auto lostRows = statistics.rows - rowsBeforeTransaction;
+                        statistics.rows -= lostRows;
+                        statistics.failedRows += lostRows;
+                        rowsInTransaction = 0;
+                    }
+                }
+            }
+            return success;
+        }
+    };
+
+    double BatchWriter::Statistics::RowsPerSecond() const {
+        if (seconds <= 0.0) {
+            return 0.0;
+        }
+        return (double)rows / seconds;
+    }
+
+    double BatchWriter::Statistics::CommitsPerSecond() const {
+        if (seconds <= 0.0) {
+            return 0.0;
+        }
+        return (double)commits / seconds;
+    }
+
+    BatchWriter::~BatchWriter() noexcept {
+        if (impl_ != nullptr) {
+            (void)Flush();
+        }
+    }
+
+    BatchWriter::BatchWriter(BatchWriter&&) noexcept = default;
+    BatchWriter& BatchWriter::operator=(BatchWriter&& other) noexcept {
+        if (this != &other) {
+            if (impl_ != nullptr) {
+                (void)Flush();
+            }
+            impl_ = std::move(other.impl_);
+        }
+        return *this;
+    }
+
+    BatchWriter::BatchWriter(
+        const DatabaseConnection& db,
+        const std::string& sql
+    )
+        : BatchWriter(db, sql, Configuration())
+    {
+    }
+
+    BatchWriter::BatchWriter(
+        const DatabaseConnection& db,
+        const std::string& sql,
+        const Configuration& configuration
+    )
+        : impl_(new Impl(db.get(), configuration))
+    {
+        impl_->configuration.rowsPerStatement = 1;
+        impl_->statement = BuildStatement(db, sql);
+    }
+
+    BatchWriter::BatchWriter(
+        const DatabaseConnection& db,
+        const std::string& table,
+        const std::vector< std::string >& columns
+    )
+        : BatchWriter(db, table, columns, Configuration())
+    {
+    }
+
+    BatchWriter::BatchWriter(
+        const DatabaseConnection& db,
+        const std::string& table,
+        const std::vector< std::string >& columns,
+        const Configuration& configuration
+    )
+        : impl_(new Impl(db.get(), configuration))
+    {
+        impl_->table = table;
+        impl_->columns = columns;
+        if (columns.empty()) {
+            return;
+        }
+        const auto maxParameters = (size_t)sqlite3_limit(
+            db.get(),
+            SQLITE_LIMIT_VARIABLE_NUMBER,
+            -1
+        );
+        impl_->configuration.rowsPerStatement = std::max(
+            (size_t)1,
+            std::min(
+                configuration.rowsPerStatement,
+                maxParameters / columns.size()
+            )
+        );
+        impl_->statement = BuildStatement(
+            db,
+            MakeInsertStatement(table, columns, 1)
+        );
+        if (impl_->configuration.rowsPerStatement > 1) {
+            impl_->multiRowStatement = BuildStatement(
+                db,
+                MakeInsertStatement(
+                    table,
+                    columns,
+                    impl_->configuration.rowsPerStatement
+                )
+            );
+            impl_->heldValues.reserve(
+                impl_->configuration.rowsPerStatement * columns.size()
+            );
+        }
+    }
+
+    BatchWriter::operator bool() const {
+        return (
+            (impl_ != nullptr)
+            && (impl_->statement != nullptr)
+            && (
+                (impl_->configuration.rowsPerStatement == 1)
+                || (impl_->multiRowStatement != nullptr)
+            )
+            && (impl_->begin != nullptr)
+            && (impl_->commit != nullptr)
+        );
+    }
+
+    bool BatchWriter::Flush() {
+        if (impl_ == nullptr) {
+            return false;
+        }
+        return impl_->Commit();
+    }
+
+    auto BatchWriter::GetStatistics() const -> Statistics {
+        if (impl_ == nullptr) {
+            return Statistics();
+        }
+        return impl_->statistics;
+    }
+
+    bool BatchWriter::BeginRow() {
+        if (!*this) {
+            return false;
+        }
+        const auto now = Clock::now();
+        if (!impl_->started) {
+            impl_->started = true;
+            impl_->firstRowTime = now;
+        }
+        if (!impl_->inTransaction) {
+            const auto results = StepStatement(impl_->begin);
+            ResetStatement(impl_->begin);
+            if (results.error) {
+                return false;
+            }
+            impl_->inTransaction = true;
+            impl_->transactionStartTime = now;
+            impl_->rowsBeforeTransaction = impl_->statistics.rows;
+        }
+        return true;
+    }
+
+    bool BatchWriter::IsHoldingRows() const {
+        return (impl_->configuration.rowsPerStatement > 1);
+    }
+
+    bool BatchWriter::HoldRow(std::vector< Value >&& values) {
+        if (values.size() != impl_->columns.size()) {
+            CountWrite(false, 1);
+            return false;
+        }
+        for (auto& value: values) {
+            impl_->heldValues.push_back(std::move(value));
+        }
+        if (++impl_->heldRows < impl_->configuration.rowsPerStatement) {
+            return true;
+        }
+        return impl_->WriteHeldRows();
+    }
+
+    const PreparedStatement& BatchWriter::GetStatement() const {
+        return impl_->statement;
+    }
+
+    void BatchWriter::CountWrite(bool success, size_t numRows) {
+        impl_->CountWrite(success, numRows);
+    }
+
+    bool BatchWriter::EndRow(bool success) {
+        ++impl_->rowsInTransaction;
+        const auto& configuration = impl_->configuration;
+        if (
+            (impl_->rowsInTransaction >= configuration.rowsPerTransaction)
+            || (
+                (configuration.transactionTimeBudget.count() > 0)
+                && (
+                    Clock::now() - impl_->transactionStartTime
+                    >= configuration.transactionTimeBudget
+                )
+            )
+        ) {
+            if (!impl_->Commit()) {
+                success = false;
+            }
+        }
+        return success;
+    }
+
+}
@@ -0,0 +1,96 @@
+/**
+ * @file BindGuard.cpp
+ *
+ * This module contains the implementation of the SQLiteWrappers::BindGuard
+ * class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <SQLiteWrappers/BindGuard.hpp>
+
+namespace SQLiteWrappers {
+
+    BindGuard::~BindGuard() noexcept {
+        ResetStatement(stmt_);
+    }
+
+    BindGuard::BindGuard(const PreparedStatement& stmt)
+        : stmt_(stmt)
+    {
+    }
+
+    BindGuard& BindGuard::BindNull(int index) {
+        (void)sqlite3_bind_null(stmt_.get(), index);
+        return *this;
+    }
+
+    BindGuard& BindGuard::Bind(int index, double value) {
+        (void)sqlite3_bind_double(stmt_.get(), index, value);
+        return *this;
+    }
+
+    BindGuard& BindGuard::Bind(int index, std::string_view value) {
+        (void)sqlite3_bind_text(
+            stmt_.get(),
+            index,
+            // An empty view may have no data, which would bind NULL.
+            (value.data() == nullptr) ? "" : value.data(),
+            (int)value.length(),
+            SQLITE_STATIC
+        );
+        return *this;
+    }
+
+    BindGuard& BindGuard::Bind(int index, const std::string& value) {
+        return Bind(index, std::string_view(value));
+    }
+
+    BindGuard& BindGuard::Bind(int index, const char* value) {
+        if (value == nullptr) {
+            return BindNull(index);
+        }
+        return Bind(index, std::string_view(value));
+    }
+
+    BindGuard& BindGuard::Bind(int index, BlobView value) {
+        (void)sqlite3_bind_blob(
+            stmt_.get(),
+            index,
+            // An empty blob may have no data, which would bind NULL.
+            (value.data == nullptr) ? (const void*)"" : value.data,
+            (int)value.size,
+            SQLITE_STATIC
+        );
+        return *this;
+    }
+
+    BindGuard& BindGuard::Bind(int index, const std::vector< uint8_t >& value) {
+        return Bind(index, BlobView{value.data(), value.size()});
+    }
+
+    BindGuard& BindGuard::Bind(int index, const Value& value) {
+        if (const auto integer = std::get_if< sqlite3_int64 >(&value)) {
+            return Bind(index, *integer);
+        } else if (const auto real = std::get_if< double >(&value)) {
+            return Bind(index, *real);
+        } else if (const auto text = std::get_if< std::string >(&value)) {
+            return Bind(index, *text);
+        } else if (const auto blob = std::get_if< std::vector< uint8_t > >(&value)) {
+            return Bind(index, *blob);
+        } else {
+            return BindNull(index);
+        }
+    }
+
+#if defined(__cpp_lib_span)
+    BindGuard& BindGuard::Bind(int index, std::span< const uint8_t > value) {
+        return Bind(index, BlobView{value.data(), value.size()});
+    }
+#endif
+
+    StepStatementResults BindGuard::Step() {
+        return StepStatement(stmt_);
+    }
+
+}
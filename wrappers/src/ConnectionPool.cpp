@@ -0,0 +1,543 @@
+/**
+ * @file ConnectionPool.cpp
+ *
+ * This module contains the implementation of the
+ * SQLiteWrappers::ConnectionPool class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <SQLiteWrappers/BindGuard.hpp>
+#include <SQLiteWrappers/ConnectionPool.hpp>
+#include <thread>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This is where threads sleep while every reader of a pool is checked
+     * out, until one is returned.
+     */
+    struct ReaderReturns {
+        /**
+         * This is used to synchronize the waiting threads with the threads
+         * returning readers.
+         */
+        std::mutex mutex;
+
+        /**
+         * This is used to wake a waiting thread when a reader is returned.
+         */
+        std::condition_variable returned;
+
+        /**
+         * This is the number of threads waiting, so that threads returning
+         * readers don't need the mutex when none are.
+         */
+        std::atomic< size_t > waiting{0};
+    };
+
+    /**
+     * This holds one of the pool's read-only connections.  Each slot is
+     * aligned to its own cache line, so that threads checking out readers
+     * from different slots don't slow each other down.
+     */
+    struct alignas(64) ConnectionPool::Reader::Slot {
+        /**
+         * This indicates whether or not the connection is checked out.
+         */
+        std::atomic< bool > checkedOut{false};
+
+        /**
+         * This is the read-only connection.
+         */
+        DatabaseConnection db;
+
+        /**
+         * This holds prepared statements for the connection.
+         */
+        std::unique_ptr< StatementCache > statements;
+
+        /**
+         * This is where threads wait for the pool's readers to be returned.
+         */
+        ReaderReturns* returns = nullptr;
+    };
+
+    /**
+     * This holds a write job waiting to be performed by the writer thread.
+     */
+    struct PendingWrite {
+        /**
+         * This is the function which performs the write job.
+         */
+        ConnectionPool::WriteJob job;
+
+        /**
+         * This is used to deliver the outcome of the write job.
+         */
+        std::promise< bool > result;
+    };
+
+    /**
+     * This contains the private properties of a ConnectionPool instance.
+     */
+    struct ConnectionPool::Impl {
+        // Properties
+
+        /**
+         * This is the connection used for all writes.
+         */
+        DatabaseConnection writer;
+
+        /**
+         * This holds prepared statements for the writer connection.
+         */
+        std::unique_ptr< StatementCache > writerStatements;
+
+        /**
+         * These hold the read-only connections.
+         */
+        std::unique_ptr< Reader::Slot[] > readers;
+
+        /**
+         * This is the number of read-only connections.
+         */
+        size_t numReaders = 0;
+
+        /**
+         * This is where threads wait when every reader is checked out.
+         */
+        ReaderReturns readerReturns;
+
+        /**
+         * This indicates whether or not all connections were opened and
+         * the database was put into WAL mode.
+         */
+        bool ready = false;
+
+        /**
+         * This is used to synchronize access to the write queue.
+         */
+        std::mutex mutex;
+
+        /**
+         * This is used to wake the writer thread when a job is queued
+         * or when the pool is being destroyed.
+         */
+        std::condition_variable wakeCondition;
+
+        /**
+         * These are the write jobs waiting to be performed.
+         */
+        std::deque< PendingWrite > writeQueue;
+
+        /**
+         * This indicates whether or not the writer performs all the write
+         * jobs waiting in its queue within a single transaction.
+         */
+        bool groupCommit = false;
+
+        /**
+         * This indicates whether or not the writer thread should stop
+         * once the write queue is empty.
+         */
+        bool stopWriter = false;
+
+        /**
+         * This is the thread which performs write jobs.
+         */
+        std::thread writerThread;
+
+        // Methods
+
+        /**
+         * Open the pool's connections and start the writer thread.
+         *
+         * @param[in] path
+         *     This is the path to the database file to open.
+         *
+         * @param[in] configuration
+         *     These are the settings which control how the pool is set up.
+         */
+        void Open(
+            const std::string& path,
+            const Configuration& configuration
+        ) {
+            // The writer is opened first, since it needs to create the
+            // database (if necessary) and switch it to WAL mode, which
+            // read-only connections aren't allowed to do.
+            writer = OpenDatabase(
+                path,
+                SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX
+            );
+            if (writer == nullptr) {
+                return;
+            }
+            (void)sqlite3_busy_timeout(
+                writer.get(),
+                configuration.busyTimeoutMilliseconds
+            );
+            const auto journalMode = BuildStatement(writer, "PRAGMA journal_mode=WAL");
+            if (
+                (journalMode == nullptr)
+                || StepStatement(journalMode).error
+                || (FetchColumnString(journalMode, 0) != "wal")
+            ) {
+                return;
+            }
+            writerStatements.reset(
+                new StatementCache(
+                    writer,
+                    configuration.statementCacheCapacity
+                )
+            );
+
+            // The readers don't need SQLite's own mutexes, because each is
+            // only used by the one thread which has it checked out.
+            numReaders = std::max((size_t)1, configuration.numReaders);
+            readers.reset(new Reader::Slot[numReaders]);
+            for (size_t i = 0; i < numReaders; ++i) {
+                auto& slot = readers[i];
+                slot.db = OpenDatabase(
+                    path,
+                    SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX
+                );
+                if (slot.db == nullptr) {
+                    return;
+                }
+                (void)sqlite3_busy_timeout(
+                    slot.db.get(),
+                    configuration.busyTimeoutMilliseconds
+                );
+                slot.statements.reset(
+                    new StatementCache(
+                        slot.db,
+                        configuration.statementCacheCapacity
+                    )
+                );
+                slot.returns = &readerReturns;
+            }
+            groupCommit = configuration.groupCommit;
+            writerThread = std::thread(&Impl::Writer, this);
+            ready = true;
+        }
+
+        /**
+         * Check out a reader which isn't checked out, if there is one,
+         * without waiting.
+         *
+         * @return
+         *     The slot of the reader checked out is returned.
+         *
+         * @retval nullptr
+         *     This is returned if every reader is checked out.
+         */
+        Reader::Slot* TryCheckOutReader() {
+            const auto start = (
+                std::hash< std::thread::id >()(std::this_thread::get_id())
+                % numReaders
+            );
+            for (size_t i = 0; i < numReaders; ++i) {
+                auto& slot = readers[(start + i) % numReaders];
+                if (
+                    !slot.checkedOut.load()
+                    && !slot.checkedOut.exchange(true)
+                ) {
+                    return &slot;
+                }
+            }
+            return nullptr;
+        }
+
+        /**
+         * This is the body of the writer thread, which performs write jobs
+         * until told to stop.
+         */
+        void Writer() {
+            std::unique_lock< decltype(mutex) > lock(mutex);
+            for (;;) {
+                wakeCondition.wait(
+                    lock,
+                    [this]{
+                        return (
+                            stopWriter
+                            || !writeQueue.empty()
+                        );
+                    }
+                );
+                if (writeQueue.empty()) {
+                    break;
+                }
+                std::deque< PendingWrite > batch;
+                if (groupCommit) {
+                    batch.swap(writeQueue);
+                } else {
+                    batch.push_back(std::move(writeQueue.front()));
+                    writeQueue.pop_front();
+                }
+                lock.unlock();
+                PerformWrites(batch);
+                lock.lock();
+            }
+        }
+
+        /**
+         * Perform the given write jobs, in order.  If there is more than
+         * one, they're performed within a single transaction, and none of
+         * them is reported as successful until the transaction commits.
+         * If a job throws an exception, it's delivered through the futures
+         * of all the jobs in the transaction, which is rolled back.
+         *
+         * @param[in,out] batch
+         *     These are the write jobs to perform.
+         */
+        void PerformWrites(std::deque< PendingWrite >& batch) {
+            if (batch.size() == 1) {
+                auto& write = batch.front();
+                try {
+                    write.result.set_value(write.job(writer, *writerStatements));
+                } catch (...) {
+                    write.result.set_exception(std::current_exception());
+                }
+                return;
+            }
+            std::vector< bool > results;
+            results.reserve(batch.size());
+            const auto begin = writerStatements->Acquire("BEGIN");
+            bool inTransaction = !StepStatement(begin).error;
+            try {
+                for (auto& write: batch) {
+                    results.push_back(write.job(writer, *writerStatements));
+
+                    // Some errors roll back the whole transaction, taking
+                    // the earlier jobs with it.  If that happens, start over
+                    // with a new transaction for the remaining jobs.
+                    if (
+                        inTransaction
+                        && (sqlite3_get_autocommit(writer.get()) != 0)
+                    ) {
+                        results.assign(results.size(), false);
+                        ResetStatement(begin);
+                        inTransaction = !StepStatement(begin).error;
+                    }
+                }
+            } catch (...) {
+                // A job which throws may leave its writes half done, so
+                // the whole transaction is rolled back, and every job in
+                // the batch gets the exception rather than a result.
+                const auto exception = std::current_exception();
+                if (sqlite3_get_autocommit(writer.get()) == 0) {
+                    const auto rollback = writerStatements->Acquire("ROLLBACK");
+                    (void)StepStatement(rollback);
+                }
+                for (auto& write: batch) {
+                    write.result.set_exception(exception);
+                }
+                return;
+            }
+            if (inTransaction) {
+                const auto commit = writerStatements->Acquire("COMMIT");
+                if (StepStatement(commit).error) {
+                    results.assign(results.size(), false);
+                    const auto rollback = writerStatements->Acquire("ROLLBACK");
+                    (void)StepStatement(rollback);
+                }
+            }
+            for (size_t i = 0; i < batch.size(); ++i) {
+                batch[i].result.set_value(results[i]);
+            }
+        }
+
+        /**
+         * Stop the writer thread, after it performs all queued write jobs.
+         */
+        void Close() {
+            if (!writerThread.joinable()) {
+                return;
+            }
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                stopWriter = true;
+                wakeCondition.notify_all();
+            }
+            writerThread.join();
+        }
+    };
+
+    ConnectionPool::Reader::~Reader() noexcept {
+        Release();
+    }
+
+    ConnectionPool::Reader::Reader(Reader&& other) noexcept
+        : slot_(other.slot_)
+    {
+        other.slot_ = nullptr;
+    }
+
+    auto ConnectionPool::Reader::operator=(Reader&& other) noexcept -> Reader& {
+        if (this != &other) {
+            Release();
+            slot_ = other.slot_;
+            other.slot_ = nullptr;
+        }
+        return *this;
+    }
+
+    ConnectionPool::Reader::Reader(Slot* slot)
+        : slot_(slot)
+    {
+    }
+
+    const DatabaseConnection& ConnectionPool::Reader::GetConnection() const {
+        return slot_->db;
+    }
+
+    StatementCache& ConnectionPool::Reader::GetStatements() const {
+        return *slot_->statements;
+    }
+
+    ConnectionPool::Reader::operator bool() const {
+        return (slot_ != nullptr);
+    }
+
+    void ConnectionPool::Reader::Release() {
+        if (slot_ != nullptr) {
+            // Both this store and the load of the count of waiting threads
+            // are sequentially consistent, so that either this thread sees
+            // a thread which started waiting, or that thread sees the slot
+            // returned.
+            const auto returns = slot_->returns;
+            slot_->checkedOut.store(false);
+            slot_ = nullptr;
+            if (returns->waiting.load() > 0) {
+                std::lock_guard< decltype(returns->mutex) > lock(returns->mutex);
+                returns->returned.notify_one();
+            }
+        }
+    }
+
+    ConnectionPool::~ConnectionPool() noexcept {
+        if (impl_ != nullptr) {
+            impl_->Close();
+        }
+    }
+
+    ConnectionPool::ConnectionPool(ConnectionPool&&) noexcept = default;
+    ConnectionPool& ConnectionPool::operator=(ConnectionPool&& other) noexcept {
+        if (this != &other) {
+            if (impl_ != nullptr) {
+                impl_->Close();
+            }
+            impl_ = std::move(other.impl_);
+        }
+        return *this;
+    }
+
+    ConnectionPool::ConnectionPool(const std::string& path)
+        : ConnectionPool(path, Configuration())
+    {
+    }
+
+    ConnectionPool::ConnectionPool(
+        const std::string& path,
+        const Configuration& configuration
+    )
+        : impl_(new Impl())
+    {
+        impl_->Open(path, configuration);
+    }
+
+    ConnectionPool::operator bool() const {
+        return (
+            (impl_ != nullptr)
+            && impl_->ready
+        );
+    }
+
+    auto ConnectionPool::CheckOutReader() -> Reader {
+        return CheckOutReader(-1);
+    }
+
+    auto ConnectionPool::CheckOutReader(int timeoutMilliseconds) -> Reader {
+        if (!*this) {
+            return Reader(nullptr);
+        }
+        auto slot = impl_->TryCheckOutReader();
+        if (slot != nullptr) {
+            return Reader(slot);
+        }
+
+        // Every reader is checked out, so sleep until one is returned.
+        auto& returns = impl_->readerReturns;
+        const auto deadline = (
+            std::chrono::steady_clock::now()
+            + std::chrono::milliseconds(timeoutMilliseconds)
+        );
+        std::unique_lock< decltype(returns.mutex) > lock(returns.mutex);
+        ++returns.waiting;
+        for (;;) {
+            slot = impl_->TryCheckOutReader();
+            if (slot != nullptr) {
+                break;
+            }
+            if (timeoutMilliseconds < 0) {
+                returns.returned.wait(lock);
+            } else if (
+                returns.returned.wait_until(lock, deadline)
+                == std::cv_status::timeout
+            ) {
+                // This thread may have been woken for a reader just as the
+                // wait timed out, so look one last time.
+                slot = impl_->TryCheckOutReader();
+                break;
+            }
+        }
+        --returns.waiting;
+        return Reader(slot);
+    }
+
+    std::future< bool > ConnectionPool::Write(WriteJob job) {
+        if (!*this) {
+            std::promise< bool > failure;
+            failure.set_value(false);
+            return failure.get_future();
+        }
+        PendingWrite write;
+        write.job = std::move(job);
+        auto result = write.result.get_future();
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->writeQueue.push_back(std::move(write));
+        impl_->wakeCondition.notify_one();
+        return result;
+    }
+
+    std::future< bool > ConnectionPool::Write(
+        const std::string& sql,
+        std::vector< Value >&& values
+    ) {
+        return Write(
+            [sql, values = std::move(values)](
+                const DatabaseConnection&,
+                StatementCache& statements
+            ){
+                const auto stmt = statements.Acquire(sql);
+                if (!stmt) {
+                    return false;
+                }
+                BindGuard bindings(stmt);
+                for (size_t i = 0; i < values.size(); ++i) {
+                    bindings.Bind((int)(i + 1), values[i]);
+                }
+                return !bindings.Step().error;
+            }
+        );
+    }
+
+}
@@ -0,0 +1,193 @@
+/**
+ * @file Executor.cpp
+ *
+ * This module contains the implementation of the SQLiteWrappers::Executor
+ * class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <SQLiteWrappers/Executor.hpp>
+#include <thread>
+
+namespace SQLiteWrappers {
+
+    /**
+     * This contains the private properties of an Executor instance.
+     */
+    struct Executor::Impl {
+        // Properties
+
+        /**
+         * This holds the connections used to execute statements.
+         */
+        std::unique_ptr< ConnectionPool > pool;
+
+        /**
+         * This is used to synchronize access to the read queue.
+         */
+        std::mutex mutex;
+
+        /**
+         * This is used to wake the worker threads when a job is queued
+         * or when the executor is being destroyed.
+         */
+        std::condition_variable wakeCondition;
+
+        /**
+         * These are the read jobs waiting to be performed.
+         */
+        std::deque< ReadJob > readQueue;
+
+        /**
+         * This indicates whether or not the worker threads should stop
+         * once the read queue is empty.
+         */
+        bool stopWorkers = false;
+
+        /**
+         * These are the threads which perform read jobs.
+         */
+        std::vector< std::thread > workers;
+
+        // Methods
+
+        /**
+         * This is the body of each worker thread, which performs read jobs
+         * until told to stop.
+         */
+        void Worker() {
+            std::unique_lock< decltype(mutex) > lock(mutex);
+            for (;;) {
+                wakeCondition.wait(
+                    lock,
+                    [this]{
+                        return (
+                            stopWorkers
+                            || !readQueue.empty()
+                        );
+                    }
+                );
+                if (readQueue.empty()) {
+                    break;
+                }
+                auto job = std::move(readQueue.front());
+                readQueue.pop_front();
+                lock.unlock();
+                {
+                    // An exception thrown by the job must not escape the
+                    // thread, or it would end the program.
+                    const auto reader = pool->CheckOutReader();
+                    try {
+                        job(reader.GetConnection(), reader.GetStatements());
+                    } catch (...) {
+                    }
+                }
+                lock.lock();
+            }
+        }
+
+        /**
+         * Stop the worker threads, after they perform all queued read jobs.
+         */
+        void Close() {
+            {
+                std::lock_guard< decltype(mutex) > lock(mutex);
+                stopWorkers = true;
+                wakeCondition.notify_all();
+            }
+            for (auto& worker: workers) {
+                worker.join();
+            }
+            workers.clear();
+        }
+    };
+
+    Executor::~Executor() noexcept {
+        if (impl_ != nullptr) {
+            impl_->Close();
+        }
+    }
+
+    Executor::Executor(Executor&&) noexcept = default;
+    Executor& Executor::operator=(Executor&& other) noexcept {
+        if (this != &other) {
+            if (impl_ != nullptr) {
+                impl_->Close();
+            }
+            impl_ = std::move(other.impl_);
+        }
+        return *this;
+    }
+
+    Executor::Executor(const std::string& path)
+        : Executor(path, Configuration())
+    {
+    }
+
+    Executor::Executor(
+        const std::string& path,
+        const Configuration& configuration
+    )
+        : impl_(new Impl())
+    {
+        ConnectionPool::Configuration poolConfiguration;
+        poolConfiguration.numReaders = std::max(
+            (size_t)1,
+            configuration.numReaderThreads
+        );
+        poolConfiguration.statementCacheCapacity = configuration.statementCacheCapacity;
+        poolConfiguration.busyTimeoutMilliseconds = configuration.busyTimeoutMilliseconds;
+        poolConfiguration.groupCommit = true;
+        impl_->pool.reset(new ConnectionPool(path, poolConfiguration));
+        if (!*impl_->pool) {
+            return;
+        }
+        for (size_t i = 0; i < poolConfiguration.numReaders; ++i) {
+            impl_->workers.emplace_back(&Impl::Worker, impl_.get());
+        }
+    }
+
+    Executor::operator bool() const {
+        return (
+            (impl_ != nullptr)
+            && (bool)*impl_->pool
+        );
+    }
+
+    void Executor::Read(ReadJob job) {
+        if (!*this) {
+            return;
+        }
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->readQueue.push_back(std::move(job));
+        impl_->wakeCondition.notify_one();
+    }
+
+    std::future< bool > Executor::Execute(
+        const std::string& sql,
+        std::vector< Value >&& values
+    ) {
+        if (impl_ == nullptr) {
+            std::promise< bool > failure;
+            failure.set_value(false);
+            return failure.get_future();
+        }
+        return impl_->pool->Write(sql, std::move(values));
+    }
+
+    std::future< bool > Executor::Execute(ConnectionPool::WriteJob job) {
+        if (impl_ == nullptr) {
+            std::promise< bool > failure;
+            failure.set_value(false);
+            return failure.get_future();
+        }
+        return impl_->pool->Write(std::move(job));
+    }
+
+}
@@ -0,0 +1,155 @@
+/**
+ * @file LatencyHistogram.cpp
+ *
+ * This module contains the implementation of the
+ * SQLiteWrappers::LatencyHistogram class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <algorithm>
+#include <math.h>
+#include <SQLiteWrappers/LatencyHistogram.hpp>
+
+namespace {
+
+    /**
+     * Return the position of the most significant bit set in the given
+     * value.
+     *
+     * @param[in] value
+     *     This is the value to examine.  It must not be zero.
+     *
+     * @return
+     *     The zero-based position of the most significant bit set in the
+     *     value is returned.
+     */
+    unsigned int FindLeadingBit(uint64_t value) {
+        unsigned int position = 0;
+        for (unsigned int width = 32; width > 0; width /= 2) {
+            if ((value >> width) != 0) {
+                value >>= width;
+                position += width;
+            }
+        }
+        return position;
+    }
+
+}
+
+namespace SQLiteWrappers {
+
+    void LatencyHistogram::Record(uint64_t nanoseconds) {
+        const auto index = GetBucketIndex(nanoseconds);
+        if (index >= buckets_.size()) {
+            buckets_.resize(index + 1);
+        }
+        ++buckets_[index];
+        if (
+            (count_ == 0)
+            || (nanoseconds < min_)
+        ) {
+            min_ = nanoseconds;
+        }
+        max_ = std::max(max_, nanoseconds);
+        total_ += nanoseconds;
+        ++count_;
+    }
+
+    void LatencyHistogram::Merge(const LatencyHistogram& other) {
+        if (other.count_ == 0) {
+            return;
+        }
+        if (other.buckets_.size() > buckets_.size()) {
+            buckets_.resize(other.buckets_.size());
+        }
+        for (size_t i = 0; i < other.buckets_.size(); ++i) {
+            buckets_[i] += other.buckets_[i];
+        }
+        if (
+            (count_ == 0)
+            || (other.min_ < min_)
+        ) {
+            min_ = other.min_;
+        }
+        max_ = std::max(max_, other.max_);
+        total_ += other.total_;
+        count_ += other.count_;
+    }
+
+    void LatencyHistogram::Reset() {
+        buckets_.clear();
+        count_ = 0;
+        min_ = 0;
+        max_ = 0;
+        total_ = 0;
+    }
+
+    uint64_t LatencyHistogram::GetCount() const {
+        return count_;
+    }
+
+    uint64_t LatencyHistogram::GetMin() const {
+        return min_;
+    }
+
+    uint64_t LatencyHistogram::GetMax() const {
+        return max_;
+    }
+
+    uint64_t LatencyHistogram::GetTotal() const {
+        return total_;
+    }
+
+    double LatencyHistogram::GetMean() const {
+        if (count_ == 0) {
+            return 0.0;
+        }
+        return (double)total_ / (double)count_;
+    }
+
+    uint64_t LatencyHistogram::GetValueAtPercentile(double percentile) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        const auto fraction = std::min(std::max(percentile, 0.0), 100.0) / 100.0;
+        const auto rank = std::max(
+            (uint64_t)1,
+            (uint64_t)ceil(fraction * (double)count_)
+        );
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            seen += buckets_[i];
+            if (seen >= rank) {
+                return std::min(
+                    std::max(GetBucketUpperBound(i), min_),
+                    max_
+                );
+            }
+        }
+        return max_;
+    }
+
+    size_t LatencyHistogram::GetBucketIndex(uint64_t nanoseconds) {
+        // Durations below SUB_BUCKET_COUNT each get their own bucket.
+        // Above that, the leading one bit picks the power of two, and
+        // the SUB_BUCKET_BITS bits after it pick the sub-bucket.
+        if (nanoseconds < SUB_BUCKET_COUNT) {
+            return (size_t)nanoseconds;
+        }
+        const auto leadingBit = FindLeadingBit(nanoseconds);
+        const auto shift = leadingBit - SUB_BUCKET_BITS;
+        const auto subBucket = (nanoseconds >> shift) & (SUB_BUCKET_COUNT - 1);
+        return (size_t)((shift + 1) * SUB_BUCKET_COUNT + subBucket);
+    }
+
+    uint64_t LatencyHistogram::GetBucketUpperBound(size_t index) {
+        if (index < SUB_BUCKET_COUNT) {
+            return (uint64_t)index;
+        }
+        const auto shift = (unsigned int)(index / SUB_BUCKET_COUNT - 1);
+        const auto subBucket = (uint64_t)(index % SUB_BUCKET_COUNT);
+        return ((SUB_BUCKET_COUNT + subBucket + 1) << shift) - 1;
+    }
+
+}
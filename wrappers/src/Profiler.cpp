@@ -0,0 +1,437 @@
+/**
+ * @file Profiler.cpp
+ *
+ * This module contains the implementation of the SQLiteWrappers::Profiler
+ * class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <sqlite3.h>
+#include <SQLiteWrappers/Profiler.hpp>
+#include <stdio.h>
+#include <unordered_map>
+
+namespace {
+
+    /**
+     * This is the clock used to time statements.
+     */
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * This holds what is known about a statement which is currently
+     * being run.
+     */
+    struct Run {
+        /**
+         * This is when the statement was first stepped.
+         */
+        Clock::time_point start;
+
+        /**
+         * This is the number of rows of results produced so far.
+         */
+        uint64_t rows = 0;
+
+        /**
+         * This is the number of nanoseconds spent so far inside calls to
+         * sqlite3_step made through the profiler.
+         */
+        uint64_t stepNanoseconds = 0;
+
+        /**
+         * This indicates whether or not the statement was stepped through
+         * the profiler, so that its steps were timed.
+         */
+        bool stepped = false;
+    };
+
+    /**
+     * Return the number of nanoseconds from the given time until now.
+     *
+     * @param[in] start
+     *     This is the time from which to measure.
+     *
+     * @return
+     *     The number of nanoseconds elapsed since the given time
+     *     is returned.
+     */
+    uint64_t NanosecondsSince(Clock::time_point start) {
+        return (uint64_t)std::chrono::duration_cast< std::chrono::nanoseconds >(
+            Clock::now() - start
+        ).count();
+    }
+
+}
+
+namespace SQLiteWrappers {
+
+    /**
+     * This contains the private properties of a Profiler instance.
+     */
+    struct Profiler::Impl {
+        // Properties
+
+        /**
+         * This is the database connection being profiled.  The raw
+         * connection is held, rather than the caller's handle, so that
+         * the handle may be moved while the connection stays open.
+         */
+        sqlite3* db;
+
+        /**
+         * These are the statements currently being run.  They're only
+         * touched by the thread using the connection.
+         */
+        std::unordered_map< sqlite3_stmt*, Run > runs;
+
+        /**
+         * This is the statement which most recently produced a row,
+         * cached so that a statement producing many rows in a row costs
+         * only a pointer comparison per row.
+         */
+        sqlite3_stmt* lastStmt = nullptr;
+
+        /**
+         * This is the run of the statement which most recently produced
+         * a row.
+         */
+        Run* lastRun = nullptr;
+
+        /**
+         * This is the statement currently being stepped through the
+         * profiler, if any.
+         */
+        sqlite3_stmt* steppingStmt = nullptr;
+
+        /**
+         * This is when the current step through the profiler started.
+         */
+        Clock::time_point stepStart;
+
+        /**
+         * This is used to synchronize access to the profiles.
+         */
+        mutable std::mutex mutex;
+
+        /**
+         * These are the measurements aggregated for each SQL text.
+         */
+        std::unordered_map< std::string, StatementProfile > profiles;
+
+        // Methods
+
+        /**
+         * This is the constructor.
+         *
+         * @param[in] db
+         *     This is the database connection to profile.
+         */
+        explicit Impl(sqlite3* db)
+            : db(db)
+        {
+        }
+
+        /**
+         * Return the profile for the given SQL text, making it if needed.
+         * The mutex must be held.
+         *
+         * @param[in] sql
+         *     This is the SQL text of the statement.
+         *
+         * @return
+         *     The profile for the SQL text is returned.
+         */
+        StatementProfile& GetProfile(const char* sql) {
+            auto& profile = profiles[sql];
+            if (profile.sql.empty()) {
+                profile.sql = sql;
+            }
+            return profile;
+        }
+
+        /**
+         * Note that the given statement has started running.
+         *
+         * @param[in] stmt
+         *     This is the statement which started running.
+         */
+        void StartRun(sqlite3_stmt* stmt) {
+            // A trigger fired by the statement reports the statement
+            // starting again; only the first report counts.
+            Run run;
+            run.start = Clock::now();
+            (void)runs.emplace(stmt, run);
+        }
+
+        /**
+         * Note that the given statement has produced a row of results.
+         *
+         * @param[in] stmt
+         *     This is the statement which produced a row.
+         */
+        void CountRow(sqlite3_stmt* stmt) {
+            if (stmt != lastStmt) {
+                const auto run = runs.find(stmt);
+                if (run == runs.end()) {
+                    return;
+                }
+                lastStmt = stmt;
+                lastRun = &run->second;
+            }
+            ++lastRun->rows;
+        }
+
+        /**
+         * Note that the given statement has finished running, and add
+         * its measurements to the profile for its SQL text.
+         *
+         * @param[in] stmt
+         *     This is the statement which finished running.
+         *
+         * @param[in] reportedNanoseconds
+         *     This is how long SQLite reports the statement took.  It's
+         *     only used if the start of the run wasn't seen, since SQLite
+         *     may only time statements to the millisecond.
+         */
+        void FinishRun(
+            sqlite3_stmt* stmt,
+            sqlite3_int64 reportedNanoseconds
+        ) {
+            uint64_t nanoseconds = (uint64_t)std::max(reportedNanoseconds, (sqlite3_int64)0);
+            uint64_t rows = 0;
+            uint64_t stepNanoseconds = 0;
+            bool stepped = false;
+            const auto run = runs.find(stmt);
+            if (run != runs.end()) {
+                nanoseconds = NanosecondsSince(run->second.start);
+                rows = run->second.rows;
+                stepNanoseconds = run->second.stepNanoseconds;
+                stepped = run->second.stepped;
+                runs.erase(run);
+            }
+
+            // A statement which runs to completion finishes inside its
+            // last step, so the part of that step taken so far counts.
+            if (stmt == steppingStmt) {
+                stepNanoseconds += NanosecondsSince(stepStart);
+                stepped = true;
+                steppingStmt = nullptr;
+            }
+            if (stmt == lastStmt) {
+                lastStmt = nullptr;
+                lastRun = nullptr;
+            }
+            const auto fullscanSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+            const auto sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+            const auto autoindexRows = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+            const auto vmSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+            const auto reprepares = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_REPREPARE, 1);
+            const auto sql = sqlite3_sql(stmt);
+            std::lock_guard< decltype(mutex) > lock(mutex);
+            auto& profile = GetProfile((sql == NULL) ? "" : sql);
+            ++profile.runs;
+            profile.rows += rows;
+            profile.runTime.Record(nanoseconds);
+            if (stepped) {
+                profile.stepTime.Record(stepNanoseconds);
+            }
+            profile.fullscanSteps += (uint64_t)fullscanSteps;
+            profile.sorts += (uint64_t)sorts;
+            profile.autoindexRows += (uint64_t)autoindexRows;
+            profile.vmSteps += (uint64_t)vmSteps;
+            profile.reprepares += (uint64_t)reprepares;
+        }
+
+        /**
+         * This is the function installed as the connection's trace hook.
+         *
+         * @param[in] type
+         *     This identifies the event being traced.
+         *
+         * @param[in] context
+         *     This is the profiler's private properties.
+         *
+         * @param[in] p
+         *     This is the statement involved in the event.
+         *
+         * @param[in] x
+         *     This is extra information about the event, which depends
+         *     on its type.
+         *
+         * @return
+         *     Zero is returned, as SQLite requires.
+         */
+        static int Trace(
+            unsigned int type,
+            void* context,
+            void* p,
+            void* x
+        ) {
+            const auto impl = (Impl*)context;
+            const auto stmt = (sqlite3_stmt*)p;
+            switch (type) {
+                case SQLITE_TRACE_STMT: {
+                    impl->StartRun(stmt);
+                } break;
+
+                case SQLITE_TRACE_ROW: {
+                    impl->CountRow(stmt);
+                } break;
+
+                case SQLITE_TRACE_PROFILE: {
+                    impl->FinishRun(stmt, *(sqlite3_int64*)x);
+                } break;
+
+                default: break;
+            }
+            return 0;
+        }
+    };
+
+    Profiler::~Profiler() noexcept {
+        if (impl_ != nullptr) {
+            (void)sqlite3_trace_v2(impl_->db, 0, NULL, NULL);
+        }
+    }
+
+    Profiler::Profiler(Profiler&&) noexcept = default;
+
+    Profiler& Profiler::operator=(Profiler&& other) noexcept {
+        if (this != &other) {
+            if (impl_ != nullptr) {
+                (void)sqlite3_trace_v2(impl_->db, 0, NULL, NULL);
+            }
+            impl_ = std::move(other.impl_);
+        }
+        return *this;
+    }
+
+    Profiler::Profiler(const DatabaseConnection& db)
+        : impl_(new Impl(db.get()))
+    {
+        (void)sqlite3_trace_v2(
+            db.get(),
+            SQLITE_TRACE_STMT | SQLITE_TRACE_ROW | SQLITE_TRACE_PROFILE,
+            &Impl::Trace,
+            impl_.get()
+        );
+    }
+
+    PreparedStatement Profiler::Prepare(const std::string& sql) {
+        if (impl_ == nullptr) {
+            return nullptr;
+        }
+        const auto start = Clock::now();
+        auto stmt = BuildStatement(impl_->db, sql);
+        const auto nanoseconds = NanosecondsSince(start);
+        const auto stmtSql = (
+            (stmt == nullptr)
+            ? NULL
+            : sqlite3_sql(stmt.get())
+        );
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        auto& profile = impl_->GetProfile(
+            (stmtSql == NULL)
+            ? sql.c_str()
+            : stmtSql
+        );
+        profile.prepareTime.Record(nanoseconds);
+        return stmt;
+    }
+
+    StepStatementResults Profiler::Step(const PreparedStatement& stmt) {
+        if (impl_ == nullptr) {
+            return StepStatement(stmt);
+        }
+        impl_->steppingStmt = stmt.get();
+        impl_->stepStart = Clock::now();
+        const auto results = StepStatement(stmt);
+        if (impl_->steppingStmt == stmt.get()) {
+            impl_->steppingStmt = nullptr;
+            const auto run = impl_->runs.find(stmt.get());
+            if (run != impl_->runs.end()) {
+                run->second.stepNanoseconds += NanosecondsSince(impl_->stepStart);
+                run->second.stepped = true;
+            }
+        }
+        return results;
+    }
+
+    auto Profiler::GetProfiles() const -> std::vector< StatementProfile > {
+        std::vector< StatementProfile > profiles;
+        if (impl_ == nullptr) {
+            return profiles;
+        }
+        {
+            std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+            profiles.reserve(impl_->profiles.size());
+            for (const auto& profile: impl_->profiles) {
+                profiles.push_back(profile.second);
+            }
+        }
+        std::sort(
+            profiles.begin(),
+            profiles.end(),
+            [](const StatementProfile& lhs, const StatementProfile& rhs){
+                return lhs.runTime.GetTotal() > rhs.runTime.GetTotal();
+            }
+        );
+        return profiles;
+    }
+
+    std::string Profiler::Dump() const {
+        if (impl_ == nullptr) {
+            return "";
+        }
+        std::string report = (
+            "    runs       rows     run ms     p50 us     p99 us     max us"
+            "    step ms   step p99 us   prepare us   fullscan    sort  autoidx    vmsteps  reprep  sql\n"
+        );
+        char line[256];
+        for (const auto& profile: GetProfiles()) {
+            (void)snprintf(
+                line,
+                sizeof(line),
+                "%8llu %10llu %10.3f %10.1f %10.1f %10.1f %10.3f %13.1f %12.1f %10llu %7llu %8llu %10llu %7llu  ",
+                (unsigned long long)profile.runs,
+                (unsigned long long)profile.rows,
+                (double)profile.runTime.GetTotal() / 1e6,
+                (double)profile.runTime.GetValueAtPercentile(50.0) / 1e3,
+                (double)profile.runTime.GetValueAtPercentile(99.0) / 1e3,
+                (double)profile.runTime.GetMax() / 1e3,
+                (double)profile.stepTime.GetTotal() / 1e6,
+                (double)profile.stepTime.GetValueAtPercentile(99.0) / 1e3,
+                profile.prepareTime.GetMean() / 1e3,
+                (unsigned long long)profile.fullscanSteps,
+                (unsigned long long)profile.sorts,
+                (unsigned long long)profile.autoindexRows,
+                (unsigned long long)profile.vmSteps,
+                (unsigned long long)profile.reprepares
+            );
+            report += line;
+            if (profile.fullscanSteps != 0) {
+                report += "[FULL SCAN] ";
+            }
+            if (profile.autoindexRows != 0) {
+                report += "[AUTOINDEX] ";
+            }
+            report += profile.sql;
+            report += '\n';
+        }
+        return report;
+    }
+
+    void Profiler::Reset() {
+        if (impl_ == nullptr) {
+            return;
+        }
+        std::lock_guard< decltype(impl_->mutex) > lock(impl_->mutex);
+        impl_->profiles.clear();
+    }
+
+}
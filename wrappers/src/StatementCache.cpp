@@ -0,0 +1,255 @@
+/**
+ * @file StatementCache.cpp
+ *
+ * This module contains the implementation of the
+ * SQLiteWrappers::StatementCache class.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <list>
+#include <SQLiteWrappers/Profiler.hpp>
+#include <SQLiteWrappers/StatementCache.hpp>
+#include <unordered_map>
+
+namespace {
+
+    /**
+     * This is an idle statement held by the cache.
+     */
+    struct Entry {
+        /**
+         * This is the SQL text from which the statement was compiled.
+         */
+        std::string sql;
+
+        /**
+         * This is the idle statement.
+         */
+        SQLiteWrappers::PreparedStatement stmt;
+    };
+
+}
+
+namespace SQLiteWrappers {
+
+    /**
+     * This contains the private properties of a StatementCache instance.
+     */
+    struct StatementCache::Impl {
+        // Properties
+
+        /**
+         * This is the database connection for which to prepare statements.
+         * The raw connection is held, rather than the caller's handle, so
+         * that the handle may be moved while the connection stays open.
+         */
+        sqlite3* db;
+
+        /**
+         * This is the maximum number of idle statements to hold.
+         */
+        size_t capacity;
+
+        /**
+         * These are the idle statements, ordered from most recently used
+         * to least recently used.
+         */
+        std::list< Entry > entries;
+
+        /**
+         * This is used to find idle statements by their SQL text.
+         */
+        std::unordered_map< std::string, std::list< Entry >::iterator > index;
+
+        /**
+         * These are counters which describe how effective the cache
+         * has been.
+         */
+        Statistics statistics;
+
+        /**
+         * If not nullptr, this is used to compile statements, so that it
+         * measures how long each compilation takes.
+         */
+        Profiler* profiler = nullptr;
+
+        // Methods
+
+        /**
+         * This is the constructor.
+         *
+         * @param[in] db
+         *     This is the database connection for which to prepare
+         *     statements.
+         *
+         * @param[in] capacity
+         *     This is the maximum number of idle statements to hold.
+         */
+        Impl(
+            sqlite3* db,
+            size_t capacity
+        )
+            : db(db)
+            , capacity(capacity)
+        {
+        }
+
+        /**
+         * Take back a statement which was borrowed from the cache.
+         *
+         * @param[in] sql
+         *     This is the SQL text from which the statement was compiled.
+         *
+         * @param[in] stmt
+         *     This is the statement being returned.
+         */
+        void Return(
+            std::string&& sql,
+            PreparedStatement&& stmt
+        ) {
+            if (
+                (capacity == 0)
+                || (index.find(sql) != index.end())
+            ) {
+                return;
+            }
+            ResetStatement(stmt);
+            entries.push_front({std::move(sql), std::move(stmt)});
+            (void)index.insert({entries.front().sql, entries.begin()});
+            while (entries.size() > capacity) {
+                (void)index.erase(entries.back().sql);
+                entries.pop_back();
+                ++statistics.evictions;
+            }
+        }
+    };
+
+    CachedStatement::~CachedStatement() noexcept {
+        Release();
+    }
+
+    CachedStatement::CachedStatement(CachedStatement&& other) noexcept
+        : owner_(other.owner_)
+        , sql_(std::move(other.sql_))
+        , stmt_(std::move(other.stmt_))
+    {
+        other.owner_ = nullptr;
+    }
+
+    CachedStatement& CachedStatement::operator=(CachedStatement&& other) noexcept {
+        if (this != &other) {
+            Release();
+            owner_ = other.owner_;
+            sql_ = std::move(other.sql_);
+            stmt_ = std::move(other.stmt_);
+            other.owner_ = nullptr;
+        }
+        return *this;
+    }
+
+    CachedStatement::CachedStatement(
+        StatementCache::Impl* owner,
+        std::string&& sql,
+        PreparedStatement&& stmt
+    )
+        : owner_(owner)
+        , sql_(std::move(sql))
+        , stmt_(std::move(stmt))
+    {
+    }
+
+    const PreparedStatement& CachedStatement::Get() const {
+        return stmt_;
+    }
+
+    CachedStatement::operator const PreparedStatement&() const {
+        return stmt_;
+    }
+
+    CachedStatement::operator bool() const {
+        return (stmt_ != nullptr);
+    }
+
+    void CachedStatement::Release() {
+        if (
+            (owner_ != nullptr)
+            && (stmt_ != nullptr)
+        ) {
+            owner_->Return(std::move(sql_), std::move(stmt_));
+        }
+        owner_ = nullptr;
+        stmt_ = nullptr;
+    }
+
+    StatementCache::~StatementCache() noexcept = default;
+    StatementCache::StatementCache(StatementCache&&) noexcept = default;
+    StatementCache& StatementCache::operator=(StatementCache&&) noexcept = default;
+
+    StatementCache::StatementCache(
+        const DatabaseConnection& db,
+        size_t capacity
+    )
+        : impl_(new Impl(db.get(), capacity))
+    {
+    }
+
+    CachedStatement StatementCache::Acquire(const std::string& sql) {
+        if (impl_ == nullptr) {
+            return CachedStatement(nullptr, std::string(), nullptr);
+        }
+        const auto indexEntry = impl_->index.find(sql);
+        if (indexEntry == impl_->index.end()) {
+            ++impl_->statistics.misses;
+            return CachedStatement(
+                impl_.get(),
+                std::string(sql),
+                (
+                    (impl_->profiler == nullptr)
+                    ? BuildStatement(impl_->db, sql)
+                    : impl_->profiler->Prepare(sql)
+                )
+            );
+        }
+        ++impl_->statistics.hits;
+        const auto entry = indexEntry->second;
+        impl_->index.erase(indexEntry);
+        CachedStatement cachedStatement(
+            impl_.get(),
+            std::move(entry->sql),
+            std::move(entry->stmt)
+        );
+        impl_->entries.erase(entry);
+        return cachedStatement;
+    }
+
+    void StatementCache::SetProfiler(Profiler* profiler) {
+        if (impl_ == nullptr) {
+            return;
+        }
+        impl_->profiler = profiler;
+    }
+
+    void StatementCache::Clear() {
+        if (impl_ == nullptr) {
+            return;
+        }
+        impl_->index.clear();
+        impl_->entries.clear();
+    }
+
+    size_t StatementCache::GetSize() const {
+        if (impl_ == nullptr) {
+            return 0;
+        }
+        return impl_->entries.size();
+    }
+
+    auto StatementCache::GetStatistics() const -> Statistics {
+        if (impl_ == nullptr) {
+            return Statistics();
+        }
+        return impl_->statistics;
+    }
+
+}
@@ -0,0 +1,155 @@
+/**
+ * @file Wrappers.cpp
+ *
+ * This module contains the implementation of the thin C++ wrappers around
+ * the SQLite C API.
+ *
+ * © 2020 by Richard Walters
+ */
+
+#include <SQLiteWrappers/Wrappers.hpp>
+
+namespace SQLiteWrappers {
+
+    static_assert(
+        sizeof(DatabaseConnection) == sizeof(sqlite3*),
+        "DatabaseConnection should be no bigger than a raw pointer"
+    );
+    static_assert(
+        sizeof(PreparedStatement) == sizeof(sqlite3_stmt*),
+        "PreparedStatement should be no bigger than a raw pointer"
+    );
+
+    DatabaseConnection OpenDatabase(const std::string& path) {
+        return OpenDatabase(
+            path,
+            SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE
+        );
+    }
+
+    DatabaseConnection OpenDatabase(
+        const std::string& path,
+        int flags
+    ) {
+        sqlite3* dbRaw;
+        if (sqlite3_open_v2(path.c_str(), &dbRaw, flags, NULL) != SQLITE_OK) {
+            (void)sqlite3_close(dbRaw);
+            return nullptr;
+        }
+        return DatabaseConnection(dbRaw);
+    }
+
+    PreparedStatement BuildStatement(
+        const DatabaseConnection& db,
+        const std::string& statement
+    ) {
+        return BuildStatement(db.get(), statement);
+    }
+
+    PreparedStatement BuildStatement(
+        sqlite3* db,
+        const std::string& statement
+    ) {
+        sqlite3_stmt* statementRaw;
+        if (
+            sqlite3_prepare_v2(
+                db,
+                statement.c_str(),
+                (int)(statement.length() + 1), // sqlite wants count to include the null
+                &statementRaw,
+                NULL
+            ) != SQLITE_OK)
+        {
+            return nullptr;
+        }
+        return PreparedStatement(statementRaw);
+    }
+
+    void BindStatementParameter(
+        const PreparedStatement& stmt,
+        int index,
+        int value
+    ) {
+        (void)sqlite3_bind_int(
+            stmt.get(),
+            index,
+            value
+        );
+    }
+
+    void BindStatementParameter(
+        const PreparedStatement& stmt,
+        int index,
+        const std::string& value
+    ) {
+        (void)sqlite3_bind_text(
+            stmt.get(),
+            index,
+            value.data(),
+            (int)value.length(),
+            SQLITE_TRANSIENT
+        );
+    }
+
+    StepStatementResults StepStatement(const PreparedStatement& stmt) {
+        StepStatementResults results;
+        switch (sqlite3_step(stmt.get())) {
+            case SQLITE_DONE: {
+                results.done = true;
+            } break;
+
+            case SQLITE_ROW: {
+            } break;
+
+            default: {
+                results.error = true;
+            } break;
+        }
+        return results;
+    }
+
+    void ResetStatement(const PreparedStatement& stmt) {
+        (void)sqlite3_reset(stmt.get());
+        (void)sqlite3_clear_bindings(stmt.get());
+    }
+
+    int CountColumns(const PreparedStatement& stmt) {
+        return sqlite3_column_count(stmt.get());
+    }
+
+    std::string ColumnName(
+        const PreparedStatement& stmt,
+        int index
+    ) {
+        return sqlite3_column_name(stmt.get(), index);
+    }
+
+    int FetchColumnInt(
+        const PreparedStatement& stmt,
+        int index
+    ) {
+        return sqlite3_column_int(stmt.get(), index);
+    }
+
+    std::string FetchColumnString(
+        const PreparedStatement& stmt,
+        int index
+    ) {
+        const auto text = (const char*)sqlite3_column_text(stmt.get(), index);
+        if (text == NULL) {
+            return "";
+        }
+        return std::string(
+            text,
+            (size_t)sqlite3_column_bytes(stmt.get(), index)
+        );
+    }
+
+    bool IsColumnNull(
+        const PreparedStatement& stmt,
+        int index
+    ) {
+        return (sqlite3_column_type(stmt.get(), index) == SQLITE_NULL);
+    }
+
+}